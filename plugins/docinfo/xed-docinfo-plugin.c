@@ -20,9 +20,7 @@
  */
 
 #include <config.h>
-#include <string.h> /* For strlen (...) */
 #include <glib/gi18n.h>
-#include <pango/pango-break.h>
 #include <gmodule.h>
 
 #include <xed/xed-window.h>
@@ -31,6 +29,7 @@
 #include <xed/xed-utils.h>
 
 #include "xed-docinfo-plugin.h"
+#include "xed-docinfo-stats.h"
 
 #define MENU_PATH "/MenuBar/ToolsMenu/ToolsOps_2"
 
@@ -54,6 +53,13 @@ struct _XedDocInfoPluginPrivate
     GtkWidget *selected_chars_label;
     GtkWidget *selected_chars_ns_label;
     GtkWidget *selected_bytes_label;
+
+    /* statistics of the document shown in the dialog */
+    XedDocInfoStats *stats;
+    gulong stats_changed_id;
+
+    /* counting of the selection running on the worker */
+    GCancellable *selection_cancellable;
 };
 
 enum
@@ -70,57 +76,21 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedDocInfoPlugin,
                                 0,
                                 G_IMPLEMENT_INTERFACE_DYNAMIC (XED_TYPE_WINDOW_ACTIVATABLE,
                                                                xed_window_activatable_iface_init)
-                                G_ADD_PRIVATE_DYNAMIC (XedDocInfoPlugin))
+                                G_ADD_PRIVATE_DYNAMIC (XedDocInfoPlugin)
+                                _xed_docinfo_stats_register_type (type_module);
+)
 
-static void
-calculate_info (XedDocument *doc,
-                GtkTextIter *start,
-                GtkTextIter *end,
-                gint        *chars,
-                gint        *words,
-                gint        *white_chars,
-                gint        *bytes)
+static gchar *
+format_count (gint64   count,
+              gboolean complete)
 {
-    gchar *text;
-
-    xed_debug (DEBUG_PLUGINS);
-
-    text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (doc), start, end, TRUE);
-
-    *chars = g_utf8_strlen (text, -1);
-    *bytes = strlen (text);
-
-    if (*chars > 0)
+    /* Show that the number is still being computed */
+    if (!complete)
     {
-        PangoLogAttr *attrs;
-        gint i;
-
-        attrs = g_new0 (PangoLogAttr, *chars + 1);
-
-        pango_get_log_attrs (text, -1, 0, pango_language_from_string ("C"), attrs, *chars + 1);
-
-        for (i = 0; i < (*chars); i++)
-        {
-            if (attrs[i].is_white)
-            {
-                ++(*white_chars);
-            }
-
-            if (attrs[i].is_word_start)
-            {
-                ++(*words);
-            }
-        }
-
-        g_free (attrs);
-    }
-    else
-    {
-        *white_chars = 0;
-        *words = 0;
+        return g_strdup_printf ("%" G_GINT64_FORMAT "\u2026", count);
     }
 
-    g_free (text);
+    return g_strdup_printf ("%" G_GINT64_FORMAT, count);
 }
 
 static void
@@ -128,12 +98,10 @@ update_document_info (XedDocInfoPlugin *plugin,
                       XedDocument *doc)
 {
     XedDocInfoPluginPrivate *priv;
-    GtkTextIter start, end;
-    gint words = 0;
-    gint chars = 0;
-    gint white_chars = 0;
+    XedDocInfoCounts counts;
+    gboolean complete;
+    gint64 chars;
     gint lines = 0;
-    gint bytes = 0;
     gchar *tmp_str;
     gchar *doc_name;
 
@@ -141,22 +109,22 @@ update_document_info (XedDocInfoPlugin *plugin,
 
     priv = plugin->priv;
 
-    gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+    complete = xed_docinfo_stats_get_document_counts (priv->stats, &counts);
 
+    /* these two are known by the buffer, no need to wait for the counting */
     lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (doc));
-
-    calculate_info (doc, &start, &end, &chars, &words, &white_chars, &bytes);
+    chars = gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (doc));
 
     if (chars == 0)
     {
         lines = 0;
     }
 
-    xed_debug_message (DEBUG_PLUGINS, "Chars: %d", chars);
+    xed_debug_message (DEBUG_PLUGINS, "Chars: %" G_GINT64_FORMAT, chars);
     xed_debug_message (DEBUG_PLUGINS, "Lines: %d", lines);
-    xed_debug_message (DEBUG_PLUGINS, "Words: %d", words);
-    xed_debug_message (DEBUG_PLUGINS, "Chars non-space: %d", chars - white_chars);
-    xed_debug_message (DEBUG_PLUGINS, "Bytes: %d", bytes);
+    xed_debug_message (DEBUG_PLUGINS, "Words: %" G_GINT64_FORMAT, counts.words);
+    xed_debug_message (DEBUG_PLUGINS, "Chars non-space: %" G_GINT64_FORMAT, counts.chars - counts.white_chars);
+    xed_debug_message (DEBUG_PLUGINS, "Bytes: %" G_GINT64_FORMAT, counts.bytes);
 
     doc_name = xed_document_get_short_name_for_display (doc);
     tmp_str = g_strdup_printf ("<span weight=\"bold\">%s</span>", doc_name);
@@ -168,54 +136,109 @@ update_document_info (XedDocInfoPlugin *plugin,
     gtk_label_set_text (GTK_LABEL (priv->lines_label), tmp_str);
     g_free (tmp_str);
 
-    tmp_str = g_strdup_printf("%d", words);
+    tmp_str = format_count (counts.words, complete);
     gtk_label_set_text (GTK_LABEL (priv->words_label), tmp_str);
     g_free (tmp_str);
 
-    tmp_str = g_strdup_printf("%d", chars);
+    tmp_str = format_count (chars, TRUE);
     gtk_label_set_text (GTK_LABEL (priv->chars_label), tmp_str);
     g_free (tmp_str);
 
-    tmp_str = g_strdup_printf("%d", chars - white_chars);
+    tmp_str = format_count (counts.chars - counts.white_chars, complete);
     gtk_label_set_text (GTK_LABEL (priv->chars_ns_label), tmp_str);
     g_free (tmp_str);
 
-    tmp_str = g_strdup_printf("%d", bytes);
+    tmp_str = format_count (counts.bytes, complete);
     gtk_label_set_text (GTK_LABEL (priv->bytes_label), tmp_str);
     g_free (tmp_str);
 }
 
+static void
+set_selection_counts (XedDocInfoPlugin       *plugin,
+                      const XedDocInfoCounts *counts,
+                      gboolean                complete)
+{
+    XedDocInfoPluginPrivate *priv;
+    gchar *tmp_str;
+
+    priv = plugin->priv;
+
+    xed_debug_message (DEBUG_PLUGINS, "Selected chars: %" G_GINT64_FORMAT, counts->chars);
+    xed_debug_message (DEBUG_PLUGINS, "Selected words: %" G_GINT64_FORMAT, counts->words);
+    xed_debug_message (DEBUG_PLUGINS, "Selected chars non-space: %" G_GINT64_FORMAT, counts->chars - counts->white_chars);
+    xed_debug_message (DEBUG_PLUGINS, "Selected bytes: %" G_GINT64_FORMAT, counts->bytes);
+
+    tmp_str = format_count (counts->words, complete);
+    gtk_label_set_text (GTK_LABEL (priv->selected_words_label), tmp_str);
+    g_free (tmp_str);
+
+    tmp_str = format_count (counts->chars, complete);
+    gtk_label_set_text (GTK_LABEL (priv->selected_chars_label), tmp_str);
+    g_free (tmp_str);
+
+    tmp_str = format_count (counts->chars - counts->white_chars, complete);
+    gtk_label_set_text (GTK_LABEL (priv->selected_chars_ns_label), tmp_str);
+    g_free (tmp_str);
+
+    tmp_str = format_count (counts->bytes, complete);
+    gtk_label_set_text (GTK_LABEL (priv->selected_bytes_label), tmp_str);
+    g_free (tmp_str);
+}
+
+static void
+selection_counted_cb (XedDocInfoStats  *stats,
+                      GAsyncResult     *result,
+                      XedDocInfoPlugin *plugin)
+{
+    XedDocInfoCounts counts;
+
+    /* the dialog was closed or the selection changed in the meantime, in
+     * which case the plugin may be gone already */
+    if (!xed_docinfo_stats_count_range_finish (stats, result, &counts, NULL))
+    {
+        return;
+    }
+
+    g_clear_object (&plugin->priv->selection_cancellable);
+    set_selection_counts (plugin, &counts, TRUE);
+}
+
+static void
+cancel_selection_count (XedDocInfoPlugin *plugin)
+{
+    XedDocInfoPluginPrivate *priv = plugin->priv;
+
+    if (priv->selection_cancellable != NULL)
+    {
+        g_cancellable_cancel (priv->selection_cancellable);
+        g_clear_object (&priv->selection_cancellable);
+    }
+}
+
 static void
 update_selection_info (XedDocInfoPlugin *plugin,
                        XedDocument *doc)
 {
     XedDocInfoPluginPrivate *priv;
+    XedDocInfoCounts counts = { 0 };
     gboolean sel;
     GtkTextIter start, end;
-    gint words = 0;
-    gint chars = 0;
-    gint white_chars = 0;
     gint lines = 0;
-    gint bytes = 0;
     gchar *tmp_str;
 
     xed_debug (DEBUG_PLUGINS);
 
     priv = plugin->priv;
 
+    cancel_selection_count (plugin);
+
     sel = gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
 
     if (sel)
     {
         lines = gtk_text_iter_get_line (&end) - gtk_text_iter_get_line (&start) + 1;
 
-        calculate_info (doc, &start, &end, &chars, &words, &white_chars, &bytes);
-
-        xed_debug_message (DEBUG_PLUGINS, "Selected chars: %d", chars);
         xed_debug_message (DEBUG_PLUGINS, "Selected lines: %d", lines);
-        xed_debug_message (DEBUG_PLUGINS, "Selected words: %d", words);
-        xed_debug_message (DEBUG_PLUGINS, "Selected chars non-space: %d", chars - white_chars);
-        xed_debug_message (DEBUG_PLUGINS, "Selected bytes: %d", bytes);
 
         gtk_widget_set_sensitive (priv->selection_vbox, TRUE);
     }
@@ -226,30 +249,74 @@ update_selection_info (XedDocInfoPlugin *plugin,
         xed_debug_message (DEBUG_PLUGINS, "Selection empty");
     }
 
-    if (chars == 0)
-    {
-        lines = 0;
-    }
-
     tmp_str = g_strdup_printf("%d", lines);
     gtk_label_set_text (GTK_LABEL (priv->selected_lines_label), tmp_str);
     g_free (tmp_str);
 
-    tmp_str = g_strdup_printf("%d", words);
-    gtk_label_set_text (GTK_LABEL (priv->selected_words_label), tmp_str);
-    g_free (tmp_str);
+    /* the other labels are filled in once the selection is counted */
+    set_selection_counts (plugin, &counts, !sel);
 
-    tmp_str = g_strdup_printf("%d", chars);
-    gtk_label_set_text (GTK_LABEL (priv->selected_chars_label), tmp_str);
-    g_free (tmp_str);
+    if (sel)
+    {
+        priv->selection_cancellable = g_cancellable_new ();
+
+        xed_docinfo_stats_count_range_async (priv->stats,
+                                             &start,
+                                             &end,
+                                             priv->selection_cancellable,
+                                             (GAsyncReadyCallback) selection_counted_cb,
+                                             plugin);
+    }
+}
 
-    tmp_str = g_strdup_printf("%d", chars - white_chars);
-    gtk_label_set_text (GTK_LABEL (priv->selected_chars_ns_label), tmp_str);
-    g_free (tmp_str);
+static void
+stats_changed_cb (XedDocInfoStats  *stats,
+                  XedDocInfoPlugin *plugin)
+{
+    XedDocument *doc;
 
-    tmp_str = g_strdup_printf("%d", bytes);
-    gtk_label_set_text (GTK_LABEL (priv->selected_bytes_label), tmp_str);
-    g_free (tmp_str);
+    doc = xed_window_get_active_document (plugin->priv->window);
+
+    if (doc != NULL && plugin->priv->dialog != NULL)
+    {
+        update_document_info (plugin, doc);
+    }
+}
+
+static void
+disconnect_stats (XedDocInfoPlugin *plugin)
+{
+    XedDocInfoPluginPrivate *priv = plugin->priv;
+
+    cancel_selection_count (plugin);
+
+    if (priv->stats != NULL)
+    {
+        g_signal_handler_disconnect (priv->stats, priv->stats_changed_id);
+        g_clear_object (&priv->stats);
+        priv->stats_changed_id = 0;
+    }
+}
+
+/* Keep the dialog live while the document is being counted or edited */
+static void
+connect_stats (XedDocInfoPlugin *plugin,
+               XedDocument      *doc)
+{
+    XedDocInfoPluginPrivate *priv = plugin->priv;
+
+    if (priv->stats != NULL && xed_docinfo_stats_get_document (priv->stats) == doc)
+    {
+        return;
+    }
+
+    disconnect_stats (plugin);
+
+    if (doc != NULL)
+    {
+        priv->stats = xed_docinfo_stats_new (doc);
+        priv->stats_changed_id = g_signal_connect (priv->stats, "changed", G_CALLBACK (stats_changed_cb), plugin);
+    }
 }
 
 static void
@@ -285,6 +352,15 @@ docinfo_dialog_response_cb (GtkDialog        *widget,
     }
 }
 
+/* The document is only counted while the dialog is shown */
+static void
+docinfo_dialog_destroy_cb (GtkWidget        *widget,
+                           XedDocInfoPlugin *plugin)
+{
+    disconnect_stats (plugin);
+    plugin->priv->dialog = NULL;
+}
+
 static void
 create_docinfo_dialog (XedDocInfoPlugin *plugin)
 {
@@ -339,7 +415,7 @@ create_docinfo_dialog (XedDocInfoPlugin *plugin)
     gtk_window_set_transient_for (GTK_WINDOW (priv->dialog), GTK_WINDOW (priv->window));
 
     g_signal_connect (priv->dialog, "destroy",
-                      G_CALLBACK (gtk_widget_destroyed), &priv->dialog);
+                      G_CALLBACK (docinfo_dialog_destroy_cb), plugin);
     g_signal_connect (priv->dialog, "response",
                       G_CALLBACK (docinfo_dialog_response_cb), plugin);
 }
@@ -368,6 +444,7 @@ docinfo_cb (GtkAction        *action,
         gtk_widget_show (GTK_WIDGET (priv->dialog));
     }
 
+    connect_stats (plugin, doc);
     update_document_info (plugin, doc);
     update_selection_info (plugin, doc);
 }
@@ -396,6 +473,7 @@ xed_docinfo_plugin_dispose (GObject *object)
 
     xed_debug_message (DEBUG_PLUGINS, "XedDocInfoPlugin dispose");
 
+    disconnect_stats (plugin);
     g_clear_object (&plugin->priv->action_group);
     g_clear_object (&plugin->priv->window);
 
@@ -464,7 +542,18 @@ update_ui (XedDocInfoPlugin *plugin)
 
     if (priv->dialog != NULL)
     {
+        XedDocument *doc;
+
         gtk_dialog_set_response_sensitive (GTK_DIALOG (priv->dialog), GTK_RESPONSE_OK, (view != NULL));
+
+        doc = xed_window_get_active_document (priv->window);
+        connect_stats (plugin, doc);
+
+        if (doc != NULL)
+        {
+            update_document_info (plugin, doc);
+            update_selection_info (plugin, doc);
+        }
     }
 }
 
@@ -509,6 +598,11 @@ xed_docinfo_plugin_deactivate (XedWindowActivatable *activatable)
     priv = XED_DOCINFO_PLUGIN (activatable)->priv;
     manager = xed_window_get_ui_manager (priv->window);
 
+    if (priv->dialog != NULL)
+    {
+        gtk_widget_destroy (priv->dialog);
+    }
+
     gtk_ui_manager_remove_ui (manager, priv->ui_id);
     gtk_ui_manager_remove_action_group (manager, priv->action_group);
 }
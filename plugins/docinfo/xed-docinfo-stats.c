@@ -0,0 +1,839 @@
+/*
+ * xed-docinfo-stats.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The statistics of a document are kept per chunk of characters. Chunks are
+ * counted on a worker thread and only the chunks touched by an edit are
+ * counted again, so the totals stay up to date while typing without ever
+ * copying the whole buffer at once, even when it is a single long line.
+ *
+ * A chunk may end in the middle of a word, so each one is counted with a few
+ * characters before it, which tell whether its first character starts a
+ * word.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <pango/pango-break.h>
+
+#include <xed/xed-debug.h>
+
+#include "xed-docinfo-stats.h"
+
+/* Number of characters counted together, which also bounds the bytes
+ * copied at once. Chunks are split again once they grow past twice this
+ * size */
+#define CHUNK_CHARS         (64 * 1024)
+
+/* Characters before a chunk looked at to find its first word */
+#define CONTEXT_CHARS       8
+
+#define MAX_JOBS_IN_FLIGHT  4
+#define CHANGED_TIMEOUT     100
+
+typedef enum
+{
+    CHUNK_DIRTY,
+    CHUNK_PENDING,
+    CHUNK_VALID
+} ChunkState;
+
+typedef struct
+{
+    gint              n_chars;
+    ChunkState        state;
+    guint64           version;
+    XedDocInfoCounts  counts;
+} Chunk;
+
+typedef struct
+{
+    gchar            *text;
+    gsize             len;
+    gsize             context_len;
+    guint             index;
+    guint64           version;
+    XedDocInfoCounts  counts;
+} CountJob;
+
+/* The pieces of a range which were not counted yet */
+typedef struct
+{
+    GPtrArray        *pieces;
+    XedDocInfoCounts  counts;
+} RangeJob;
+
+struct _XedDocInfoStatsPrivate
+{
+    XedDocument *doc;
+
+    GArray  *chunks;
+    guint64  last_version;
+
+    /* where the next dispatch resumes looking for dirty chunks */
+    guint    dispatch_index;
+    gint     dispatch_offset;
+    guint    jobs_in_flight;
+
+    gint     insert_offset;
+
+    guint    dispatch_id;
+    guint    changed_id;
+};
+
+enum
+{
+    CHANGED,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedDocInfoStats,
+                                xed_docinfo_stats,
+                                G_TYPE_OBJECT,
+                                0,
+                                G_ADD_PRIVATE_DYNAMIC (XedDocInfoStats))
+
+static void
+counts_add (XedDocInfoCounts       *counts,
+            const XedDocInfoCounts *other)
+{
+    counts->chars += other->chars;
+    counts->words += other->words;
+    counts->white_chars += other->white_chars;
+    counts->bytes += other->bytes;
+}
+
+/* Counts @text past its first @context_len bytes, which only serve to find
+ * whether the first character counted starts a word */
+static void
+count_text (const gchar      *text,
+            gsize             len,
+            gsize             context_len,
+            XedDocInfoCounts *counts)
+{
+    PangoLogAttr *attrs;
+    glong n_chars;
+    glong n_context_chars;
+    glong i;
+
+    n_chars = g_utf8_strlen (text, len);
+    n_context_chars = g_utf8_strlen (text, context_len);
+
+    counts->chars += n_chars - n_context_chars;
+    counts->bytes += len - context_len;
+
+    if (n_chars == n_context_chars)
+    {
+        return;
+    }
+
+    attrs = g_new0 (PangoLogAttr, n_chars + 1);
+
+    pango_get_log_attrs (text, len, 0, pango_language_from_string ("C"), attrs, n_chars + 1);
+
+    for (i = n_context_chars; i < n_chars; i++)
+    {
+        if (attrs[i].is_white)
+        {
+            counts->white_chars++;
+        }
+
+        if (attrs[i].is_word_start)
+        {
+            counts->words++;
+        }
+    }
+
+    g_free (attrs);
+}
+
+static void
+count_job_free (CountJob *job)
+{
+    g_free (job->text);
+    g_slice_free (CountJob, job);
+}
+
+static gboolean
+emit_changed (XedDocInfoStats *stats)
+{
+    stats->priv->changed_id = 0;
+
+    g_signal_emit (stats, signals[CHANGED], 0);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+queue_changed (XedDocInfoStats *stats)
+{
+    if (stats->priv->changed_id == 0)
+    {
+        stats->priv->changed_id = g_timeout_add (CHANGED_TIMEOUT, (GSourceFunc) emit_changed, stats);
+    }
+}
+
+static gboolean dispatch_jobs (XedDocInfoStats *stats);
+
+static void
+schedule_dispatch (XedDocInfoStats *stats)
+{
+    if (stats->priv->dispatch_id == 0 && stats->priv->doc != NULL)
+    {
+        stats->priv->dispatch_id = g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc) dispatch_jobs, stats, NULL);
+    }
+}
+
+static void
+count_job_thread (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+    CountJob *job = task_data;
+
+    count_text (job->text, job->len, job->context_len, &job->counts);
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+range_job_free (RangeJob *job)
+{
+    g_ptr_array_free (job->pieces, TRUE);
+    g_slice_free (RangeJob, job);
+}
+
+static void
+range_job_thread (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+    RangeJob *job = task_data;
+    guint i;
+
+    for (i = 0; i < job->pieces->len; i++)
+    {
+        CountJob *piece = g_ptr_array_index (job->pieces, i);
+
+        if (g_task_return_error_if_cancelled (task))
+        {
+            return;
+        }
+
+        count_text (piece->text, piece->len, piece->context_len, &job->counts);
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static Chunk *
+find_chunk_by_version (XedDocInfoStats *stats,
+                       guint            index,
+                       guint64          version)
+{
+    GArray *chunks = stats->priv->chunks;
+    guint i;
+
+    /* the index only changes when an edit splits or merges chunks */
+    if (index < chunks->len && g_array_index (chunks, Chunk, index).version == version)
+    {
+        return &g_array_index (chunks, Chunk, index);
+    }
+
+    for (i = 0; i < chunks->len; i++)
+    {
+        if (g_array_index (chunks, Chunk, i).version == version)
+        {
+            return &g_array_index (chunks, Chunk, i);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+count_job_ready (GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+    XedDocInfoStats *stats = XED_DOCINFO_STATS (source);
+    CountJob *job;
+    Chunk *chunk;
+
+    stats->priv->jobs_in_flight--;
+
+    /* the stats were disposed while the job was running */
+    if (!g_task_propagate_boolean (G_TASK (result), NULL) || stats->priv->doc == NULL)
+    {
+        return;
+    }
+
+    job = g_task_get_task_data (G_TASK (result));
+
+    /* the chunk is gone or was edited again while it was being counted */
+    chunk = find_chunk_by_version (stats, job->index, job->version);
+    if (chunk != NULL && chunk->state == CHUNK_PENDING)
+    {
+        chunk->counts = job->counts;
+        chunk->state = CHUNK_VALID;
+        queue_changed (stats);
+    }
+
+    schedule_dispatch (stats);
+}
+
+/* The text from a few characters before @start, at most back to @limit.
+ * @context_len is set to the bytes before @start */
+static gchar *
+get_text_with_context (const GtkTextIter *limit,
+                       const GtkTextIter *start,
+                       const GtkTextIter *end,
+                       gsize             *context_len)
+{
+    GtkTextIter context_start = *start;
+    gchar *context;
+    gchar *text;
+
+    gtk_text_iter_backward_chars (&context_start, CONTEXT_CHARS);
+
+    if (gtk_text_iter_compare (&context_start, limit) < 0)
+    {
+        context_start = *limit;
+    }
+
+    context = gtk_text_iter_get_slice (&context_start, start);
+    text = gtk_text_iter_get_slice (&context_start, end);
+
+    *context_len = strlen (context);
+    g_free (context);
+
+    return text;
+}
+
+static void
+start_count_job (XedDocInfoStats *stats,
+                 guint            index,
+                 gint             offset)
+{
+    GtkTextBuffer *buffer = GTK_TEXT_BUFFER (stats->priv->doc);
+    Chunk *chunk = &g_array_index (stats->priv->chunks, Chunk, index);
+    GtkTextIter doc_start, start, end;
+    CountJob *job;
+    GTask *task;
+
+    gtk_text_buffer_get_start_iter (buffer, &doc_start);
+    gtk_text_buffer_get_iter_at_offset (buffer, &start, offset);
+    gtk_text_buffer_get_iter_at_offset (buffer, &end, offset + chunk->n_chars);
+
+    job = g_slice_new0 (CountJob);
+    job->text = get_text_with_context (&doc_start, &start, &end, &job->context_len);
+    job->len = strlen (job->text);
+    job->index = index;
+    job->version = chunk->version;
+
+    chunk->state = CHUNK_PENDING;
+    stats->priv->jobs_in_flight++;
+
+    task = g_task_new (stats, NULL, count_job_ready, NULL);
+    g_task_set_task_data (task, job, (GDestroyNotify) count_job_free);
+    g_task_run_in_thread (task, count_job_thread);
+    g_object_unref (task);
+}
+
+static gboolean
+dispatch_jobs (XedDocInfoStats *stats)
+{
+    XedDocInfoStatsPrivate *priv = stats->priv;
+
+    priv->dispatch_id = 0;
+
+    if (priv->doc == NULL)
+    {
+        return G_SOURCE_REMOVE;
+    }
+
+    while (priv->dispatch_index < priv->chunks->len && priv->jobs_in_flight < MAX_JOBS_IN_FLIGHT)
+    {
+        Chunk *chunk = &g_array_index (priv->chunks, Chunk, priv->dispatch_index);
+        gint n_chars = chunk->n_chars;
+
+        if (chunk->state == CHUNK_DIRTY)
+        {
+            start_count_job (stats, priv->dispatch_index, priv->dispatch_offset);
+        }
+
+        priv->dispatch_index++;
+        priv->dispatch_offset += n_chars;
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+restart_dispatch (XedDocInfoStats *stats)
+{
+    stats->priv->dispatch_index = 0;
+    stats->priv->dispatch_offset = 0;
+
+    schedule_dispatch (stats);
+}
+
+/* The chunk holding @offset, and where it starts */
+static guint
+find_chunk_for_offset (XedDocInfoStats *stats,
+                       gint             offset,
+                       gint            *chunk_start)
+{
+    GArray *chunks = stats->priv->chunks;
+    gint chunk_end = 0;
+    guint i;
+
+    for (i = 0; i + 1 < chunks->len; i++)
+    {
+        gint n_chars = g_array_index (chunks, Chunk, i).n_chars;
+
+        if (offset < chunk_end + n_chars)
+        {
+            break;
+        }
+
+        chunk_end += n_chars;
+    }
+
+    *chunk_start = chunk_end;
+
+    return i;
+}
+
+static void
+append_chunks (GArray  *chunks,
+               guint    index,
+               gint     n_chars,
+               guint64 *last_version)
+{
+    do
+    {
+        Chunk chunk = { 0 };
+
+        chunk.n_chars = MIN (n_chars, CHUNK_CHARS);
+        chunk.state = CHUNK_DIRTY;
+        chunk.version = ++(*last_version);
+
+        g_array_insert_val (chunks, index, chunk);
+
+        index++;
+        n_chars -= chunk.n_chars;
+    } while (n_chars > 0);
+}
+
+static void
+invalidate_chunk (XedDocInfoStats *stats,
+                  guint            index)
+{
+    XedDocInfoStatsPrivate *priv = stats->priv;
+    Chunk *chunk = &g_array_index (priv->chunks, Chunk, index);
+
+    if (chunk->n_chars > 2 * CHUNK_CHARS)
+    {
+        gint n_chars = chunk->n_chars;
+
+        g_array_remove_index (priv->chunks, index);
+        append_chunks (priv->chunks, index, n_chars, &priv->last_version);
+    }
+    else
+    {
+        chunk->state = CHUNK_DIRTY;
+        chunk->version = ++priv->last_version;
+    }
+}
+
+/* Invalidates the chunk an edit ending at @edit_end was made in, and the
+ * next one when the edit may have changed its first word */
+static void
+invalidate_edited_chunk (XedDocInfoStats *stats,
+                         guint            index,
+                         gint             chunk_start,
+                         gint             edit_end)
+{
+    GArray *chunks = stats->priv->chunks;
+    gint chunk_end = chunk_start + g_array_index (chunks, Chunk, index).n_chars;
+
+    if (index + 1 < chunks->len && chunk_end - edit_end < CONTEXT_CHARS)
+    {
+        invalidate_chunk (stats, index + 1);
+    }
+
+    invalidate_chunk (stats, index);
+
+    restart_dispatch (stats);
+}
+
+static void
+insert_text_cb (GtkTextBuffer *buffer,
+                GtkTextIter   *location,
+                const gchar   *text,
+                gint           len,
+                XedDocInfoStats *stats)
+{
+    stats->priv->insert_offset = gtk_text_iter_get_offset (location);
+}
+
+static void
+insert_text_after_cb (GtkTextBuffer *buffer,
+                      GtkTextIter   *location,
+                      const gchar   *text,
+                      gint           len,
+                      XedDocInfoStats *stats)
+{
+    gint chunk_start;
+    gint edit_end;
+    guint index;
+
+    /* location now points at the end of the inserted text */
+    edit_end = gtk_text_iter_get_offset (location);
+    index = find_chunk_for_offset (stats, stats->priv->insert_offset, &chunk_start);
+    g_array_index (stats->priv->chunks, Chunk, index).n_chars += edit_end - stats->priv->insert_offset;
+
+    invalidate_edited_chunk (stats, index, chunk_start, edit_end);
+}
+
+static void
+delete_range_cb (GtkTextBuffer   *buffer,
+                 GtkTextIter     *start,
+                 GtkTextIter     *end,
+                 XedDocInfoStats *stats)
+{
+    GArray *chunks = stats->priv->chunks;
+    gint start_offset;
+    gint end_offset;
+    gint chunk_start;
+    gint last_start;
+    guint first;
+    guint last;
+    gint n_chars = 0;
+    guint i;
+
+    start_offset = gtk_text_iter_get_offset (start);
+    end_offset = gtk_text_iter_get_offset (end);
+
+    first = find_chunk_for_offset (stats, start_offset, &chunk_start);
+    last = find_chunk_for_offset (stats, end_offset, &last_start);
+
+    /* merge the chunks the deletion spans into the first one */
+    for (i = first; i <= last; i++)
+    {
+        n_chars += g_array_index (chunks, Chunk, i).n_chars;
+    }
+
+    if (last > first)
+    {
+        g_array_remove_range (chunks, first + 1, last - first);
+    }
+
+    g_array_index (chunks, Chunk, first).n_chars = n_chars - (end_offset - start_offset);
+
+    invalidate_edited_chunk (stats, first, chunk_start, start_offset);
+}
+
+static void
+xed_docinfo_stats_dispose (GObject *object)
+{
+    XedDocInfoStats *stats = XED_DOCINFO_STATS (object);
+
+    if (stats->priv->doc != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (stats->priv->doc, stats);
+        g_object_remove_weak_pointer (G_OBJECT (stats->priv->doc), (gpointer *) &stats->priv->doc);
+        stats->priv->doc = NULL;
+    }
+
+    if (stats->priv->dispatch_id != 0)
+    {
+        g_source_remove (stats->priv->dispatch_id);
+        stats->priv->dispatch_id = 0;
+    }
+
+    if (stats->priv->changed_id != 0)
+    {
+        g_source_remove (stats->priv->changed_id);
+        stats->priv->changed_id = 0;
+    }
+
+    G_OBJECT_CLASS (xed_docinfo_stats_parent_class)->dispose (object);
+}
+
+static void
+xed_docinfo_stats_finalize (GObject *object)
+{
+    XedDocInfoStats *stats = XED_DOCINFO_STATS (object);
+
+    g_array_free (stats->priv->chunks, TRUE);
+
+    G_OBJECT_CLASS (xed_docinfo_stats_parent_class)->finalize (object);
+}
+
+static void
+xed_docinfo_stats_class_init (XedDocInfoStatsClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = xed_docinfo_stats_dispose;
+    object_class->finalize = xed_docinfo_stats_finalize;
+
+    signals[CHANGED] =
+        g_signal_new ("changed",
+                      G_OBJECT_CLASS_TYPE (object_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XedDocInfoStatsClass, changed),
+                      NULL, NULL,
+                      g_cclosure_marshal_VOID__VOID,
+                      G_TYPE_NONE,
+                      0);
+}
+
+static void
+xed_docinfo_stats_class_finalize (XedDocInfoStatsClass *klass)
+{
+    /* dummy function - used by G_DEFINE_DYNAMIC_TYPE_EXTENDED */
+}
+
+static void
+xed_docinfo_stats_init (XedDocInfoStats *stats)
+{
+    stats->priv = xed_docinfo_stats_get_instance_private (stats);
+    stats->priv->chunks = g_array_new (FALSE, FALSE, sizeof (Chunk));
+}
+
+/**
+ * xed_docinfo_stats_new:
+ * @doc: a #XedDocument
+ *
+ * Creates the statistics engine of @doc. Counting starts in the background
+ * right away and follows the edits of @doc until the engine is disposed.
+ *
+ * Returns: a new #XedDocInfoStats
+ */
+XedDocInfoStats *
+xed_docinfo_stats_new (XedDocument *doc)
+{
+    XedDocInfoStats *stats;
+
+    g_return_val_if_fail (XED_IS_DOCUMENT (doc), NULL);
+
+    xed_debug (DEBUG_PLUGINS);
+
+    stats = g_object_new (XED_TYPE_DOCINFO_STATS, NULL);
+    stats->priv->doc = doc;
+    g_object_add_weak_pointer (G_OBJECT (doc), (gpointer *) &stats->priv->doc);
+
+    append_chunks (stats->priv->chunks, 0,
+                   gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (doc)),
+                   &stats->priv->last_version);
+
+    g_signal_connect (doc, "insert-text", G_CALLBACK (insert_text_cb), stats);
+    g_signal_connect_after (doc, "insert-text", G_CALLBACK (insert_text_after_cb), stats);
+    g_signal_connect (doc, "delete-range", G_CALLBACK (delete_range_cb), stats);
+
+    restart_dispatch (stats);
+
+    return stats;
+}
+
+/**
+ * xed_docinfo_stats_get_document:
+ * @stats: a #XedDocInfoStats
+ *
+ * Returns: (transfer none): the document counted by @stats, or %NULL if it
+ * was finalized
+ */
+XedDocument *
+xed_docinfo_stats_get_document (XedDocInfoStats *stats)
+{
+    g_return_val_if_fail (XED_IS_DOCINFO_STATS (stats), NULL);
+
+    return stats->priv->doc;
+}
+
+/**
+ * xed_docinfo_stats_get_document_counts:
+ * @stats: a #XedDocInfoStats
+ * @counts: (out): return location for the counts
+ *
+ * Gets the counts of the whole document. Chunks which are still being
+ * counted contribute their last known value.
+ *
+ * Returns: %TRUE if every chunk is up to date
+ */
+gboolean
+xed_docinfo_stats_get_document_counts (XedDocInfoStats  *stats,
+                                       XedDocInfoCounts *counts)
+{
+    GArray *chunks;
+    gboolean complete = TRUE;
+    guint i;
+
+    g_return_val_if_fail (XED_IS_DOCINFO_STATS (stats), FALSE);
+    g_return_val_if_fail (counts != NULL, FALSE);
+
+    memset (counts, 0, sizeof (XedDocInfoCounts));
+    chunks = stats->priv->chunks;
+
+    for (i = 0; i < chunks->len; i++)
+    {
+        Chunk *chunk = &g_array_index (chunks, Chunk, i);
+
+        counts_add (counts, &chunk->counts);
+        complete = complete && chunk->state == CHUNK_VALID;
+    }
+
+    return complete;
+}
+
+/**
+ * xed_docinfo_stats_count_range_async:
+ * @stats: a #XedDocInfoStats
+ * @start: start of the range
+ * @end: end of the range
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the range
+ *   is counted
+ * @user_data: (closure): the data to pass to the callback function
+ *
+ * Counts the text between @start and @end. Chunks entirely covered by the
+ * range and already counted are not looked at again; the text of the other
+ * pieces is copied, at most a chunk at a time, and counted on a worker
+ * thread.
+ */
+void
+xed_docinfo_stats_count_range_async (XedDocInfoStats     *stats,
+                                     const GtkTextIter   *start,
+                                     const GtkTextIter   *end,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data)
+{
+    GtkTextBuffer *buffer;
+    GArray *chunks;
+    RangeJob *job;
+    GTask *task;
+    gint start_offset;
+    gint end_offset;
+    gint offset = 0;
+    guint i;
+
+    g_return_if_fail (XED_IS_DOCINFO_STATS (stats));
+    g_return_if_fail (stats->priv->doc != NULL);
+
+    buffer = GTK_TEXT_BUFFER (stats->priv->doc);
+    chunks = stats->priv->chunks;
+    start_offset = gtk_text_iter_get_offset (start);
+    end_offset = gtk_text_iter_get_offset (end);
+
+    job = g_slice_new0 (RangeJob);
+    job->pieces = g_ptr_array_new_with_free_func ((GDestroyNotify) count_job_free);
+
+    for (i = 0; i < chunks->len && offset < end_offset; i++)
+    {
+        Chunk *chunk = &g_array_index (chunks, Chunk, i);
+        GtkTextIter piece_start, piece_end;
+        CountJob *piece;
+
+        offset += chunk->n_chars;
+
+        if (offset <= start_offset)
+        {
+            continue;
+        }
+
+        if (chunk->state == CHUNK_VALID &&
+            offset - chunk->n_chars >= start_offset &&
+            offset <= end_offset)
+        {
+            counts_add (&job->counts, &chunk->counts);
+            continue;
+        }
+
+        gtk_text_buffer_get_iter_at_offset (buffer, &piece_start, MAX (offset - chunk->n_chars, start_offset));
+        gtk_text_buffer_get_iter_at_offset (buffer, &piece_end, MIN (offset, end_offset));
+
+        /* a word started before the range is counted, but only once */
+        piece = g_slice_new0 (CountJob);
+        piece->text = get_text_with_context (start, &piece_start, &piece_end, &piece->context_len);
+        piece->len = strlen (piece->text);
+
+        g_ptr_array_add (job->pieces, piece);
+    }
+
+    task = g_task_new (stats, cancellable, callback, user_data);
+    g_task_set_task_data (task, job, (GDestroyNotify) range_job_free);
+
+    if (job->pieces->len == 0)
+    {
+        g_task_return_boolean (task, TRUE);
+    }
+    else
+    {
+        g_task_run_in_thread (task, range_job_thread);
+    }
+
+    g_object_unref (task);
+}
+
+/**
+ * xed_docinfo_stats_count_range_finish:
+ * @stats: a #XedDocInfoStats
+ * @result: a #GAsyncResult
+ * @counts: (out): return location for the counts
+ * @error: a #GError, or %NULL
+ *
+ * Finishes a count started with xed_docinfo_stats_count_range_async().
+ *
+ * Returns: %TRUE if @counts was set, %FALSE if the count was cancelled
+ */
+gboolean
+xed_docinfo_stats_count_range_finish (XedDocInfoStats   *stats,
+                                      GAsyncResult      *result,
+                                      XedDocInfoCounts  *counts,
+                                      GError           **error)
+{
+    RangeJob *job;
+
+    g_return_val_if_fail (g_task_is_valid (result, stats), FALSE);
+    g_return_val_if_fail (counts != NULL, FALSE);
+
+    if (!g_task_propagate_boolean (G_TASK (result), error))
+    {
+        return FALSE;
+    }
+
+    job = g_task_get_task_data (G_TASK (result));
+    *counts = job->counts;
+
+    return TRUE;
+}
+
+void
+_xed_docinfo_stats_register_type (GTypeModule *type_module)
+{
+    xed_docinfo_stats_register_type (type_module);
+}
@@ -0,0 +1,88 @@
+/*
+ * xed-docinfo-stats.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_DOCINFO_STATS_H__
+#define __XED_DOCINFO_STATS_H__
+
+#include <glib-object.h>
+#include <gio/gio.h>
+#include <xed/xed-document.h>
+
+G_BEGIN_DECLS
+
+#define XED_TYPE_DOCINFO_STATS              (xed_docinfo_stats_get_type ())
+#define XED_DOCINFO_STATS(obj)              (G_TYPE_CHECK_INSTANCE_CAST ((obj), XED_TYPE_DOCINFO_STATS, XedDocInfoStats))
+#define XED_DOCINFO_STATS_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), XED_TYPE_DOCINFO_STATS, XedDocInfoStatsClass))
+#define XED_IS_DOCINFO_STATS(obj)           (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XED_TYPE_DOCINFO_STATS))
+#define XED_IS_DOCINFO_STATS_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), XED_TYPE_DOCINFO_STATS))
+#define XED_DOCINFO_STATS_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), XED_TYPE_DOCINFO_STATS, XedDocInfoStatsClass))
+
+typedef struct _XedDocInfoStats        XedDocInfoStats;
+typedef struct _XedDocInfoStatsClass   XedDocInfoStatsClass;
+typedef struct _XedDocInfoStatsPrivate XedDocInfoStatsPrivate;
+
+typedef struct _XedDocInfoCounts XedDocInfoCounts;
+
+struct _XedDocInfoCounts
+{
+    gint64 chars;
+    gint64 words;
+    gint64 white_chars;
+    gint64 bytes;
+};
+
+struct _XedDocInfoStats
+{
+    GObject parent;
+
+    XedDocInfoStatsPrivate *priv;
+};
+
+struct _XedDocInfoStatsClass
+{
+    GObjectClass parent_class;
+
+    /* Signals */
+    void (* changed) (XedDocInfoStats *stats);
+};
+
+GType            xed_docinfo_stats_get_type                 (void) G_GNUC_CONST;
+void             _xed_docinfo_stats_register_type           (GTypeModule *type_module);
+
+XedDocInfoStats *xed_docinfo_stats_new                      (XedDocument         *doc);
+
+XedDocument     *xed_docinfo_stats_get_document             (XedDocInfoStats     *stats);
+
+gboolean         xed_docinfo_stats_get_document_counts      (XedDocInfoStats     *stats,
+                                                             XedDocInfoCounts    *counts);
+
+void             xed_docinfo_stats_count_range_async        (XedDocInfoStats     *stats,
+                                                             const GtkTextIter   *start,
+                                                             const GtkTextIter   *end,
+                                                             GCancellable        *cancellable,
+                                                             GAsyncReadyCallback  callback,
+                                                             gpointer             user_data);
+gboolean         xed_docinfo_stats_count_range_finish       (XedDocInfoStats     *stats,
+                                                             GAsyncResult        *result,
+                                                             XedDocInfoCounts    *counts,
+                                                             GError             **error);
+
+G_END_DECLS
+
+#endif /* __XED_DOCINFO_STATS_H__ */
@@ -0,0 +1,1185 @@
+/*
+ * xed-file-browser-index.c - Xed plugin providing easy file access
+ * from the sidepanel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <xed/xed-dirs.h>
+
+#include "xed-file-browser-index.h"
+
+/*
+ * The index keeps every file below the root as a path relative to it.  The
+ * paths live back to back in a single string pool, and each one has a fixed
+ * size entry with a mask of the characters it contains.  A query first
+ * rejects every path that lacks one of its characters, which costs a single
+ * AND per path, and only scores the survivors.
+ *
+ * The crawl runs on a worker thread and produces a new snapshot which is
+ * swapped in once it is complete.  Changes reported by the store in between
+ * are kept as small added and removed sets on top of the snapshot.
+ */
+
+/* Stop crawling after this many files */
+#define INDEX_MAX_PATHS (1 << 21)
+
+/* Crawl again once this many changes were made on top of the snapshot */
+#define INDEX_MAX_CHANGES 4096
+
+/* Seconds to wait before crawling again after a directory was created */
+#define INDEX_RESCAN_DELAY 2
+
+#define INDEX_CACHE_MAGIC "XEDFBIDX1"
+
+#define INDEX_QUERY_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+                               G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+                               G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+                               G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP
+
+typedef struct
+{
+    guint32 offset;     /* start of the path in the pool */
+    guint16 length;
+    guint16 basename;   /* start of the basename within the path */
+    guint64 mask;
+} IndexEntry;
+
+typedef struct
+{
+    GString *pool;
+    GArray *entries;
+} IndexSnapshot;
+
+typedef struct
+{
+    GFile *root;
+    gchar *cache_filename;
+    gboolean load_cache;
+} CrawlData;
+
+typedef struct
+{
+    XedFileBrowserIndex *index;
+    GCancellable *cancellable;
+    IndexSnapshot *snapshot;
+} PublishData;
+
+typedef struct
+{
+    const gchar *path;
+    guint length;
+    gint score;
+} IndexMatch;
+
+typedef struct
+{
+    XedFileBrowserIndex *index;
+    GFile *root;
+    gchar *path;
+} CreatedData;
+
+struct _XedFileBrowserIndexPrivate
+{
+    GFile *root;
+    IndexSnapshot *snapshot;
+
+    GHashTable *added;
+    GHashTable *removed;
+
+    GCancellable *cancellable;
+    guint rescan_id;
+
+    /* The snapshot entries matching the previous query, which a query
+     * extending it only has to look at again */
+    gchar *last_query;
+    GArray *last_matches;
+};
+
+enum
+{
+    CHANGED,
+    NUM_SIGNALS
+};
+
+static guint signals[NUM_SIGNALS] = { 0 };
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedFileBrowserIndex,
+                                xed_file_browser_index,
+                                G_TYPE_OBJECT,
+                                0,
+                                G_ADD_PRIVATE_DYNAMIC (XedFileBrowserIndex))
+
+static inline guint64
+char_mask (guchar c)
+{
+    c = g_ascii_tolower (c);
+
+    if (c >= 'a' && c <= 'z')
+    {
+        return G_GUINT64_CONSTANT (1) << (c - 'a');
+    }
+
+    if (c >= '0' && c <= '9')
+    {
+        return G_GUINT64_CONSTANT (1) << (26 + c - '0');
+    }
+
+    return G_GUINT64_CONSTANT (1) << (36 + c % 28);
+}
+
+static guint64
+path_mask (const gchar *path,
+           gsize        length)
+{
+    guint64 mask = 0;
+    gsize i;
+
+    for (i = 0; i < length; i++)
+    {
+        mask |= char_mask (path[i]);
+    }
+
+    return mask;
+}
+
+static gboolean
+name_is_indexed (const gchar *name,
+                 gsize        length)
+{
+    return length > 0 && name[0] != '.' && name[length - 1] != '~';
+}
+
+static gboolean
+path_is_indexed (const gchar *path)
+{
+    const gchar *start = path;
+    const gchar *end;
+
+    while ((end = strchr (start, '/')) != NULL)
+    {
+        if (!name_is_indexed (start, end - start))
+        {
+            return FALSE;
+        }
+
+        start = end + 1;
+    }
+
+    return name_is_indexed (start, strlen (start));
+}
+
+static IndexSnapshot *
+snapshot_new (void)
+{
+    IndexSnapshot *snapshot;
+
+    snapshot = g_slice_new (IndexSnapshot);
+    snapshot->pool = g_string_sized_new (4096);
+    snapshot->entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+
+    return snapshot;
+}
+
+static void
+snapshot_free (IndexSnapshot *snapshot)
+{
+    if (snapshot == NULL)
+    {
+        return;
+    }
+
+    g_string_free (snapshot->pool, TRUE);
+    g_array_free (snapshot->entries, TRUE);
+    g_slice_free (IndexSnapshot, snapshot);
+}
+
+static gboolean
+snapshot_add (IndexSnapshot *snapshot,
+              const gchar   *path)
+{
+    IndexEntry entry;
+    const gchar *base;
+    gsize length;
+
+    if (snapshot->entries->len >= INDEX_MAX_PATHS)
+    {
+        return FALSE;
+    }
+
+    length = strlen (path);
+
+    if (length == 0 || length > G_MAXUINT16 ||
+        snapshot->pool->len + length + 1 > G_MAXUINT32)
+    {
+        return TRUE;
+    }
+
+    base = strrchr (path, '/');
+
+    entry.offset = snapshot->pool->len;
+    entry.length = length;
+    entry.basename = base != NULL ? base - path + 1 : 0;
+    entry.mask = path_mask (path, length);
+
+    /* Keep the terminating nul, so paths can be used straight from the pool */
+    g_string_append_len (snapshot->pool, path, length + 1);
+    g_array_append_val (snapshot->entries, entry);
+
+    return TRUE;
+}
+
+static gchar *
+get_cache_filename (GFile *root)
+{
+    gchar *uri;
+    gchar *checksum;
+    gchar *name;
+    gchar *filename;
+
+    uri = g_file_get_uri (root);
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+    name = g_strconcat (checksum, ".index", NULL);
+
+    filename = g_build_filename (xed_dirs_get_user_cache_dir (), "filebrowser", name, NULL);
+
+    g_free (name);
+    g_free (checksum);
+    g_free (uri);
+
+    return filename;
+}
+
+/* The cache holds a header line, the uri of the root on its own line and
+ * then the nul separated paths, which is exactly the pool of a snapshot */
+static IndexSnapshot *
+snapshot_load (const gchar *filename,
+               GFile       *root)
+{
+    IndexSnapshot *snapshot;
+    gchar *contents;
+    gsize length;
+    gchar *header;
+    gchar *uri;
+    const gchar *ptr;
+    const gchar *end;
+
+    if (!g_file_get_contents (filename, &contents, &length, NULL))
+    {
+        return NULL;
+    }
+
+    uri = g_file_get_uri (root);
+    header = g_strdup_printf ("%s\n%s\n", INDEX_CACHE_MAGIC, uri);
+    g_free (uri);
+
+    if (length < strlen (header) || strncmp (contents, header, strlen (header)) != 0)
+    {
+        g_free (header);
+        g_free (contents);
+        return NULL;
+    }
+
+    snapshot = snapshot_new ();
+
+    ptr = contents + strlen (header);
+    end = contents + length;
+
+    while (ptr < end)
+    {
+        const gchar *next = memchr (ptr, '\0', end - ptr);
+
+        if (next == NULL || !snapshot_add (snapshot, ptr))
+        {
+            break;
+        }
+
+        ptr = next + 1;
+    }
+
+    g_free (header);
+    g_free (contents);
+
+    return snapshot;
+}
+
+static void
+snapshot_save (IndexSnapshot *snapshot,
+               const gchar   *filename,
+               GFile         *root)
+{
+    GString *contents;
+    gchar *dirname;
+    gchar *uri;
+    GError *error = NULL;
+
+    dirname = g_path_get_dirname (filename);
+
+    if (g_mkdir_with_parents (dirname, 0755) != 0)
+    {
+        g_free (dirname);
+        return;
+    }
+
+    g_free (dirname);
+
+    uri = g_file_get_uri (root);
+    contents = g_string_sized_new (snapshot->pool->len + strlen (uri) + 16);
+    g_string_append_printf (contents, "%s\n%s\n", INDEX_CACHE_MAGIC, uri);
+    g_string_append_len (contents, snapshot->pool->str, snapshot->pool->len);
+    g_free (uri);
+
+    if (!g_file_set_contents (filename, contents->str, contents->len, &error))
+    {
+        g_warning ("Could not save the file browser index: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_string_free (contents, TRUE);
+}
+
+static IndexSnapshot *
+crawl (GFile        *root,
+       GCancellable *cancellable)
+{
+    IndexSnapshot *snapshot;
+    GQueue dirs = G_QUEUE_INIT;
+    GFile *dir;
+    gboolean full = FALSE;
+
+    snapshot = snapshot_new ();
+    g_queue_push_tail (&dirs, g_object_ref (root));
+
+    while (!full && (dir = g_queue_pop_head (&dirs)) != NULL)
+    {
+        GFileEnumerator *enumerator;
+        GFileInfo *info;
+        gchar *prefix;
+
+        if (g_cancellable_is_cancelled (cancellable))
+        {
+            g_object_unref (dir);
+            break;
+        }
+
+        enumerator = g_file_enumerate_children (dir,
+                                                INDEX_QUERY_ATTRIBUTES,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                cancellable,
+                                                NULL);
+
+        if (enumerator == NULL)
+        {
+            g_object_unref (dir);
+            continue;
+        }
+
+        prefix = g_file_get_relative_path (root, dir);
+
+        while (!full && (info = g_file_enumerator_next_file (enumerator, cancellable, NULL)) != NULL)
+        {
+            const gchar *name = g_file_info_get_name (info);
+
+            if (!g_file_info_get_is_hidden (info) &&
+                !g_file_info_get_is_backup (info) &&
+                name_is_indexed (name, strlen (name)))
+            {
+                GFileType type = g_file_info_get_file_type (info);
+
+                if (type == G_FILE_TYPE_DIRECTORY)
+                {
+                    g_queue_push_tail (&dirs, g_file_get_child (dir, name));
+                }
+                else if (type == G_FILE_TYPE_REGULAR || type == G_FILE_TYPE_SYMBOLIC_LINK)
+                {
+                    gchar *path;
+
+                    path = prefix != NULL ? g_build_filename (prefix, name, NULL) : g_strdup (name);
+                    full = !snapshot_add (snapshot, path);
+                    g_free (path);
+                }
+            }
+
+            g_object_unref (info);
+        }
+
+        g_free (prefix);
+        g_object_unref (enumerator);
+        g_object_unref (dir);
+    }
+
+    g_list_free_full (dirs.head, g_object_unref);
+
+    return snapshot;
+}
+
+static void
+crawl_data_free (CrawlData *data)
+{
+    g_object_unref (data->root);
+    g_free (data->cache_filename);
+    g_slice_free (CrawlData, data);
+}
+
+static void
+invalidate_query_cache (XedFileBrowserIndex *index)
+{
+    g_clear_pointer (&index->priv->last_query, g_free);
+
+    if (index->priv->last_matches != NULL)
+    {
+        g_array_free (index->priv->last_matches, TRUE);
+        index->priv->last_matches = NULL;
+    }
+}
+
+static void
+install_snapshot (XedFileBrowserIndex *index,
+                  IndexSnapshot       *snapshot)
+{
+    snapshot_free (index->priv->snapshot);
+    index->priv->snapshot = snapshot;
+
+    invalidate_query_cache (index);
+
+    g_signal_emit (index, signals[CHANGED], 0);
+}
+
+static void
+publish_data_free (PublishData *data)
+{
+    g_object_unref (data->index);
+    g_object_unref (data->cancellable);
+    snapshot_free (data->snapshot);
+    g_slice_free (PublishData, data);
+}
+
+static gboolean
+publish_cached_snapshot (PublishData *data)
+{
+    XedFileBrowserIndex *index = data->index;
+
+    /* Only use the cache until the first crawl of this root is done */
+    if (data->cancellable == index->priv->cancellable &&
+        !g_cancellable_is_cancelled (data->cancellable) &&
+        index->priv->snapshot == NULL)
+    {
+        install_snapshot (index, data->snapshot);
+        data->snapshot = NULL;
+    }
+
+    return FALSE;
+}
+
+static void
+crawl_thread (GTask        *task,
+              gpointer      source_object,
+              gpointer      task_data,
+              GCancellable *cancellable)
+{
+    CrawlData *data = task_data;
+    IndexSnapshot *snapshot;
+
+    if (data->load_cache)
+    {
+        snapshot = snapshot_load (data->cache_filename, data->root);
+
+        if (snapshot != NULL)
+        {
+            PublishData *publish;
+
+            publish = g_slice_new (PublishData);
+            publish->index = g_object_ref (source_object);
+            publish->cancellable = g_object_ref (cancellable);
+            publish->snapshot = snapshot;
+
+            g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                             (GSourceFunc) publish_cached_snapshot,
+                             publish,
+                             (GDestroyNotify) publish_data_free);
+        }
+    }
+
+    snapshot = crawl (data->root, cancellable);
+
+    if (g_task_return_error_if_cancelled (task))
+    {
+        snapshot_free (snapshot);
+        return;
+    }
+
+    snapshot_save (snapshot, data->cache_filename, data->root);
+
+    g_task_return_pointer (task, snapshot, (GDestroyNotify) snapshot_free);
+}
+
+static void
+crawl_ready_cb (XedFileBrowserIndex *index,
+                GAsyncResult        *result,
+                gpointer             user_data)
+{
+    IndexSnapshot *snapshot;
+
+    snapshot = g_task_propagate_pointer (G_TASK (result), NULL);
+
+    /* Another crawl was started in the meantime */
+    if (g_task_get_cancellable (G_TASK (result)) != index->priv->cancellable)
+    {
+        snapshot_free (snapshot);
+        return;
+    }
+
+    g_clear_object (&index->priv->cancellable);
+
+    if (snapshot == NULL)
+    {
+        return;
+    }
+
+    g_hash_table_remove_all (index->priv->added);
+    g_hash_table_remove_all (index->priv->removed);
+
+    install_snapshot (index, snapshot);
+}
+
+static void
+cancel_crawl (XedFileBrowserIndex *index)
+{
+    if (index->priv->rescan_id != 0)
+    {
+        g_source_remove (index->priv->rescan_id);
+        index->priv->rescan_id = 0;
+    }
+
+    if (index->priv->cancellable != NULL)
+    {
+        g_cancellable_cancel (index->priv->cancellable);
+        g_clear_object (&index->priv->cancellable);
+    }
+}
+
+static void
+start_crawl (XedFileBrowserIndex *index)
+{
+    CrawlData *data;
+    GTask *task;
+
+    cancel_crawl (index);
+
+    index->priv->cancellable = g_cancellable_new ();
+
+    data = g_slice_new (CrawlData);
+    data->root = g_object_ref (index->priv->root);
+    data->cache_filename = get_cache_filename (index->priv->root);
+    data->load_cache = index->priv->snapshot == NULL;
+
+    task = g_task_new (index,
+                       index->priv->cancellable,
+                       (GAsyncReadyCallback) crawl_ready_cb,
+                       NULL);
+    g_task_set_task_data (task, data, (GDestroyNotify) crawl_data_free);
+    g_task_run_in_thread (task, crawl_thread);
+    g_object_unref (task);
+}
+
+static gboolean
+rescan_timeout (XedFileBrowserIndex *index)
+{
+    index->priv->rescan_id = 0;
+
+    start_crawl (index);
+
+    return FALSE;
+}
+
+static void
+schedule_rescan (XedFileBrowserIndex *index)
+{
+    if (index->priv->rescan_id != 0)
+    {
+        return;
+    }
+
+    index->priv->rescan_id = g_timeout_add_seconds (INDEX_RESCAN_DELAY,
+                                                    (GSourceFunc) rescan_timeout,
+                                                    index);
+}
+
+static void
+xed_file_browser_index_dispose (GObject *object)
+{
+    XedFileBrowserIndex *index = XED_FILE_BROWSER_INDEX (object);
+
+    cancel_crawl (index);
+    g_clear_object (&index->priv->root);
+
+    G_OBJECT_CLASS (xed_file_browser_index_parent_class)->dispose (object);
+}
+
+static void
+xed_file_browser_index_finalize (GObject *object)
+{
+    XedFileBrowserIndex *index = XED_FILE_BROWSER_INDEX (object);
+
+    snapshot_free (index->priv->snapshot);
+    invalidate_query_cache (index);
+
+    g_hash_table_destroy (index->priv->added);
+    g_hash_table_destroy (index->priv->removed);
+
+    G_OBJECT_CLASS (xed_file_browser_index_parent_class)->finalize (object);
+}
+
+static void
+xed_file_browser_index_class_init (XedFileBrowserIndexClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = xed_file_browser_index_dispose;
+    object_class->finalize = xed_file_browser_index_finalize;
+
+    signals[CHANGED] =
+        g_signal_new ("changed",
+                      G_OBJECT_CLASS_TYPE (object_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XedFileBrowserIndexClass, changed),
+                      NULL, NULL,
+                      g_cclosure_marshal_VOID__VOID,
+                      G_TYPE_NONE, 0);
+}
+
+static void
+xed_file_browser_index_class_finalize (XedFileBrowserIndexClass *klass)
+{
+    /* dummy function - used by G_DEFINE_DYNAMIC_TYPE */
+}
+
+static void
+xed_file_browser_index_init (XedFileBrowserIndex *index)
+{
+    index->priv = xed_file_browser_index_get_instance_private (index);
+
+    index->priv->added = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    index->priv->removed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+/* Returns the score of the query as a subsequence of text[start, end), or -1
+ * when it does not match.  Consecutive characters and characters starting a
+ * word count extra */
+static gint
+match_range (const gchar *text,
+             guint        start,
+             guint        end,
+             const gchar *query)
+{
+    const gchar *q;
+    guint pos = start;
+    guint last = G_MAXUINT;
+    gint score = 0;
+
+    for (q = query; *q != '\0'; q++)
+    {
+        while (pos < end && g_ascii_tolower (text[pos]) != *q)
+        {
+            pos++;
+        }
+
+        if (pos == end)
+        {
+            return -1;
+        }
+
+        score += 1;
+
+        if (last != G_MAXUINT && pos == last + 1)
+        {
+            score += 4;
+        }
+
+        if (pos == start ||
+            strchr ("/._- ", text[pos - 1]) != NULL ||
+            (g_ascii_isupper (text[pos]) && g_ascii_islower (text[pos - 1])))
+        {
+            score += 3;
+        }
+
+        last = pos++;
+    }
+
+    return score;
+}
+
+static gint
+score_path (const gchar *path,
+            guint        length,
+            guint        basename,
+            const gchar *query)
+{
+    gint score;
+
+    /* Matching the basename alone is what is meant most of the time */
+    score = match_range (path, basename, length, query);
+
+    if (score >= 0)
+    {
+        return score * 2 + 16;
+    }
+
+    return match_range (path, 0, length, query);
+}
+
+static inline gboolean
+match_is_better (gint        score,
+                 guint       length,
+                 IndexMatch *other)
+{
+    return score > other->score || (score == other->score && length < other->length);
+}
+
+static void
+matches_insert (GArray      *matches,
+                guint        max_results,
+                const gchar *path,
+                guint        length,
+                gint         score)
+{
+    IndexMatch match;
+    guint i;
+
+    if (matches->len == max_results)
+    {
+        if (!match_is_better (score, length, &g_array_index (matches, IndexMatch, max_results - 1)))
+        {
+            return;
+        }
+
+        g_array_set_size (matches, max_results - 1);
+    }
+
+    for (i = matches->len; i > 0; i--)
+    {
+        if (!match_is_better (score, length, &g_array_index (matches, IndexMatch, i - 1)))
+        {
+            break;
+        }
+    }
+
+    match.path = path;
+    match.length = length;
+    match.score = score;
+
+    g_array_insert_val (matches, i, match);
+}
+
+/* Whether the path or one of its parents was deleted since the crawl */
+static gboolean
+path_is_removed (GHashTable  *removed,
+                 const gchar *path,
+                 guint        length,
+                 gchar       *scratch)
+{
+    guint i;
+
+    if (g_hash_table_size (removed) == 0)
+    {
+        return FALSE;
+    }
+
+    memcpy (scratch, path, length + 1);
+
+    for (i = 0; i <= length; i++)
+    {
+        if (scratch[i] == '/' || scratch[i] == '\0')
+        {
+            gboolean found;
+            gchar c = scratch[i];
+
+            scratch[i] = '\0';
+            found = g_hash_table_contains (removed, scratch);
+            scratch[i] = c;
+
+            if (found)
+            {
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+static gchar *
+normalize_query (const gchar *query)
+{
+    GString *normalized;
+    const gchar *ptr;
+
+    normalized = g_string_new (NULL);
+
+    for (ptr = query; *ptr != '\0'; ptr++)
+    {
+        if (!g_ascii_isspace (*ptr))
+        {
+            g_string_append_c (normalized, g_ascii_tolower (*ptr));
+        }
+    }
+
+    return g_string_free (normalized, FALSE);
+}
+
+/* Public */
+
+XedFileBrowserIndex *
+xed_file_browser_index_new (void)
+{
+    return XED_FILE_BROWSER_INDEX (g_object_new (XED_TYPE_FILE_BROWSER_INDEX, NULL));
+}
+
+/**
+ * xed_file_browser_index_set_root:
+ * @index: a #XedFileBrowserIndex
+ * @root: (allow-none): the directory to index
+ *
+ * Starts indexing @root in the background.  The result of the previous crawl
+ * of @root, if any, is loaded from the cache first so queries can be
+ * answered before the crawl is done.  Only local directories are indexed.
+ */
+void
+xed_file_browser_index_set_root (XedFileBrowserIndex *index,
+                                 GFile               *root)
+{
+    g_return_if_fail (XED_IS_FILE_BROWSER_INDEX (index));
+    g_return_if_fail (root == NULL || G_IS_FILE (root));
+
+    if (root == index->priv->root ||
+        (root != NULL && index->priv->root != NULL && g_file_equal (root, index->priv->root)))
+    {
+        return;
+    }
+
+    cancel_crawl (index);
+
+    g_clear_object (&index->priv->root);
+    g_hash_table_remove_all (index->priv->added);
+    g_hash_table_remove_all (index->priv->removed);
+
+    snapshot_free (index->priv->snapshot);
+    index->priv->snapshot = NULL;
+    invalidate_query_cache (index);
+
+    if (root != NULL)
+    {
+        index->priv->root = g_object_ref (root);
+
+        if (g_file_is_native (root))
+        {
+            start_crawl (index);
+        }
+    }
+
+    g_signal_emit (index, signals[CHANGED], 0);
+}
+
+GFile *
+xed_file_browser_index_get_root (XedFileBrowserIndex *index)
+{
+    g_return_val_if_fail (XED_IS_FILE_BROWSER_INDEX (index), NULL);
+
+    return index->priv->root;
+}
+
+gboolean
+xed_file_browser_index_is_crawling (XedFileBrowserIndex *index)
+{
+    g_return_val_if_fail (XED_IS_FILE_BROWSER_INDEX (index), FALSE);
+
+    return index->priv->cancellable != NULL;
+}
+
+static gchar *
+get_relative_path (XedFileBrowserIndex *index,
+                   GFile               *file)
+{
+    if (index->priv->root == NULL || !g_file_is_native (index->priv->root))
+    {
+        return NULL;
+    }
+
+    return g_file_get_relative_path (index->priv->root, file);
+}
+
+static void
+count_change (XedFileBrowserIndex *index)
+{
+    if (g_hash_table_size (index->priv->added) +
+        g_hash_table_size (index->priv->removed) > INDEX_MAX_CHANGES)
+    {
+        schedule_rescan (index);
+    }
+}
+
+static void
+created_data_free (CreatedData *data)
+{
+    g_object_unref (data->index);
+    g_object_unref (data->root);
+    g_free (data->path);
+    g_slice_free (CreatedData, data);
+}
+
+static void
+query_created_type_cb (GFile        *file,
+                       GAsyncResult *result,
+                       CreatedData  *data)
+{
+    XedFileBrowserIndex *index = data->index;
+    GFileInfo *info;
+
+    info = g_file_query_info_finish (file, result, NULL);
+
+    /* Gone already, or the index moved to another root meanwhile */
+    if (info == NULL ||
+        index->priv->root == NULL ||
+        !g_file_equal (index->priv->root, data->root))
+    {
+        g_clear_object (&info);
+        created_data_free (data);
+        return;
+    }
+
+    /* A new directory can bring any number of files with it */
+    if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+    {
+        schedule_rescan (index);
+    }
+    else
+    {
+        g_hash_table_add (index->priv->added, data->path);
+        data->path = NULL;
+        count_change (index);
+    }
+
+    g_object_unref (info);
+    created_data_free (data);
+}
+
+void
+xed_file_browser_index_file_created (XedFileBrowserIndex *index,
+                                     GFile               *file)
+{
+    CreatedData *data;
+    gchar *path;
+
+    g_return_if_fail (XED_IS_FILE_BROWSER_INDEX (index));
+    g_return_if_fail (G_IS_FILE (file));
+
+    path = get_relative_path (index, file);
+
+    if (path == NULL || !path_is_indexed (path))
+    {
+        g_free (path);
+        return;
+    }
+
+    g_hash_table_remove (index->priv->removed, path);
+
+    data = g_slice_new (CreatedData);
+    data->index = g_object_ref (index);
+    data->root = g_object_ref (index->priv->root);
+    data->path = path;
+
+    g_file_query_info_async (file,
+                             G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                             G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                             G_PRIORITY_DEFAULT,
+                             NULL,
+                             (GAsyncReadyCallback) query_created_type_cb,
+                             data);
+}
+
+void
+xed_file_browser_index_file_deleted (XedFileBrowserIndex *index,
+                                     GFile               *file)
+{
+    gchar *path;
+
+    g_return_if_fail (XED_IS_FILE_BROWSER_INDEX (index));
+    g_return_if_fail (G_IS_FILE (file));
+
+    path = get_relative_path (index, file);
+
+    if (path == NULL || !path_is_indexed (path))
+    {
+        g_free (path);
+        return;
+    }
+
+    g_hash_table_remove (index->priv->added, path);
+    g_hash_table_add (index->priv->removed, path);
+    count_change (index);
+}
+
+/**
+ * xed_file_browser_index_query:
+ * @index: a #XedFileBrowserIndex
+ * @query: the characters to look for
+ * @max_results: the maximum number of results
+ *
+ * Finds the files whose path contains the characters of @query in order,
+ * ignoring case and white space.  Matches within the basename and on word
+ * boundaries rank first.
+ *
+ * Returns: (transfer full): the best matches as paths relative to the root
+ */
+GPtrArray *
+xed_file_browser_index_query (XedFileBrowserIndex *index,
+                              const gchar         *query,
+                              guint                max_results)
+{
+    XedFileBrowserIndexPrivate *priv;
+    GPtrArray *result;
+    GArray *matches;
+    gchar *normalized;
+    gchar *scratch;
+    guint64 query_mask;
+    GHashTableIter iter;
+    gpointer key;
+    guint i;
+
+    g_return_val_if_fail (XED_IS_FILE_BROWSER_INDEX (index), NULL);
+    g_return_val_if_fail (query != NULL, NULL);
+
+    priv = index->priv;
+    result = g_ptr_array_new_with_free_func (g_free);
+    normalized = normalize_query (query);
+
+    if (*normalized == '\0' || max_results == 0)
+    {
+        g_free (normalized);
+        return result;
+    }
+
+    query_mask = path_mask (normalized, strlen (normalized));
+    matches = g_array_sized_new (FALSE, FALSE, sizeof (IndexMatch), max_results);
+    scratch = g_malloc (G_MAXUINT16 + 1);
+
+    if (priv->snapshot != NULL)
+    {
+        IndexSnapshot *snapshot = priv->snapshot;
+        GArray *candidates;
+        gboolean narrow;
+        guint n;
+
+        narrow = priv->last_matches != NULL && g_str_has_prefix (normalized, priv->last_query);
+        n = narrow ? priv->last_matches->len : snapshot->entries->len;
+        candidates = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+        for (i = 0; i < n; i++)
+        {
+            guint32 idx = narrow ? g_array_index (priv->last_matches, guint32, i) : i;
+            IndexEntry *entry = &g_array_index (snapshot->entries, IndexEntry, idx);
+            const gchar *path;
+            gint score;
+
+            if ((entry->mask & query_mask) != query_mask)
+            {
+                continue;
+            }
+
+            path = snapshot->pool->str + entry->offset;
+            score = score_path (path, entry->length, entry->basename, normalized);
+
+            if (score < 0)
+            {
+                continue;
+            }
+
+            g_array_append_val (candidates, idx);
+
+            if (!path_is_removed (priv->removed, path, entry->length, scratch))
+            {
+                matches_insert (matches, max_results, path, entry->length, score);
+            }
+        }
+
+        invalidate_query_cache (index);
+        priv->last_query = g_strdup (normalized);
+        priv->last_matches = candidates;
+    }
+
+    g_hash_table_iter_init (&iter, priv->added);
+
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        const gchar *path = key;
+        const gchar *base;
+        guint length;
+        gint score;
+        guint j;
+
+        length = strlen (path);
+
+        if ((path_mask (path, length) & query_mask) != query_mask ||
+            path_is_removed (priv->removed, path, length, scratch))
+        {
+            continue;
+        }
+
+        base = strrchr (path, '/');
+        score = score_path (path, length, base != NULL ? base - path + 1 : 0, normalized);
+
+        if (score < 0)
+        {
+            continue;
+        }
+
+        /* The file may have been recreated while still in the snapshot */
+        for (j = 0; j < matches->len; j++)
+        {
+            if (strcmp (g_array_index (matches, IndexMatch, j).path, path) == 0)
+            {
+                break;
+            }
+        }
+
+        if (j == matches->len)
+        {
+            matches_insert (matches, max_results, path, length, score);
+        }
+    }
+
+    for (i = 0; i < matches->len; i++)
+    {
+        g_ptr_array_add (result, g_strdup (g_array_index (matches, IndexMatch, i).path));
+    }
+
+    g_array_free (matches, TRUE);
+    g_free (scratch);
+    g_free (normalized);
+
+    return result;
+}
+
+void
+_xed_file_browser_index_register_type (GTypeModule *type_module)
+{
+    xed_file_browser_index_register_type (type_module);
+}
+
+// ex:ts=8:noet:
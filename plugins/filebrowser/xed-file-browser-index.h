@@ -0,0 +1,72 @@
+/*
+ * xed-file-browser-index.h - Xed plugin providing easy file access
+ * from the sidepanel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_FILE_BROWSER_INDEX_H__
+#define __XED_FILE_BROWSER_INDEX_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+#define XED_TYPE_FILE_BROWSER_INDEX             (xed_file_browser_index_get_type ())
+#define XED_FILE_BROWSER_INDEX(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), XED_TYPE_FILE_BROWSER_INDEX, XedFileBrowserIndex))
+#define XED_FILE_BROWSER_INDEX_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), XED_TYPE_FILE_BROWSER_INDEX, XedFileBrowserIndexClass))
+#define XED_IS_FILE_BROWSER_INDEX(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XED_TYPE_FILE_BROWSER_INDEX))
+#define XED_IS_FILE_BROWSER_INDEX_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), XED_TYPE_FILE_BROWSER_INDEX))
+#define XED_FILE_BROWSER_INDEX_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), XED_TYPE_FILE_BROWSER_INDEX, XedFileBrowserIndexClass))
+
+typedef struct _XedFileBrowserIndex        XedFileBrowserIndex;
+typedef struct _XedFileBrowserIndexClass   XedFileBrowserIndexClass;
+typedef struct _XedFileBrowserIndexPrivate XedFileBrowserIndexPrivate;
+
+struct _XedFileBrowserIndex
+{
+    GObject parent;
+
+    XedFileBrowserIndexPrivate *priv;
+};
+
+struct _XedFileBrowserIndexClass
+{
+    GObjectClass parent_class;
+
+    /* Signals */
+    void (* changed) (XedFileBrowserIndex *index);
+};
+
+GType xed_file_browser_index_get_type (void) G_GNUC_CONST;
+void _xed_file_browser_index_register_type (GTypeModule *type_module);
+
+XedFileBrowserIndex *xed_file_browser_index_new          (void);
+
+void       xed_file_browser_index_set_root               (XedFileBrowserIndex *index,
+                                                          GFile               *root);
+GFile     *xed_file_browser_index_get_root               (XedFileBrowserIndex *index);
+gboolean   xed_file_browser_index_is_crawling            (XedFileBrowserIndex *index);
+
+void       xed_file_browser_index_file_created           (XedFileBrowserIndex *index,
+                                                          GFile               *file);
+void       xed_file_browser_index_file_deleted           (XedFileBrowserIndex *index,
+                                                          GFile               *file);
+
+GPtrArray *xed_file_browser_index_query                  (XedFileBrowserIndex *index,
+                                                          const gchar         *query,
+                                                          guint                max_results);
+
+G_END_DECLS
+#endif /* __XED_FILE_BROWSER_INDEX_H__ */
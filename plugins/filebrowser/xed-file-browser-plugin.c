@@ -37,6 +37,8 @@
 #include "xed-file-browser-utils.h"
 #include "xed-file-browser-error.h"
 #include "xed-file-browser-widget.h"
+#include "xed-file-browser-index.h"
+#include "xed-file-browser-search.h"
 #include "xed-file-browser-messages.h"
 
 #define FILE_BROWSER_SCHEMA         "org.x.editor.plugins.filebrowser"
@@ -47,6 +49,7 @@ struct _XedFileBrowserPluginPrivate
     XedWindow *window;
 
     XedFileBrowserWidget *tree_widget;
+    XedFileBrowserSearch *search;
     gulong merge_id;
     GtkActionGroup *action_group;
     GtkActionGroup *single_selection_action_group;
@@ -66,6 +69,10 @@ enum
 static void on_location_activated_cb (XedFileBrowserWidget *widget,
                                       GFile                *location,
                                       XedWindow            *window);
+static void on_search_location_activated_cb (XedFileBrowserSearch *search,
+                                             GFile                *location,
+                                             gint                  line,
+                                             XedWindow            *window);
 static void on_error_cb (XedFileBrowserWidget *widget,
                          guint                 code,
                          gchar const          *message,
@@ -107,6 +114,8 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedFileBrowserPlugin,
                                                                xed_window_activatable_iface_init)
                                 G_ADD_PRIVATE_DYNAMIC (XedFileBrowserPlugin)
                                 _xed_file_browser_store_register_type        (type_module);  \
+                                _xed_file_browser_index_register_type        (type_module);  \
+                                _xed_file_browser_search_register_type       (type_module);  \
                                 _xed_file_bookmarks_store_register_type      (type_module);  \
                                 _xed_file_browser_view_register_type         (type_module);  \
                                 _xed_file_browser_widget_register_type       (type_module);
@@ -377,6 +386,37 @@ on_action_open_terminal (GtkAction            *action,
     }
 }
 
+static void
+on_action_find_in_files (GtkAction            *action,
+                         XedFileBrowserPlugin *plugin)
+{
+    XedFileBrowserPluginPrivate *priv = plugin->priv;
+    XedFileBrowserStore *store;
+    XedPanel *panel;
+    GtkTreeIter iter;
+    GFile *file;
+
+    if (!xed_file_browser_widget_get_selected_directory (priv->tree_widget, &iter))
+    {
+        return;
+    }
+
+    store = xed_file_browser_widget_get_browser_store (priv->tree_widget);
+    gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, XED_FILE_BROWSER_STORE_COLUMN_LOCATION, &file, -1);
+
+    if (file)
+    {
+        xed_file_browser_search_set_root (priv->search, file);
+        g_object_unref (file);
+    }
+
+    /* The window keeps the View menu in sync with the panel */
+    panel = xed_window_get_bottom_panel (priv->window);
+    gtk_widget_show (GTK_WIDGET (panel));
+    xed_panel_activate_item (panel, GTK_WIDGET (priv->search));
+    xed_file_browser_search_grab_focus (priv->search);
+}
+
 static void
 on_selection_changed_cb (GtkTreeSelection     *selection,
                          XedFileBrowserPlugin *plugin)
@@ -415,6 +455,7 @@ on_selection_changed_cb (GtkTreeSelection     *selection,
     }
 
     gtk_action_set_sensitive (gtk_action_group_get_action (priv->single_selection_action_group, "OpenTerminal"), sensitive);
+    gtk_action_set_sensitive (gtk_action_group_get_action (priv->single_selection_action_group, "FindInFiles"), sensitive);
 }
 
 #define POPUP_UI ""                             \
@@ -425,6 +466,7 @@ on_selection_changed_cb (GtkTreeSelection     *selection,
 "    </placeholder>"                            \
 "    <placeholder name=\"FilePopup_Opt4\">"     \
 "      <menuitem action=\"OpenTerminal\"/>"     \
+"      <menuitem action=\"FindInFiles\"/>"      \
 "    </placeholder>"                            \
 "  </popup>"                                    \
 "  <popup name=\"BookmarkPopup\">"              \
@@ -446,7 +488,11 @@ static GtkActionEntry extra_single_selection_actions[] = {
     {"OpenTerminal", "utilities-terminal", N_("_Open terminal here"),
      NULL,
      N_("Open a terminal at the currently opened directory"),
-     G_CALLBACK (on_action_open_terminal)}
+     G_CALLBACK (on_action_open_terminal)},
+    {"FindInFiles", "xsi-edit-find-symbolic", N_("_Find in files here..."),
+     NULL,
+     N_("Search the files below the selected directory"),
+     G_CALLBACK (on_action_find_in_files)}
 };
 
 static void
@@ -558,6 +604,14 @@ xed_file_browser_plugin_activate (XedWindowActivatable *activatable)
     xed_panel_add_item (panel, GTK_WIDGET (priv->tree_widget), _("File Browser"), "folder");
     gtk_widget_show (GTK_WIDGET (priv->tree_widget));
 
+    priv->search = XED_FILE_BROWSER_SEARCH (xed_file_browser_search_new ());
+    g_signal_connect (priv->search, "location-activated",
+                      G_CALLBACK (on_search_location_activated_cb), priv->window);
+
+    panel = xed_window_get_bottom_panel (priv->window);
+    xed_panel_add_item (panel, GTK_WIDGET (priv->search), _("Find in Files"), "xsi-edit-find-symbolic");
+    gtk_widget_show (GTK_WIDGET (priv->search));
+
     add_popup_ui (plugin);
 
     /* Restore filter options */
@@ -606,6 +660,10 @@ xed_file_browser_plugin_deactivate (XedWindowActivatable *activatable)
 
     panel = xed_window_get_side_panel (priv->window);
     xed_panel_remove_item (panel, GTK_WIDGET (priv->tree_widget));
+
+    xed_file_browser_search_stop (priv->search);
+    panel = xed_window_get_bottom_panel (priv->window);
+    xed_panel_remove_item (panel, GTK_WIDGET (priv->search));
 }
 
 static void
@@ -643,6 +701,15 @@ on_location_activated_cb (XedFileBrowserWidget *tree_widget,
     xed_commands_load_location (window, location, NULL, 0);
 }
 
+static void
+on_search_location_activated_cb (XedFileBrowserSearch *search,
+                                 GFile                *location,
+                                 gint                  line,
+                                 XedWindow            *window)
+{
+    xed_commands_load_location (window, location, NULL, line >= 0 ? line + 1 : 0);
+}
+
 static void
 on_error_cb (XedFileBrowserWidget *tree_widget,
              guint                 code,
@@ -843,14 +910,15 @@ on_virtual_root_changed_cb (XedFileBrowserStore  *store,
     else
     {
         uri_root = g_file_get_uri (root);
-        g_object_unref (root);
     }
 
     g_settings_set_string (priv->onload_settings, "root", uri_root);
-    g_free (uri_root);
 
     virtual_root = xed_file_browser_store_get_virtual_root (store);
 
+    /* Find in files searches what the browser shows */
+    xed_file_browser_search_set_root (priv->search, virtual_root != NULL ? virtual_root : root);
+
     if (!virtual_root)
     {
         /* Set virtual to same as root then */
@@ -868,6 +936,9 @@ on_virtual_root_changed_cb (XedFileBrowserStore  *store,
         g_object_unref (virtual_root);
     }
 
+    g_free (uri_root);
+    g_object_unref (root);
+
     g_signal_handlers_disconnect_by_func (XED_WINDOW (priv->window), G_CALLBACK (on_tab_added_cb), plugin);
 }
 
@@ -0,0 +1,1300 @@
+/*
+ * xed-file-browser-search.c - Xed plugin providing easy file access
+ * from the sidepanel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <xed/xed-utils.h>
+
+#include "xed-file-browser-search.h"
+#include "xed-file-browser-marshal.h"
+
+/*
+ * Find in files below the root of the browser.  One worker thread per core
+ * walks the tree: each has its own queue of directories to list and files to
+ * search, takes its work from the tail of it, and when it runs dry steals from
+ * the head of the queue of another worker, where the biggest directories
+ * still wait.  Hidden, backup, binary and .gitignored files are skipped.
+ *
+ * Files are mapped in memory.  When the search text is literal, it is first
+ * looked for with memchr, which the C library vectorises, and only the files
+ * holding it are copied out of the mapping, validated and handed to the
+ * regex.  The mapping is only read under a guard, so a file truncated in the
+ * meantime is skipped rather than crashing the editor.  The matching lines
+ * are sent to the main thread in batches.
+ */
+
+/* Files bigger than this are not searched */
+#define MAX_FILE_SIZE (256 * 1024 * 1024)
+
+/* Git takes a file with a nul byte in its first 8000 bytes for binary */
+#define BINARY_CHECK_LENGTH 8000
+
+/* Lines listed at most for a file, and in total */
+#define MAX_LINES_PER_FILE 1000
+#define MAX_LINES 20000
+
+/* Longest a worker without work sleeps before looking again */
+#define WAIT_INTERVAL (10 * G_TIME_SPAN_MILLISECOND)
+
+/* Milliseconds between two updates of the status while searching */
+#define STATUS_INTERVAL 250
+
+#define REGEX_SPECIAL_CHARS "\\^$.|?*+()[]{}"
+
+enum
+{
+    COLUMN_MARKUP,
+    COLUMN_LOCATION,
+    COLUMN_LINE,
+    N_COLUMNS
+};
+
+enum
+{
+    LOCATION_ACTIVATED,
+    NUM_SIGNALS
+};
+
+static guint signals[NUM_SIGNALS] = { 0 };
+
+typedef struct
+{
+    GPatternSpec *spec;
+    guint negate : 1;
+    guint dir_only : 1;
+    guint anchored : 1;
+} IgnoreRule;
+
+/* The rules of a .gitignore, chained to the ones of the directories
+ * above. Never changed once built, so shared between the workers */
+typedef struct _IgnoreRules IgnoreRules;
+
+struct _IgnoreRules
+{
+    gint ref_count;
+    IgnoreRules *parent;
+    gchar *base;
+    gsize base_length;
+    GArray *rules;
+};
+
+typedef struct
+{
+    gchar *path;
+    gboolean is_dir;
+    IgnoreRules *rules;
+} WorkItem;
+
+typedef struct
+{
+    GMutex lock;
+    GQueue items;
+} WorkQueue;
+
+typedef struct
+{
+    gint line;
+    gchar *markup;
+} LineResult;
+
+typedef struct
+{
+    gchar *path;
+    GArray *lines;
+    gboolean truncated;
+} FileResult;
+
+typedef struct
+{
+    gint ref_count;
+
+    GFile *location;
+    gchar *root;
+    GRegex *regex;
+    gchar *literal;
+    gsize literal_length;
+    gboolean caseless;
+    GCancellable *cancellable;
+
+    WorkQueue *queues;
+    guint n_workers;
+
+    /* Items queued or being worked on, the scan is over at 0 */
+    gint pending;
+    GMutex wait_lock;
+    GCond wait_cond;
+
+    GMutex results_lock;
+    GPtrArray *results;
+    guint flush_id;
+
+    gint n_files;
+    gint n_lines;
+    gint truncated;
+
+    /* Only touched on the main thread, cleared when the scan is stopped */
+    XedFileBrowserSearch *search;
+} Scan;
+
+typedef struct
+{
+    Scan *scan;
+    guint id;
+} Worker;
+
+struct _XedFileBrowserSearchPrivate
+{
+    GFile *root;
+
+    GtkWidget *entry;
+    GtkWidget *match_case_button;
+    GtkWidget *regex_button;
+    GtkWidget *stop_button;
+    GtkWidget *status_label;
+    GtkWidget *treeview;
+    GtkTreeStore *store;
+
+    Scan *scan;
+    guint status_id;
+};
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedFileBrowserSearch,
+                                xed_file_browser_search,
+                                GTK_TYPE_BOX,
+                                0,
+                                G_ADD_PRIVATE_DYNAMIC (XedFileBrowserSearch))
+
+static IgnoreRules *
+ignore_rules_ref (IgnoreRules *rules)
+{
+    if (rules != NULL)
+    {
+        g_atomic_int_inc (&rules->ref_count);
+    }
+
+    return rules;
+}
+
+static void
+ignore_rules_unref (IgnoreRules *rules)
+{
+    guint i;
+
+    if (rules == NULL || !g_atomic_int_dec_and_test (&rules->ref_count))
+    {
+        return;
+    }
+
+    for (i = 0; i < rules->rules->len; i++)
+    {
+        g_pattern_spec_free (g_array_index (rules->rules, IgnoreRule, i).spec);
+    }
+
+    ignore_rules_unref (rules->parent);
+    g_array_free (rules->rules, TRUE);
+    g_free (rules->base);
+    g_slice_free (IgnoreRules, rules);
+}
+
+/* Understands the common part of the .gitignore syntax: comments, negation,
+ * directory only and anchored patterns.  A "**" is taken as a "*", which in
+ * a GPatternSpec also matches slashes. */
+static IgnoreRules *
+ignore_rules_load (IgnoreRules *parent,
+                   const gchar *dir)
+{
+    IgnoreRules *rules;
+    gchar *filename;
+    gchar *contents;
+    gchar **lines;
+    guint i;
+
+    filename = g_build_filename (dir, ".gitignore", NULL);
+
+    if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+        g_free (filename);
+        return ignore_rules_ref (parent);
+    }
+
+    g_free (filename);
+
+    rules = g_slice_new0 (IgnoreRules);
+    rules->ref_count = 1;
+    rules->parent = ignore_rules_ref (parent);
+    rules->base = g_strdup (dir);
+    rules->base_length = strlen (dir);
+    rules->rules = g_array_new (FALSE, FALSE, sizeof (IgnoreRule));
+
+    lines = g_strsplit (contents, "\n", -1);
+
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        IgnoreRule rule = { NULL, FALSE, FALSE, FALSE };
+        gchar *pattern = g_strchomp (lines[i]);
+        gsize length;
+
+        if (*pattern == '#' || *pattern == '\0')
+        {
+            continue;
+        }
+
+        if (*pattern == '!')
+        {
+            rule.negate = TRUE;
+            pattern++;
+        }
+
+        length = strlen (pattern);
+
+        if (length > 0 && pattern[length - 1] == '/')
+        {
+            rule.dir_only = TRUE;
+            pattern[--length] = '\0';
+        }
+
+        if (g_str_has_prefix (pattern, "**/"))
+        {
+            pattern += 3;
+        }
+
+        if (*pattern == '/')
+        {
+            rule.anchored = TRUE;
+            pattern++;
+        }
+        else
+        {
+            rule.anchored = strchr (pattern, '/') != NULL;
+        }
+
+        if (*pattern == '\0')
+        {
+            continue;
+        }
+
+        rule.spec = g_pattern_spec_new (pattern);
+        g_array_append_val (rules->rules, rule);
+    }
+
+    g_strfreev (lines);
+    g_free (contents);
+
+    return rules;
+}
+
+/* As in git, the last rule matching wins, and the rules of a directory
+ * come before the ones of its parents */
+static gboolean
+ignore_rules_match (IgnoreRules *rules,
+                    const gchar *path,
+                    const gchar *name,
+                    gboolean     is_dir)
+{
+    for (; rules != NULL; rules = rules->parent)
+    {
+        const gchar *relative = path + rules->base_length;
+        gint i;
+
+        if (*relative == G_DIR_SEPARATOR)
+        {
+            relative++;
+        }
+
+        for (i = rules->rules->len - 1; i >= 0; i--)
+        {
+            IgnoreRule *rule = &g_array_index (rules->rules, IgnoreRule, i);
+
+            if (rule->dir_only && !is_dir)
+            {
+                continue;
+            }
+
+            if (g_pattern_match_string (rule->spec, rule->anchored ? relative : name))
+            {
+                return !rule->negate;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+static WorkItem *
+work_item_new (gchar       *path,
+               gboolean     is_dir,
+               IgnoreRules *rules)
+{
+    WorkItem *item;
+
+    item = g_slice_new (WorkItem);
+    item->path = path;
+    item->is_dir = is_dir;
+    item->rules = ignore_rules_ref (rules);
+
+    return item;
+}
+
+static void
+work_item_free (WorkItem *item)
+{
+    ignore_rules_unref (item->rules);
+    g_free (item->path);
+    g_slice_free (WorkItem, item);
+}
+
+static void
+line_result_clear (LineResult *line)
+{
+    g_free (line->markup);
+}
+
+static void
+file_result_free (FileResult *result)
+{
+    g_free (result->path);
+    g_array_free (result->lines, TRUE);
+    g_slice_free (FileResult, result);
+}
+
+static Scan *
+scan_ref (Scan *scan)
+{
+    g_atomic_int_inc (&scan->ref_count);
+
+    return scan;
+}
+
+static void
+scan_unref (Scan *scan)
+{
+    guint i;
+
+    if (!g_atomic_int_dec_and_test (&scan->ref_count))
+    {
+        return;
+    }
+
+    for (i = 0; i < scan->n_workers; i++)
+    {
+        g_queue_free_full (&scan->queues[i].items, (GDestroyNotify) work_item_free);
+        g_mutex_clear (&scan->queues[i].lock);
+    }
+
+    g_free (scan->queues);
+    g_mutex_clear (&scan->wait_lock);
+    g_cond_clear (&scan->wait_cond);
+    g_mutex_clear (&scan->results_lock);
+    g_ptr_array_unref (scan->results);
+    g_object_unref (scan->cancellable);
+    g_regex_unref (scan->regex);
+    g_free (scan->literal);
+    g_object_unref (scan->location);
+    g_free (scan->root);
+    g_slice_free (Scan, scan);
+}
+
+static void
+push_item (Scan     *scan,
+           guint     id,
+           WorkItem *item)
+{
+    WorkQueue *queue = &scan->queues[id];
+
+    g_atomic_int_inc (&scan->pending);
+
+    g_mutex_lock (&queue->lock);
+    g_queue_push_tail (&queue->items, item);
+    g_mutex_unlock (&queue->lock);
+
+    g_mutex_lock (&scan->wait_lock);
+    g_cond_signal (&scan->wait_cond);
+    g_mutex_unlock (&scan->wait_lock);
+}
+
+static WorkItem *
+next_item (Scan  *scan,
+           guint  id)
+{
+    WorkItem *item;
+    guint i;
+
+    /* The newest item of our own queue, its files are still cached */
+    g_mutex_lock (&scan->queues[id].lock);
+    item = g_queue_pop_tail (&scan->queues[id].items);
+    g_mutex_unlock (&scan->queues[id].lock);
+
+    /* Else the oldest one of somebody else */
+    for (i = 1; item == NULL && i < scan->n_workers; i++)
+    {
+        WorkQueue *queue = &scan->queues[(id + i) % scan->n_workers];
+
+        g_mutex_lock (&queue->lock);
+        item = g_queue_pop_head (&queue->items);
+        g_mutex_unlock (&queue->lock);
+    }
+
+    return item;
+}
+
+static void
+scan_directory (Worker   *worker,
+                WorkItem *item)
+{
+    Scan *scan = worker->scan;
+    IgnoreRules *rules;
+    GDir *dir;
+    const gchar *name;
+
+    dir = g_dir_open (item->path, 0, NULL);
+
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    rules = ignore_rules_load (item->rules, item->path);
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        gchar *path;
+        GStatBuf buf;
+        gboolean is_dir;
+
+        /* Hidden and backup files are left out like in the index, which
+         * also keeps away from .git */
+        if (name[0] == '.' || name[strlen (name) - 1] == '~')
+        {
+            continue;
+        }
+
+        path = g_build_filename (item->path, name, NULL);
+
+        if (g_lstat (path, &buf) != 0 ||
+            /* Links are followed to files only, a directory could loop */
+            (S_ISLNK (buf.st_mode) && (g_stat (path, &buf) != 0 || !S_ISREG (buf.st_mode))))
+        {
+            g_free (path);
+            continue;
+        }
+
+        is_dir = S_ISDIR (buf.st_mode);
+
+        if ((!is_dir && (!S_ISREG (buf.st_mode) || buf.st_size == 0 || buf.st_size > MAX_FILE_SIZE)) ||
+            ignore_rules_match (rules, path, name, is_dir))
+        {
+            g_free (path);
+            continue;
+        }
+
+        push_item (scan, worker->id, work_item_new (path, is_dir, rules));
+    }
+
+    ignore_rules_unref (rules);
+    g_dir_close (dir);
+}
+
+static gboolean
+contains_literal (Scan        *scan,
+                  const gchar *data,
+                  gsize        length)
+{
+    const gchar *needle = scan->literal;
+    gsize n = scan->literal_length;
+    const gchar *end = data + length;
+    const gchar *p = data;
+    gchar lower;
+    gchar upper;
+
+    if (!scan->caseless)
+    {
+        while ((gsize) (end - p) >= n)
+        {
+            p = memchr (p, needle[0], end - p - n + 1);
+
+            if (p == NULL)
+            {
+                return FALSE;
+            }
+
+            if (memcmp (p, needle, n) == 0)
+            {
+                return TRUE;
+            }
+
+            p++;
+        }
+
+        return FALSE;
+    }
+
+    /* The literal is ASCII when the search ignores the case */
+    lower = g_ascii_tolower (needle[0]);
+    upper = g_ascii_toupper (needle[0]);
+
+    while ((gsize) (end - p) >= n)
+    {
+        const gchar *last = end - n + 1;
+        const gchar *found;
+
+        found = memchr (p, lower, last - p);
+
+        if (upper != lower)
+        {
+            const gchar *found_upper = memchr (p, upper, (found != NULL ? found : last) - p);
+
+            if (found_upper != NULL)
+            {
+                found = found_upper;
+            }
+        }
+
+        if (found == NULL)
+        {
+            return FALSE;
+        }
+
+        if (g_ascii_strncasecmp (found, needle, n) == 0)
+        {
+            return TRUE;
+        }
+
+        p = found + 1;
+    }
+
+    return FALSE;
+}
+
+static void
+add_line (FileResult  *result,
+          gint         line,
+          const gchar *line_start,
+          const gchar *match_start,
+          const gchar *match_end,
+          const gchar *text_end)
+{
+    LineResult line_result;
+
+    line_result.line = line;
+    line_result.markup = xed_utils_make_match_snippet (line, line_start, match_start, match_end, text_end);
+
+    g_array_append_val (result->lines, line_result);
+}
+
+/* Lists each line holding a match once */
+static FileResult *
+search_text (Scan        *scan,
+             const gchar *path,
+             const gchar *text,
+             gsize        length)
+{
+    FileResult *result;
+    GMatchInfo *match_info;
+    const gchar *line_start = text;
+    const gchar *scanned = text;
+    gint line = 0;
+    gint last_line = -1;
+
+    result = g_slice_new0 (FileResult);
+    result->lines = g_array_new (FALSE, FALSE, sizeof (LineResult));
+    g_array_set_clear_func (result->lines, (GDestroyNotify) line_result_clear);
+
+    g_regex_match_full (scan->regex, text, length, 0, 0, &match_info, NULL);
+
+    while (g_match_info_matches (match_info))
+    {
+        const gchar *match_start;
+        const gchar *newline;
+        gint start;
+        gint end;
+
+        g_match_info_fetch_pos (match_info, 0, &start, &end);
+        match_start = text + start;
+
+        while ((newline = memchr (scanned, '\n', match_start - scanned)) != NULL)
+        {
+            line++;
+            line_start = newline + 1;
+            scanned = newline + 1;
+        }
+
+        scanned = match_start;
+
+        if (line != last_line)
+        {
+            if (result->lines->len == MAX_LINES_PER_FILE)
+            {
+                result->truncated = TRUE;
+                break;
+            }
+
+            add_line (result, line, line_start, match_start, text + end, text + length);
+            last_line = line;
+        }
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+
+    if (result->lines->len == 0)
+    {
+        file_result_free (result);
+        return NULL;
+    }
+
+    result->path = g_strdup (path);
+
+    return result;
+}
+
+static gboolean flush_results_cb (Scan *scan);
+
+static void
+add_result (Scan       *scan,
+            FileResult *result)
+{
+    gint n_lines = result->lines->len;
+
+    /* Enough for anyone to look at, stop there */
+    if (g_atomic_int_add (&scan->n_lines, n_lines) + n_lines > MAX_LINES)
+    {
+        g_atomic_int_set (&scan->truncated, TRUE);
+        g_cancellable_cancel (scan->cancellable);
+    }
+
+    g_mutex_lock (&scan->results_lock);
+
+    g_ptr_array_add (scan->results, result);
+
+    if (scan->flush_id == 0)
+    {
+        scan->flush_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                          (GSourceFunc) flush_results_cb,
+                                          scan_ref (scan),
+                                          (GDestroyNotify) scan_unref);
+    }
+
+    g_mutex_unlock (&scan->results_lock);
+}
+
+typedef struct
+{
+    Scan *scan;
+    const gchar *data;
+    gsize length;
+    gchar *copy;
+} Candidate;
+
+/* Copies the file out of the mapping if it may hold a match */
+static void
+copy_candidate (Candidate *candidate)
+{
+    const gchar *data = candidate->data;
+    gsize length = candidate->length;
+
+    if (memchr (data, '\0', MIN (length, BINARY_CHECK_LENGTH)) != NULL)
+    {
+        return;
+    }
+
+    if (candidate->scan->literal != NULL && !contains_literal (candidate->scan, data, length))
+    {
+        return;
+    }
+
+    candidate->copy = g_malloc (length + 1);
+    memcpy (candidate->copy, data, length);
+    candidate->copy[length] = '\0';
+}
+
+static void
+search_file (Scan     *scan,
+             WorkItem *item)
+{
+    GMappedFile *mapped;
+    Candidate candidate;
+    const gchar *relative;
+    FileResult *result = NULL;
+
+    g_atomic_int_inc (&scan->n_files);
+
+    mapped = g_mapped_file_new (item->path, FALSE, NULL);
+
+    if (mapped == NULL)
+    {
+        return;
+    }
+
+    candidate.scan = scan;
+    candidate.data = g_mapped_file_get_contents (mapped);
+    candidate.length = g_mapped_file_get_length (mapped);
+    candidate.copy = NULL;
+
+    if (candidate.data != NULL &&
+        !xed_utils_read_mapped_guarded ((XedMappedReadFunc) copy_candidate, &candidate))
+    {
+        g_clear_pointer (&candidate.copy, g_free);
+    }
+
+    g_mapped_file_unref (mapped);
+
+    if (candidate.copy != NULL &&
+        g_utf8_validate (candidate.copy, candidate.length, NULL))
+    {
+        relative = item->path + strlen (scan->root);
+
+        if (*relative == G_DIR_SEPARATOR)
+        {
+            relative++;
+        }
+
+        result = search_text (scan, relative, candidate.copy, candidate.length);
+    }
+
+    g_free (candidate.copy);
+
+    if (result != NULL)
+    {
+        add_result (scan, result);
+    }
+}
+
+static gboolean scan_finished_cb (Scan *scan);
+
+static gpointer
+worker_thread (Worker *worker)
+{
+    Scan *scan = worker->scan;
+    WorkItem *item;
+
+    while (TRUE)
+    {
+        item = next_item (scan, worker->id);
+
+        if (item == NULL)
+        {
+            g_mutex_lock (&scan->wait_lock);
+
+            if (g_atomic_int_get (&scan->pending) == 0)
+            {
+                g_mutex_unlock (&scan->wait_lock);
+                break;
+            }
+
+            g_cond_wait_until (&scan->wait_cond, &scan->wait_lock, g_get_monotonic_time () + WAIT_INTERVAL);
+            g_mutex_unlock (&scan->wait_lock);
+
+            continue;
+        }
+
+        /* Once cancelled the queues are only drained */
+        if (!g_cancellable_is_cancelled (scan->cancellable))
+        {
+            if (item->is_dir)
+            {
+                scan_directory (worker, item);
+            }
+            else
+            {
+                search_file (scan, item);
+            }
+        }
+
+        work_item_free (item);
+
+        if (g_atomic_int_dec_and_test (&scan->pending))
+        {
+            g_mutex_lock (&scan->wait_lock);
+            g_cond_broadcast (&scan->wait_cond);
+            g_mutex_unlock (&scan->wait_lock);
+
+            g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                             (GSourceFunc) scan_finished_cb,
+                             scan_ref (scan),
+                             (GDestroyNotify) scan_unref);
+        }
+    }
+
+    scan_unref (scan);
+    g_slice_free (Worker, worker);
+
+    return NULL;
+}
+
+static void
+set_status (XedFileBrowserSearch *search,
+            const gchar          *status)
+{
+    gtk_label_set_text (GTK_LABEL (search->priv->status_label), status);
+}
+
+static gboolean
+update_status_cb (XedFileBrowserSearch *search)
+{
+    gchar *status;
+    gint n_files;
+
+    n_files = g_atomic_int_get (&search->priv->scan->n_files);
+    status = g_strdup_printf (ngettext ("Searching... %d file", "Searching... %d files", n_files), n_files);
+    set_status (search, status);
+    g_free (status);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+flush_results_cb (Scan *scan)
+{
+    XedFileBrowserSearch *search = scan->search;
+    GPtrArray *results;
+    guint i;
+
+    g_mutex_lock (&scan->results_lock);
+    results = scan->results;
+    scan->results = g_ptr_array_new_with_free_func ((GDestroyNotify) file_result_free);
+    scan->flush_id = 0;
+    g_mutex_unlock (&scan->results_lock);
+
+    for (i = 0; search != NULL && i < results->len; i++)
+    {
+        FileResult *result = g_ptr_array_index (results, i);
+        GFile *location;
+        GtkTreeIter parent;
+        GtkTreePath *path;
+        gchar *markup;
+        guint j;
+
+        location = g_file_resolve_relative_path (scan->location, result->path);
+
+        markup = g_markup_printf_escaped (result->truncated ? "<b>%s</b> (%u+)" : "<b>%s</b> (%u)",
+                                          result->path, result->lines->len);
+
+        gtk_tree_store_insert_with_values (search->priv->store, &parent, NULL, -1,
+                                           COLUMN_MARKUP, markup,
+                                           COLUMN_LOCATION, location,
+                                           COLUMN_LINE, -1,
+                                           -1);
+        g_free (markup);
+
+        for (j = 0; j < result->lines->len; j++)
+        {
+            LineResult *line = &g_array_index (result->lines, LineResult, j);
+
+            gtk_tree_store_insert_with_values (search->priv->store, NULL, &parent, -1,
+                                               COLUMN_MARKUP, line->markup,
+                                               COLUMN_LOCATION, location,
+                                               COLUMN_LINE, line->line,
+                                               -1);
+        }
+
+        path = gtk_tree_model_get_path (GTK_TREE_MODEL (search->priv->store), &parent);
+        gtk_tree_view_expand_row (GTK_TREE_VIEW (search->priv->treeview), path, FALSE);
+        gtk_tree_path_free (path);
+
+        g_object_unref (location);
+    }
+
+    g_ptr_array_unref (results);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+clear_scan (XedFileBrowserSearch *search)
+{
+    if (search->priv->status_id != 0)
+    {
+        g_source_remove (search->priv->status_id);
+        search->priv->status_id = 0;
+    }
+
+    if (search->priv->scan != NULL)
+    {
+        search->priv->scan->search = NULL;
+        g_cancellable_cancel (search->priv->scan->cancellable);
+        scan_unref (search->priv->scan);
+        search->priv->scan = NULL;
+    }
+}
+
+static gboolean
+scan_finished_cb (Scan *scan)
+{
+    XedFileBrowserSearch *search = scan->search;
+    gint n_lines;
+    gchar *status;
+
+    if (search == NULL)
+    {
+        return G_SOURCE_REMOVE;
+    }
+
+    flush_results_cb (scan);
+
+    n_lines = g_atomic_int_get (&scan->n_lines);
+
+    if (g_atomic_int_get (&scan->truncated))
+    {
+        status = g_strdup_printf (_("Found the first %d matching lines"), n_lines);
+    }
+    else if (n_lines == 0)
+    {
+        status = g_strdup (_("No matches found"));
+    }
+    else
+    {
+        status = g_strdup_printf (ngettext ("Found %d matching line", "Found %d matching lines", n_lines), n_lines);
+    }
+
+    set_status (search, status);
+    g_free (status);
+
+    clear_scan (search);
+    gtk_widget_set_sensitive (search->priv->stop_button, FALSE);
+
+    return G_SOURCE_REMOVE;
+}
+
+static GRegex *
+create_regex (const gchar  *text,
+              gboolean      use_regex,
+              gboolean      caseless,
+              GError      **error)
+{
+    GRegexCompileFlags flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+    gchar *pattern;
+    GRegex *regex;
+
+    pattern = use_regex ? g_strdup (text) : g_regex_escape_string (text, -1);
+
+    if (caseless)
+    {
+        flags |= G_REGEX_CASELESS;
+    }
+
+    regex = g_regex_new (pattern, flags, 0, error);
+
+    g_free (pattern);
+
+    return regex;
+}
+
+/* The text every match holds, if it can be told without parsing the regex */
+static gchar *
+get_literal (const gchar *text,
+             gboolean     use_regex,
+             gboolean     caseless)
+{
+    const gchar *p;
+
+    if (use_regex && strpbrk (text, REGEX_SPECIAL_CHARS) != NULL)
+    {
+        return NULL;
+    }
+
+    /* Ignoring the case is only cheap for ASCII */
+    for (p = text; caseless && *p != '\0'; p++)
+    {
+        if ((guchar) *p >= 0x80)
+        {
+            return NULL;
+        }
+    }
+
+    return g_strdup (text);
+}
+
+static void
+start_search (XedFileBrowserSearch *search)
+{
+    const gchar *text;
+    gchar *root;
+    gboolean use_regex;
+    gboolean caseless;
+    GRegex *regex;
+    Scan *scan;
+    GError *error = NULL;
+    guint i;
+
+    text = gtk_entry_get_text (GTK_ENTRY (search->priv->entry));
+
+    if (*text == '\0')
+    {
+        return;
+    }
+
+    clear_scan (search);
+    gtk_widget_set_sensitive (search->priv->stop_button, FALSE);
+    gtk_tree_store_clear (search->priv->store);
+
+    root = search->priv->root != NULL ? g_file_get_path (search->priv->root) : NULL;
+
+    if (root == NULL)
+    {
+        set_status (search, _("Only local folders can be searched"));
+        return;
+    }
+
+    use_regex = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (search->priv->regex_button));
+    caseless = !gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (search->priv->match_case_button));
+
+    regex = create_regex (text, use_regex, caseless, &error);
+
+    if (regex == NULL)
+    {
+        set_status (search, error->message);
+        g_error_free (error);
+        g_free (root);
+        return;
+    }
+
+    scan = g_slice_new0 (Scan);
+    scan->ref_count = 1;
+    scan->location = g_object_ref (search->priv->root);
+    scan->root = root;
+    scan->regex = regex;
+    scan->literal = get_literal (text, use_regex, caseless);
+    scan->literal_length = scan->literal != NULL ? strlen (scan->literal) : 0;
+    scan->caseless = caseless;
+    scan->cancellable = g_cancellable_new ();
+    scan->n_workers = g_get_num_processors ();
+    scan->queues = g_new0 (WorkQueue, scan->n_workers);
+    scan->results = g_ptr_array_new_with_free_func ((GDestroyNotify) file_result_free);
+    scan->search = search;
+
+    g_mutex_init (&scan->wait_lock);
+    g_cond_init (&scan->wait_cond);
+    g_mutex_init (&scan->results_lock);
+
+    for (i = 0; i < scan->n_workers; i++)
+    {
+        g_mutex_init (&scan->queues[i].lock);
+        g_queue_init (&scan->queues[i].items);
+    }
+
+    push_item (scan, 0, work_item_new (g_strdup (root), TRUE, NULL));
+
+    for (i = 0; i < scan->n_workers; i++)
+    {
+        Worker *worker = g_slice_new (Worker);
+
+        worker->scan = scan_ref (scan);
+        worker->id = i;
+
+        g_thread_unref (g_thread_new ("xed-find-in-files", (GThreadFunc) worker_thread, worker));
+    }
+
+    search->priv->scan = scan;
+    search->priv->status_id = g_timeout_add (STATUS_INTERVAL, (GSourceFunc) update_status_cb, search);
+
+    gtk_widget_set_sensitive (search->priv->stop_button, TRUE);
+    update_status_cb (search);
+}
+
+static void
+on_entry_activate (GtkEntry             *entry,
+                   XedFileBrowserSearch *search)
+{
+    start_search (search);
+}
+
+static void
+on_stop_clicked (GtkButton            *button,
+                 XedFileBrowserSearch *search)
+{
+    xed_file_browser_search_stop (search);
+}
+
+static void
+on_row_activated (GtkTreeView          *treeview,
+                  GtkTreePath          *path,
+                  GtkTreeViewColumn    *column,
+                  XedFileBrowserSearch *search)
+{
+    GtkTreeIter iter;
+    GFile *location;
+    gint line;
+
+    if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (search->priv->store), &iter, path))
+    {
+        return;
+    }
+
+    gtk_tree_model_get (GTK_TREE_MODEL (search->priv->store), &iter,
+                        COLUMN_LOCATION, &location,
+                        COLUMN_LINE, &line,
+                        -1);
+
+    if (location != NULL)
+    {
+        g_signal_emit (search, signals[LOCATION_ACTIVATED], 0, location, line);
+        g_object_unref (location);
+    }
+}
+
+static void
+xed_file_browser_search_dispose (GObject *object)
+{
+    XedFileBrowserSearch *search = XED_FILE_BROWSER_SEARCH (object);
+
+    clear_scan (search);
+    g_clear_object (&search->priv->root);
+
+    G_OBJECT_CLASS (xed_file_browser_search_parent_class)->dispose (object);
+}
+
+static void
+xed_file_browser_search_class_init (XedFileBrowserSearchClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = xed_file_browser_search_dispose;
+
+    signals[LOCATION_ACTIVATED] =
+        g_signal_new ("location-activated",
+                      G_OBJECT_CLASS_TYPE (object_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XedFileBrowserSearchClass, location_activated),
+                      NULL, NULL,
+                      xed_file_browser_marshal_VOID__OBJECT_INT,
+                      G_TYPE_NONE, 2, G_TYPE_FILE, G_TYPE_INT);
+}
+
+static void
+xed_file_browser_search_class_finalize (XedFileBrowserSearchClass *klass)
+{
+    /* dummy function - used by G_DEFINE_DYNAMIC_TYPE */
+}
+
+static void
+xed_file_browser_search_init (XedFileBrowserSearch *search)
+{
+    GtkWidget *hbox;
+    GtkWidget *sw;
+    GtkTreeViewColumn *column;
+    GtkCellRenderer *cell;
+
+    search->priv = xed_file_browser_search_get_instance_private (search);
+
+    gtk_orientable_set_orientation (GTK_ORIENTABLE (search), GTK_ORIENTATION_VERTICAL);
+
+    hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_container_set_border_width (GTK_CONTAINER (hbox), 3);
+    gtk_box_pack_start (GTK_BOX (search), hbox, FALSE, FALSE, 0);
+
+    search->priv->entry = gtk_search_entry_new ();
+    gtk_entry_set_placeholder_text (GTK_ENTRY (search->priv->entry), _("Find in files"));
+    gtk_box_pack_start (GTK_BOX (hbox), search->priv->entry, FALSE, FALSE, 0);
+    g_signal_connect (search->priv->entry, "activate", G_CALLBACK (on_entry_activate), search);
+
+    search->priv->match_case_button = gtk_check_button_new_with_mnemonic (_("_Match case"));
+    gtk_box_pack_start (GTK_BOX (hbox), search->priv->match_case_button, FALSE, FALSE, 0);
+
+    search->priv->regex_button = gtk_check_button_new_with_mnemonic (_("Regular _expression"));
+    gtk_box_pack_start (GTK_BOX (hbox), search->priv->regex_button, FALSE, FALSE, 0);
+
+    search->priv->status_label = gtk_label_new (NULL);
+    gtk_label_set_ellipsize (GTK_LABEL (search->priv->status_label), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_halign (search->priv->status_label, GTK_ALIGN_START);
+    gtk_box_pack_start (GTK_BOX (hbox), search->priv->status_label, TRUE, TRUE, 0);
+
+    search->priv->stop_button = gtk_button_new_with_mnemonic (_("_Stop"));
+    gtk_widget_set_sensitive (search->priv->stop_button, FALSE);
+    gtk_box_pack_end (GTK_BOX (hbox), search->priv->stop_button, FALSE, FALSE, 0);
+    g_signal_connect (search->priv->stop_button, "clicked", G_CALLBACK (on_stop_clicked), search);
+
+    gtk_widget_show_all (hbox);
+
+    sw = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_widget_show (sw);
+    gtk_box_pack_start (GTK_BOX (search), sw, TRUE, TRUE, 0);
+
+    search->priv->store = gtk_tree_store_new (N_COLUMNS, G_TYPE_STRING, G_TYPE_FILE, G_TYPE_INT);
+
+    search->priv->treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL (search->priv->store));
+    g_object_unref (search->priv->store);
+    gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (search->priv->treeview), FALSE);
+    gtk_tree_view_set_enable_search (GTK_TREE_VIEW (search->priv->treeview), FALSE);
+    gtk_container_add (GTK_CONTAINER (sw), search->priv->treeview);
+    gtk_widget_show (search->priv->treeview);
+
+    column = gtk_tree_view_column_new ();
+    cell = gtk_cell_renderer_text_new ();
+    gtk_tree_view_column_pack_start (column, cell, TRUE);
+    gtk_tree_view_column_add_attribute (column, cell, "markup", COLUMN_MARKUP);
+    gtk_tree_view_append_column (GTK_TREE_VIEW (search->priv->treeview), column);
+
+    g_signal_connect (search->priv->treeview, "row-activated", G_CALLBACK (on_row_activated), search);
+}
+
+GtkWidget *
+xed_file_browser_search_new (void)
+{
+    return GTK_WIDGET (g_object_new (XED_TYPE_FILE_BROWSER_SEARCH, NULL));
+}
+
+/* The folder searched next, a running search goes on in the previous one */
+void
+xed_file_browser_search_set_root (XedFileBrowserSearch *search,
+                                  GFile                *root)
+{
+    g_return_if_fail (XED_IS_FILE_BROWSER_SEARCH (search));
+
+    g_clear_object (&search->priv->root);
+
+    if (root != NULL)
+    {
+        search->priv->root = g_object_ref (root);
+    }
+}
+
+void
+xed_file_browser_search_grab_focus (XedFileBrowserSearch *search)
+{
+    g_return_if_fail (XED_IS_FILE_BROWSER_SEARCH (search));
+
+    gtk_widget_grab_focus (search->priv->entry);
+}
+
+void
+xed_file_browser_search_stop (XedFileBrowserSearch *search)
+{
+    g_return_if_fail (XED_IS_FILE_BROWSER_SEARCH (search));
+
+    if (search->priv->scan == NULL)
+    {
+        return;
+    }
+
+    clear_scan (search);
+    gtk_widget_set_sensitive (search->priv->stop_button, FALSE);
+    set_status (search, _("Stopped"));
+}
+
+void
+_xed_file_browser_search_register_type (GTypeModule *type_module)
+{
+    xed_file_browser_search_register_type (type_module);
+}
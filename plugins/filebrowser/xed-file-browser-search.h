@@ -0,0 +1,65 @@
+/*
+ * xed-file-browser-search.h - Xed plugin providing easy file access
+ * from the sidepanel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_FILE_BROWSER_SEARCH_H__
+#define __XED_FILE_BROWSER_SEARCH_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+#define XED_TYPE_FILE_BROWSER_SEARCH             (xed_file_browser_search_get_type ())
+#define XED_FILE_BROWSER_SEARCH(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), XED_TYPE_FILE_BROWSER_SEARCH, XedFileBrowserSearch))
+#define XED_FILE_BROWSER_SEARCH_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), XED_TYPE_FILE_BROWSER_SEARCH, XedFileBrowserSearchClass))
+#define XED_IS_FILE_BROWSER_SEARCH(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XED_TYPE_FILE_BROWSER_SEARCH))
+#define XED_IS_FILE_BROWSER_SEARCH_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), XED_TYPE_FILE_BROWSER_SEARCH))
+#define XED_FILE_BROWSER_SEARCH_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), XED_TYPE_FILE_BROWSER_SEARCH, XedFileBrowserSearchClass))
+
+typedef struct _XedFileBrowserSearch        XedFileBrowserSearch;
+typedef struct _XedFileBrowserSearchClass   XedFileBrowserSearchClass;
+typedef struct _XedFileBrowserSearchPrivate XedFileBrowserSearchPrivate;
+
+struct _XedFileBrowserSearch
+{
+    GtkBox parent;
+
+    XedFileBrowserSearchPrivate *priv;
+};
+
+struct _XedFileBrowserSearchClass
+{
+    GtkBoxClass parent_class;
+
+    /* Signals */
+    void (* location_activated) (XedFileBrowserSearch *search,
+                                 GFile                *location,
+                                 gint                  line);
+};
+
+GType xed_file_browser_search_get_type (void) G_GNUC_CONST;
+void _xed_file_browser_search_register_type (GTypeModule *type_module);
+
+GtkWidget *xed_file_browser_search_new          (void);
+
+void       xed_file_browser_search_set_root     (XedFileBrowserSearch *search,
+                                                 GFile                *root);
+void       xed_file_browser_search_grab_focus   (XedFileBrowserSearch *search);
+void       xed_file_browser_search_stop         (XedFileBrowserSearch *search);
+
+G_END_DECLS
+#endif /* __XED_FILE_BROWSER_SEARCH_H__ */
@@ -41,6 +41,11 @@
 #define FILE_BROWSER_NODE_DIR(node) ((FileBrowserNodeDir *)(node))
 
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
+#define DIRECTORY_LOAD_MAX_ITEMS_PER_CALLBACK 4096
+
+/* Main loop time, in microseconds, spent adding loaded files to the
+ * model before giving the view a chance to draw */
+#define DIRECTORY_LOAD_FRAME_BUDGET 8000
 #define STANDARD_ATTRIBUTE_TYPES G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
                                  G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
                                  G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
@@ -69,9 +74,34 @@ struct _AsyncNode
 {
     FileBrowserNodeDir *dir;
     GCancellable *cancellable;
-    GSList *original_children;
+    gint ref_count;
+
+    /* Files are enumerated by gio, sorted on a worker thread and added
+     * to the model from an idle, so the three steps overlap */
+    gint n_items;          /* files asked from the enumerator at once */
+    gint64 requested;      /* when they were asked */
+    gdouble publish_cost;  /* measured microseconds to add one file */
+
+    guint n_preparing;     /* batches being sorted */
+    GQueue prepared;       /* sorted batches waiting to be added */
+    guint published;       /* files of the head batch already added */
+    guint publish_id;
+
+    gboolean enumerated;
 };
 
+/* A file enumerated in a directory being loaded, with everything that
+ * is needed to sort it computed off the main thread */
+typedef struct
+{
+    GFileInfo *info;
+    GFile *file;
+    gchar *name;
+    gchar *collate_key;
+    gboolean is_dir;
+    gboolean is_hidden;
+} PreparedFile;
+
 typedef struct {
     XedFileBrowserStore *model;
     GFile *virtual_root;
@@ -84,6 +114,7 @@ struct _FileBrowserNode
     GFile *file;
     guint flags;
     gchar *name;
+    gchar *collate_key;
 
     GdkPixbuf *icon;
     GdkPixbuf *emblem;
@@ -91,6 +122,7 @@ struct _FileBrowserNode
     FileBrowserNode *parent;
     gint pos;
     gboolean inserted;
+    GSequenceIter *row; /* position in the rows of the parent while inserted */
 };
 
 struct _FileBrowserNodeDir
@@ -98,6 +130,13 @@ struct _FileBrowserNodeDir
     FileBrowserNode node;
     GSList *children;
 
+    /* The inserted children, in the same order as children, so that
+     * positions can be computed and looked up in O(log n) */
+    GSequence *rows;
+
+    /* GFile -> child, for lookups by location */
+    GHashTable *index;
+
     GCancellable *cancellable;
     GFileMonitor *monitor;
     XedFileBrowserStore *model;
@@ -209,6 +248,8 @@ enum
     BEGIN_REFRESH,
     END_REFRESH,
     UNLOAD,
+    FILE_CREATED,
+    FILE_DELETED,
     NUM_SIGNALS
 };
 
@@ -415,6 +456,24 @@ xed_file_browser_store_class_init (XedFileBrowserStoreClass * klass)
                       g_cclosure_marshal_VOID__OBJECT,
                       G_TYPE_NONE, 1,
                       G_TYPE_FILE);
+    model_signals[FILE_CREATED] =
+        g_signal_new ("file-created",
+                      G_OBJECT_CLASS_TYPE (object_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XedFileBrowserStoreClass,
+                               file_created), NULL, NULL,
+                      g_cclosure_marshal_VOID__OBJECT,
+                      G_TYPE_NONE, 1,
+                      G_TYPE_FILE);
+    model_signals[FILE_DELETED] =
+        g_signal_new ("file-deleted",
+                      G_OBJECT_CLASS_TYPE (object_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XedFileBrowserStoreClass,
+                               file_deleted), NULL, NULL,
+                      g_cclosure_marshal_VOID__OBJECT,
+                      G_TYPE_NONE, 1,
+                      G_TYPE_FILE);
 }
 
 static void
@@ -523,6 +582,91 @@ model_node_inserted (XedFileBrowserStore *model,
     return node == model->priv->virtual_root || (model_node_visibility (model, node) && node->inserted);
 }
 
+static gint
+model_compare_rows (gconstpointer a,
+                    gconstpointer b,
+                    gpointer      user_data)
+{
+    XedFileBrowserStore *model = XED_FILE_BROWSER_STORE (user_data);
+
+    if (model->priv->sort_func == NULL)
+    {
+        return 0;
+    }
+
+    return model->priv->sort_func ((FileBrowserNode *) a, (FileBrowserNode *) b);
+}
+
+static void
+model_node_set_inserted (XedFileBrowserStore *model,
+                         FileBrowserNode     *node,
+                         gboolean             inserted)
+{
+    node->inserted = inserted;
+
+    if (node->parent == NULL)
+    {
+        return;
+    }
+
+    if (inserted && node->row == NULL)
+    {
+        node->row = g_sequence_insert_sorted (FILE_BROWSER_NODE_DIR (node->parent)->rows,
+                                              node,
+                                              model_compare_rows,
+                                              model);
+    }
+    else if (!inserted && node->row != NULL)
+    {
+        g_sequence_remove (node->row);
+        node->row = NULL;
+    }
+}
+
+/* Returns the row of node, or the row it would be inserted at */
+static GSequenceIter *
+model_node_row (XedFileBrowserStore *model,
+                FileBrowserNode     *node)
+{
+    if (node->row != NULL)
+    {
+        return node->row;
+    }
+
+    return g_sequence_search (FILE_BROWSER_NODE_DIR (node->parent)->rows,
+                              node,
+                              model_compare_rows,
+                              model);
+}
+
+static FileBrowserNode *
+model_find_child (FileBrowserNode *parent,
+                  GFile           *file)
+{
+    return g_hash_table_lookup (FILE_BROWSER_NODE_DIR (parent)->index, file);
+}
+
+static void
+model_index_child (FileBrowserNode *parent,
+                   FileBrowserNode *child)
+{
+    if (child->file != NULL)
+    {
+        g_hash_table_insert (FILE_BROWSER_NODE_DIR (parent)->index, child->file, child);
+    }
+}
+
+static void
+model_unindex_child (FileBrowserNode *parent,
+                     FileBrowserNode *child)
+{
+    if (child->file != NULL &&
+        g_hash_table_lookup (FILE_BROWSER_NODE_DIR (parent)->index, child->file) == child)
+    {
+        g_hash_table_remove (FILE_BROWSER_NODE_DIR (parent)->index, child->file);
+    }
+}
+
 /* Interface implementation */
 
 static GtkTreeModelFlags
@@ -559,7 +703,6 @@ xed_file_browser_store_get_iter (GtkTreeModel *tree_model,
     gint *indices, depth, i;
     FileBrowserNode *node;
     XedFileBrowserStore *model;
-    gint num;
 
     g_assert (XED_IS_FILE_BROWSER_STORE (tree_model));
     g_assert (path != NULL);
@@ -571,44 +714,26 @@ xed_file_browser_store_get_iter (GtkTreeModel *tree_model,
 
     for (i = 0; i < depth; ++i)
     {
-        GSList * item;
+        GSequenceIter *row;
 
         if (node == NULL)
         {
             return FALSE;
         }
 
-        num = 0;
-
         if (!NODE_IS_DIR (node))
         {
             return FALSE;
         }
 
-        for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-        {
-            FileBrowserNode * child;
-
-            child = (FileBrowserNode *) (item->data);
-
-            if (model_node_inserted (model, child))
-            {
-                if (num == indices[i])
-                {
-                    node = child;
-                    break;
-                }
-
-                num++;
-            }
-        }
+        row = g_sequence_get_iter_at_pos (FILE_BROWSER_NODE_DIR (node)->rows, indices[i]);
 
-        if (item == NULL)
+        if (g_sequence_iter_is_end (row))
         {
             return FALSE;
         }
 
-        node = (FileBrowserNode *) (item->data);
+        node = (FileBrowserNode *) g_sequence_get (row);
     }
 
     iter->user_data = node;
@@ -623,50 +748,30 @@ xed_file_browser_store_get_path_real (XedFileBrowserStore *model,
                                       FileBrowserNode     *node)
 {
     GtkTreePath *path;
-    gint num = 0;
 
     path = gtk_tree_path_new ();
 
     while (node != model->priv->virtual_root)
     {
-        GSList *item;
-
         if (node->parent == NULL)
         {
             gtk_tree_path_free (path);
             return NULL;
         }
 
-        num = 0;
-
-        for (item = FILE_BROWSER_NODE_DIR (node->parent)->children; item; item = item->next)
+        if (!model_node_visibility (model, node))
         {
-            FileBrowserNode *check;
-
-            check = (FileBrowserNode *) (item->data);
-
-            if (model_node_visibility (model, check) && (check == node || check->inserted))
+            if (NODE_IS_DUMMY (node))
             {
-                if (check == node)
-                {
-                    gtk_tree_path_prepend_index (path, num);
-                    break;
-                }
-
-                ++num;
+                g_warning ("Dummy not visible???");
             }
-            else if (check == node)
-            {
-                if (NODE_IS_DUMMY (node))
-                {
-                    g_warning ("Dummy not visible???");
-                }
 
-                gtk_tree_path_free (path);
-                return NULL;
-            }
+            gtk_tree_path_free (path);
+            return NULL;
         }
 
+        gtk_tree_path_prepend_index (path, g_sequence_iter_get_position (model_node_row (model, node)));
+
         node = node->parent;
     }
 
@@ -729,8 +834,7 @@ xed_file_browser_store_iter_next (GtkTreeModel *tree_model,
 {
     XedFileBrowserStore *model;
     FileBrowserNode *node;
-    GSList *item;
-    GSList *first;
+    GSequenceIter *row;
 
     g_return_val_if_fail (XED_IS_FILE_BROWSER_STORE (tree_model), FALSE);
     g_return_val_if_fail (iter != NULL, FALSE);
@@ -744,18 +848,20 @@ xed_file_browser_store_iter_next (GtkTreeModel *tree_model,
         return FALSE;
     }
 
-    first = g_slist_next (g_slist_find (FILE_BROWSER_NODE_DIR (node->parent)->children, node));
+    row = model_node_row (model, node);
 
-    for (item = first; item; item = item->next)
+    if (node->row != NULL)
     {
-        if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-        {
-            iter->user_data = item->data;
-            return TRUE;
-        }
+        row = g_sequence_iter_next (row);
     }
 
-    return FALSE;
+    if (g_sequence_iter_is_end (row))
+    {
+        return FALSE;
+    }
+
+    iter->user_data = g_sequence_get (row);
+    return TRUE;
 }
 
 static gboolean
@@ -765,7 +871,7 @@ xed_file_browser_store_iter_children (GtkTreeModel *tree_model,
 {
     FileBrowserNode *node;
     XedFileBrowserStore *model;
-    GSList *item;
+    GSequenceIter *row;
 
     g_return_val_if_fail (XED_IS_FILE_BROWSER_STORE (tree_model), FALSE);
     g_return_val_if_fail (parent == NULL || parent->user_data != NULL, FALSE);
@@ -791,32 +897,35 @@ xed_file_browser_store_iter_children (GtkTreeModel *tree_model,
         return FALSE;
     }
 
-    for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+    row = g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->rows);
+
+    if (g_sequence_iter_is_end (row))
     {
-        if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-        {
-            iter->user_data = item->data;
-            return TRUE;
-        }
+        return FALSE;
     }
 
-    return FALSE;
+    iter->user_data = g_sequence_get (row);
+    return TRUE;
 }
 
 static gboolean
 filter_tree_model_iter_has_child_real (XedFileBrowserStore *model,
                                        FileBrowserNode     *node)
 {
-    GSList *item;
+    GSequenceIter *row;
 
     if (!NODE_IS_DIR (node))
     {
         return FALSE;
     }
 
-    for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+    /* The dummy may be hidden while it is still inserted, see
+     * model_check_dummy () */
+    for (row = g_sequence_get_begin_iter (FILE_BROWSER_NODE_DIR (node)->rows);
+         !g_sequence_iter_is_end (row);
+         row = g_sequence_iter_next (row))
     {
-        if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
+        if (model_node_inserted (model, (FileBrowserNode *) g_sequence_get (row)))
         {
             return TRUE;
         }
@@ -855,8 +964,6 @@ xed_file_browser_store_iter_n_children (GtkTreeModel *tree_model,
 {
     FileBrowserNode *node;
     XedFileBrowserStore *model;
-    GSList *item;
-    gint num = 0;
 
     g_return_val_if_fail (XED_IS_FILE_BROWSER_STORE (tree_model), FALSE);
     g_return_val_if_fail (iter == NULL || iter->user_data != NULL, FALSE);
@@ -877,15 +984,7 @@ xed_file_browser_store_iter_n_children (GtkTreeModel *tree_model,
         return 0;
     }
 
-    for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-    {
-        if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-        {
-            ++num;
-        }
-    }
-
-    return num;
+    return g_sequence_get_length (FILE_BROWSER_NODE_DIR (node)->rows);
 }
 
 static gboolean
@@ -895,8 +994,7 @@ xed_file_browser_store_iter_nth_child (GtkTreeModel *tree_model,
 {
     FileBrowserNode *node;
     XedFileBrowserStore *model;
-    GSList *item;
-    gint num = 0;
+    GSequenceIter *row;
 
     g_return_val_if_fail (XED_IS_FILE_BROWSER_STORE (tree_model), FALSE);
     g_return_val_if_fail (parent == NULL || parent->user_data != NULL, FALSE);
@@ -917,21 +1015,15 @@ xed_file_browser_store_iter_nth_child (GtkTreeModel *tree_model,
         return FALSE;
     }
 
-    for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-    {
-        if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-        {
-            if (num == n)
-            {
-                iter->user_data = item->data;
-                return TRUE;
-            }
+    row = g_sequence_get_iter_at_pos (FILE_BROWSER_NODE_DIR (node)->rows, n);
 
-            ++num;
-        }
+    if (g_sequence_iter_is_end (row))
+    {
+        return FALSE;
     }
 
-    return FALSE;
+    iter->user_data = g_sequence_get (row);
+    return TRUE;
 }
 
 static gboolean
@@ -970,7 +1062,7 @@ xed_file_browser_store_row_inserted (GtkTreeModel *tree_model,
 {
     FileBrowserNode * node = (FileBrowserNode *)(iter->user_data);
 
-    node->inserted = TRUE;
+    model_node_set_inserted (XED_FILE_BROWSER_STORE (tree_model), node, TRUE);
 }
 
 static gboolean
@@ -1090,18 +1182,19 @@ collate_nodes (FileBrowserNode *node1,
     }
     else
     {
-        gchar *k1, *k2;
-        gint result;
-
-        k1 = g_utf8_collate_key_for_filename (node1->name, -1);
-        k2 = g_utf8_collate_key_for_filename (node2->name, -1);
-
-        result = strcmp (k1, k2);
+        /* The keys are kept, sorting a large directory compares
+         * every node many times */
+        if (node1->collate_key == NULL)
+        {
+            node1->collate_key = g_utf8_collate_key_for_filename (node1->name, -1);
+        }
 
-        g_free (k1);
-        g_free (k2);
+        if (node2->collate_key == NULL)
+        {
+            node2->collate_key = g_utf8_collate_key_for_filename (node2->name, -1);
+        }
 
-        return result;
+        return strcmp (node1->collate_key, node2->collate_key);
     }
 }
 
@@ -1161,6 +1254,7 @@ model_resort_node (XedFileBrowserStore *model,
     {
         /* Just sort the children of the parent */
         dir->children = g_slist_sort (dir->children, (GCompareFunc) (model->priv->sort_func));
+        g_sequence_sort (dir->rows, model_compare_rows, model);
     }
     else
     {
@@ -1176,6 +1270,7 @@ model_resort_node (XedFileBrowserStore *model,
         }
 
         dir->children = g_slist_sort (dir->children, (GCompareFunc) (model->priv->sort_func));
+        g_sequence_sort (dir->rows, model_compare_rows, model);
         neworder = g_new (gint, pos);
         pos = 0;
 
@@ -1324,7 +1419,7 @@ model_refilter_node (XedFileBrowserStore *model,
         {
             if (old_visible)
             {
-                node->inserted = FALSE;
+                model_node_set_inserted (model, node, FALSE);
                 row_deleted (model, *path);
             }
             else
@@ -1358,6 +1453,8 @@ static void
 file_browser_node_set_name (FileBrowserNode *node)
 {
     g_free (node->name);
+    g_free (node->collate_key);
+    node->collate_key = NULL;
 
     if (node->file)
     {
@@ -1405,6 +1502,8 @@ file_browser_node_dir_new (XedFileBrowserStore *model,
     node->flags |= XED_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
 
     FILE_BROWSER_NODE_DIR (node)->model = model;
+    FILE_BROWSER_NODE_DIR (node)->rows = g_sequence_new (NULL);
+    FILE_BROWSER_NODE_DIR (node)->index = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
 
     return node;
 }
@@ -1429,6 +1528,7 @@ file_browser_node_free_children (XedFileBrowserStore *model,
 
         g_slist_free (FILE_BROWSER_NODE_DIR (node)->children);
         FILE_BROWSER_NODE_DIR (node)->children = NULL;
+        g_hash_table_remove_all (FILE_BROWSER_NODE_DIR (node)->index);
 
         /* This node is no longer loaded */
         node->flags &= ~XED_FILE_BROWSER_STORE_FLAG_LOADED;
@@ -1467,6 +1567,12 @@ file_browser_node_free (XedFileBrowserStore *model,
         }
     }
 
+    if (node->row != NULL)
+    {
+        g_sequence_remove (node->row);
+        node->row = NULL;
+    }
+
     if (node->file)
     {
         g_signal_emit (model, model_signals[UNLOAD], 0, node->file);
@@ -1484,9 +1590,12 @@ file_browser_node_free (XedFileBrowserStore *model,
     }
 
     g_free (node->name);
+    g_free (node->collate_key);
 
     if (NODE_IS_DIR (node))
     {
+        g_sequence_free (FILE_BROWSER_NODE_DIR (node)->rows);
+        g_hash_table_destroy (FILE_BROWSER_NODE_DIR (node)->index);
         g_slice_free (FileBrowserNodeDir, (FileBrowserNodeDir *)node);
     }
     else
@@ -1596,7 +1705,7 @@ model_remove_node (XedFileBrowserStore *model,
        not the virtual root) */
     if (model_node_visibility (model, node) && node != model->priv->virtual_root)
     {
-        node->inserted = FALSE;
+        model_node_set_inserted (model, node, FALSE);
         row_deleted (model, path);
     }
 
@@ -1615,6 +1724,7 @@ model_remove_node (XedFileBrowserStore *model,
             FILE_BROWSER_NODE_DIR (node->parent)->children = g_slist_remove (FILE_BROWSER_NODE_DIR
                                                                              (node->parent)->children,
                                                                              node);
+            model_unindex_child (node->parent, node);
         }
     }
 
@@ -1669,7 +1779,7 @@ model_clear (XedFileBrowserStore *model,
             {
                 path = gtk_tree_path_new_first ();
 
-                dummy->inserted = FALSE;
+                model_node_set_inserted (model, dummy, FALSE);
                 row_deleted (model, path);
                 gtk_tree_path_free (path);
             }
@@ -1865,6 +1975,7 @@ model_check_dummy (XedFileBrowserStore *model,
         if (!model_node_visibility (model, node))
         {
             dummy->flags |= XED_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+            model_node_set_inserted (model, dummy, FALSE);
             return;
         }
 
@@ -1898,7 +2009,7 @@ model_check_dummy (XedFileBrowserStore *model,
                 path = xed_file_browser_store_get_path_real (model, dummy);
                 dummy->flags |= XED_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 
-                dummy->inserted = FALSE;
+                model_node_set_inserted (model, dummy, FALSE);
                 row_deleted (model, path);
                 gtk_tree_path_free (path);
             }
@@ -1923,6 +2034,8 @@ insert_node_sorted (XedFileBrowserStore *model,
     {
         dir->children = g_slist_insert_sorted (dir->children, child, (GCompareFunc) (model->priv->sort_func));
     }
+
+    model_index_child (parent, child);
 }
 
 static void
@@ -1965,6 +2078,11 @@ model_add_nodes_batch (XedFileBrowserStore *model,
 
     sorted_children = g_slist_sort (children, (GCompareFunc) model->priv->sort_func);
 
+    for (l = sorted_children; l; l = l->next)
+    {
+        model_index_child (parent, l->data);
+    }
+
     child = sorted_children;
     l = dir->children;
     prev = NULL;
@@ -2146,27 +2264,6 @@ file_browser_node_set_from_info (XedFileBrowserStore *model,
     }
 }
 
-static FileBrowserNode *
-node_list_contains_file (GSList *children,
-                         GFile  *file)
-{
-    GSList *item;
-
-    for (item = children; item; item = item->next)
-    {
-        FileBrowserNode *node;
-
-        node = (FileBrowserNode *) (item->data);
-
-        if (node->file != NULL && g_file_equal (node->file, file))
-        {
-            return node;
-        }
-    }
-
-    return NULL;
-}
-
 static FileBrowserNode *
 model_add_node_from_file (XedFileBrowserStore *model,
                           FileBrowserNode     *parent,
@@ -2177,7 +2274,7 @@ model_add_node_from_file (XedFileBrowserStore *model,
     gboolean free_info = FALSE;
     GError * error = NULL;
 
-    if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL)
+    if ((node = model_find_child (parent, file)) == NULL)
     {
         if (info == NULL)
         {
@@ -2218,25 +2315,146 @@ model_add_node_from_file (XedFileBrowserStore *model,
     return node;
 }
 
-/* We pass in a copy of the list of parent->children so that we do
- * not have to check if a file already exists among the ones we just
- * added */
+static FileBrowserNode *
+model_add_node_from_dir (XedFileBrowserStore *model,
+                         FileBrowserNode     *parent,
+                         GFile               *file)
+{
+    FileBrowserNode *node;
+
+    /* Check if it already exists */
+    if ((node = model_find_child (parent, file)) == NULL)
+    {
+        node = file_browser_node_dir_new (model, file, parent);
+        file_browser_node_set_from_info (model, node, NULL, FALSE);
+
+        if (node->name == NULL)
+        {
+            file_browser_node_set_name (node);
+        }
+
+        if (node->icon == NULL)
+        {
+            node->icon = xed_file_browser_utils_pixbuf_from_theme ("folder", GTK_ICON_SIZE_MENU);
+        }
+
+        model_add_node (model, node, parent);
+    }
+
+    return node;
+}
+
+static void
+on_directory_monitor_event (GFileMonitor      *monitor,
+                            GFile             *file,
+                            GFile             *other_file,
+                            GFileMonitorEvent  event_type,
+                            FileBrowserNode   *parent)
+{
+    FileBrowserNode *node;
+    FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+
+    switch (event_type)
+    {
+        case G_FILE_MONITOR_EVENT_DELETED:
+            node = model_find_child (parent, file);
+
+            if (node != NULL)
+            {
+                model_remove_node (dir->model, node, NULL, TRUE);
+            }
+
+            g_signal_emit (dir->model, model_signals[FILE_DELETED], 0, file);
+            break;
+        case G_FILE_MONITOR_EVENT_CREATED:
+            if (g_file_query_exists (file, NULL))
+            {
+                model_add_node_from_file (dir->model, parent, file, NULL);
+                g_signal_emit (dir->model, model_signals[FILE_CREATED], 0, file);
+            }
+
+            break;
+        default:
+            break;
+    }
+}
+
+static AsyncNode *
+async_node_ref (AsyncNode *async)
+{
+    async->ref_count++;
+    return async;
+}
+
+static void
+prepared_file_free (PreparedFile *prepared)
+{
+    g_object_unref (prepared->info);
+    g_object_unref (prepared->file);
+    g_free (prepared->name);
+    g_free (prepared->collate_key);
+    g_slice_free (PreparedFile, prepared);
+}
+
+static void
+async_node_unref (AsyncNode *async)
+{
+    if (--async->ref_count > 0)
+    {
+        return;
+    }
+
+    g_queue_foreach (&async->prepared, (GFunc) g_ptr_array_unref, NULL);
+    g_queue_clear (&async->prepared);
+    g_object_unref (async->cancellable);
+    g_slice_free (AsyncNode, async);
+}
+
+/* Same order as model_sort_default () */
+static gint
+prepared_file_compare (gconstpointer a,
+                       gconstpointer b)
+{
+    const PreparedFile *file1 = *(const PreparedFile **) a;
+    const PreparedFile *file2 = *(const PreparedFile **) b;
+
+    if (file1->is_dir != file2->is_dir)
+    {
+        return file1->is_dir ? -1 : 1;
+    }
+
+    if (file1->is_hidden != file2->is_hidden)
+    {
+        return file2->is_hidden ? -1 : 1;
+    }
+
+    return strcmp (file1->collate_key, file2->collate_key);
+}
+
 static void
-model_add_nodes_from_files (XedFileBrowserStore *model,
-                            FileBrowserNode     *parent,
-                            GSList              *original_children,
-                            GList               *files)
+prepare_files_thread (GTask        *task,
+                      gpointer      source_object,
+                      gpointer      task_data,
+                      GCancellable *cancellable)
 {
+    GFile *parent = G_FILE (source_object);
+    GList *files = task_data;
     GList *item;
-    GSList *nodes = NULL;
+    GPtrArray *batch;
+
+    batch = g_ptr_array_new_with_free_func ((GDestroyNotify) prepared_file_free);
 
     for (item = files; item; item = item->next)
     {
         GFileInfo *info = G_FILE_INFO (item->data);
+        PreparedFile *prepared;
         GFileType type;
         gchar const *name;
-        GFile *file;
-        FileBrowserNode *node;
+
+        if (g_cancellable_is_cancelled (cancellable))
+        {
+            break;
+        }
 
         type = g_file_info_get_file_type (info);
 
@@ -2245,7 +2463,6 @@ model_add_nodes_from_files (XedFileBrowserStore *model,
             type != G_FILE_TYPE_DIRECTORY &&
             type != G_FILE_TYPE_SYMBOLIC_LINK)
         {
-            g_object_unref (info);
             continue;
         }
 
@@ -2256,107 +2473,229 @@ model_add_nodes_from_files (XedFileBrowserStore *model,
             (strcmp (name, ".") == 0 ||
              strcmp (name, "..") == 0))
         {
-            g_object_unref (info);
             continue;
         }
 
-        file = g_file_get_child (parent->file, name);
+        prepared = g_slice_new (PreparedFile);
+        prepared->info = g_object_ref (info);
+        prepared->file = g_file_get_child (parent, name);
+        prepared->name = xed_file_browser_utils_file_basename (prepared->file);
+        prepared->collate_key = g_utf8_collate_key_for_filename (prepared->name, -1);
+        prepared->is_dir = type == G_FILE_TYPE_DIRECTORY;
+        prepared->is_hidden = g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info);
 
-        node = node_list_contains_file (original_children, file);
-        if (node == NULL)
-        {
+        g_ptr_array_add (batch, prepared);
+    }
 
-            if (type == G_FILE_TYPE_DIRECTORY)
-            {
-                node = file_browser_node_dir_new (model, file, parent);
-            }
-            else
-            {
-                node = file_browser_node_new (file, parent);
-            }
+    if (g_task_return_error_if_cancelled (task))
+    {
+        g_ptr_array_unref (batch);
+        return;
+    }
 
-            file_browser_node_set_from_info (model, node, info, FALSE);
+    g_ptr_array_sort (batch, prepared_file_compare);
 
-            nodes = g_slist_prepend (nodes, node);
-        }
+    g_task_return_pointer (task, batch, (GDestroyNotify) g_ptr_array_unref);
+}
 
-        g_object_unref (file);
-        g_object_unref (info);
+static void
+free_file_infos (GList *files)
+{
+    g_list_free_full (files, g_object_unref);
+}
+
+static FileBrowserNode *
+model_node_from_prepared (XedFileBrowserStore *model,
+                          FileBrowserNode     *parent,
+                          PreparedFile        *prepared)
+{
+    FileBrowserNode *node;
+
+    if (prepared->is_dir)
+    {
+        node = file_browser_node_dir_new (model, NULL, parent);
+    }
+    else
+    {
+        node = file_browser_node_new (NULL, parent);
     }
 
-    if (nodes)
+    /* The name was computed on the worker, don't query it again */
+    node->file = g_object_ref (prepared->file);
+    node->name = prepared->name;
+    node->collate_key = prepared->collate_key;
+    prepared->name = NULL;
+    prepared->collate_key = NULL;
+
+    file_browser_node_set_from_info (model, node, prepared->info, FALSE);
+
+    return node;
+}
+
+static void
+model_end_directory_load (AsyncNode *async)
+{
+    FileBrowserNodeDir *dir = async->dir;
+    FileBrowserNode *parent = (FileBrowserNode *)dir;
+
+    if (!async->enumerated ||
+        async->n_preparing > 0 ||
+        async->publish_id != 0 ||
+        g_cancellable_is_cancelled (async->cancellable))
+    {
+        return;
+    }
+
+    /* We're done loading */
+    g_object_unref (dir->cancellable);
+    dir->cancellable = NULL;
+
+/*
+ * FIXME: This is temporarly, it is a bug in gio:
+ * http://bugzilla.gnome.org/show_bug.cgi?id=565924
+ */
+    if (g_file_is_native (parent->file) && dir->monitor == NULL)
     {
-        model_add_nodes_batch (model, nodes, parent);
+        dir->monitor = g_file_monitor_directory (parent->file,
+                                                 G_FILE_MONITOR_NONE,
+                                                 NULL,
+                                                 NULL);
+        if (dir->monitor != NULL)
+        {
+            g_signal_connect (dir->monitor, "changed",
+                      G_CALLBACK (on_directory_monitor_event), parent);
+        }
     }
+
+    model_check_dummy (dir->model, parent);
+    model_end_loading (dir->model, parent);
 }
 
-static FileBrowserNode *
-model_add_node_from_dir (XedFileBrowserStore *model,
-                         FileBrowserNode     *parent,
-                         GFile               *file)
+/* Adds as many sorted files to the model as fit in the frame budget, the
+ * rows of the whole chunk are inserted at once by model_add_nodes_batch () */
+static gboolean
+model_publish_prepared (AsyncNode *async)
 {
-    FileBrowserNode *node;
+    FileBrowserNodeDir *dir = async->dir;
+    FileBrowserNode *parent = (FileBrowserNode *)dir;
+    GSList *nodes = NULL;
+    gint64 start;
+    gint n_files;
+    gint n_published = 0;
 
-    /* Check if it already exists */
-    if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL)
+    if (g_cancellable_is_cancelled (async->cancellable))
     {
-        node = file_browser_node_dir_new (model, file, parent);
-        file_browser_node_set_from_info (model, node, NULL, FALSE);
+        async->publish_id = 0;
+        return G_SOURCE_REMOVE;
+    }
 
-        if (node->name == NULL)
+    start = g_get_monotonic_time ();
+    n_files = MAX (1, (gint) (DIRECTORY_LOAD_FRAME_BUDGET / async->publish_cost));
+
+    while (n_published < n_files && !g_queue_is_empty (&async->prepared))
+    {
+        GPtrArray *batch = g_queue_peek_head (&async->prepared);
+
+        while (n_published < n_files && async->published < batch->len)
         {
-            file_browser_node_set_name (node);
+            PreparedFile *prepared = g_ptr_array_index (batch, async->published++);
+
+            if (model_find_child (parent, prepared->file) == NULL)
+            {
+                nodes = g_slist_prepend (nodes, model_node_from_prepared (dir->model, parent, prepared));
+            }
+
+            n_published++;
         }
 
-        if (node->icon == NULL)
+        if (async->published == batch->len)
         {
-            node->icon = xed_file_browser_utils_pixbuf_from_theme ("folder", GTK_ICON_SIZE_MENU);
+            g_ptr_array_unref (g_queue_pop_head (&async->prepared));
+            async->published = 0;
         }
+    }
 
-        model_add_node (model, node, parent);
+    if (nodes)
+    {
+        model_add_nodes_batch (dir->model, g_slist_reverse (nodes), parent);
     }
 
-    return node;
+    if (n_published > 0)
+    {
+        gdouble cost = (gdouble)(g_get_monotonic_time () - start) / n_published;
+
+        async->publish_cost = MAX (1.0, (async->publish_cost + cost) / 2);
+    }
+
+    if (!g_queue_is_empty (&async->prepared))
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    async->publish_id = 0;
+    model_end_directory_load (async);
+
+    return G_SOURCE_REMOVE;
 }
 
 static void
-on_directory_monitor_event (GFileMonitor      *monitor,
-                            GFile             *file,
-                            GFile             *other_file,
-                            GFileMonitorEvent  event_type,
-                            FileBrowserNode   *parent)
+prepare_files_ready_cb (GObject      *source_object,
+                        GAsyncResult *result,
+                        gpointer      user_data)
 {
-    FileBrowserNode *node;
-    FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+    AsyncNode *async = user_data;
+    GPtrArray *batch;
 
-    switch (event_type)
+    async->n_preparing--;
+
+    batch = g_task_propagate_pointer (G_TASK (result), NULL);
+
+    if (batch == NULL || g_cancellable_is_cancelled (async->cancellable))
     {
-        case G_FILE_MONITOR_EVENT_DELETED:
-            node = node_list_contains_file (dir->children, file);
+        if (batch != NULL)
+        {
+            g_ptr_array_unref (batch);
+        }
 
-            if (node != NULL)
-            {
-                model_remove_node (dir->model, node, NULL, TRUE);
-            }
-            break;
-        case G_FILE_MONITOR_EVENT_CREATED:
-            if (g_file_query_exists (file, NULL))
-            {
-                model_add_node_from_file (dir->model, parent, file, NULL);
-            }
+        async_node_unref (async);
+        return;
+    }
 
-            break;
-        default:
-            break;
+    g_queue_push_tail (&async->prepared, batch);
+
+    if (async->publish_id == 0)
+    {
+        async->publish_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                             (GSourceFunc) model_publish_prepared,
+                                             async_node_ref (async),
+                                             (GDestroyNotify) async_node_unref);
     }
+
+    async_node_unref (async);
 }
 
+/* Asks for as many files per round trip as the main loop can add while
+ * the round trip takes, so that neither side waits for the other: remote
+ * directories get larger batches, slow views smaller ones */
 static void
-async_node_free (AsyncNode *async)
+async_node_adapt_batch_size (AsyncNode *async,
+                             guint      n_received)
 {
-    g_object_unref (async->cancellable);
-    g_slist_free (async->original_children);
-    g_slice_free (AsyncNode, async);
+    gint64 latency;
+    gdouble n_items;
+
+    if (n_received < (guint)async->n_items)
+    {
+        return;
+    }
+
+    latency = g_get_monotonic_time () - async->requested;
+    n_items = DIRECTORY_LOAD_FRAME_BUDGET / async->publish_cost *
+              MAX (1.0, (gdouble)latency / DIRECTORY_LOAD_FRAME_BUDGET);
+
+    async->n_items = CLAMP ((gint)n_items,
+                            DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
+                            DIRECTORY_LOAD_MAX_ITEMS_PER_CALLBACK);
 }
 
 static void
@@ -2375,42 +2714,19 @@ model_iterate_next_files_cb (GFileEnumerator *enumerator,
     {
         g_file_enumerator_close (enumerator, NULL, NULL);
         g_object_unref (enumerator);
-        async_node_free (async);
 
         if (!error)
         {
-            /* We're done loading */
-            g_object_unref (dir->cancellable);
-            dir->cancellable = NULL;
-
-/*
- * FIXME: This is temporarly, it is a bug in gio:
- * http://bugzilla.gnome.org/show_bug.cgi?id=565924
- */
-            if (g_file_is_native (parent->file) && dir->monitor == NULL)
-            {
-                dir->monitor = g_file_monitor_directory (parent->file,
-                                                         G_FILE_MONITOR_NONE,
-                                                         NULL,
-                                                         NULL);
-                if (dir->monitor != NULL)
-                {
-                    g_signal_connect (dir->monitor, "changed",
-                              G_CALLBACK (on_directory_monitor_event), parent);
-                }
-            }
-
-            model_check_dummy (dir->model, parent);
-            model_end_loading (dir->model, parent);
+            async->enumerated = TRUE;
+            model_end_directory_load (async);
         }
-        else
+        else if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED)
         {
             /* Simply return if we were cancelled */
-            if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED)
-            {
-                return;
-            }
-
+            g_error_free (error);
+        }
+        else
+        {
             /* Otherwise handle the error appropriately */
             g_signal_emit (dir->model,
                            model_signals[ERROR],
@@ -2421,19 +2737,31 @@ model_iterate_next_files_cb (GFileEnumerator *enumerator,
             file_browser_node_unload (dir->model, (FileBrowserNode *)parent, TRUE);
             g_error_free (error);
         }
+
+        async_node_unref (async);
     }
     else if (g_cancellable_is_cancelled (async->cancellable))
     {
         /* Check cancel state manually */
         g_file_enumerator_close (enumerator, NULL, NULL);
         g_object_unref (enumerator);
-        async_node_free (async);
+        free_file_infos (files);
+        async_node_unref (async);
     }
     else
     {
-        model_add_nodes_from_files (dir->model, parent, async->original_children, files);
+        GTask *task;
+
+        async_node_adapt_batch_size (async, g_list_length (files));
+
+        /* Sort these files on a worker while the next ones are fetched */
+        async->n_preparing++;
+
+        task = g_task_new (parent->file, async->cancellable, prepare_files_ready_cb, async_node_ref (async));
+        g_task_set_task_data (task, files, (GDestroyNotify) free_file_infos);
+        g_task_run_in_thread (task, prepare_files_thread);
+        g_object_unref (task);
 
-        g_list_free (files);
         next_files_async (enumerator, async);
     }
 }
@@ -2442,8 +2770,10 @@ static void
 next_files_async (GFileEnumerator *enumerator,
                   AsyncNode       *async)
 {
+    async->requested = g_get_monotonic_time ();
+
     g_file_enumerator_next_files_async (enumerator,
-                                        DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
+                                        async->n_items,
                                         G_PRIORITY_DEFAULT,
                                         async->cancellable,
                                         (GAsyncReadyCallback)model_iterate_next_files_cb,
@@ -2460,7 +2790,7 @@ model_iterate_children_cb (GFile        *file,
 
     if (g_cancellable_is_cancelled (async->cancellable))
     {
-        async_node_free (async);
+        async_node_unref (async);
         return;
     }
 
@@ -2480,7 +2810,7 @@ model_iterate_children_cb (GFile        *file,
 
         file_browser_node_unload (dir->model, (FileBrowserNode *)dir, TRUE);
         g_error_free (error);
-        async_node_free (async);
+        async_node_unref (async);
     }
     else
     {
@@ -2510,10 +2840,13 @@ model_load_directory (XedFileBrowserStore *model,
 
     dir->cancellable = g_cancellable_new ();
 
-    async = g_slice_new (AsyncNode);
+    async = g_slice_new0 (AsyncNode);
     async->dir = dir;
     async->cancellable = g_object_ref (dir->cancellable);
-    async->original_children = g_slist_copy (dir->children);
+    async->ref_count = 1;
+    async->n_items = DIRECTORY_LOAD_ITEMS_PER_CALLBACK;
+    async->publish_cost = (gdouble) DIRECTORY_LOAD_FRAME_BUDGET / DIRECTORY_LOAD_ITEMS_PER_CALLBACK;
+    g_queue_init (&async->prepared);
 
     /* Start loading async */
     g_file_enumerate_children_async (node->file,
@@ -2657,6 +2990,7 @@ set_virtual_root_from_node (XedFileBrowserStore *model,
             {
                 /* Only free when the node is not in the chain */
                 dir->children = g_slist_remove (dir->children, check);
+                model_unindex_child (next, check);
                 file_browser_node_free (model, check);
             }
         }
@@ -2687,6 +3021,7 @@ set_virtual_root_from_node (XedFileBrowserStore *model,
         else if (NODE_IS_DUMMY (check))
         {
             check->flags |= XED_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+            model_node_set_inserted (model, check, FALSE);
         }
     }
 
@@ -2738,31 +3073,41 @@ model_find_node_children (XedFileBrowserStore *model,
                           FileBrowserNode     *parent,
                           GFile               *file)
 {
-    FileBrowserNodeDir *dir;
     FileBrowserNode *child;
-    FileBrowserNode *result;
-    GSList *children;
+    GFile *check;
+    GFile *next;
 
     if (!NODE_IS_DIR (parent))
     {
         return NULL;
     }
 
-    dir = FILE_BROWSER_NODE_DIR (parent);
+    /* Look up the child of parent that file is in */
+    check = g_object_ref (file);
 
-    for (children = dir->children; children; children = children->next)
+    while ((next = g_file_get_parent (check)) != NULL && !g_file_equal (next, parent->file))
     {
-        child = (FileBrowserNode *)(children->data);
+        g_object_unref (check);
+        check = next;
+    }
 
-        result = model_find_node (model, child, file);
+    if (next == NULL)
+    {
+        g_object_unref (check);
+        return NULL;
+    }
 
-        if (result)
-        {
-            return result;
-        }
+    child = model_find_child (parent, check);
+
+    g_object_unref (next);
+    g_object_unref (check);
+
+    if (child == NULL)
+    {
+        return NULL;
     }
 
-    return NULL;
+    return model_find_node (model, child, file);
 }
 
 static FileBrowserNode *
@@ -3431,9 +3776,13 @@ reparent_node (FileBrowserNode *node,
     {
         dir = FILE_BROWSER_NODE_DIR (node);
 
+        /* The locations of all the children change */
+        g_hash_table_remove_all (dir->index);
+
         for (child = dir->children; child; child = child->next)
         {
             reparent_node ((FileBrowserNode *)child->data, TRUE);
+            model_index_child (node, (FileBrowserNode *)child->data);
         }
     }
 }
@@ -3471,9 +3820,13 @@ xed_file_browser_store_rename (XedFileBrowserStore *model,
 
     if (g_file_move (node->file, file, G_FILE_COPY_NONE, NULL, NULL, NULL, &err))
     {
+        model_unindex_child (node->parent, node);
+
         previous = node->file;
         node->file = file;
 
+        model_index_child (node->parent, node);
+
         /* This makes sure the actual info for the node is requeried */
         file_browser_node_set_name (node);
         file_browser_node_set_from_info (model, node, NULL, TRUE);
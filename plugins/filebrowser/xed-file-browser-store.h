@@ -112,6 +112,10 @@ struct _XedFileBrowserStoreClass {
     void (*end_refresh)   (XedFileBrowserStore *model);
     void (*unload)        (XedFileBrowserStore *model,
                            GFile               *location);
+    void (*file_created)  (XedFileBrowserStore *model,
+                           GFile               *location);
+    void (*file_deleted)  (XedFileBrowserStore *model,
+                           GFile               *location);
 };
 
 GType xed_file_browser_store_get_type (void) G_GNUC_CONST;
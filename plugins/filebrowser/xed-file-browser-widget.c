@@ -34,12 +34,14 @@
 #include "xed-file-browser-widget.h"
 #include "xed-file-browser-view.h"
 #include "xed-file-browser-store.h"
+#include "xed-file-browser-index.h"
 #include "xed-file-bookmarks-store.h"
 #include "xed-file-browser-marshal.h"
 #include "xed-file-browser-enum-types.h"
 
 #define XML_UI_FILE "xed-file-browser-widget-ui.xml"
 #define LOCATION_DATA_KEY "xed-file-browser-widget-location"
+#define QUICK_OPEN_MAX_RESULTS 50
 
 enum
 {
@@ -59,6 +61,13 @@ enum
     N_COLUMNS
 };
 
+enum
+{
+    QUICK_OPEN_COLUMN_MARKUP,
+    QUICK_OPEN_COLUMN_PATH,
+    QUICK_OPEN_N_COLUMNS
+};
+
 /* Properties */
 enum
 {
@@ -120,6 +129,12 @@ struct _XedFileBrowserWidgetPrivate
     GtkWidget *filter_expander;
     GtkWidget *filter_entry;
 
+    XedFileBrowserIndex *index;
+    GtkWidget *quick_open;
+    GtkWidget *quick_open_entry;
+    GtkWidget *quick_open_view;
+    GtkListStore *quick_open_model;
+
     GtkUIManager *manager;
     GtkActionGroup *action_group;
     GtkActionGroup *action_group_selection;
@@ -164,6 +179,13 @@ static void on_file_store_error (XedFileBrowserStore  *store,
 static gboolean on_file_store_no_trash (XedFileBrowserStore  *store,
                                         GList                *files,
                                         XedFileBrowserWidget *obj);
+static void on_file_store_root_changed (XedFileBrowserStore  *store,
+                                        GParamSpec           *param,
+                                        XedFileBrowserWidget *obj);
+static void on_file_store_rename (XedFileBrowserStore  *store,
+                                  GFile                *oldfile,
+                                  GFile                *newfile,
+                                  XedFileBrowserWidget *obj);
 static void on_combo_changed (GtkComboBox          *combo,
                               XedFileBrowserWidget *obj);
 static gboolean on_treeview_popup_menu (XedFileBrowserView   *treeview,
@@ -220,6 +242,8 @@ static void on_action_filter_binary (GtkAction            *action,
                                      XedFileBrowserWidget *obj);
 static void on_action_bookmark_open (GtkAction            *action,
                                      XedFileBrowserWidget *obj);
+static void on_action_file_quick_open (GtkAction            *action,
+                                       XedFileBrowserWidget *obj);
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedFileBrowserWidget,
                                 xed_file_browser_widget,
@@ -354,6 +378,19 @@ xed_file_browser_widget_finalize (GObject *object)
     g_object_unref (obj->priv->file_store);
     g_object_unref (obj->priv->bookmarks_store);
     g_object_unref (obj->priv->combo_model);
+    g_object_unref (obj->priv->quick_open_model);
+
+    if (obj->priv->index != NULL)
+    {
+        /* The store can outlive the widget */
+        g_signal_handlers_disconnect_by_func (obj->priv->file_store, on_file_store_rename, obj);
+        g_signal_handlers_disconnect_by_func (obj->priv->file_store, on_file_store_root_changed, obj);
+
+        /* A crawl in progress keeps the index alive for a while */
+        g_signal_handlers_disconnect_by_data (obj->priv->index, obj);
+        xed_file_browser_index_set_root (obj->priv->index, NULL);
+        g_object_unref (obj->priv->index);
+    }
 
     g_slist_foreach (obj->priv->filter_funcs, (GFunc)filter_func_free, NULL);
     g_slist_free (obj->priv->filter_funcs);
@@ -768,7 +805,9 @@ static const GtkActionEntry tree_actions_file_selection[] =
 static const GtkActionEntry tree_actions[] =
 {
     {"DirectoryUp", "xsi-go-up-symbolic", N_("Up"), NULL,
-     N_("Open the parent folder"), G_CALLBACK (on_action_directory_up)}
+     N_("Open the parent folder"), G_CALLBACK (on_action_directory_up)},
+    {"FileQuickOpen", "xsi-go-jump-symbolic", N_("_Go to File..."), NULL,
+     N_("Find a file below the root by its name"), G_CALLBACK (on_action_file_quick_open)}
 };
 
 static const GtkActionEntry tree_actions_single_most_selection[] =
@@ -952,6 +991,15 @@ create_toolbar (XedFileBrowserWidget *obj,
 
     create_combo (obj);
     gtk_box_pack_start (GTK_BOX (toolbar), obj->priv->combo, TRUE, TRUE, 0);
+
+    action = gtk_action_group_get_action (obj->priv->action_group, "FileQuickOpen");
+    button = gtk_button_new ();
+    gtk_style_context_add_class (gtk_widget_get_style_context (button), "small-button");
+    image = gtk_image_new ();
+    gtk_button_set_image (GTK_BUTTON (button), image);
+    gtk_activatable_set_related_action (GTK_ACTIVATABLE (button), action);
+    gtk_button_set_label (GTK_BUTTON (button), NULL);
+    gtk_box_pack_start (GTK_BOX (toolbar), button, FALSE, FALSE, 0);
     gtk_box_pack_start (GTK_BOX (obj), toolbar, FALSE, FALSE, 0);
     gtk_widget_show_all (toolbar);
 
@@ -1168,6 +1216,235 @@ create_filter (XedFileBrowserWidget *obj)
     gtk_container_add (GTK_CONTAINER (expander), vbox);
 }
 
+static void
+hide_quick_open (XedFileBrowserWidget *obj)
+{
+    gtk_widget_hide (obj->priv->quick_open);
+    gtk_list_store_clear (obj->priv->quick_open_model);
+    gtk_widget_grab_focus (GTK_WIDGET (obj->priv->treeview));
+}
+
+static gchar *
+quick_open_markup (const gchar *path)
+{
+    gchar *display;
+    gchar *base;
+    gchar *markup;
+
+    display = g_filename_display_name (path);
+    base = strrchr (display, '/');
+
+    if (base == NULL)
+    {
+        markup = g_markup_printf_escaped ("<b>%s</b>", display);
+    }
+    else
+    {
+        *base++ = '\0';
+        markup = g_markup_printf_escaped ("<b>%s</b>  <small>%s</small>", base, display);
+    }
+
+    g_free (display);
+
+    return markup;
+}
+
+static void
+update_quick_open (XedFileBrowserWidget *obj)
+{
+    GPtrArray *paths;
+    GtkTreeIter iter;
+    guint i;
+
+    gtk_list_store_clear (obj->priv->quick_open_model);
+
+    if (obj->priv->index == NULL)
+    {
+        return;
+    }
+
+    paths = xed_file_browser_index_query (obj->priv->index,
+                                          gtk_entry_get_text (GTK_ENTRY (obj->priv->quick_open_entry)),
+                                          QUICK_OPEN_MAX_RESULTS);
+
+    for (i = 0; i < paths->len; i++)
+    {
+        const gchar *path = g_ptr_array_index (paths, i);
+        gchar *markup = quick_open_markup (path);
+
+        gtk_list_store_insert_with_values (obj->priv->quick_open_model, NULL, -1,
+                                           QUICK_OPEN_COLUMN_MARKUP, markup,
+                                           QUICK_OPEN_COLUMN_PATH, path,
+                                           -1);
+        g_free (markup);
+    }
+
+    g_ptr_array_unref (paths);
+
+    if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (obj->priv->quick_open_model), &iter))
+    {
+        GtkTreeSelection *selection;
+
+        selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (obj->priv->quick_open_view));
+        gtk_tree_selection_select_iter (selection, &iter);
+    }
+}
+
+static void
+quick_open_activate (XedFileBrowserWidget *obj,
+                     GtkTreeIter          *iter)
+{
+    GFile *root;
+    gchar *path;
+
+    root = xed_file_browser_index_get_root (obj->priv->index);
+
+    gtk_tree_model_get (GTK_TREE_MODEL (obj->priv->quick_open_model), iter,
+                        QUICK_OPEN_COLUMN_PATH, &path,
+                        -1);
+
+    if (root != NULL && path != NULL)
+    {
+        GFile *location = g_file_resolve_relative_path (root, path);
+
+        g_signal_emit (obj, signals[LOCATION_ACTIVATED], 0, location);
+        g_object_unref (location);
+    }
+
+    g_free (path);
+
+    hide_quick_open (obj);
+}
+
+static void
+on_quick_open_entry_activate (GtkEntry             *entry,
+                              XedFileBrowserWidget *obj)
+{
+    GtkTreeSelection *selection;
+    GtkTreeIter iter;
+
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (obj->priv->quick_open_view));
+
+    if (gtk_tree_selection_get_selected (selection, NULL, &iter))
+    {
+        quick_open_activate (obj, &iter);
+    }
+}
+
+static gboolean
+on_quick_open_entry_key_press_event (GtkWidget            *entry,
+                                     GdkEventKey          *event,
+                                     XedFileBrowserWidget *obj)
+{
+    GtkTreeModel *model = GTK_TREE_MODEL (obj->priv->quick_open_model);
+    GtkTreeSelection *selection;
+    GtkTreeIter iter;
+    gboolean moved;
+
+    if (event->keyval != GDK_KEY_Up && event->keyval != GDK_KEY_KP_Up &&
+        event->keyval != GDK_KEY_Down && event->keyval != GDK_KEY_KP_Down)
+    {
+        return FALSE;
+    }
+
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (obj->priv->quick_open_view));
+
+    if (!gtk_tree_selection_get_selected (selection, NULL, &iter))
+    {
+        moved = gtk_tree_model_get_iter_first (model, &iter);
+    }
+    else if (event->keyval == GDK_KEY_Up || event->keyval == GDK_KEY_KP_Up)
+    {
+        moved = gtk_tree_model_iter_previous (model, &iter);
+    }
+    else
+    {
+        moved = gtk_tree_model_iter_next (model, &iter);
+    }
+
+    if (moved)
+    {
+        GtkTreePath *path = gtk_tree_model_get_path (model, &iter);
+
+        gtk_tree_selection_select_iter (selection, &iter);
+        gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (obj->priv->quick_open_view), path, NULL, FALSE, 0, 0);
+        gtk_tree_path_free (path);
+    }
+
+    return TRUE;
+}
+
+static void
+on_quick_open_row_activated (GtkTreeView          *view,
+                             GtkTreePath          *path,
+                             GtkTreeViewColumn    *column,
+                             XedFileBrowserWidget *obj)
+{
+    GtkTreeIter iter;
+
+    if (gtk_tree_model_get_iter (GTK_TREE_MODEL (obj->priv->quick_open_model), &iter, path))
+    {
+        quick_open_activate (obj, &iter);
+    }
+}
+
+static void
+create_quick_open (XedFileBrowserWidget *obj)
+{
+    GtkWidget *vbox;
+    GtkWidget *entry;
+    GtkWidget *sw;
+    GtkWidget *view;
+    GtkCellRenderer *renderer;
+
+    vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 3);
+    gtk_widget_set_no_show_all (vbox, TRUE);
+    gtk_box_pack_start (GTK_BOX (obj), vbox, FALSE, FALSE, 0);
+
+    obj->priv->quick_open = vbox;
+
+    entry = gtk_search_entry_new ();
+    gtk_entry_set_placeholder_text (GTK_ENTRY (entry), _("Go to file"));
+    gtk_widget_show (entry);
+    gtk_box_pack_start (GTK_BOX (vbox), entry, FALSE, FALSE, 0);
+
+    obj->priv->quick_open_entry = entry;
+
+    obj->priv->quick_open_model = gtk_list_store_new (QUICK_OPEN_N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING);
+
+    view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (obj->priv->quick_open_model));
+    gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (view), FALSE);
+    gtk_tree_view_set_enable_search (GTK_TREE_VIEW (view), FALSE);
+    gtk_widget_show (view);
+
+    obj->priv->quick_open_view = view;
+
+    renderer = gtk_cell_renderer_text_new ();
+    g_object_set (renderer, "ellipsize-set", TRUE, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+    gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (view), -1, NULL, renderer,
+                                                 "markup", QUICK_OPEN_COLUMN_MARKUP,
+                                                 NULL);
+
+    sw = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (sw), GTK_SHADOW_IN);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_min_content_height (GTK_SCROLLED_WINDOW (sw), 160);
+    gtk_container_add (GTK_CONTAINER (sw), view);
+    gtk_widget_show (sw);
+    gtk_box_pack_start (GTK_BOX (vbox), sw, FALSE, FALSE, 0);
+
+    g_signal_connect_swapped (entry, "search-changed",
+                              G_CALLBACK (update_quick_open), obj);
+    g_signal_connect_swapped (entry, "stop-search",
+                              G_CALLBACK (hide_quick_open), obj);
+    g_signal_connect (entry, "activate",
+                      G_CALLBACK (on_quick_open_entry_activate), obj);
+    g_signal_connect (entry, "key-press-event",
+                      G_CALLBACK (on_quick_open_entry_key_press_event), obj);
+    g_signal_connect (view, "row-activated",
+                      G_CALLBACK (on_quick_open_row_activated), obj);
+}
+
 static void
 xed_file_browser_widget_init (XedFileBrowserWidget *obj)
 {
@@ -1681,6 +1958,7 @@ xed_file_browser_widget_new (const gchar *data_dir)
     XedFileBrowserWidget *obj = g_object_new (XED_TYPE_FILE_BROWSER_WIDGET, NULL);
 
     create_toolbar (obj, data_dir);
+    create_quick_open (obj);
     create_tree (obj);
     create_filter (obj);
 
@@ -2512,6 +2790,7 @@ on_model_set (GObject              *gobject,
         }
 
         gtk_widget_set_sensitive (obj->priv->filter_expander, FALSE);
+        gtk_widget_hide (obj->priv->quick_open);
 
         add_signal (obj, gobject, g_signal_connect (gobject, "bookmark-activated",
                                                     G_CALLBACK (on_bookmark_activated), obj));
@@ -3013,6 +3292,93 @@ on_action_bookmark_open (GtkAction            *action,
     }
 }
 
+static void
+on_file_store_root_changed (XedFileBrowserStore  *store,
+                            GParamSpec           *param,
+                            XedFileBrowserWidget *obj)
+{
+    GFile *root;
+
+    root = xed_file_browser_store_get_root (store);
+    xed_file_browser_index_set_root (obj->priv->index, root);
+
+    if (root != NULL)
+    {
+        g_object_unref (root);
+    }
+}
+
+static void
+on_file_store_rename (XedFileBrowserStore  *store,
+                      GFile                *oldfile,
+                      GFile                *newfile,
+                      XedFileBrowserWidget *obj)
+{
+    xed_file_browser_index_file_deleted (obj->priv->index, oldfile);
+    xed_file_browser_index_file_created (obj->priv->index, newfile);
+}
+
+static void
+on_index_changed (XedFileBrowserIndex  *index,
+                  XedFileBrowserWidget *obj)
+{
+    if (gtk_widget_get_visible (obj->priv->quick_open))
+    {
+        update_quick_open (obj);
+    }
+}
+
+/* The index is only built once quick open was used, crawling every root the
+ * browser visits would be wasted work for everyone else */
+static void
+ensure_index (XedFileBrowserWidget *obj)
+{
+    XedFileBrowserStore *store = obj->priv->file_store;
+
+    if (obj->priv->index != NULL)
+    {
+        return;
+    }
+
+    obj->priv->index = xed_file_browser_index_new ();
+
+    g_signal_connect_object (store, "file-created",
+                             G_CALLBACK (xed_file_browser_index_file_created),
+                             obj->priv->index, G_CONNECT_SWAPPED);
+    g_signal_connect_object (store, "file-deleted",
+                             G_CALLBACK (xed_file_browser_index_file_deleted),
+                             obj->priv->index, G_CONNECT_SWAPPED);
+    g_signal_connect (store, "rename",
+                      G_CALLBACK (on_file_store_rename), obj);
+    g_signal_connect (store, "notify::root",
+                      G_CALLBACK (on_file_store_root_changed), obj);
+    g_signal_connect (obj->priv->index, "changed",
+                      G_CALLBACK (on_index_changed), obj);
+
+    on_file_store_root_changed (store, NULL, obj);
+}
+
+static void
+on_action_file_quick_open (GtkAction            *action,
+                           XedFileBrowserWidget *obj)
+{
+    GtkTreeModel *model;
+
+    model = gtk_tree_view_get_model (GTK_TREE_VIEW (obj->priv->treeview));
+
+    if (!XED_IS_FILE_BROWSER_STORE (model))
+    {
+        return;
+    }
+
+    ensure_index (obj);
+
+    gtk_widget_show (obj->priv->quick_open);
+    gtk_widget_grab_focus (obj->priv->quick_open_entry);
+
+    update_quick_open (obj);
+}
+
 void
 _xed_file_browser_widget_register_type (GTypeModule *type_module)
 {
@@ -31,9 +31,17 @@
 
 #define MODELINES_LANGUAGE_MAPPINGS_FILE "language-mappings"
 
+/* Modelines are only looked for on the first and last lines, and no more
+ * than this many characters are read from either end of the buffer, however
+ * long these lines are */
+#define MODELINE_MAX_LINES 10
+#define MODELINE_MAX_CHARS 4096
+
 /* base dir to lookup configuration files */
 static gchar *modelines_data_dir;
 
+static GSettings *editor_settings;
+
 /* Mappings: language name -> Xed language ID */
 static GHashTable *vim_languages;
 static GHashTable *emacs_languages;
@@ -66,9 +74,13 @@ typedef struct _ModelineOptions
 	guint		right_margin_position;
 
 	ModelineSet	set;
+
+	/* of the text the options were parsed from */
+	guint		content_hash;
 } ModelineOptions;
 
 #define MODELINE_OPTIONS_DATA_KEY "ModelineOptionsDataKey"
+#define MODELINE_APPLIED_HASH_DATA_KEY "ModelineAppliedHashDataKey"
 
 static gboolean
 has_option (ModelineOptions *options,
@@ -102,6 +114,8 @@ modeline_parser_shutdown ()
 	emacs_languages = NULL;
 	kate_languages = NULL;
 
+	g_clear_object (&editor_settings);
+
 	g_free (modelines_data_dir);
 	modelines_data_dir = NULL;
 }
@@ -609,6 +623,102 @@ parse_modeline (gchar           *s,
 	}
 }
 
+/* Parses the lines of @text, the first of which is @first_line counting
+ * from 0. memchr() is vectorised, it skips the lines without any marker
+ * quickly: the markers of all the modelines have a ':' or a '*'. */
+static void
+parse_modelines (gchar           *text,
+		 gint             first_line,
+		 gint             line_count,
+		 ModelineOptions *options)
+{
+	gchar *line = text;
+	gint line_number = first_line + 1;
+
+	while (line != NULL)
+	{
+		gchar *next;
+		gsize length;
+
+		next = strchr (line, '\n');
+
+		if (next != NULL)
+		{
+			*next = '\0';
+			length = next - line;
+			next++;
+		}
+		else
+		{
+			length = strlen (line);
+		}
+
+		if (memchr (line, ':', length) != NULL ||
+		    memchr (line, '*', length) != NULL)
+		{
+			parse_modeline (line, line_number, line_count, options);
+		}
+
+		line = next;
+		line_number++;
+	}
+}
+
+/* Gets the first and the last lines, where modelines can be, cut to
+ * MODELINE_MAX_CHARS characters from either end */
+static void
+get_modeline_text (GtkTextBuffer  *buffer,
+		   gchar         **head,
+		   gchar         **tail,
+		   gint           *tail_first_line)
+{
+	GtkTextIter start, end, limit;
+	gint line_count;
+
+	line_count = gtk_text_buffer_get_line_count (buffer);
+
+	gtk_text_buffer_get_start_iter (buffer, &start);
+	gtk_text_buffer_get_iter_at_line (buffer, &end, MODELINE_MAX_LINES);
+
+	/* the newline ending the last line is not part of it */
+	if (gtk_text_iter_get_line (&end) == MODELINE_MAX_LINES)
+	{
+		gtk_text_iter_backward_char (&end);
+	}
+
+	limit = start;
+	gtk_text_iter_forward_chars (&limit, MODELINE_MAX_CHARS);
+
+	if (gtk_text_iter_compare (&limit, &end) < 0)
+	{
+		end = limit;
+	}
+
+	*head = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+
+	if (line_count <= MODELINE_MAX_LINES)
+	{
+		*tail = g_strdup ("");
+		*tail_first_line = line_count;
+		return;
+	}
+
+	/* the last lines, after the first ones */
+	gtk_text_buffer_get_iter_at_line (buffer, &start, MAX (line_count - MODELINE_MAX_LINES, MODELINE_MAX_LINES));
+	gtk_text_buffer_get_end_iter (buffer, &end);
+
+	limit = end;
+	gtk_text_iter_backward_chars (&limit, MODELINE_MAX_CHARS);
+
+	if (gtk_text_iter_compare (&limit, &start) > 0)
+	{
+		start = limit;
+	}
+
+	*tail = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+	*tail_first_line = gtk_text_iter_get_line (&start);
+}
+
 static gboolean
 check_previous (GtkSourceView   *view,
                 ModelineOptions *previous,
@@ -675,75 +785,59 @@ void
 modeline_parser_apply_modeline (GtkSourceView *view)
 {
 	ModelineOptions options;
+	ModelineOptions *previous;
 	GtkTextBuffer *buffer;
-	GtkTextIter iter, liter;
 	gint line_count;
+	gchar *head;
+	gchar *tail;
+	gint tail_first_line;
+	guint content_hash;
 	GSettings *settings;
 
-	options.language_id = NULL;
-	options.set = MODELINE_SET_NONE;
-
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
-	gtk_text_buffer_get_start_iter (buffer, &iter);
-
 	line_count = gtk_text_buffer_get_line_count (buffer);
 
-	/* Parse the modelines on the 10 first lines... */
-	while ((gtk_text_iter_get_line (&iter) < 10) &&
-	       !gtk_text_iter_is_end (&iter))
-	{
-		gchar *line;
-
-		liter = iter;
-		gtk_text_iter_forward_to_line_end (&iter);
-		line = gtk_text_buffer_get_text (buffer, &liter, &iter, TRUE);
+	get_modeline_text (buffer, &head, &tail, &tail_first_line);
 
-		parse_modeline (line,
-				1 + gtk_text_iter_get_line (&iter),
-				line_count,
-				&options);
+	content_hash = g_str_hash (head);
+	content_hash = content_hash * 31 + g_str_hash (tail);
+	content_hash = content_hash * 31 + line_count;
+	content_hash = content_hash * 31 + tail_first_line;
 
-		gtk_text_iter_forward_line (&iter);
+	/* 0 is for a view without modeline applied */
+	content_hash = MAX (content_hash, 1);
 
-		g_free (line);
-	}
+	previous = g_object_get_data (G_OBJECT (buffer), MODELINE_OPTIONS_DATA_KEY);
 
-	/* ...and on the 10 last ones (modelines are not allowed in between) */
-	if (!gtk_text_iter_is_end (&iter))
+	if (previous != NULL && previous->content_hash == content_hash)
 	{
-		gint cur_line;
-		guint remaining_lines;
-
-		/* we are on the 11th line (count from 0) */
-		cur_line = gtk_text_iter_get_line (&iter);
-		/* g_assert (10 == cur_line); */
-
-		remaining_lines = line_count - cur_line - 1;
-
-		if (remaining_lines > 10)
+		/* The lines which can hold modelines are the same, for instance
+		 * when a document is saved */
+		if (GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (view), MODELINE_APPLIED_HASH_DATA_KEY)) == content_hash)
 		{
-			gtk_text_buffer_get_end_iter (buffer, &iter);
-			gtk_text_iter_backward_lines (&iter, 9);
+			g_free (head);
+			g_free (tail);
+			return;
 		}
-	}
 
-	while (!gtk_text_iter_is_end (&iter))
+		options = *previous;
+		options.language_id = g_strdup (previous->language_id);
+	}
+	else
 	{
-		gchar *line;
+		options.language_id = NULL;
+		options.set = MODELINE_SET_NONE;
 
-		liter = iter;
-		gtk_text_iter_forward_to_line_end (&iter);
-		line = gtk_text_buffer_get_text (buffer, &liter, &iter, TRUE);
-
-		parse_modeline (line,
-				1 + gtk_text_iter_get_line (&iter),
-				line_count,
-				&options);
+		/* ...on the 10 first lines and on the 10 last ones (modelines
+		 * are not allowed in between) */
+		parse_modelines (head, 0, line_count, &options);
+		parse_modelines (tail, tail_first_line, line_count, &options);
+	}
 
-		gtk_text_iter_forward_line (&iter);
+	options.content_hash = content_hash;
 
-		g_free (line);
-	}
+	g_free (head);
+	g_free (tail);
 
 	/* Try to set language */
 	if (has_option (&options, MODELINE_SET_LANGUAGE) && options.language_id)
@@ -762,10 +856,12 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 		}
 	}
 
-	ModelineOptions *previous = g_object_get_data (G_OBJECT (buffer),
-	                                               MODELINE_OPTIONS_DATA_KEY);
+	if (editor_settings == NULL)
+	{
+		editor_settings = g_settings_new ("org.x.editor.preferences.editor");
+	}
 
-    settings = g_settings_new ("org.x.editor.preferences.editor");
+	settings = editor_settings;
 
 	/* Apply the options we got from modelines and restore defaults if
 	   we set them before */
@@ -857,6 +953,10 @@ modeline_parser_apply_modeline (GtkSourceView *view)
 		                        (GDestroyNotify)free_modeline_options);
 	}
 
+	g_object_set_data (G_OBJECT (view),
+	                   MODELINE_APPLIED_HASH_DATA_KEY,
+	                   GUINT_TO_POINTER (content_hash));
+
 	g_free (options.language_id);
 }
 
@@ -866,6 +966,10 @@ modeline_parser_deactivate (GtkSourceView *view)
 	g_object_set_data (G_OBJECT (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view))),
 	                   MODELINE_OPTIONS_DATA_KEY,
 	                   NULL);
+
+	g_object_set_data (G_OBJECT (view),
+	                   MODELINE_APPLIED_HASH_DATA_KEY,
+	                   NULL);
 }
 
 /* vi:ts=8 */
@@ -23,6 +23,7 @@
 
 #include <config.h>
 #include <string.h>
+#include <math.h>
 #include <stdlib.h>
 #include <glib/gi18n.h>
 #include <xed/xed-window.h>
@@ -30,12 +31,24 @@
 #include <xed/xed-debug.h>
 #include <xed/xed-utils.h>
 #include <xed/xed-app.h>
+#include <libpeas-gtk/peas-gtk-configurable.h>
 
 #include "xed-sort-plugin.h"
 
 #define MENU_PATH "/MenuBar/EditMenu/EditOps_6"
 
+#define SORT_SCHEMA                     "org.x.editor.plugins.sort"
+#define SETTINGS_KEY_REVERSE_ORDER      "reverse-order"
+#define SETTINGS_KEY_REMOVE_DUPLICATES  "remove-duplicates"
+#define SETTINGS_KEY_IGNORE_CASE        "ignore-case"
+#define SETTINGS_KEY_NUMERIC            "numeric"
+#define SETTINGS_KEY_START_COLUMN       "start-column"
+
+/* Below this many lines the keys are not worth spreading over threads */
+#define PARALLEL_MIN_LINES 20000
+
 static void xed_window_activatable_iface_init (XedWindowActivatableInterface *iface);
+static void peas_gtk_configurable_iface_init (PeasGtkConfigurableInterface *iface);
 
 struct _XedSortPluginPrivate
 {
@@ -44,9 +57,34 @@ struct _XedSortPluginPrivate
     GtkActionGroup *ui_action_group;
     guint ui_id;
 
+    GSettings *settings;
+
     GtkTextIter start, end; /* selection */
 };
 
+typedef struct _SortConfigureWidget SortConfigureWidget;
+
+struct _SortConfigureWidget
+{
+    GtkWidget *dialog;
+    GtkWidget *reverse_order;
+    GtkWidget *remove_duplicates;
+    GtkWidget *ignore_case;
+    GtkWidget *numeric;
+    GtkWidget *start_column;
+
+    GSettings *settings;
+};
+
+typedef struct
+{
+    gboolean reverse_order;
+    gboolean remove_duplicates;
+    gboolean ignore_case;
+    gboolean numeric;
+    guint    start_column; /* 0 based */
+} SortOptions;
+
 enum
 {
     PROP_0,
@@ -59,14 +97,17 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedSortPlugin,
                                 0,
                                 G_IMPLEMENT_INTERFACE_DYNAMIC (XED_TYPE_WINDOW_ACTIVATABLE,
                                                                xed_window_activatable_iface_init)
+                                G_IMPLEMENT_INTERFACE_DYNAMIC (PEAS_GTK_TYPE_CONFIGURABLE,
+                                                               peas_gtk_configurable_iface_init)
                                 G_ADD_PRIVATE_DYNAMIC (XedSortPlugin))
 
 static void sort_cb (GtkAction     *action,
                      XedSortPlugin *plugin);
 
-static void buffer_sort_lines (GtkSourceBuffer *buffer,
-                               GtkTextIter     *start,
-                               GtkTextIter     *end);
+static void buffer_sort_lines (GtkSourceBuffer   *buffer,
+                               GtkTextIter       *start,
+                               GtkTextIter       *end,
+                               const SortOptions *options);
 
 static const GtkActionEntry action_entries[] =
 {
@@ -107,6 +148,7 @@ sort_cb (GtkAction     *action,
 {
     XedSortPluginPrivate *priv;
     XedDocument *doc;
+    SortOptions options;
 
     xed_debug (DEBUG_PLUGINS);
 
@@ -117,54 +159,232 @@ sort_cb (GtkAction     *action,
 
     get_current_selection (plugin);
 
+    options.reverse_order = g_settings_get_boolean (priv->settings, SETTINGS_KEY_REVERSE_ORDER);
+    options.remove_duplicates = g_settings_get_boolean (priv->settings, SETTINGS_KEY_REMOVE_DUPLICATES);
+    options.ignore_case = g_settings_get_boolean (priv->settings, SETTINGS_KEY_IGNORE_CASE);
+    options.numeric = g_settings_get_boolean (priv->settings, SETTINGS_KEY_NUMERIC);
+    options.start_column = g_settings_get_uint (priv->settings, SETTINGS_KEY_START_COLUMN) - 1;
+
     buffer_sort_lines (GTK_SOURCE_BUFFER (doc),
                        &priv->start,
-                       &priv->end);
+                       &priv->end,
+                       &options);
 }
 
-static gchar *
-get_line_slice (GtkTextBuffer *buf,
-                gint           line)
+/* A line of the sorted range. Only its comparison key is kept, @index
+ * finds the line back in the slice taken from the buffer */
+typedef struct {
+    gchar   *key;    /* the key to use for the comparison */
+    gdouble  number; /* the key to use for numeric comparison */
+    guint    index;  /* position in the original text */
+} SortLine;
+
+typedef struct {
+    const gchar       *text;
+    const gint        *offsets; /* start of each line */
+    const gint        *lengths; /* length of each line without its terminator */
+    SortLine          *lines;
+    guint              first;
+    guint              last;
+    const SortOptions *options;
+} KeyBatch;
+
+static const gchar *
+skip_columns (const gchar *line,
+              const gchar *line_end,
+              guint        columns)
 {
-    GtkTextIter start, end;
+    while (columns > 0 && line < line_end)
+    {
+        line = g_utf8_next_char (line);
+        columns--;
+    }
+
+    return MIN (line, line_end);
+}
+
+/* Like sort -n, reads an optional sign, digits and one decimal point,
+ * after any blanks. Lines which do not start with a number count as 0:
+ * unlike g_ascii_strtod(), words such as "nan" or "info" must not give
+ * keys which compare equal to everything. */
+static gdouble
+parse_number (const gchar *str,
+              const gchar *str_end)
+{
+    const gchar *p = str;
+    const gchar *digits_start;
+    gboolean seen_point = FALSE;
+    gchar *number;
+    gdouble value;
+
+    while (p < str_end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+
+    str = p;
+
+    if (p < str_end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+
+    digits_start = p;
+
+    while (p < str_end && (g_ascii_isdigit (*p) || (*p == '.' && !seen_point)))
+    {
+        seen_point = seen_point || *p == '.';
+        p++;
+    }
+
+    /* a lone sign or point is not a number */
+    if (p - digits_start == (seen_point ? 1 : 0))
+    {
+        return 0;
+    }
+
+    number = g_strndup (str, p - str);
+    value = g_ascii_strtod (number, NULL);
+    g_free (number);
 
-    gtk_text_buffer_get_iter_at_line (buf, &start, line);
-    end = start;
+    return isfinite (value) ? value : 0;
+}
 
-    if (!gtk_text_iter_ends_line (&start))
+static gpointer
+build_keys (gpointer data)
+{
+    KeyBatch *batch = data;
+    guint i;
+
+    for (i = batch->first; i < batch->last; i++)
     {
-        gtk_text_iter_forward_to_line_end (&end);
+        const gchar *line = batch->text + batch->offsets[i];
+        const gchar *line_end = line + batch->lengths[i];
+        const gchar *key_start;
+        SortLine *sort_line = &batch->lines[i];
+
+        key_start = skip_columns (line, line_end, batch->options->start_column);
+
+        sort_line->index = i;
+
+        if (batch->options->numeric)
+        {
+            sort_line->number = parse_number (key_start, line_end);
+        }
+        else if (batch->options->ignore_case)
+        {
+            gchar *str = g_utf8_casefold (key_start, line_end - key_start);
+
+            sort_line->key = g_utf8_collate_key (str, -1);
+            g_free (str);
+        }
+        else
+        {
+            sort_line->key = g_utf8_collate_key (key_start, line_end - key_start);
+        }
     }
 
-    return gtk_text_buffer_get_slice (buf, &start, &end, TRUE);
+    return NULL;
 }
 
-typedef struct {
-    gchar *line; /* the original text to re-insert */
-    gchar *key;  /* the key to use for the comparison */
-} SortLine;
+/* The collation keys are the costly part of the sort, compute them on
+ * all the cores when the range is large */
+static void
+build_keys_parallel (KeyBatch *all)
+{
+    guint n_lines = all->last - all->first;
+    guint n_threads;
+    KeyBatch *batches;
+    GThread **threads;
+    guint i;
+
+    n_threads = n_lines < PARALLEL_MIN_LINES ? 1 : MAX (1, g_get_num_processors ());
+
+    batches = g_new (KeyBatch, n_threads);
+    threads = g_new0 (GThread *, n_threads);
+
+    for (i = 0; i < n_threads; i++)
+    {
+        batches[i] = *all;
+        batches[i].first = all->first + (guint64) n_lines * i / n_threads;
+        batches[i].last = all->first + (guint64) n_lines * (i + 1) / n_threads;
+
+        /* the first batch is done on this thread */
+        if (i > 0)
+        {
+            threads[i] = g_thread_new ("xed-sort-keys", build_keys, &batches[i]);
+        }
+    }
+
+    build_keys (&batches[0]);
+
+    for (i = 1; i < n_threads; i++)
+    {
+        g_thread_join (threads[i]);
+    }
+
+    g_free (threads);
+    g_free (batches);
+}
+
+static gint
+compare_keys (const SortLine *a,
+              const SortLine *b,
+              gboolean        numeric)
+{
+    if (numeric)
+    {
+        return (a->number > b->number) - (a->number < b->number);
+    }
+
+    return strcmp (a->key, b->key);
+}
 
 static gint
 compare_line (gconstpointer aptr,
-              gconstpointer bptr)
+              gconstpointer bptr,
+              gpointer      user_data)
 {
     const SortLine *a = aptr;
     const SortLine *b = bptr;
+    const SortOptions *options = user_data;
+    gint ret;
+
+    ret = compare_keys (a, b, options->numeric);
+
+    if (options->reverse_order)
+    {
+        ret = -ret;
+    }
 
-    return g_strcmp0 (a->key, b->key);
+    /* keep equal lines in their original order */
+    if (ret == 0)
+    {
+        ret = (a->index > b->index) - (a->index < b->index);
+    }
+
+    return ret;
 }
 
 static void
-buffer_sort_lines (GtkSourceBuffer    *buffer,
-                   GtkTextIter        *start,
-                   GtkTextIter        *end)
+buffer_sort_lines (GtkSourceBuffer   *buffer,
+                   GtkTextIter       *start,
+                   GtkTextIter       *end,
+                   const SortOptions *options)
 {
     GtkTextBuffer *text_buffer;
     gint start_line;
     gint end_line;
-    gint num_lines;
+    gchar *text;
+    gint text_len;
+    GArray *offsets;
+    GArray *lengths;
+    guint num_lines;
     SortLine *lines;
-    gint i;
+    KeyBatch batch;
+    GString *sorted;
+    gint pos;
+    guint i;
 
     g_return_if_fail (GTK_SOURCE_IS_BUFFER (buffer));
     g_return_if_fail (start != NULL);
@@ -200,41 +420,79 @@ buffer_sort_lines (GtkSourceBuffer    *buffer,
         return;
     }
 
+    /* Take the whole range at once and split it in place */
+    text = gtk_text_buffer_get_slice (text_buffer, start, end, TRUE);
+    text_len = strlen (text);
+
     num_lines = end_line - start_line + 1;
-    lines = g_new0 (SortLine, num_lines);
+    offsets = g_array_sized_new (FALSE, FALSE, sizeof (gint), num_lines + 1);
+    lengths = g_array_sized_new (FALSE, FALSE, sizeof (gint), num_lines);
 
-    for (i = 0; i < num_lines; i++)
+    pos = 0;
+    while (pos < text_len)
     {
-        gchar *line;
+        gint delimiter;
+        gint next;
 
-        lines[i].line = get_line_slice (text_buffer, start_line + i);
-        line = g_utf8_casefold (lines[i].line, -1);
-        lines[i].key = g_utf8_collate_key (line, -1);
+        pango_find_paragraph_boundary (text + pos, text_len - pos, &delimiter, &next);
 
-        g_free (line);
+        g_array_append_val (offsets, pos);
+        g_array_append_val (lengths, delimiter);
+
+        pos += next;
     }
 
-    qsort (lines, num_lines, sizeof (SortLine), compare_line);
+    num_lines = lengths->len;
 
-    gtk_text_buffer_begin_user_action (text_buffer);
+    lines = g_new0 (SortLine, num_lines);
 
-    gtk_text_buffer_delete (text_buffer, start, end);
+    batch.text = text;
+    batch.offsets = (const gint *) offsets->data;
+    batch.lengths = (const gint *) lengths->data;
+    batch.lines = lines;
+    batch.first = 0;
+    batch.last = num_lines;
+    batch.options = options;
+
+    build_keys_parallel (&batch);
+
+    g_qsort_with_data (lines, num_lines, sizeof (SortLine), compare_line, (gpointer) options);
+
+    /* Build the result and put it back with a single insertion, so that
+     * the whole sort is one delete and one insert in the undo history */
+    sorted = g_string_sized_new (text_len + 1);
 
     for (i = 0; i < num_lines; i++)
     {
-        gtk_text_buffer_insert (text_buffer, start, lines[i].line, -1);
-        gtk_text_buffer_insert (text_buffer, start, "\n", -1);
+        guint index = lines[i].index;
+
+        if (options->remove_duplicates && i > 0 &&
+            compare_keys (&lines[i - 1], &lines[i], options->numeric) == 0)
+        {
+            continue;
+        }
+
+        g_string_append_len (sorted, text + batch.offsets[index], batch.lengths[index]);
+        g_string_append_c (sorted, '\n');
     }
 
+    gtk_text_buffer_begin_user_action (text_buffer);
+
+    gtk_text_buffer_delete (text_buffer, start, end);
+    gtk_text_buffer_insert (text_buffer, start, sorted->str, sorted->len);
+
     gtk_text_buffer_end_user_action (text_buffer);
 
     for (i = 0; i < num_lines; i++)
     {
-        g_free (lines[i].line);
         g_free (lines[i].key);
     }
 
     g_free (lines);
+    g_string_free (sorted, TRUE);
+    g_array_free (offsets, TRUE);
+    g_array_free (lengths, TRUE);
+    g_free (text);
 }
 
 static void
@@ -310,6 +568,7 @@ xed_sort_plugin_init (XedSortPlugin *plugin)
     xed_debug_message (DEBUG_PLUGINS, "XedSortPlugin initializing");
 
     plugin->priv = xed_sort_plugin_get_instance_private (plugin);
+    plugin->priv->settings = g_settings_new (SORT_SCHEMA);
 }
 
 static void
@@ -321,6 +580,7 @@ xed_sort_plugin_dispose (GObject *object)
 
     g_clear_object (&plugin->priv->ui_action_group);
     g_clear_object (&plugin->priv->window);
+    g_clear_object (&plugin->priv->settings);
 
     G_OBJECT_CLASS (xed_sort_plugin_parent_class)->dispose (object);
 }
@@ -371,6 +631,101 @@ xed_sort_plugin_get_property (GObject    *object,
     }
 }
 
+static void
+dialog_response_cb (GtkWidget *widget,
+                    gint       response,
+                    gpointer   data)
+{
+    gtk_widget_destroy (widget);
+}
+
+static void
+configure_widget_destroyed (GtkWidget *widget,
+                            gpointer   data)
+{
+    SortConfigureWidget *conf_widget = (SortConfigureWidget *) data;
+
+    xed_debug (DEBUG_PLUGINS);
+
+    g_object_unref (conf_widget->settings);
+    g_slice_free (SortConfigureWidget, data);
+}
+
+static SortConfigureWidget *
+get_configure_widget (XedSortPlugin *plugin)
+{
+    SortConfigureWidget *widget;
+    gchar *data_dir;
+    gchar *ui_file;
+    GtkWidget *error_widget;
+    gboolean ret;
+
+    xed_debug (DEBUG_PLUGINS);
+
+    widget = g_slice_new (SortConfigureWidget);
+    widget->settings = g_object_ref (plugin->priv->settings);
+
+    data_dir = peas_extension_base_get_data_dir (PEAS_EXTENSION_BASE (plugin));
+    ui_file = g_build_filename (data_dir, "xed-sort-configure.ui", NULL);
+    ret = xed_utils_get_ui_objects (ui_file,
+                                    NULL,
+                                    &error_widget,
+                                    "configure_dialog", &widget->dialog,
+                                    "check_button_reverse_order", &widget->reverse_order,
+                                    "check_button_remove_duplicates", &widget->remove_duplicates,
+                                    "check_button_ignore_case", &widget->ignore_case,
+                                    "check_button_numeric", &widget->numeric,
+                                    "spin_button_start_column", &widget->start_column,
+                                    NULL);
+
+    g_free (data_dir);
+    g_free (ui_file);
+
+    if (!ret)
+    {
+        g_object_unref (widget->settings);
+        g_slice_free (SortConfigureWidget, widget);
+        return NULL;
+    }
+
+    gtk_window_set_modal (GTK_WINDOW (widget->dialog), TRUE);
+
+    g_settings_bind (widget->settings, SETTINGS_KEY_REVERSE_ORDER,
+                     widget->reverse_order, "active",
+                     G_SETTINGS_BIND_DEFAULT | G_SETTINGS_BIND_GET_NO_CHANGES);
+    g_settings_bind (widget->settings, SETTINGS_KEY_REMOVE_DUPLICATES,
+                     widget->remove_duplicates, "active",
+                     G_SETTINGS_BIND_DEFAULT | G_SETTINGS_BIND_GET_NO_CHANGES);
+    g_settings_bind (widget->settings, SETTINGS_KEY_IGNORE_CASE,
+                     widget->ignore_case, "active",
+                     G_SETTINGS_BIND_DEFAULT | G_SETTINGS_BIND_GET_NO_CHANGES);
+    g_settings_bind (widget->settings, SETTINGS_KEY_NUMERIC,
+                     widget->numeric, "active",
+                     G_SETTINGS_BIND_DEFAULT | G_SETTINGS_BIND_GET_NO_CHANGES);
+    g_settings_bind (widget->settings, SETTINGS_KEY_START_COLUMN,
+                     widget->start_column, "value",
+                     G_SETTINGS_BIND_DEFAULT | G_SETTINGS_BIND_GET_NO_CHANGES);
+
+    g_signal_connect (widget->dialog, "destroy",
+                      G_CALLBACK (configure_widget_destroyed), widget);
+
+    gtk_widget_show (GTK_WIDGET (widget->dialog));
+    g_signal_connect (widget->dialog, "response",
+                      G_CALLBACK (dialog_response_cb), widget);
+
+    return widget;
+}
+
+static GtkWidget *
+xed_sort_plugin_create_configure_widget (PeasGtkConfigurable *configurable)
+{
+    SortConfigureWidget *widget;
+
+    widget = get_configure_widget (XED_SORT_PLUGIN (configurable));
+
+    return widget != NULL ? widget->dialog : NULL;
+}
+
 static void
 xed_sort_plugin_class_init (XedSortPluginClass *klass)
 {
@@ -398,6 +753,12 @@ xed_window_activatable_iface_init (XedWindowActivatableInterface *iface)
     iface->update_state = xed_sort_plugin_update_state;
 }
 
+static void
+peas_gtk_configurable_iface_init (PeasGtkConfigurableInterface *iface)
+{
+    iface->create_configure_widget = xed_sort_plugin_create_configure_widget;
+}
+
 G_MODULE_EXPORT void
 peas_register_types (PeasObjectModule *module)
 {
@@ -406,4 +767,8 @@ peas_register_types (PeasObjectModule *module)
     peas_object_module_register_extension_type (module,
                                                 XED_TYPE_WINDOW_ACTIVATABLE,
                                                 XED_TYPE_SORT_PLUGIN);
+
+    peas_object_module_register_extension_type (module,
+                                                PEAS_GTK_TYPE_CONFIGURABLE,
+                                                XED_TYPE_SORT_PLUGIN);
 }
@@ -0,0 +1,352 @@
+/*
+ * xed-taglist-plugin-model.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "xed-taglist-plugin-model.h"
+
+static void xed_taglist_plugin_model_tree_model_init (GtkTreeModelIface *iface);
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedTaglistPluginModel,
+				xed_taglist_plugin_model,
+				G_TYPE_OBJECT,
+				0,
+				G_IMPLEMENT_INTERFACE_DYNAMIC (GTK_TYPE_TREE_MODEL,
+							       xed_taglist_plugin_model_tree_model_init))
+
+#define ITER_INDEX(iter) ((guint) GPOINTER_TO_UINT ((iter)->user_data))
+
+static gboolean
+set_iter (XedTaglistPluginModel *model,
+	  GtkTreeIter           *iter,
+	  guint                  index)
+{
+	if (index >= model->matches->len)
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->stamp = model->stamp;
+	iter->user_data = GUINT_TO_POINTER (index);
+
+	return TRUE;
+}
+
+static TagMatch *
+get_match (XedTaglistPluginModel *model,
+	   GtkTreeIter           *iter)
+{
+	g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+	g_return_val_if_fail (ITER_INDEX (iter) < model->matches->len, NULL);
+
+	return &g_array_index (model->matches, TagMatch, ITER_INDEX (iter));
+}
+
+static GtkTreeModelFlags
+xed_taglist_plugin_model_get_flags (GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+xed_taglist_plugin_model_get_n_columns (GtkTreeModel *tree_model)
+{
+	return XED_TAGLIST_PLUGIN_MODEL_N_COLUMNS;
+}
+
+static GType
+xed_taglist_plugin_model_get_column_type (GtkTreeModel *tree_model,
+					  gint          index)
+{
+	switch (index)
+	{
+		case XED_TAGLIST_PLUGIN_MODEL_COLUMN_NAME:
+		case XED_TAGLIST_PLUGIN_MODEL_COLUMN_GROUP:
+			return G_TYPE_STRING;
+
+		case XED_TAGLIST_PLUGIN_MODEL_COLUMN_TAG:
+			return G_TYPE_POINTER;
+
+		default:
+			g_return_val_if_reached (G_TYPE_INVALID);
+	}
+}
+
+static gboolean
+xed_taglist_plugin_model_get_iter (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter,
+				   GtkTreePath  *path)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (tree_model);
+
+	if (gtk_tree_path_get_depth (path) != 1)
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	return set_iter (model, iter, gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+xed_taglist_plugin_model_get_path (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (tree_model);
+
+	g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+
+	return gtk_tree_path_new_from_indices (ITER_INDEX (iter), -1);
+}
+
+static void
+xed_taglist_plugin_model_get_value (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter,
+				    gint          column,
+				    GValue       *value)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (tree_model);
+	TagMatch *match;
+
+	g_value_init (value,
+		      xed_taglist_plugin_model_get_column_type (tree_model, column));
+
+	match = get_match (model, iter);
+	g_return_if_fail (match != NULL);
+
+	switch (column)
+	{
+		case XED_TAGLIST_PLUGIN_MODEL_COLUMN_NAME:
+			g_value_set_string (value, (gchar *)match->tag->name);
+			break;
+
+		case XED_TAGLIST_PLUGIN_MODEL_COLUMN_GROUP:
+			if (model->show_groups)
+				g_value_set_string (value, (gchar *)match->group->name);
+			break;
+
+		case XED_TAGLIST_PLUGIN_MODEL_COLUMN_TAG:
+			g_value_set_pointer (value, match->tag);
+			break;
+	}
+}
+
+static gboolean
+xed_taglist_plugin_model_iter_next (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (tree_model);
+
+	g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+
+	return set_iter (model, iter, ITER_INDEX (iter) + 1);
+}
+
+static gboolean
+xed_taglist_plugin_model_iter_previous (GtkTreeModel *tree_model,
+					GtkTreeIter  *iter)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (tree_model);
+
+	g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+
+	if (ITER_INDEX (iter) == 0)
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	return set_iter (model, iter, ITER_INDEX (iter) - 1);
+}
+
+static gboolean
+xed_taglist_plugin_model_iter_children (GtkTreeModel *tree_model,
+					GtkTreeIter  *iter,
+					GtkTreeIter  *parent)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (tree_model);
+
+	if (parent != NULL)
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	return set_iter (model, iter, 0);
+}
+
+static gboolean
+xed_taglist_plugin_model_iter_has_child (GtkTreeModel *tree_model,
+					 GtkTreeIter  *iter)
+{
+	return FALSE;
+}
+
+static gint
+xed_taglist_plugin_model_iter_n_children (GtkTreeModel *tree_model,
+					  GtkTreeIter  *iter)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (tree_model);
+
+	if (iter != NULL)
+		return 0;
+
+	return model->matches->len;
+}
+
+static gboolean
+xed_taglist_plugin_model_iter_nth_child (GtkTreeModel *tree_model,
+					 GtkTreeIter  *iter,
+					 GtkTreeIter  *parent,
+					 gint          n)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (tree_model);
+
+	if (parent != NULL || n < 0)
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	return set_iter (model, iter, n);
+}
+
+static gboolean
+xed_taglist_plugin_model_iter_parent (GtkTreeModel *tree_model,
+				      GtkTreeIter  *iter,
+				      GtkTreeIter  *child)
+{
+	iter->stamp = 0;
+
+	return FALSE;
+}
+
+static void
+xed_taglist_plugin_model_tree_model_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = xed_taglist_plugin_model_get_flags;
+	iface->get_n_columns = xed_taglist_plugin_model_get_n_columns;
+	iface->get_column_type = xed_taglist_plugin_model_get_column_type;
+	iface->get_iter = xed_taglist_plugin_model_get_iter;
+	iface->get_path = xed_taglist_plugin_model_get_path;
+	iface->get_value = xed_taglist_plugin_model_get_value;
+	iface->iter_next = xed_taglist_plugin_model_iter_next;
+	iface->iter_previous = xed_taglist_plugin_model_iter_previous;
+	iface->iter_children = xed_taglist_plugin_model_iter_children;
+	iface->iter_has_child = xed_taglist_plugin_model_iter_has_child;
+	iface->iter_n_children = xed_taglist_plugin_model_iter_n_children;
+	iface->iter_nth_child = xed_taglist_plugin_model_iter_nth_child;
+	iface->iter_parent = xed_taglist_plugin_model_iter_parent;
+}
+
+static void
+xed_taglist_plugin_model_finalize (GObject *object)
+{
+	XedTaglistPluginModel *model = XED_TAGLIST_PLUGIN_MODEL (object);
+
+	g_array_free (model->matches, TRUE);
+
+	G_OBJECT_CLASS (xed_taglist_plugin_model_parent_class)->finalize (object);
+}
+
+static void
+xed_taglist_plugin_model_class_init (XedTaglistPluginModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = xed_taglist_plugin_model_finalize;
+}
+
+static void
+xed_taglist_plugin_model_class_finalize (XedTaglistPluginModelClass *klass)
+{
+	/* dummy function - used by G_DEFINE_DYNAMIC_TYPE */
+}
+
+static void
+xed_taglist_plugin_model_init (XedTaglistPluginModel *model)
+{
+	/* The rows never change, so the iters stay valid as long as the
+	 * model lives: the stamp only has to tell models apart */
+	do
+	{
+		model->stamp = g_random_int ();
+	}
+	while (model->stamp == 0);
+}
+
+/* Takes ownership of matches, an array of TagMatch */
+GtkTreeModel *
+xed_taglist_plugin_model_new (GArray   *matches,
+			      gboolean  show_groups)
+{
+	XedTaglistPluginModel *model;
+
+	g_return_val_if_fail (matches != NULL, NULL);
+
+	model = g_object_new (XED_TYPE_TAGLIST_PLUGIN_MODEL, NULL);
+	model->matches = matches;
+	model->show_groups = show_groups;
+
+	return GTK_TREE_MODEL (model);
+}
+
+GtkTreeModel *
+xed_taglist_plugin_model_new_for_group (TagGroup *group)
+{
+	GArray *matches;
+	GList *l;
+
+	g_return_val_if_fail (group != NULL, NULL);
+
+	matches = g_array_sized_new (FALSE, FALSE, sizeof (TagMatch),
+				     g_list_length (group->tags));
+
+	for (l = group->tags; l != NULL; l = g_list_next (l))
+	{
+		TagMatch match;
+
+		match.tag = (Tag*) l->data;
+		match.group = group;
+		g_array_append_val (matches, match);
+	}
+
+	return xed_taglist_plugin_model_new (matches, FALSE);
+}
+
+Tag *
+xed_taglist_plugin_model_get_tag (XedTaglistPluginModel *model,
+				  GtkTreeIter           *iter)
+{
+	TagMatch *match;
+
+	g_return_val_if_fail (XED_IS_TAGLIST_PLUGIN_MODEL (model), NULL);
+
+	match = get_match (model, iter);
+
+	return match != NULL ? match->tag : NULL;
+}
+
+void
+_xed_taglist_plugin_model_register_type (GTypeModule *type_module)
+{
+	xed_taglist_plugin_model_register_type (type_module);
+}
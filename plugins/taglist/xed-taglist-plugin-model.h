@@ -0,0 +1,88 @@
+/*
+ * xed-taglist-plugin-model.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_TAGLIST_PLUGIN_MODEL_H__
+#define __XED_TAGLIST_PLUGIN_MODEL_H__
+
+#include <gtk/gtk.h>
+
+#include "xed-taglist-plugin-parser.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Type checking and casting macros
+ */
+#define XED_TYPE_TAGLIST_PLUGIN_MODEL              (xed_taglist_plugin_model_get_type())
+#define XED_TAGLIST_PLUGIN_MODEL(obj)              (G_TYPE_CHECK_INSTANCE_CAST((obj), XED_TYPE_TAGLIST_PLUGIN_MODEL, XedTaglistPluginModel))
+#define XED_TAGLIST_PLUGIN_MODEL_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST((klass), XED_TYPE_TAGLIST_PLUGIN_MODEL, XedTaglistPluginModelClass))
+#define XED_IS_TAGLIST_PLUGIN_MODEL(obj)           (G_TYPE_CHECK_INSTANCE_TYPE((obj), XED_TYPE_TAGLIST_PLUGIN_MODEL))
+#define XED_IS_TAGLIST_PLUGIN_MODEL_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), XED_TYPE_TAGLIST_PLUGIN_MODEL))
+#define XED_TAGLIST_PLUGIN_MODEL_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS((obj), XED_TYPE_TAGLIST_PLUGIN_MODEL, XedTaglistPluginModelClass))
+
+enum
+{
+	XED_TAGLIST_PLUGIN_MODEL_COLUMN_NAME,
+	XED_TAGLIST_PLUGIN_MODEL_COLUMN_GROUP,
+	XED_TAGLIST_PLUGIN_MODEL_COLUMN_TAG,
+	XED_TAGLIST_PLUGIN_MODEL_N_COLUMNS
+};
+
+/*
+ * A read only list of tags. The rows are not copied anywhere: the values
+ * are read from the tags when the view asks for them, which it only does
+ * for the rows it shows.
+ */
+typedef struct _XedTaglistPluginModel XedTaglistPluginModel;
+
+struct _XedTaglistPluginModel
+{
+	GObject parent;
+
+	/*< private > */
+	GArray *matches;
+	gboolean show_groups;
+	gint stamp;
+};
+
+typedef struct _XedTaglistPluginModelClass XedTaglistPluginModelClass;
+
+struct _XedTaglistPluginModelClass
+{
+	GObjectClass parent_class;
+};
+
+/*
+ * Public methods
+ */
+void		 _xed_taglist_plugin_model_register_type	(GTypeModule *module);
+
+GType		 xed_taglist_plugin_model_get_type	(void) G_GNUC_CONST;
+
+GtkTreeModel	*xed_taglist_plugin_model_new		(GArray      *matches,
+							 gboolean     show_groups);
+GtkTreeModel	*xed_taglist_plugin_model_new_for_group	(TagGroup    *group);
+
+Tag		*xed_taglist_plugin_model_get_tag	(XedTaglistPluginModel *model,
+							 GtkTreeIter           *iter);
+
+G_END_DECLS
+
+#endif /* __XED_TAGLIST_PLUGIN_MODEL_H__ */
@@ -37,20 +37,15 @@
 #include <glib/gi18n.h>
 
 #include "xed-taglist-plugin-panel.h"
+#include "xed-taglist-plugin-model.h"
 #include "xed-taglist-plugin-parser.h"
 
-enum
-{
-	COLUMN_TAG_NAME,
-	COLUMN_TAG_INDEX_IN_GROUP,
-	NUM_COLUMNS
-};
-
 struct _XedTaglistPluginPanelPrivate
 {
 	XedWindow  *window;
 
 	GtkWidget *tag_groups_combo;
+	GtkWidget *search_entry;
 	GtkWidget *tags_list;
 	GtkWidget *preview;
 
@@ -236,6 +231,24 @@ insert_tag (XedTaglistPluginPanel *panel,
 		gtk_widget_grab_focus (GTK_WIDGET (view));
 }
 
+static void
+insert_selected_tag (XedTaglistPluginPanel *panel,
+		     gboolean                 grab_focus)
+{
+	GtkTreeModel *model;
+	GtkTreeSelection *selection;
+	GtkTreeIter iter;
+
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (panel->priv->tags_list));
+
+	if (gtk_tree_selection_get_selected (selection, &model, &iter))
+	{
+		insert_tag (panel,
+			    xed_taglist_plugin_model_get_tag (XED_TAGLIST_PLUGIN_MODEL (model), &iter),
+			    grab_focus);
+	}
+}
+
 static void
 tag_list_row_activated_cb (GtkTreeView             *tag_list,
 			   GtkTreePath             *path,
@@ -244,21 +257,16 @@ tag_list_row_activated_cb (GtkTreeView             *tag_list,
 {
 	GtkTreeIter iter;
 	GtkTreeModel *model;
-	gint index;
 
 	xed_debug (DEBUG_PLUGINS);
 
 	model = gtk_tree_view_get_model (tag_list);
 
-	gtk_tree_model_get_iter (model, &iter, path);
-	g_return_if_fail (&iter != NULL);
-
-	gtk_tree_model_get (model, &iter, COLUMN_TAG_INDEX_IN_GROUP, &index, -1);
-
-	xed_debug_message (DEBUG_PLUGINS, "Index: %d", index);
+	if (!gtk_tree_model_get_iter (model, &iter, path))
+		return;
 
 	insert_tag (panel,
-		    (Tag*)g_list_nth_data (panel->priv->selected_tag_group->tags, index),
+		    xed_taglist_plugin_model_get_tag (XED_TAGLIST_PLUGIN_MODEL (model), &iter),
 		    TRUE);
 }
 
@@ -273,27 +281,18 @@ tag_list_key_press_event_cb (GtkTreeView             *tag_list,
 
 	if (event->keyval == GDK_KEY_Return)
 	{
-		GtkTreeModel *model;
-		GtkTreeSelection *selection;
-		GtkTreeIter iter;
-		gint index;
-
 		xed_debug_message (DEBUG_PLUGINS, "RETURN Pressed");
 
-		model = gtk_tree_view_get_model (tag_list);
-
-		selection = gtk_tree_view_get_selection (tag_list);
+		insert_selected_tag (panel, grab_focus);
 
-		if (gtk_tree_selection_get_selected (selection, NULL, &iter))
-		{
-			gtk_tree_model_get (model, &iter, COLUMN_TAG_INDEX_IN_GROUP, &index, -1);
-
-			xed_debug_message (DEBUG_PLUGINS, "Index: %d", index);
+		return TRUE;
+	}
 
-			insert_tag (panel,
-				    (Tag*)g_list_nth_data (panel->priv->selected_tag_group->tags, index),
-				    grab_focus);
-		}
+	/* Typing in the list searches the tags */
+	if (gtk_search_entry_handle_event (GTK_SEARCH_ENTRY (panel->priv->search_entry),
+					   (GdkEvent *) event) == GDK_EVENT_STOP)
+	{
+		gtk_entry_grab_focus_without_selecting (GTK_ENTRY (panel->priv->search_entry));
 
 		return TRUE;
 	}
@@ -301,58 +300,49 @@ tag_list_key_press_event_cb (GtkTreeView             *tag_list,
 	return FALSE;
 }
 
-static GtkTreeModel*
-create_model (XedTaglistPluginPanel *panel)
+static void
+populate_tags_list (XedTaglistPluginPanel *panel)
 {
-	gint i = 0;
-	GtkListStore *store;
-	GtkTreeIter iter;
-	GList *list;
+	GtkTreeModel* model;
+	const gchar *text;
 
 	xed_debug (DEBUG_PLUGINS);
 
-	/* create list store */
-	store = gtk_list_store_new (NUM_COLUMNS, G_TYPE_STRING, G_TYPE_INT);
-
-	/* add data to the list store */
-	list = panel->priv->selected_tag_group->tags;
-
-	while (list != NULL)
-	{
-		const gchar* tag_name;
-
-		tag_name = (gchar *)((Tag*)list->data)->name;
-
-		xed_debug_message (DEBUG_PLUGINS, "%d : %s", i, tag_name);
+	g_return_if_fail (taglist != NULL);
 
-		gtk_list_store_append (store, &iter);
-		gtk_list_store_set (store, &iter,
-				    COLUMN_TAG_NAME, tag_name,
-				    COLUMN_TAG_INDEX_IN_GROUP, i,
-				    -1);
-		++i;
+	text = gtk_entry_get_text (GTK_ENTRY (panel->priv->search_entry));
 
-		list = g_list_next (list);
-	}
+	/* The model only wraps the tags, the view asks it for the rows it
+	 * shows, so that swapping it costs next to nothing even for thousands
+	 * of tags */
+	if (*text != '\0')
+		model = xed_taglist_plugin_model_new (find_tags (text), TRUE);
+	else if (panel->priv->selected_tag_group != NULL)
+		model = xed_taglist_plugin_model_new_for_group (panel->priv->selected_tag_group);
+	else
+		return;
 
 	xed_debug_message (DEBUG_PLUGINS, "Rows: %d ",
-			     gtk_tree_model_iter_n_children (GTK_TREE_MODEL (store), NULL));
+			   gtk_tree_model_iter_n_children (model, NULL));
 
-	return GTK_TREE_MODEL (store);
-}
+	gtk_tree_view_set_model (GTK_TREE_VIEW (panel->priv->tags_list),
+			         model);
 
-static void
-populate_tags_list (XedTaglistPluginPanel *panel)
-{
-	GtkTreeModel* model;
+	/* Clean up preview */
+	gtk_label_set_text (GTK_LABEL (panel->priv->preview),
+			    "");
 
-	xed_debug (DEBUG_PLUGINS);
+	/* When searching, let Return insert the best match right away */
+	if (*text != '\0' && gtk_tree_model_iter_n_children (model, NULL) > 0)
+	{
+		GtkTreePath *path;
 
-	g_return_if_fail (taglist != NULL);
+		path = gtk_tree_path_new_first ();
+		gtk_tree_view_set_cursor (GTK_TREE_VIEW (panel->priv->tags_list),
+					  path, NULL, FALSE);
+		gtk_tree_path_free (path);
+	}
 
-	model = create_model (panel);
-	gtk_tree_view_set_model (GTK_TREE_VIEW (panel->priv->tags_list),
-			         model);
 	g_object_unref (model);
 }
 
@@ -426,13 +416,13 @@ selected_group_changed (GtkComboBox             *combo,
 				     "New selected group: %s",
 				     panel->priv->selected_tag_group->name);
 
-		populate_tags_list (panel);
+		/* Picking a group ends the search, which shows the group */
+		if (gtk_entry_get_text_length (GTK_ENTRY (panel->priv->search_entry)) > 0)
+			gtk_entry_set_text (GTK_ENTRY (panel->priv->search_entry), "");
+		else
+			populate_tags_list (panel);
 	}
 
-	/* Clean up preview */
-	gtk_label_set_text (GTK_LABEL (panel->priv->preview),
-			    "");
-
 	g_free (group_name);
 }
 
@@ -487,22 +477,15 @@ tag_list_cursor_changed_cb (GtkTreeView *tag_list,
 	GtkTreeModel *model;
 	GtkTreeSelection *selection;
 	GtkTreeIter iter;
-	gint index;
 
 	XedTaglistPluginPanel *panel = (XedTaglistPluginPanel *)data;
 
-	model = gtk_tree_view_get_model (tag_list);
-
 	selection = gtk_tree_view_get_selection (tag_list);
 
-	if (gtk_tree_selection_get_selected (selection, NULL, &iter))
+	if (gtk_tree_selection_get_selected (selection, &model, &iter))
 	{
-		gtk_tree_model_get (model, &iter, COLUMN_TAG_INDEX_IN_GROUP, &index, -1);
-
-		xed_debug_message (DEBUG_PLUGINS, "Index: %d", index);
-
 		update_preview (panel,
-			        (Tag*)g_list_nth_data (panel->priv->selected_tag_group->tags, index));
+			        xed_taglist_plugin_model_get_tag (XED_TAGLIST_PLUGIN_MODEL (model), &iter));
 	}
 }
 
@@ -517,8 +500,7 @@ tags_list_query_tooltip_cb (GtkWidget               *widget,
 	GtkTreeIter iter;
 	GtkTreeModel *model;
 	GtkTreePath *path = NULL;
-	gint index;
-	Tag *tag;
+	Tag *tag = NULL;
 
 	model = gtk_tree_view_get_model (GTK_TREE_VIEW (widget));
 
@@ -550,12 +532,9 @@ tags_list_query_tooltip_cb (GtkWidget               *widget,
 		}
 	}
 
-	gtk_tree_model_get_iter (model, &iter, path);
-	gtk_tree_model_get (model, &iter,
-			    COLUMN_TAG_INDEX_IN_GROUP, &index,
-			    -1);
+	if (gtk_tree_model_get_iter (model, &iter, path))
+		tag = xed_taglist_plugin_model_get_tag (XED_TAGLIST_PLUGIN_MODEL (model), &iter);
 
-	tag = g_list_nth_data (panel->priv->selected_tag_group->tags, index);
 	if (tag != NULL)
 	{
 		gchar *tip;
@@ -573,6 +552,48 @@ tags_list_query_tooltip_cb (GtkWidget               *widget,
 	return FALSE;
 }
 
+static void
+search_entry_changed_cb (GtkEditable             *editable,
+			 XedTaglistPluginPanel *panel)
+{
+	xed_debug (DEBUG_PLUGINS);
+
+	/* The taglists are only loaded at the first draw */
+	if (taglist == NULL)
+		return;
+
+	populate_tags_list (panel);
+}
+
+static void
+search_entry_activate_cb (GtkEntry                *entry,
+			  XedTaglistPluginPanel *panel)
+{
+	insert_selected_tag (panel, TRUE);
+}
+
+static void
+search_entry_stop_search_cb (GtkSearchEntry          *entry,
+			     XedTaglistPluginPanel *panel)
+{
+	gtk_entry_set_text (GTK_ENTRY (entry), "");
+}
+
+static gboolean
+search_entry_key_press_event_cb (GtkWidget               *entry,
+				 GdkEventKey             *event,
+				 XedTaglistPluginPanel *panel)
+{
+	if (event->keyval == GDK_KEY_Down || event->keyval == GDK_KEY_KP_Down)
+	{
+		gtk_widget_grab_focus (panel->priv->tags_list);
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 static gboolean
 draw_event_cb (GtkWidget      *panel,
                cairo_t        *cr,
@@ -684,6 +705,15 @@ xed_taglist_plugin_panel_init (XedTaglistPluginPanel *panel)
 			  G_CALLBACK (realize_tag_groups_combo),
 			  panel);
 
+	panel->priv->search_entry = gtk_search_entry_new ();
+	gtk_entry_set_placeholder_text (GTK_ENTRY (panel->priv->search_entry),
+					_("Search all groups"));
+	gtk_box_pack_start (GTK_BOX (panel),
+			    panel->priv->search_entry,
+			    FALSE,
+			    TRUE,
+			    0);
+
 	sw = gtk_scrolled_window_new (NULL, NULL);
 
 	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw),
@@ -702,6 +732,12 @@ xed_taglist_plugin_panel_init (XedTaglistPluginPanel *panel)
 	xed_utils_set_atk_name_description (panel->priv->tags_list,
 					      _("Tags"),
 					      NULL);
+	xed_utils_set_atk_name_description (panel->priv->search_entry,
+					      _("Search Tags"),
+					      NULL);
+	xed_utils_set_atk_relation (panel->priv->search_entry,
+				      panel->priv->tags_list,
+				      ATK_RELATION_CONTROLLER_FOR);
 	xed_utils_set_atk_relation (panel->priv->tag_groups_combo,
 				      panel->priv->tags_list,
 				      ATK_RELATION_CONTROLLER_FOR);
@@ -713,22 +749,43 @@ xed_taglist_plugin_panel_init (XedTaglistPluginPanel *panel)
 
 	g_object_set (panel->priv->tags_list, "has-tooltip", TRUE, NULL);
 
-	/* Add the tags column */
+	/* Add the tags column, with the group of the tag when searching */
 	cell = gtk_cell_renderer_text_new ();
+	g_object_set (cell, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
 	column = gtk_tree_view_column_new_with_attributes (_("Tags"),
 							   cell,
 							   "text",
-							   COLUMN_TAG_NAME,
+							   XED_TAGLIST_PLUGIN_MODEL_COLUMN_NAME,
 							   NULL);
+
+	cell = gtk_cell_renderer_text_new ();
+	g_object_set (cell,
+		      "sensitive", FALSE,
+		      "scale", PANGO_SCALE_SMALL,
+		      NULL);
+	gtk_tree_view_column_pack_end (column, cell, FALSE);
+	gtk_tree_view_column_add_attribute (column,
+					    cell,
+					    "text",
+					    XED_TAGLIST_PLUGIN_MODEL_COLUMN_GROUP);
+
+	/* All the rows have the same height, so that only the visible ones
+	 * need to be measured */
+	gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_expand (column, TRUE);
 	gtk_tree_view_append_column (GTK_TREE_VIEW (panel->priv->tags_list),
 				     column);
+	gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (panel->priv->tags_list),
+					     TRUE);
 
-	gtk_tree_view_set_search_column (GTK_TREE_VIEW (panel->priv->tags_list),
-					 COLUMN_TAG_NAME);
+	/* The search entry replaces the interactive search of the view */
+	gtk_tree_view_set_enable_search (GTK_TREE_VIEW (panel->priv->tags_list),
+					 FALSE);
 
 	gtk_container_add (GTK_CONTAINER (sw), panel->priv->tags_list);
 
 	focus_chain = g_list_prepend (focus_chain, panel->priv->tags_list);
+	focus_chain = g_list_prepend (focus_chain, panel->priv->search_entry);
 	focus_chain = g_list_prepend (focus_chain, panel->priv->tag_groups_combo);
 
 	gtk_container_set_focus_chain (GTK_CONTAINER (panel),
@@ -739,6 +796,7 @@ xed_taglist_plugin_panel_init (XedTaglistPluginPanel *panel)
 
 	gtk_widget_show_all (GTK_WIDGET (sw));
 	gtk_widget_show (GTK_WIDGET (panel->priv->tag_groups_combo));
+	gtk_widget_show (GTK_WIDGET (panel->priv->search_entry));
 
 	g_signal_connect_after (panel->priv->tags_list,
 				"row_activated",
@@ -760,6 +818,22 @@ xed_taglist_plugin_panel_init (XedTaglistPluginPanel *panel)
 			  "changed",
 			  G_CALLBACK (selected_group_changed),
 			  panel);
+	g_signal_connect (panel->priv->search_entry,
+			  "changed",
+			  G_CALLBACK (search_entry_changed_cb),
+			  panel);
+	g_signal_connect (panel->priv->search_entry,
+			  "activate",
+			  G_CALLBACK (search_entry_activate_cb),
+			  panel);
+	g_signal_connect (panel->priv->search_entry,
+			  "stop-search",
+			  G_CALLBACK (search_entry_stop_search_cb),
+			  panel);
+	g_signal_connect (panel->priv->search_entry,
+			  "key-press-event",
+			  G_CALLBACK (search_entry_key_press_event_cb),
+			  panel);
 	g_signal_connect (panel,
 			  "draw",
 			  G_CALLBACK (draw_event_cb),
@@ -31,17 +31,74 @@
 /* FIXME: we should rewrite the parser to avoid using DOM */
 
 #include <config.h>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <libxml/parser.h>
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <xed/xed-debug.h>
+#include <xed/xed-dirs.h>
 
 #include "xed-taglist-plugin-parser.h"
 
 /* we screwed up so we still look here for compatibility */
 #define USER_XED_TAGLIST_PLUGIN_LOCATION "xed/taglist/"
 
+/*
+ * The parsed tag lists are kept in a cache file, mapped in memory as it is
+ * laid out on disk:
+ *
+ *   CacheHeader
+ *   the stamp, padded to 4 bytes
+ *   CacheGroup[n_groups]
+ *   CacheTag[n_tags], the tags of a group following each other
+ *   the strings, each ending with a nul byte
+ *
+ * The stamp lists the tag list files with their modification times and
+ * sizes, and the languages of the locale, so that the cache is only used
+ * when parsing the files again would give the same tag lists.
+ */
+#define CACHE_FILE    "taglist.cache"
+#define CACHE_MAGIC   0x4354574c /* "LWTC" */
+#define CACHE_VERSION 1
+#define CACHE_NONE    G_MAXUINT32
+
+typedef struct
+{
+	guint32 magic;
+	guint32 version;
+	guint32 stamp_size;
+	guint32 n_groups;
+	guint32 n_tags;
+	guint32 strings_size;
+} CacheHeader;
+
+typedef struct
+{
+	guint32 name;
+	guint32 first_tag;
+	guint32 n_tags;
+} CacheGroup;
+
+typedef struct
+{
+	guint32 name;
+	guint32 begin;
+	guint32 end;
+} CacheTag;
+
+typedef struct
+{
+	/* Casefolded name of the tag, or one of its later words */
+	const gchar *key;
+	const gchar *name;
+	guint order;
+
+	TagMatch match;
+} IndexEntry;
+
 TagList* taglist = NULL;
 static gint taglist_ref_count = 0;
 
@@ -54,7 +111,6 @@ static TagGroup* get_tag_group (const gchar* filename, xmlDocPtr doc,
 static TagList* lookup_best_lang (TagList *taglist, const gchar *filename,
 				xmlDocPtr doc, xmlNsPtr ns, xmlNodePtr cur);
 static TagList 	*parse_taglist_file (const gchar* filename);
-static TagList  *parse_taglist_dir (const gchar *dir);
 
 static void	 free_tag (Tag *tag);
 static void	 free_tag_group (TagGroup *tag_group);
@@ -540,9 +596,29 @@ void free_taglist(void)
 		return;
 	}
 
-	for (l = taglist->tag_groups; l != NULL; l = g_list_next (l))
+	if (taglist->cache != NULL)
 	{
-		free_tag_group ((TagGroup*) l->data);
+		for (l = taglist->tag_groups; l != NULL; l = g_list_next (l))
+		{
+			g_list_free (((TagGroup*) l->data)->tags);
+		}
+
+		g_free (taglist->cache_groups);
+		g_free (taglist->cache_tags);
+		g_mapped_file_unref (taglist->cache);
+	}
+	else
+	{
+		for (l = taglist->tag_groups; l != NULL; l = g_list_next (l))
+		{
+			free_tag_group ((TagGroup*) l->data);
+		}
+	}
+
+	if (taglist->index != NULL)
+	{
+		g_array_free (taglist->index, TRUE);
+		g_string_chunk_free (taglist->index_keys);
 	}
 
 	g_list_free (taglist->tag_groups);
@@ -552,11 +628,20 @@ void free_taglist(void)
 	xed_debug_message (DEBUG_PLUGINS, "Really freed");
 }
 
-static TagList* parse_taglist_dir(const gchar* dir)
+static gint
+compare_filenames (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Adds the tag list files of @dir to @files, in a stable order */
+static void
+list_taglist_dir (const gchar *dir, GPtrArray *files)
 {
 	GError* error = NULL;
 	GDir* d;
 	const gchar* dirent;
+	guint first = files->len;
 
 	xed_debug_message(DEBUG_PLUGINS, "DIR: %s", dir);
 
@@ -566,27 +651,304 @@ static TagList* parse_taglist_dir(const gchar* dir)
 	{
 		xed_debug_message(DEBUG_PLUGINS, "%s", error->message);
 		g_error_free (error);
-		return taglist;
+		return;
 	}
 
 	while ((dirent = g_dir_read_name(d)))
 	{
 		if (g_str_has_suffix(dirent, ".tags") || g_str_has_suffix(dirent, ".tags.gz"))
 		{
-			gchar* tags_file = g_build_filename(dir, dirent, NULL);
-			parse_taglist_file(tags_file);
-			g_free (tags_file);
+			g_ptr_array_add (files, g_build_filename(dir, dirent, NULL));
 		}
 	}
 
 	g_dir_close (d);
 
-	return taglist;
+	qsort (files->pdata + first, files->len - first, sizeof (gpointer), compare_filenames);
+}
+
+static GString *
+get_cache_stamp (GPtrArray *files)
+{
+	const gchar * const *langs;
+	GString *stamp;
+	guint i;
+
+	stamp = g_string_new (NULL);
+
+	for (i = 0; i < files->len; i++)
+	{
+		const gchar *filename = g_ptr_array_index (files, i);
+		GStatBuf buf;
+
+		if (g_stat (filename, &buf) != 0)
+		{
+			continue;
+		}
+
+		g_string_append_printf (stamp, "%s %" G_GINT64_FORMAT " %" G_GINT64_FORMAT "\n",
+					filename, (gint64) buf.st_mtime, (gint64) buf.st_size);
+	}
+
+	/* the groups are picked for the languages of the locale */
+	for (langs = g_get_language_names (); *langs != NULL; langs++)
+	{
+		g_string_append_printf (stamp, "%s\n", *langs);
+	}
+
+	return stamp;
+}
+
+static gchar *
+get_cache_filename (void)
+{
+	return g_build_filename (xed_dirs_get_user_cache_dir (), CACHE_FILE, NULL);
+}
+
+static gsize
+get_cache_stamp_size (gsize stamp_len)
+{
+	return (stamp_len + 3) & ~((gsize) 3);
+}
+
+static gboolean
+cache_string_is_valid (guint32 offset, const CacheHeader *header, gboolean nullable)
+{
+	return offset < header->strings_size || (nullable && offset == CACHE_NONE);
+}
+
+/* Checks the whole cache once, so that it can be read without checks */
+static gboolean
+cache_is_valid (const gchar *contents, gsize length, GString *stamp)
+{
+	const CacheHeader *header = (const CacheHeader *) contents;
+	const CacheGroup *groups;
+	const CacheTag *tags;
+	gsize size;
+	guint i;
+
+	if (length < sizeof (CacheHeader) ||
+	    header->magic != CACHE_MAGIC ||
+	    header->version != CACHE_VERSION ||
+	    header->stamp_size != stamp->len)
+	{
+		return FALSE;
+	}
+
+	size = sizeof (CacheHeader) + get_cache_stamp_size (header->stamp_size) +
+	       (gsize) header->n_groups * sizeof (CacheGroup) +
+	       (gsize) header->n_tags * sizeof (CacheTag) +
+	       header->strings_size;
+
+	if (length != size ||
+	    header->strings_size == 0 ||
+	    contents[length - 1] != '\0' ||
+	    memcmp (contents + sizeof (CacheHeader), stamp->str, stamp->len) != 0)
+	{
+		return FALSE;
+	}
+
+	groups = (const CacheGroup *) (contents + sizeof (CacheHeader) + get_cache_stamp_size (header->stamp_size));
+	tags = (const CacheTag *) (groups + header->n_groups);
+
+	for (i = 0; i < header->n_groups; i++)
+	{
+		if (!cache_string_is_valid (groups[i].name, header, FALSE) ||
+		    groups[i].first_tag > header->n_tags ||
+		    groups[i].n_tags > header->n_tags - groups[i].first_tag)
+		{
+			return FALSE;
+		}
+	}
+
+	for (i = 0; i < header->n_tags; i++)
+	{
+		if (!cache_string_is_valid (tags[i].name, header, FALSE) ||
+		    !cache_string_is_valid (tags[i].begin, header, TRUE) ||
+		    !cache_string_is_valid (tags[i].end, header, TRUE))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static xmlChar *
+get_cache_string (const gchar *strings, guint32 offset)
+{
+	return offset == CACHE_NONE ? NULL : (xmlChar *) (strings + offset);
+}
+
+/* Builds the tag list from the cache, without copying any string */
+static gboolean
+load_cache (GString *stamp)
+{
+	gchar *filename;
+	GMappedFile *mapped;
+	const gchar *contents;
+	const CacheHeader *header;
+	const CacheGroup *groups;
+	const CacheTag *tags;
+	const gchar *strings;
+	guint i;
+
+	filename = get_cache_filename ();
+	mapped = g_mapped_file_new (filename, FALSE, NULL);
+	g_free (filename);
+
+	if (mapped == NULL)
+	{
+		return FALSE;
+	}
+
+	contents = g_mapped_file_get_contents (mapped);
+
+	if (!cache_is_valid (contents, g_mapped_file_get_length (mapped), stamp))
+	{
+		xed_debug_message (DEBUG_PLUGINS, "The cache is out of date");
+		g_mapped_file_unref (mapped);
+		return FALSE;
+	}
+
+	header = (const CacheHeader *) contents;
+	groups = (const CacheGroup *) (contents + sizeof (CacheHeader) + get_cache_stamp_size (header->stamp_size));
+	tags = (const CacheTag *) (groups + header->n_groups);
+	strings = (const gchar *) (tags + header->n_tags);
+
+	taglist = g_new0 (TagList, 1);
+	taglist->cache = mapped;
+	taglist->cache_groups = g_new0 (TagGroup, header->n_groups);
+	taglist->cache_tags = g_new0 (Tag, header->n_tags);
+
+	for (i = 0; i < header->n_tags; i++)
+	{
+		Tag *tag = &taglist->cache_tags[i];
+
+		tag->name = get_cache_string (strings, tags[i].name);
+		tag->begin = get_cache_string (strings, tags[i].begin);
+		tag->end = get_cache_string (strings, tags[i].end);
+	}
+
+	/* prepending from the end keeps the lists in order */
+	for (i = header->n_groups; i > 0; i--)
+	{
+		const CacheGroup *cache_group = &groups[i - 1];
+		TagGroup *group = &taglist->cache_groups[i - 1];
+		guint j;
+
+		group->name = get_cache_string (strings, cache_group->name);
+
+		for (j = cache_group->n_tags; j > 0; j--)
+		{
+			group->tags = g_list_prepend (group->tags, &taglist->cache_tags[cache_group->first_tag + j - 1]);
+		}
+
+		taglist->tag_groups = g_list_prepend (taglist->tag_groups, group);
+	}
+
+	xed_debug_message (DEBUG_PLUGINS, "%u tag groups loaded from the cache", header->n_groups);
+
+	return TRUE;
+}
+
+static guint32
+add_cache_string (GString *strings, const xmlChar *str)
+{
+	guint32 offset;
+
+	if (str == NULL)
+	{
+		return CACHE_NONE;
+	}
+
+	offset = strings->len;
+	g_string_append_len (strings, (const gchar *) str, strlen ((const gchar *) str) + 1);
+
+	return offset;
+}
+
+static void
+save_cache (GString *stamp)
+{
+	CacheHeader header = { 0 };
+	GString *groups;
+	GString *tags;
+	GString *strings;
+	GString *contents;
+	gchar *filename;
+	GError *error = NULL;
+	GList *l;
+
+	groups = g_string_new (NULL);
+	tags = g_string_new (NULL);
+	strings = g_string_new (NULL);
+
+	for (l = taglist != NULL ? taglist->tag_groups : NULL; l != NULL; l = g_list_next (l))
+	{
+		TagGroup *tag_group = l->data;
+		CacheGroup group;
+		GList *t;
+
+		group.name = add_cache_string (strings, tag_group->name);
+		group.first_tag = header.n_tags;
+		group.n_tags = g_list_length (tag_group->tags);
+		g_string_append_len (groups, (const gchar *) &group, sizeof (group));
+
+		for (t = tag_group->tags; t != NULL; t = g_list_next (t))
+		{
+			Tag *tag = t->data;
+			CacheTag cache_tag;
+
+			cache_tag.name = add_cache_string (strings, tag->name);
+			cache_tag.begin = add_cache_string (strings, tag->begin);
+			cache_tag.end = add_cache_string (strings, tag->end);
+			g_string_append_len (tags, (const gchar *) &cache_tag, sizeof (cache_tag));
+		}
+
+		header.n_groups++;
+		header.n_tags += group.n_tags;
+	}
+
+	/* never empty, for the last byte to be a nul one */
+	g_string_append_c (strings, '\0');
+
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.stamp_size = stamp->len;
+	header.strings_size = strings->len;
+
+	contents = g_string_new (NULL);
+	g_string_append_len (contents, (const gchar *) &header, sizeof (header));
+	g_string_append_len (contents, stamp->str, stamp->len);
+	g_string_set_size (contents, sizeof (header) + get_cache_stamp_size (stamp->len));
+	g_string_append_len (contents, groups->str, groups->len);
+	g_string_append_len (contents, tags->str, tags->len);
+	g_string_append_len (contents, strings->str, strings->len);
+
+	filename = get_cache_filename ();
+
+	if (g_mkdir_with_parents (xed_dirs_get_user_cache_dir (), 0755) != 0 ||
+	    !g_file_set_contents (filename, contents->str, contents->len, &error))
+	{
+		xed_debug_message (DEBUG_PLUGINS, "Could not save the cache: %s",
+				   error != NULL ? error->message : g_strerror (errno));
+		g_clear_error (&error);
+	}
+
+	g_free (filename);
+	g_string_free (contents, TRUE);
+	g_string_free (strings, TRUE);
+	g_string_free (tags, TRUE);
+	g_string_free (groups, TRUE);
 }
 
 TagList* create_taglist(const gchar* data_dir)
 {
 	gchar* pdir;
+	GPtrArray *files;
+	GString *stamp;
+	guint i;
 
 	xed_debug_message(DEBUG_PLUGINS, "ref_count: %d", taglist_ref_count);
 
@@ -599,21 +961,168 @@ TagList* create_taglist(const gchar* data_dir)
 
 	const gchar* home;
 
-	/* load user's taglists */
+	files = g_ptr_array_new_with_free_func (g_free);
+
+	/* user's taglists */
 
 	home = g_get_home_dir ();
 	if (home != NULL)
 	{
 		pdir = g_build_filename(home, ".config", USER_XED_TAGLIST_PLUGIN_LOCATION, NULL);
-		parse_taglist_dir(pdir);
+		list_taglist_dir(pdir, files);
 		g_free (pdir);
 	}
 
-	/* load system's taglists */
-	parse_taglist_dir(data_dir);
+	/* system's taglists */
+	list_taglist_dir(data_dir, files);
+
+	stamp = get_cache_stamp (files);
+
+	if (!load_cache (stamp))
+	{
+		for (i = 0; i < files->len; i++)
+		{
+			parse_taglist_file (g_ptr_array_index (files, i));
+		}
+
+		save_cache (stamp);
+	}
+
+	g_string_free (stamp, TRUE);
+	g_ptr_array_free (files, TRUE);
 
 	++taglist_ref_count;
 	g_return_val_if_fail(taglist_ref_count == 1, taglist);
 
 	return taglist;
 }
+
+static gint
+index_entry_cmp (gconstpointer a, gconstpointer b)
+{
+	const IndexEntry *entry_a = a;
+	const IndexEntry *entry_b = b;
+	gint res;
+
+	res = strcmp (entry_a->key, entry_b->key);
+	if (res != 0)
+		return res;
+
+	return (entry_a->order > entry_b->order) - (entry_a->order < entry_b->order);
+}
+
+static void
+build_index (void)
+{
+	GList *g;
+	GList *t;
+	guint order = 0;
+
+	taglist->index = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+	taglist->index_keys = g_string_chunk_new (4096);
+
+	for (g = taglist->tag_groups; g != NULL; g = g_list_next (g))
+	{
+		for (t = ((TagGroup*) g->data)->tags; t != NULL; t = g_list_next (t))
+		{
+			IndexEntry entry;
+			gchar *folded;
+			const gchar *p;
+			gboolean in_word = FALSE;
+
+			entry.match.tag = (Tag*) t->data;
+			entry.match.group = (TagGroup*) g->data;
+			entry.order = order++;
+
+			folded = g_utf8_casefold ((gchar *) entry.match.tag->name, -1);
+			entry.name = g_string_chunk_insert (taglist->index_keys, folded);
+			g_free (folded);
+
+			/* Each word of the name is a key too, so that "row"
+			 * finds "Table row" */
+			for (p = entry.name; *p != '\0'; p = g_utf8_next_char (p))
+			{
+				gboolean alnum = g_unichar_isalnum (g_utf8_get_char (p));
+
+				if (p == entry.name || (alnum && !in_word))
+				{
+					entry.key = p;
+					g_array_append_val (taglist->index, entry);
+				}
+
+				in_word = alnum;
+			}
+		}
+	}
+
+	g_array_sort (taglist->index, index_entry_cmp);
+
+	xed_debug_message (DEBUG_PLUGINS, "Indexed %u tags with %u keys",
+			   order, taglist->index->len);
+}
+
+/* Returns the tags of all the groups with a word of their name starting
+ * with prefix, ignoring the case. The tags whose name starts with it come
+ * first, in the order of the names. */
+GArray* find_tags(const gchar* prefix)
+{
+	GArray *matches;
+	GArray *later_words;
+	GHashTable *seen;
+	gchar *folded;
+	gsize len;
+	guint lo, hi;
+	guint i;
+
+	g_return_val_if_fail (taglist != NULL, NULL);
+
+	if (taglist->index == NULL)
+		build_index ();
+
+	folded = g_utf8_casefold (prefix, -1);
+	len = strlen (folded);
+
+	/* Find the first key which doesn't sort before the prefix */
+	lo = 0;
+	hi = taglist->index->len;
+
+	while (lo < hi)
+	{
+		guint mid = lo + (hi - lo) / 2;
+
+		if (strcmp (g_array_index (taglist->index, IndexEntry, mid).key, folded) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	matches = g_array_new (FALSE, FALSE, sizeof (TagMatch));
+	later_words = g_array_new (FALSE, FALSE, sizeof (TagMatch));
+	seen = g_hash_table_new (NULL, NULL);
+
+	for (i = lo; i < taglist->index->len; i++)
+	{
+		IndexEntry *entry = &g_array_index (taglist->index, IndexEntry, i);
+
+		if (strncmp (entry->key, folded, len) != 0)
+			break;
+
+		if (entry->key == entry->name)
+		{
+			g_array_append_val (matches, entry->match);
+		}
+		else if (strncmp (entry->name, folded, len) != 0 &&
+			 g_hash_table_add (seen, entry->match.tag))
+		{
+			g_array_append_val (later_words, entry->match);
+		}
+	}
+
+	g_array_append_vals (matches, later_words->data, later_words->len);
+
+	g_hash_table_destroy (seen);
+	g_array_free (later_words, TRUE);
+	g_free (folded);
+
+	return matches;
+}
@@ -37,9 +37,21 @@
 typedef struct _TagList TagList;
 typedef struct _TagGroup TagGroup;
 typedef struct _Tag Tag;
+typedef struct _TagMatch TagMatch;
 
 struct _TagList {
 	GList* tag_groups;
+
+	/* When loaded from the cache, the strings point in the mapped file
+	 * and the groups and tags are allocated as two arrays */
+	GMappedFile *cache;
+	TagGroup *cache_groups;
+	Tag *cache_tags;
+
+	/* Prefix index over the names of the tags of all the groups, built
+	 * at the first search */
+	GArray *index;
+	GStringChunk *index_keys;
 };
 
 struct _TagGroup {
@@ -54,6 +66,11 @@ struct _Tag {
 	xmlChar* end;
 };
 
+struct _TagMatch {
+	Tag *tag;
+	TagGroup *group;
+};
+
 /* Note that the taglist is ref counted */
 extern TagList *taglist;
 
@@ -61,5 +78,7 @@ TagList* create_taglist(const gchar* data_dir);
 
 void free_taglist(void);
 
+GArray* find_tags(const gchar* prefix);
+
 #endif /* __XED_TAGLIST_PLUGIN_PARSER_H__ */
 
@@ -34,6 +34,7 @@
 #include <xed/xed-debug.h>
 
 #include "xed-taglist-plugin.h"
+#include "xed-taglist-plugin-model.h"
 #include "xed-taglist-plugin-panel.h"
 #include "xed-taglist-plugin-parser.h"
 
@@ -59,7 +60,8 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedTaglistPlugin,
                                 G_IMPLEMENT_INTERFACE_DYNAMIC (XED_TYPE_WINDOW_ACTIVATABLE,
                                                                xed_window_activatable_iface_init)
                                 G_ADD_PRIVATE_DYNAMIC (XedTaglistPlugin)
-                                _xed_taglist_plugin_panel_register_type (type_module))
+                                _xed_taglist_plugin_panel_register_type (type_module);
+                                _xed_taglist_plugin_model_register_type (type_module))
 
 static void
 xed_taglist_plugin_init (XedTaglistPlugin *plugin)
@@ -24,11 +24,17 @@
 
 #include "xed-trail-save-plugin.h"
 
+#define TRAIL_SAVE_SCHEMA                   "org.x.editor.plugins.trailsave"
+#define SETTINGS_KEY_MODIFIED_LINES_ONLY    "modified-lines-only"
+
+#define DIRTY_LINES_KEY "XedTrailSavePluginDirtyLines"
+
 static void xed_window_activatable_iface_init (XedWindowActivatableInterface *iface);
 
 struct _XedTrailSavePluginPrivate
 {
    XedWindow *window;
+   GSettings *settings;
 };
 
 enum
@@ -45,84 +51,368 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedTrailSavePlugin,
                                                                xed_window_activatable_iface_init)
                                 G_ADD_PRIVATE_DYNAMIC (XedTrailSavePlugin))
 
+typedef struct
+{
+    gint line;
+    gint start;  /* line offsets of the spaces to strip */
+    gint end;
+} StripRange;
+
+/* Lines edited since the document was last loaded or saved */
+typedef struct
+{
+    GArray   *lines;      /* sorted line numbers */
+    gboolean  all_dirty;  /* edited before we started tracking */
+    gint      insert_line;
+} DirtyLines;
+
+static guint
+dirty_lines_search (DirtyLines *dirty,
+                    gint        line)
+{
+    guint low = 0;
+    guint high = dirty->lines->len;
+
+    /* index of the first entry >= line */
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+
+        if (g_array_index (dirty->lines, gint, mid) < line)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/* Move the lines after @line by @delta */
 static void
-strip_trailing_spaces (GtkTextBuffer *text_buffer)
-{
-    gint line_count, line_num;
-    GtkTextIter line_start, line_end;
-    gchar *slice;
-    gchar byte;
-    gint byte_index;
-    gint strip_start_index, strip_end_index;
-    gint empty_lines_start = -1;
-    gboolean should_strip;
-    GtkTextIter strip_start, strip_end;
+dirty_lines_shift (DirtyLines *dirty,
+                   gint        line,
+                   gint        delta)
+{
+    guint i;
 
-    g_assert (text_buffer != NULL);
+    if (delta == 0)
+    {
+        return;
+    }
 
-    line_count = gtk_text_buffer_get_line_count (text_buffer);
+    for (i = dirty_lines_search (dirty, line + 1); i < dirty->lines->len; i++)
+    {
+        g_array_index (dirty->lines, gint, i) += delta;
+    }
+}
+
+static void
+dirty_lines_add_range (DirtyLines *dirty,
+                       gint        first,
+                       gint        last)
+{
+    guint index;
+    guint end;
+    gint n_lines;
+    gint *run;
+    gint i;
+
+    index = dirty_lines_search (dirty, first);
+    end = dirty_lines_search (dirty, last + 1);
+
+    /* replace the lines already there with the whole run at once */
+    if (end > index)
+    {
+        g_array_remove_range (dirty->lines, index, end - index);
+    }
+
+    n_lines = last - first + 1;
+    run = g_new (gint, n_lines);
+
+    for (i = 0; i < n_lines; i++)
+    {
+        run[i] = first + i;
+    }
+
+    g_array_insert_vals (dirty->lines, index, run, n_lines);
+    g_free (run);
+}
+
+static void
+dirty_lines_clear (DirtyLines *dirty)
+{
+    g_array_set_size (dirty->lines, 0);
+    dirty->all_dirty = FALSE;
+}
+
+static void
+dirty_lines_free (DirtyLines *dirty)
+{
+    g_array_free (dirty->lines, TRUE);
+    g_slice_free (DirtyLines, dirty);
+}
+
+static void
+on_insert_text (GtkTextBuffer *buffer,
+                GtkTextIter   *location,
+                const gchar   *text,
+                gint           len,
+                DirtyLines    *dirty)
+{
+    dirty->insert_line = gtk_text_iter_get_line (location);
+}
+
+static void
+on_insert_text_after (GtkTextBuffer *buffer,
+                      GtkTextIter   *location,
+                      const gchar   *text,
+                      gint           len,
+                      DirtyLines    *dirty)
+{
+    gint last_line;
+
+    /* location now points at the end of the inserted text */
+    last_line = gtk_text_iter_get_line (location);
+
+    dirty_lines_shift (dirty, dirty->insert_line, last_line - dirty->insert_line);
+    dirty_lines_add_range (dirty, dirty->insert_line, last_line);
+}
+
+static void
+on_delete_range (GtkTextBuffer *buffer,
+                 GtkTextIter   *start,
+                 GtkTextIter   *end,
+                 DirtyLines    *dirty)
+{
+    gint start_line;
+    gint end_line;
+
+    start_line = gtk_text_iter_get_line (start);
+    end_line = gtk_text_iter_get_line (end);
+
+    if (end_line > start_line)
+    {
+        guint first = dirty_lines_search (dirty, start_line + 1);
+        guint last = dirty_lines_search (dirty, end_line + 1);
+
+        /* the lines joined into start_line are gone, the ones after move up */
+        g_array_remove_range (dirty->lines, first, last - first);
+        dirty_lines_shift (dirty, start_line, start_line - end_line);
+    }
+
+    dirty_lines_add_range (dirty, start_line, start_line);
+}
+
+static void
+on_loaded_or_saved (XedDocument *document,
+                    DirtyLines  *dirty)
+{
+    dirty_lines_clear (dirty);
+}
+
+static void
+track_document (XedDocument *document)
+{
+    DirtyLines *dirty;
+
+    if (g_object_get_data (G_OBJECT (document), DIRTY_LINES_KEY) != NULL)
+    {
+        return;
+    }
+
+    dirty = g_slice_new0 (DirtyLines);
+    dirty->lines = g_array_new (FALSE, FALSE, sizeof (gint));
+
+    /* we do not know what was changed before now */
+    dirty->all_dirty = gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (document));
+
+    g_signal_connect (document, "insert-text", G_CALLBACK (on_insert_text), dirty);
+    g_signal_connect_after (document, "insert-text", G_CALLBACK (on_insert_text_after), dirty);
+    g_signal_connect (document, "delete-range", G_CALLBACK (on_delete_range), dirty);
+    g_signal_connect (document, "loaded", G_CALLBACK (on_loaded_or_saved), dirty);
+    g_signal_connect (document, "saved", G_CALLBACK (on_loaded_or_saved), dirty);
+
+    g_object_set_data_full (G_OBJECT (document), DIRTY_LINES_KEY, dirty, (GDestroyNotify) dirty_lines_free);
+}
+
+static void
+untrack_document (XedDocument *document)
+{
+    DirtyLines *dirty;
+
+    dirty = g_object_get_data (G_OBJECT (document), DIRTY_LINES_KEY);
+
+    if (dirty != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (document, dirty);
+        g_object_set_data (G_OBJECT (document), DIRTY_LINES_KEY, NULL);
+    }
+}
+
+/* Finds the spaces and tabs at the end of the line starting at @line_start,
+ * walking back from the line end so that the line itself is not scanned */
+static gboolean
+find_trailing_spaces (const GtkTextIter *line_start,
+                      StripRange        *range,
+                      gboolean          *blank)
+{
+    GtkTextIter start, end;
+
+    end = *line_start;
+
+    if (!gtk_text_iter_ends_line (&end))
+    {
+        gtk_text_iter_forward_to_line_end (&end);
+    }
+
+    start = end;
 
-    for (line_num = 0; line_num < line_count; ++line_num)
+    while (!gtk_text_iter_starts_line (&start))
     {
-        /* Get line text */
-        gtk_text_buffer_get_iter_at_line (text_buffer, &line_start, line_num);
+        GtkTextIter prev = start;
+        gunichar ch;
 
-        if (line_num == line_count - 1)
+        gtk_text_iter_backward_char (&prev);
+        ch = gtk_text_iter_get_char (&prev);
+
+        if (ch != ' ' && ch != '\t')
         {
-            gtk_text_buffer_get_end_iter (text_buffer, &line_end);
+            break;
         }
-        else
+
+        start = prev;
+    }
+
+    *blank = gtk_text_iter_starts_line (&start);
+
+    if (gtk_text_iter_equal (&start, &end))
+    {
+        return FALSE;
+    }
+
+    range->line = gtk_text_iter_get_line (&start);
+    range->start = gtk_text_iter_get_line_offset (&start);
+    range->end = gtk_text_iter_get_line_offset (&end);
+
+    return TRUE;
+}
+
+static void
+collect_all_lines (GtkTextBuffer *text_buffer,
+                   GArray        *ranges)
+{
+    GtkTextIter iter;
+
+    gtk_text_buffer_get_start_iter (text_buffer, &iter);
+
+    do
+    {
+        StripRange range;
+        gboolean blank;
+
+        if (find_trailing_spaces (&iter, &range, &blank))
         {
-            gtk_text_buffer_get_iter_at_line (text_buffer, &line_end, line_num + 1);
+            g_array_append_val (ranges, range);
         }
+    } while (gtk_text_iter_forward_line (&iter));
+}
 
-        slice = gtk_text_buffer_get_slice (text_buffer, &line_start, &line_end, TRUE);
+static void
+collect_dirty_lines (GtkTextBuffer *text_buffer,
+                     DirtyLines    *dirty,
+                     GArray        *ranges)
+{
+    gint line_count;
+    guint i;
 
-        if (slice == NULL)
+    line_count = gtk_text_buffer_get_line_count (text_buffer);
+
+    for (i = 0; i < dirty->lines->len; i++)
+    {
+        gint line = g_array_index (dirty->lines, gint, i);
+        GtkTextIter iter;
+        StripRange range;
+        gboolean blank;
+
+        if (line >= line_count)
         {
-            continue;
+            break;
         }
 
-        /* Find indices of bytes that should be stripped */
-        should_strip = FALSE;
-        empty_lines_start = (empty_lines_start < 0) ? line_num : empty_lines_start;
+        gtk_text_buffer_get_iter_at_line (text_buffer, &iter, line);
 
-        for (byte_index = 0; slice [byte_index] != 0; ++byte_index)
+        if (find_trailing_spaces (&iter, &range, &blank))
         {
-            byte = slice [byte_index];
-
-            if ((byte == ' ') || (byte == '\t'))
-            {
-                if (!should_strip)
-                {
-                    strip_start_index = byte_index;
-                    should_strip = TRUE;
-                }
-
-                strip_end_index = byte_index + 1;
-            }
-            else if ((byte == '\r') || (byte == '\n'))
-            {
-                break;
-            }
-            else
-            {
-                should_strip = FALSE;
-                empty_lines_start = -1;
-            }
+            g_array_append_val (ranges, range);
         }
+    }
+}
+
+/* Returns the first of the blank lines ending the buffer, or -1 */
+static gint
+find_trailing_lines (GtkTextBuffer *text_buffer)
+{
+    gint line;
+    gint empty_lines_start = -1;
+
+    for (line = gtk_text_buffer_get_line_count (text_buffer) - 1; line >= 0; line--)
+    {
+        GtkTextIter iter;
+        StripRange range;
+        gboolean blank;
 
-        g_free (slice);
+        gtk_text_buffer_get_iter_at_line (text_buffer, &iter, line);
+        find_trailing_spaces (&iter, &range, &blank);
 
-        /* Strip trailing spaces */
-        if (should_strip)
+        if (!blank)
         {
-            gtk_text_buffer_get_iter_at_line_index (text_buffer, &strip_start, line_num, strip_start_index);
-            gtk_text_buffer_get_iter_at_line_index (text_buffer, &strip_end, line_num, strip_end_index);
-            gtk_text_buffer_delete (text_buffer, &strip_start, &strip_end);
+            break;
         }
+
+        empty_lines_start = line;
     }
 
+    return empty_lines_start;
+}
+
+static void
+strip_trailing_spaces (GtkTextBuffer *text_buffer,
+                       DirtyLines    *dirty)
+{
+    GArray *ranges;
+    gint empty_lines_start;
+    GtkTextIter strip_start, strip_end;
+    guint i;
+
+    g_assert (text_buffer != NULL);
+
+    ranges = g_array_new (FALSE, FALSE, sizeof (StripRange));
+
+    /* First find everything to strip, then strip it from the end of the
+     * buffer backwards so that the positions found stay valid */
+    if (dirty == NULL || dirty->all_dirty)
+    {
+        collect_all_lines (text_buffer, ranges);
+    }
+    else
+    {
+        collect_dirty_lines (text_buffer, dirty, ranges);
+    }
+
+    empty_lines_start = find_trailing_lines (text_buffer);
+
+    if (ranges->len == 0 && empty_lines_start == -1)
+    {
+        g_array_free (ranges, TRUE);
+        return;
+    }
+
+    gtk_text_buffer_begin_user_action (text_buffer);
+
     /* Strip trailing lines */
     if (empty_lines_start != -1)
     {
@@ -135,6 +425,26 @@ strip_trailing_spaces (GtkTextBuffer *text_buffer)
         gtk_text_buffer_get_end_iter (text_buffer, &strip_end);
         gtk_text_buffer_delete (text_buffer, &strip_start, &strip_end);
     }
+
+    /* Strip trailing spaces */
+    for (i = ranges->len; i > 0; i--)
+    {
+        StripRange *range = &g_array_index (ranges, StripRange, i - 1);
+
+        /* already gone with the trailing lines */
+        if (empty_lines_start != -1 && range->line >= empty_lines_start)
+        {
+            continue;
+        }
+
+        gtk_text_buffer_get_iter_at_line_offset (text_buffer, &strip_start, range->line, range->start);
+        gtk_text_buffer_get_iter_at_line_offset (text_buffer, &strip_end, range->line, range->end);
+        gtk_text_buffer_delete (text_buffer, &strip_start, &strip_end);
+    }
+
+    gtk_text_buffer_end_user_action (text_buffer);
+
+    g_array_free (ranges, TRUE);
 }
 
 static void
@@ -142,8 +452,42 @@ on_save (XedDocument          *document,
          XedTrailSavePlugin   *plugin)
 {
     GtkTextBuffer *text_buffer = GTK_TEXT_BUFFER (document);
+    DirtyLines *dirty = NULL;
+
+    if (g_settings_get_boolean (plugin->priv->settings, SETTINGS_KEY_MODIFIED_LINES_ONLY))
+    {
+        dirty = g_object_get_data (G_OBJECT (document), DIRTY_LINES_KEY);
+    }
+
+    strip_trailing_spaces (text_buffer, dirty);
+}
+
+/* The edited lines are only needed when just those are stripped */
+static void
+on_modified_lines_only_changed (GSettings          *settings,
+                                const gchar        *key,
+                                XedTrailSavePlugin *plugin)
+{
+    gboolean modified_lines_only;
+    GList *documents;
+    GList *documents_iter;
+
+    modified_lines_only = g_settings_get_boolean (settings, SETTINGS_KEY_MODIFIED_LINES_ONLY);
+    documents = xed_window_get_documents (plugin->priv->window);
+
+    for (documents_iter = documents; documents_iter != NULL; documents_iter = documents_iter->next)
+    {
+        if (modified_lines_only)
+        {
+            track_document (XED_DOCUMENT (documents_iter->data));
+        }
+        else
+        {
+            untrack_document (XED_DOCUMENT (documents_iter->data));
+        }
+    }
 
-    strip_trailing_spaces (text_buffer);
+    g_list_free (documents);
 }
 
 static void
@@ -154,6 +498,12 @@ on_tab_added (XedWindow          *window,
     XedDocument *document;
 
     document = xed_tab_get_document (tab);
+
+    if (g_settings_get_boolean (plugin->priv->settings, SETTINGS_KEY_MODIFIED_LINES_ONLY))
+    {
+        track_document (document);
+    }
+
     g_signal_connect (document, "save",
                       G_CALLBACK (on_save), plugin);
 }
@@ -176,6 +526,7 @@ xed_trail_save_plugin_activate (XedWindowActivatable *activatable)
     GList *documents;
     GList *documents_iter;
     XedDocument *document;
+    gboolean modified_lines_only;
 
     xed_debug (DEBUG_PLUGINS);
 
@@ -185,7 +536,10 @@ xed_trail_save_plugin_activate (XedWindowActivatable *activatable)
                       G_CALLBACK (on_tab_added), XED_TRAIL_SAVE_PLUGIN (activatable));
     g_signal_connect (priv->window, "tab_removed",
                       G_CALLBACK (on_tab_removed), XED_TRAIL_SAVE_PLUGIN (activatable));
+    g_signal_connect (priv->settings, "changed::" SETTINGS_KEY_MODIFIED_LINES_ONLY,
+                      G_CALLBACK (on_modified_lines_only_changed), XED_TRAIL_SAVE_PLUGIN (activatable));
 
+    modified_lines_only = g_settings_get_boolean (priv->settings, SETTINGS_KEY_MODIFIED_LINES_ONLY);
     documents = xed_window_get_documents (priv->window);
 
     for (documents_iter = documents;
@@ -193,6 +547,12 @@ xed_trail_save_plugin_activate (XedWindowActivatable *activatable)
          documents_iter = documents_iter->next)
     {
         document = (XedDocument *) documents_iter->data;
+
+        if (modified_lines_only)
+        {
+            track_document (document);
+        }
+
         g_signal_connect (document, "save",
                           G_CALLBACK (on_save), XED_TRAIL_SAVE_PLUGIN (activatable));
     }
@@ -213,6 +573,7 @@ xed_trail_save_plugin_deactivate (XedWindowActivatable *activatable)
     priv = XED_TRAIL_SAVE_PLUGIN (activatable)->priv;
 
     g_signal_handlers_disconnect_by_data (priv->window, XED_TRAIL_SAVE_PLUGIN (activatable));
+    g_signal_handlers_disconnect_by_data (priv->settings, XED_TRAIL_SAVE_PLUGIN (activatable));
 
     documents = xed_window_get_documents (priv->window);
 
@@ -222,6 +583,7 @@ xed_trail_save_plugin_deactivate (XedWindowActivatable *activatable)
     {
         document = (XedDocument *) documents_iter->data;
         g_signal_handlers_disconnect_by_data (document, XED_TRAIL_SAVE_PLUGIN (activatable));
+        untrack_document (document);
     }
 
     g_list_free (documents);
@@ -233,6 +595,7 @@ xed_trail_save_plugin_init (XedTrailSavePlugin *plugin)
     xed_debug_message (DEBUG_PLUGINS, "XedTrailSavePlugin initializing");
 
     plugin->priv = xed_trail_save_plugin_get_instance_private (plugin);
+    plugin->priv->settings = g_settings_new (TRAIL_SAVE_SCHEMA);
 }
 
 static void
@@ -243,6 +606,7 @@ xed_trail_save_plugin_dispose (GObject *object)
     xed_debug_message (DEBUG_PLUGINS, "XedTrailSavePlugin disposing");
 
     g_clear_object (&plugin->priv->window);
+    g_clear_object (&plugin->priv->settings);
 
     G_OBJECT_CLASS (xed_trail_save_plugin_parent_class)->dispose (object);
 }
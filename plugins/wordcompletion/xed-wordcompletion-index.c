@@ -0,0 +1,1202 @@
+/*
+ * xed-wordcompletion-index.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Words are kept once for the whole application and language, in a hash
+ * table for counting and in an array sorted by bytes, where the words
+ * starting with a prefix follow each other and are found with a binary
+ * search.
+ *
+ * Edits are never rescanned as a whole: before a change the lines it
+ * touches are taken out of the index, after it they are put back. The
+ * text of these lines is copied on the main thread and split into words on
+ * a single worker thread, so the changes are applied in order.
+ *
+ * The words of the previous sessions come from a dictionary file in the
+ * cache directory, mapped in memory as it is laid out on disk:
+ *
+ *   DictionaryHeader
+ *   DictionaryEntry[n_words], sorted by word
+ *   the words, each ending with a nul byte
+ *
+ * It is written again by the worker when the index is freed, after the
+ * changes still queued, with the counts of the previous sessions halved,
+ * so that the words no longer used fade out.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include <xed/xed-debug.h>
+#include <xed/xed-dirs.h>
+
+#include "xed-wordcompletion-index.h"
+
+#define BUFFER_DATA_KEY "XedWordCompletionIndexBuffer"
+
+#define PLAIN_TEXT_ID "plain"
+
+#define DICTIONARY_MAGIC   0x44435758 /* "XWCD" */
+#define DICTIONARY_VERSION 1
+
+/* The least used words are left out of larger dictionaries */
+#define MAX_DICTIONARY_SIZE (1024 * 1024)
+
+/* Shorter words are not worth completing, longer ones are noise */
+#define MIN_WORD_LENGTH 2
+#define MAX_WORD_BYTES  100
+
+/* Below this many new words, they are inserted one by one rather than
+ * merged with the sorted array */
+#define MERGE_THRESHOLD 16
+
+typedef struct
+{
+    gchar *word;
+    guint count;
+
+    /* The highest count this session, kept once the word is gone, for
+     * the dictionary only */
+    guint peak;
+
+    /* When the word was last added, to rank the recent words first */
+    guint stamp;
+} WordEntry;
+
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    guint32 n_words;
+    guint32 words_size;
+} DictionaryHeader;
+
+typedef struct
+{
+    guint32 offset;
+    guint32 count;
+} DictionaryEntry;
+
+typedef struct
+{
+    const gchar *word;
+    guint count;
+    guint stamp;
+} Candidate;
+
+typedef struct
+{
+    gchar *removed;
+    gchar *added;
+
+    /* The removed words moved to another language, and are taken out of
+     * the peaks too */
+    gboolean moved;
+
+    /* The last job, saving the dictionary and freeing the index */
+    gboolean save;
+} IndexJob;
+
+typedef struct
+{
+    XedWordCompletionIndex *index;
+    guint n_registrations;
+
+    /* Lines before the change being made */
+    gint first_line;
+    gchar *removed;
+} BufferData;
+
+struct _XedWordCompletionIndex
+{
+    gint ref_count;
+    gchar *language_id;
+
+    GThreadPool *pool;
+
+    /* Read only, mapped when the index is created */
+    GMappedFile *mapped;
+    const DictionaryEntry *dictionary;
+    const gchar *dictionary_words;
+    guint n_dictionary_words;
+
+    /* Guards everything below, which the worker writes */
+    GMutex lock;
+    GHashTable *words;
+    GPtrArray *sorted;
+    guint clock;
+};
+
+/* Language id to index, for the indexes in use */
+static GHashTable *indexes = NULL;
+
+/* Dictionaries being written, waited for before one is read again and
+ * when the application quits */
+static GMutex saves_lock;
+static GCond saves_cond;
+static guint n_saves = 0;
+
+gboolean
+xed_wordcompletion_index_is_word_char (gunichar c)
+{
+    return g_unichar_isalnum (c) || c == '_';
+}
+
+static void
+word_entry_free (WordEntry *entry)
+{
+    g_free (entry->word);
+    g_slice_free (WordEntry, entry);
+}
+
+static void
+index_job_free (IndexJob *job)
+{
+    g_free (job->removed);
+    g_free (job->added);
+    g_slice_free (IndexJob, job);
+}
+
+static void
+count_words (GHashTable  *deltas,
+             const gchar *text,
+             gint         delta)
+{
+    const gchar *p = text;
+    const gchar *word_start = NULL;
+    glong word_length = 0;
+
+    if (text == NULL)
+    {
+        return;
+    }
+
+    while (TRUE)
+    {
+        gunichar c = g_utf8_get_char (p);
+
+        if (c != 0 && xed_wordcompletion_index_is_word_char (c))
+        {
+            if (word_start == NULL)
+            {
+                word_start = p;
+                word_length = 0;
+            }
+
+            word_length++;
+        }
+        else if (word_start != NULL)
+        {
+            if (word_length >= MIN_WORD_LENGTH && p - word_start <= MAX_WORD_BYTES)
+            {
+                gchar *word = g_strndup (word_start, p - word_start);
+                gint count = GPOINTER_TO_INT (g_hash_table_lookup (deltas, word));
+
+                g_hash_table_replace (deltas, word, GINT_TO_POINTER (count + delta));
+            }
+
+            word_start = NULL;
+        }
+
+        if (c == 0)
+        {
+            break;
+        }
+
+        p = g_utf8_next_char (p);
+    }
+}
+
+static gint
+compare_entries (WordEntry **a,
+                 WordEntry **b)
+{
+    return strcmp ((*a)->word, (*b)->word);
+}
+
+/* The first entry not sorting before @word */
+static guint
+lower_bound (GPtrArray   *sorted,
+             const gchar *word)
+{
+    guint low = 0;
+    guint high = sorted->len;
+
+    while (low < high)
+    {
+        guint middle = low + (high - low) / 2;
+        WordEntry *entry = g_ptr_array_index (sorted, middle);
+
+        if (strcmp (entry->word, word) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static void
+insert_sorted (XedWordCompletionIndex *index,
+               GPtrArray              *added)
+{
+    GPtrArray *merged;
+    guint i = 0;
+    guint j = 0;
+
+    g_ptr_array_sort (added, (GCompareFunc) compare_entries);
+
+    if (added->len < MERGE_THRESHOLD)
+    {
+        for (i = 0; i < added->len; i++)
+        {
+            WordEntry *entry = g_ptr_array_index (added, i);
+
+            g_ptr_array_insert (index->sorted, lower_bound (index->sorted, entry->word), entry);
+        }
+
+        return;
+    }
+
+    merged = g_ptr_array_sized_new (index->sorted->len + added->len);
+
+    while (i < index->sorted->len || j < added->len)
+    {
+        WordEntry *entry;
+
+        if (j == added->len ||
+            (i < index->sorted->len &&
+             compare_entries ((WordEntry **) &index->sorted->pdata[i], (WordEntry **) &added->pdata[j]) < 0))
+        {
+            entry = g_ptr_array_index (index->sorted, i++);
+        }
+        else
+        {
+            entry = g_ptr_array_index (added, j++);
+        }
+
+        g_ptr_array_add (merged, entry);
+    }
+
+    g_ptr_array_free (index->sorted, TRUE);
+    index->sorted = merged;
+}
+
+static void
+apply_deltas (XedWordCompletionIndex *index,
+              GHashTable             *deltas,
+              gboolean                moved)
+{
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    GPtrArray *added;
+
+    added = g_ptr_array_new ();
+
+    g_mutex_lock (&index->lock);
+
+    index->clock++;
+
+    g_hash_table_iter_init (&iter, deltas);
+
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        gint delta = GPOINTER_TO_INT (value);
+        WordEntry *entry;
+
+        if (delta == 0)
+        {
+            continue;
+        }
+
+        entry = g_hash_table_lookup (index->words, key);
+
+        if (entry == NULL)
+        {
+            if (delta < 0)
+            {
+                continue;
+            }
+
+            /* take the word over from the deltas */
+            g_hash_table_iter_steal (&iter);
+
+            entry = g_slice_new0 (WordEntry);
+            entry->word = key;
+            g_hash_table_insert (index->words, entry->word, entry);
+            g_ptr_array_add (added, entry);
+        }
+
+        /* Words gone from the buffers stay, they may be typed again and
+         * belong in the dictionary */
+        if (delta > 0)
+        {
+            entry->count += delta;
+            entry->peak = MAX (entry->peak, entry->count);
+            entry->stamp = index->clock;
+        }
+        else
+        {
+            entry->count = MAX ((gint) entry->count + delta, 0);
+
+            if (moved)
+            {
+                entry->peak = MAX ((gint) entry->peak + delta, (gint) entry->count);
+            }
+        }
+    }
+
+    if (added->len > 0)
+    {
+        insert_sorted (index, added);
+    }
+
+    g_mutex_unlock (&index->lock);
+
+    g_ptr_array_free (added, TRUE);
+}
+
+static void save_and_free (XedWordCompletionIndex *index);
+
+static void
+index_job_run (IndexJob               *job,
+               XedWordCompletionIndex *index)
+{
+    GHashTable *deltas;
+
+    if (job->save)
+    {
+        index_job_free (job);
+        save_and_free (index);
+        return;
+    }
+
+    deltas = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    /* Splitting happens without the lock, the queries don't wait for it */
+    count_words (deltas, job->removed, -1);
+    count_words (deltas, job->added, 1);
+
+    apply_deltas (index, deltas, job->moved);
+
+    g_hash_table_destroy (deltas);
+    index_job_free (job);
+}
+
+static void
+queue_job (XedWordCompletionIndex *index,
+           gchar                  *removed,
+           gchar                  *added,
+           gboolean                moved)
+{
+    IndexJob *job;
+
+    if (removed == NULL && added == NULL)
+    {
+        return;
+    }
+
+    job = g_slice_new0 (IndexJob);
+    job->removed = removed;
+    job->added = added;
+    job->moved = moved;
+
+    g_thread_pool_push (index->pool, job, NULL);
+}
+
+static gchar *
+get_lines (GtkTextBuffer *buffer,
+           gint           first_line,
+           gint           last_line)
+{
+    GtkTextIter start;
+    GtkTextIter end;
+
+    gtk_text_buffer_get_iter_at_line (buffer, &start, first_line);
+    gtk_text_buffer_get_iter_at_line (buffer, &end, last_line);
+
+    if (!gtk_text_iter_ends_line (&end))
+    {
+        gtk_text_iter_forward_to_line_end (&end);
+    }
+
+    return gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+}
+
+static gchar *
+get_all_text (GtkTextBuffer *buffer)
+{
+    GtkTextIter start;
+    GtkTextIter end;
+
+    gtk_text_buffer_get_bounds (buffer, &start, &end);
+
+    return gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+}
+
+static void
+insert_text_cb (GtkTextBuffer *buffer,
+                GtkTextIter   *location,
+                const gchar   *text,
+                gint           len,
+                BufferData    *data)
+{
+    data->first_line = gtk_text_iter_get_line (location);
+
+    g_free (data->removed);
+    data->removed = get_lines (buffer, data->first_line, data->first_line);
+}
+
+static void
+insert_text_after_cb (GtkTextBuffer *buffer,
+                      GtkTextIter   *location,
+                      const gchar   *text,
+                      gint           len,
+                      BufferData    *data)
+{
+    gchar *added;
+
+    /* location now points at the end of the inserted text */
+    added = get_lines (buffer, data->first_line, gtk_text_iter_get_line (location));
+
+    queue_job (data->index, data->removed, added, FALSE);
+    data->removed = NULL;
+}
+
+static void
+delete_range_cb (GtkTextBuffer *buffer,
+                 GtkTextIter   *start,
+                 GtkTextIter   *end,
+                 BufferData    *data)
+{
+    data->first_line = gtk_text_iter_get_line (start);
+
+    g_free (data->removed);
+    data->removed = get_lines (buffer, data->first_line, gtk_text_iter_get_line (end));
+}
+
+static void
+delete_range_after_cb (GtkTextBuffer *buffer,
+                       GtkTextIter   *start,
+                       GtkTextIter   *end,
+                       BufferData    *data)
+{
+    gchar *added;
+
+    added = get_lines (buffer, data->first_line, data->first_line);
+
+    queue_job (data->index, data->removed, added, FALSE);
+    data->removed = NULL;
+}
+
+static gchar *
+get_dictionary_filename (const gchar *language_id)
+{
+    gchar *basename;
+    gchar *filename;
+
+    basename = g_strconcat (language_id, ".dict", NULL);
+    filename = g_build_filename (xed_dirs_get_user_cache_dir (), "wordcompletion", basename, NULL);
+    g_free (basename);
+
+    return filename;
+}
+
+/* Checks the whole file once, so that it can be read without checks */
+static gboolean
+dictionary_is_valid (const gchar *contents,
+                     gsize        length)
+{
+    const DictionaryHeader *header = (const DictionaryHeader *) contents;
+    const DictionaryEntry *entries;
+    gsize entries_size;
+    guint i;
+
+    if (length < sizeof (DictionaryHeader) ||
+        header->magic != DICTIONARY_MAGIC ||
+        header->version != DICTIONARY_VERSION)
+    {
+        return FALSE;
+    }
+
+    entries_size = (gsize) header->n_words * sizeof (DictionaryEntry);
+
+    if (length != sizeof (DictionaryHeader) + entries_size + header->words_size ||
+        (header->n_words > 0 && contents[length - 1] != '\0'))
+    {
+        return FALSE;
+    }
+
+    entries = (const DictionaryEntry *) (contents + sizeof (DictionaryHeader));
+
+    for (i = 0; i < header->n_words; i++)
+    {
+        if (entries[i].offset >= header->words_size)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static void
+load_dictionary (XedWordCompletionIndex *index)
+{
+    gchar *filename;
+    const gchar *contents;
+    gsize length;
+    const DictionaryHeader *header;
+
+    filename = get_dictionary_filename (index->language_id);
+    index->mapped = g_mapped_file_new (filename, FALSE, NULL);
+
+    if (index->mapped == NULL)
+    {
+        g_free (filename);
+        return;
+    }
+
+    contents = g_mapped_file_get_contents (index->mapped);
+    length = g_mapped_file_get_length (index->mapped);
+
+    if (!dictionary_is_valid (contents, length))
+    {
+        xed_debug_message (DEBUG_PLUGINS, "Ignoring the invalid dictionary %s", filename);
+
+        g_mapped_file_unref (index->mapped);
+        index->mapped = NULL;
+        g_free (filename);
+        return;
+    }
+
+    header = (const DictionaryHeader *) contents;
+    index->n_dictionary_words = header->n_words;
+    index->dictionary = (const DictionaryEntry *) (contents + sizeof (DictionaryHeader));
+    index->dictionary_words = (const gchar *) (index->dictionary + header->n_words);
+
+    xed_debug_message (DEBUG_PLUGINS, "Mapped %u words from %s", index->n_dictionary_words, filename);
+
+    g_free (filename);
+}
+
+static const gchar *
+get_dictionary_word (XedWordCompletionIndex *index,
+                     guint                   i)
+{
+    return index->dictionary_words + index->dictionary[i].offset;
+}
+
+static guint
+dictionary_lower_bound (XedWordCompletionIndex *index,
+                        const gchar            *word)
+{
+    guint low = 0;
+    guint high = index->n_dictionary_words;
+
+    while (low < high)
+    {
+        guint middle = low + (high - low) / 2;
+
+        if (strcmp (get_dictionary_word (index, middle), word) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static gint
+compare_candidate_counts (Candidate *a,
+                          Candidate *b)
+{
+    if (a->count != b->count)
+    {
+        return a->count > b->count ? -1 : 1;
+    }
+
+    return strcmp (a->word, b->word);
+}
+
+static gint
+compare_candidate_words (Candidate *a,
+                         Candidate *b)
+{
+    return strcmp (a->word, b->word);
+}
+
+/* Merges the words of this session with the ones of the dictionary,
+ * under the index lock */
+static GArray *
+get_dictionary_candidates (XedWordCompletionIndex *index)
+{
+    GArray *candidates;
+    gsize size = 0;
+    guint i = 0;
+    guint j = 0;
+
+    candidates = g_array_sized_new (FALSE, FALSE, sizeof (Candidate), index->sorted->len + index->n_dictionary_words);
+
+    while (i < index->sorted->len || j < index->n_dictionary_words)
+    {
+        WordEntry *entry = i < index->sorted->len ? g_ptr_array_index (index->sorted, i) : NULL;
+        Candidate candidate = { NULL, 0, 0 };
+        gint cmp;
+
+        if (entry == NULL)
+        {
+            cmp = 1;
+        }
+        else if (j == index->n_dictionary_words)
+        {
+            cmp = -1;
+        }
+        else
+        {
+            cmp = strcmp (entry->word, get_dictionary_word (index, j));
+        }
+
+        if (cmp >= 0)
+        {
+            candidate.word = get_dictionary_word (index, j);
+            candidate.count = index->dictionary[j++].count / 2;
+        }
+
+        /* A word seen once and gone since is most likely the start of a
+         * longer one, left while it was typed */
+        if (cmp <= 0)
+        {
+            candidate.word = entry->word;
+            i++;
+
+            if (entry->count > 0 || entry->peak >= 2)
+            {
+                candidate.count += entry->peak;
+            }
+        }
+
+        if (candidate.count > 0)
+        {
+            g_array_append_val (candidates, candidate);
+            size += sizeof (DictionaryEntry) + strlen (candidate.word) + 1;
+        }
+    }
+
+    if (size > MAX_DICTIONARY_SIZE)
+    {
+        g_array_sort (candidates, (GCompareFunc) compare_candidate_counts);
+
+        size = sizeof (DictionaryHeader);
+
+        for (i = 0; i < candidates->len; i++)
+        {
+            Candidate *candidate = &g_array_index (candidates, Candidate, i);
+
+            size += sizeof (DictionaryEntry) + strlen (candidate->word) + 1;
+
+            if (size > MAX_DICTIONARY_SIZE)
+            {
+                break;
+            }
+        }
+
+        g_array_set_size (candidates, i);
+        g_array_sort (candidates, (GCompareFunc) compare_candidate_words);
+    }
+
+    return candidates;
+}
+
+static void
+save_dictionary (XedWordCompletionIndex *index)
+{
+    GArray *candidates;
+    DictionaryHeader header;
+    GString *entries;
+    GString *words;
+    gchar *filename;
+    gchar *dirname;
+    GError *error = NULL;
+    guint i;
+
+    g_mutex_lock (&index->lock);
+
+    candidates = get_dictionary_candidates (index);
+
+    entries = g_string_sized_new (sizeof (DictionaryHeader) + candidates->len * sizeof (DictionaryEntry));
+    words = g_string_new (NULL);
+
+    header.magic = DICTIONARY_MAGIC;
+    header.version = DICTIONARY_VERSION;
+    header.n_words = candidates->len;
+    g_string_append_len (entries, (const gchar *) &header, sizeof (header));
+
+    for (i = 0; i < candidates->len; i++)
+    {
+        Candidate *candidate = &g_array_index (candidates, Candidate, i);
+        DictionaryEntry entry;
+
+        entry.offset = words->len;
+        entry.count = candidate->count;
+        g_string_append_len (entries, (const gchar *) &entry, sizeof (entry));
+
+        /* with its nul byte */
+        g_string_append_len (words, candidate->word, strlen (candidate->word) + 1);
+    }
+
+    g_mutex_unlock (&index->lock);
+
+    ((DictionaryHeader *) entries->str)->words_size = words->len;
+    g_string_append_len (entries, words->str, words->len);
+
+    filename = get_dictionary_filename (index->language_id);
+    dirname = g_path_get_dirname (filename);
+
+    if (g_mkdir_with_parents (dirname, 0755) != 0 ||
+        !g_file_set_contents (filename, entries->str, entries->len, &error))
+    {
+        g_warning ("Could not save the word completion dictionary %s: %s",
+                   filename,
+                   error != NULL ? error->message : g_strerror (errno));
+        g_clear_error (&error);
+    }
+
+    g_free (dirname);
+    g_free (filename);
+    g_array_free (candidates, TRUE);
+    g_string_free (words, TRUE);
+    g_string_free (entries, TRUE);
+}
+
+static void
+index_free (XedWordCompletionIndex *index)
+{
+    if (index->mapped != NULL)
+    {
+        g_mapped_file_unref (index->mapped);
+    }
+
+    g_ptr_array_free (index->sorted, TRUE);
+    g_hash_table_destroy (index->words);
+    g_mutex_clear (&index->lock);
+    g_free (index->language_id);
+
+    g_slice_free (XedWordCompletionIndex, index);
+}
+
+/* Writing the file syncs it to the disk, which is too slow for the main
+ * thread */
+static void
+save_and_free (XedWordCompletionIndex *index)
+{
+    save_dictionary (index);
+    index_free (index);
+
+    g_mutex_lock (&saves_lock);
+    n_saves--;
+    g_cond_broadcast (&saves_cond);
+    g_mutex_unlock (&saves_lock);
+}
+
+static void
+wait_for_saves (void)
+{
+    g_mutex_lock (&saves_lock);
+
+    while (n_saves > 0)
+    {
+        g_cond_wait (&saves_cond, &saves_lock);
+    }
+
+    g_mutex_unlock (&saves_lock);
+}
+
+static void
+app_shutdown_cb (GApplication *app,
+                 gpointer      user_data)
+{
+    wait_for_saves ();
+}
+
+static const gchar *
+get_buffer_language_id (GtkTextBuffer *buffer)
+{
+    GtkSourceLanguage *language = NULL;
+
+    if (GTK_SOURCE_IS_BUFFER (buffer))
+    {
+        language = gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (buffer));
+    }
+
+    return language != NULL ? gtk_source_language_get_id (language) : PLAIN_TEXT_ID;
+}
+
+static void
+language_changed_cb (GtkTextBuffer *buffer,
+                     GParamSpec    *pspec,
+                     BufferData    *data)
+{
+    XedWordCompletionIndex *index;
+
+    index = xed_wordcompletion_index_get_for_language (get_buffer_language_id (buffer));
+
+    if (index == data->index)
+    {
+        xed_wordcompletion_index_unref (index);
+        return;
+    }
+
+    /* The words move to the dictionary of the new language. A document
+     * is indexed as plain text while it loads, and only gets its language
+     * at the end, so they must not stay in the old one */
+    queue_job (data->index, get_all_text (buffer), NULL, TRUE);
+    xed_wordcompletion_index_unref (data->index);
+
+    data->index = index;
+    queue_job (data->index, NULL, get_all_text (buffer), FALSE);
+}
+
+static void
+buffer_data_free (BufferData *data)
+{
+    xed_wordcompletion_index_unref (data->index);
+    g_free (data->removed);
+    g_slice_free (BufferData, data);
+}
+
+/**
+ * xed_wordcompletion_index_get_for_language:
+ * @language_id: the id of a #GtkSourceLanguage, or "plain"
+ *
+ * Gets the index of the words written in a language, shared by all the
+ * windows. Its words of the previous sessions are mapped in memory.
+ *
+ * Returns: (transfer full): the index
+ */
+XedWordCompletionIndex *
+xed_wordcompletion_index_get_for_language (const gchar *language_id)
+{
+    XedWordCompletionIndex *index;
+
+    g_return_val_if_fail (language_id != NULL, NULL);
+
+    if (indexes == NULL)
+    {
+        GApplication *app = g_application_get_default ();
+
+        indexes = g_hash_table_new (g_str_hash, g_str_equal);
+
+        if (app != NULL)
+        {
+            g_signal_connect (app, "shutdown", G_CALLBACK (app_shutdown_cb), NULL);
+        }
+    }
+
+    index = g_hash_table_lookup (indexes, language_id);
+
+    if (index != NULL)
+    {
+        return xed_wordcompletion_index_ref (index);
+    }
+
+    index = g_slice_new0 (XedWordCompletionIndex);
+    index->ref_count = 1;
+    index->language_id = g_strdup (language_id);
+
+    g_mutex_init (&index->lock);
+    index->words = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) word_entry_free);
+    index->sorted = g_ptr_array_new ();
+
+    /* The dictionary may still be written by an index of the same
+     * language freed just before */
+    wait_for_saves ();
+    load_dictionary (index);
+
+    /* One thread, for the changes to be applied in the order made */
+    index->pool = g_thread_pool_new ((GFunc) index_job_run, index, 1, FALSE, NULL);
+
+    g_hash_table_insert (indexes, index->language_id, index);
+
+    return index;
+}
+
+/**
+ * xed_wordcompletion_index_get_for_buffer:
+ * @buffer: a #GtkTextBuffer
+ *
+ * Returns: (transfer none) (nullable): the index @buffer was added to, for
+ * its language
+ */
+XedWordCompletionIndex *
+xed_wordcompletion_index_get_for_buffer (GtkTextBuffer *buffer)
+{
+    BufferData *data;
+
+    g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+    data = g_object_get_data (G_OBJECT (buffer), BUFFER_DATA_KEY);
+
+    return data != NULL ? data->index : NULL;
+}
+
+XedWordCompletionIndex *
+xed_wordcompletion_index_ref (XedWordCompletionIndex *index)
+{
+    g_return_val_if_fail (index != NULL, NULL);
+
+    index->ref_count++;
+
+    return index;
+}
+
+void
+xed_wordcompletion_index_unref (XedWordCompletionIndex *index)
+{
+    IndexJob *job;
+
+    g_return_if_fail (index != NULL);
+
+    if (--index->ref_count > 0)
+    {
+        return;
+    }
+
+    g_hash_table_remove (indexes, index->language_id);
+
+    g_mutex_lock (&saves_lock);
+    n_saves++;
+    g_mutex_unlock (&saves_lock);
+
+    /* The jobs still queued raise the peaks the dictionary keeps, so the
+     * worker runs them all before saving. The pool goes away by itself
+     * once it is done */
+    job = g_slice_new0 (IndexJob);
+    job->save = TRUE;
+    g_thread_pool_push (index->pool, job, NULL);
+
+    g_thread_pool_free (index->pool, FALSE, FALSE);
+}
+
+/**
+ * xed_wordcompletion_index_add_buffer:
+ * @buffer: a #GtkTextBuffer
+ *
+ * Adds the words of @buffer to the index of its language, and keeps them
+ * up to date until @buffer is removed as many times as it was added.
+ */
+void
+xed_wordcompletion_index_add_buffer (GtkTextBuffer *buffer)
+{
+    BufferData *data;
+
+    g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+    data = g_object_get_data (G_OBJECT (buffer), BUFFER_DATA_KEY);
+
+    if (data != NULL)
+    {
+        data->n_registrations++;
+        return;
+    }
+
+    xed_debug (DEBUG_PLUGINS);
+
+    data = g_slice_new0 (BufferData);
+    data->index = xed_wordcompletion_index_get_for_language (get_buffer_language_id (buffer));
+    data->n_registrations = 1;
+
+    g_signal_connect (buffer, "insert-text", G_CALLBACK (insert_text_cb), data);
+    g_signal_connect_after (buffer, "insert-text", G_CALLBACK (insert_text_after_cb), data);
+    g_signal_connect (buffer, "delete-range", G_CALLBACK (delete_range_cb), data);
+    g_signal_connect_after (buffer, "delete-range", G_CALLBACK (delete_range_after_cb), data);
+
+    if (GTK_SOURCE_IS_BUFFER (buffer))
+    {
+        g_signal_connect (buffer, "notify::language", G_CALLBACK (language_changed_cb), data);
+    }
+
+    g_object_set_data_full (G_OBJECT (buffer), BUFFER_DATA_KEY, data, (GDestroyNotify) buffer_data_free);
+
+    queue_job (data->index, NULL, get_all_text (buffer), FALSE);
+}
+
+void
+xed_wordcompletion_index_remove_buffer (GtkTextBuffer *buffer)
+{
+    BufferData *data;
+
+    g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+    data = g_object_get_data (G_OBJECT (buffer), BUFFER_DATA_KEY);
+
+    if (data == NULL || --data->n_registrations > 0)
+    {
+        return;
+    }
+
+    xed_debug (DEBUG_PLUGINS);
+
+    g_signal_handlers_disconnect_by_data (buffer, data);
+    queue_job (data->index, get_all_text (buffer), NULL, FALSE);
+
+    g_object_set_data (G_OBJECT (buffer), BUFFER_DATA_KEY, NULL);
+}
+
+/* The most used words first, and among the words used about as often, the
+ * most recent */
+static gint
+compare_rank (Candidate *a,
+              Candidate *b)
+{
+    guint rank_a = g_bit_storage (a->count);
+    guint rank_b = g_bit_storage (b->count);
+
+    if (rank_a != rank_b)
+    {
+        return rank_a > rank_b ? -1 : 1;
+    }
+
+    if (a->stamp != b->stamp)
+    {
+        return a->stamp > b->stamp ? -1 : 1;
+    }
+
+    return strcmp (a->word, b->word);
+}
+
+/**
+ * xed_wordcompletion_index_query:
+ * @index: a #XedWordCompletionIndex
+ * @prefix: the start of the words
+ * @max_results: the most words to return
+ *
+ * Finds the words longer than @prefix starting with it, among the words
+ * indexed yet and the ones of the previous sessions.
+ *
+ * Returns: (transfer full) (element-type utf8): the words, best first
+ */
+GPtrArray *
+xed_wordcompletion_index_query (XedWordCompletionIndex *index,
+                                const gchar            *prefix,
+                                guint                   max_results)
+{
+    GArray *matches;
+    GPtrArray *results;
+    gsize prefix_length;
+    guint i;
+    guint j;
+
+    g_return_val_if_fail (index != NULL, NULL);
+    g_return_val_if_fail (prefix != NULL, NULL);
+
+    prefix_length = strlen (prefix);
+    matches = g_array_new (FALSE, FALSE, sizeof (Candidate));
+    results = g_ptr_array_new_with_free_func (g_free);
+
+    g_mutex_lock (&index->lock);
+
+    i = lower_bound (index->sorted, prefix);
+    j = dictionary_lower_bound (index, prefix);
+
+    /* Both are sorted the same way, a word in both is counted once */
+    while (TRUE)
+    {
+        WordEntry *entry = NULL;
+        const gchar *saved = NULL;
+        Candidate candidate = { NULL, 0, 0 };
+        gint cmp;
+
+        if (i < index->sorted->len)
+        {
+            entry = g_ptr_array_index (index->sorted, i);
+
+            if (strncmp (entry->word, prefix, prefix_length) != 0)
+            {
+                entry = NULL;
+            }
+        }
+
+        if (j < index->n_dictionary_words)
+        {
+            saved = get_dictionary_word (index, j);
+
+            if (strncmp (saved, prefix, prefix_length) != 0)
+            {
+                saved = NULL;
+            }
+        }
+
+        if (entry == NULL && saved == NULL)
+        {
+            break;
+        }
+
+        cmp = entry == NULL ? 1 : saved == NULL ? -1 : strcmp (entry->word, saved);
+
+        if (cmp >= 0)
+        {
+            candidate.word = saved;
+            candidate.count = index->dictionary[j++].count;
+        }
+
+        /* Only the words in the buffers now, not the ones gone since, such
+         * as the starts of a word left while it was typed */
+        if (cmp <= 0)
+        {
+            candidate.word = entry->word;
+            i++;
+
+            if (entry->count > 0)
+            {
+                candidate.count += entry->count;
+                candidate.stamp = entry->stamp;
+            }
+        }
+
+        if (candidate.count > 0 && candidate.word[prefix_length] != '\0')
+        {
+            g_array_append_val (matches, candidate);
+        }
+    }
+
+    g_array_sort (matches, (GCompareFunc) compare_rank);
+
+    for (i = 0; i < matches->len && i < max_results; i++)
+    {
+        g_ptr_array_add (results, g_strdup (g_array_index (matches, Candidate, i).word));
+    }
+
+    g_mutex_unlock (&index->lock);
+
+    g_array_free (matches, TRUE);
+
+    return results;
+}
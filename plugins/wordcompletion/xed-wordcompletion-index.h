@@ -0,0 +1,49 @@
+/*
+ * xed-wordcompletion-index.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_WORDCOMPLETION_INDEX_H__
+#define __XED_WORDCOMPLETION_INDEX_H__
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+/* The words of all the buffers registered in a language, in every window,
+ * with how often and how recently they were seen. Buffers are indexed on a
+ * worker thread, and then kept up to date from the lines each edit touches.
+ * The words are kept from one session to the next. */
+typedef struct _XedWordCompletionIndex XedWordCompletionIndex;
+
+XedWordCompletionIndex *xed_wordcompletion_index_get_for_language (const gchar            *language_id);
+XedWordCompletionIndex *xed_wordcompletion_index_get_for_buffer   (GtkTextBuffer          *buffer);
+XedWordCompletionIndex *xed_wordcompletion_index_ref              (XedWordCompletionIndex *index);
+void                    xed_wordcompletion_index_unref            (XedWordCompletionIndex *index);
+
+void                    xed_wordcompletion_index_add_buffer       (GtkTextBuffer          *buffer);
+void                    xed_wordcompletion_index_remove_buffer    (GtkTextBuffer          *buffer);
+
+GPtrArray              *xed_wordcompletion_index_query            (XedWordCompletionIndex *index,
+                                                                   const gchar            *prefix,
+                                                                   guint                   max_results);
+
+gboolean                xed_wordcompletion_index_is_word_char     (gunichar                c);
+
+G_END_DECLS
+
+#endif /* __XED_WORDCOMPLETION_INDEX_H__ */
@@ -31,9 +31,10 @@
 #include <xed/xed-view-activatable.h>
 #include <libpeas-gtk/peas-gtk-configurable.h>
 #include <gtksourceview/gtksource.h>
-#include <gtksourceview/completion-providers/words/gtksourcecompletionwords.h>
 
 #include "xed-wordcompletion-plugin.h"
+#include "xed-wordcompletion-index.h"
+#include "xed-wordcompletion-provider.h"
 
 #define WINDOW_PROVIDER "XedWordCompletionPluginProvider"
 
@@ -82,7 +83,8 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedWordCompletionPlugin,
                                                                xed_view_activatable_iface_init)
                                 G_IMPLEMENT_INTERFACE_DYNAMIC (PEAS_GTK_TYPE_CONFIGURABLE,
                                                                peas_gtk_configurable_iface_init)
-                                G_ADD_PRIVATE_DYNAMIC (XedWordCompletionPlugin))
+                                G_ADD_PRIVATE_DYNAMIC (XedWordCompletionPlugin)
+                                _xed_wordcompletion_provider_register_type (type_module);)
 
 static void
 xed_wordcompletion_plugin_init (XedWordCompletionPlugin *plugin)
@@ -178,8 +180,8 @@ xed_wordcompletion_plugin_get_property (GObject    *object,
 }
 
 static void
-update_activation (GtkSourceCompletionWords *provider,
-                   GSettings                *settings)
+update_activation (XedWordCompletionProvider *provider,
+                   GSettings                 *settings)
 {
     GtkSourceCompletionActivation activation;
 
@@ -198,20 +200,20 @@ update_activation (GtkSourceCompletionWords *provider,
 }
 
 static void
-on_interactive_completion_changed_cb (GSettings                *settings,
-                                      gchar                    *key,
-                                      GtkSourceCompletionWords *provider)
+on_interactive_completion_changed_cb (GSettings                 *settings,
+                                      gchar                     *key,
+                                      XedWordCompletionProvider *provider)
 {
     update_activation (provider, settings);
 }
 
-static GtkSourceCompletionWords *
+static XedWordCompletionProvider *
 create_provider (void)
 {
-    GtkSourceCompletionWords *provider;
+    XedWordCompletionProvider *provider;
     GSettings *settings;
 
-    provider = gtk_source_completion_words_new (_("Word completion"), NULL);
+    provider = xed_wordcompletion_provider_new ();
 
     settings = g_settings_new (WORDCOMPLETION_SETTINGS_BASE);
 
@@ -236,7 +238,7 @@ static void
 xed_wordcompletion_window_activate (XedWindowActivatable *activatable)
 {
     XedWordCompletionPluginPrivate *priv;
-    GtkSourceCompletionWords *provider;
+    XedWordCompletionProvider *provider;
 
     xed_debug (DEBUG_PLUGINS);
 
@@ -293,7 +295,7 @@ xed_wordcompletion_view_activate (XedViewActivatable *activatable)
     priv->provider = g_object_ref (provider);
 
     gtk_source_completion_add_provider (completion, provider, NULL);
-    gtk_source_completion_words_register (GTK_SOURCE_COMPLETION_WORDS (provider), buf);
+    xed_wordcompletion_index_add_buffer (buf);
 }
 
 static void
@@ -314,7 +316,7 @@ xed_wordcompletion_view_deactivate (XedViewActivatable *activatable)
                                            priv->provider,
                                            NULL);
 
-    gtk_source_completion_words_unregister (GTK_SOURCE_COMPLETION_WORDS (priv->provider), buf);
+    xed_wordcompletion_index_remove_buffer (buf);
 }
 
 static void
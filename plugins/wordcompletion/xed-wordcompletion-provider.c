@@ -0,0 +1,276 @@
+/*
+ * xed-wordcompletion-provider.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <glib/gi18n-lib.h>
+
+#include "xed-wordcompletion-provider.h"
+
+/* Most proposals shown at once, the best ones come first anyway */
+#define MAX_PROPOSALS 100
+
+#define INTERACTIVE_DELAY 50
+
+struct _XedWordCompletionProviderPrivate
+{
+    GtkSourceCompletionActivation activation;
+    guint minimum_word_size;
+};
+
+enum
+{
+    PROP_0,
+    PROP_ACTIVATION,
+    PROP_MINIMUM_WORD_SIZE
+};
+
+static void xed_wordcompletion_provider_iface_init (GtkSourceCompletionProviderIface *iface);
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (XedWordCompletionProvider,
+                                xed_wordcompletion_provider,
+                                G_TYPE_OBJECT,
+                                0,
+                                G_IMPLEMENT_INTERFACE_DYNAMIC (GTK_SOURCE_TYPE_COMPLETION_PROVIDER,
+                                                               xed_wordcompletion_provider_iface_init)
+                                G_ADD_PRIVATE_DYNAMIC (XedWordCompletionProvider))
+
+static void
+xed_wordcompletion_provider_set_property (GObject      *object,
+                                          guint         prop_id,
+                                          const GValue *value,
+                                          GParamSpec   *pspec)
+{
+    XedWordCompletionProvider *provider = XED_WORDCOMPLETION_PROVIDER (object);
+
+    switch (prop_id)
+    {
+        case PROP_ACTIVATION:
+            provider->priv->activation = g_value_get_flags (value);
+            break;
+        case PROP_MINIMUM_WORD_SIZE:
+            provider->priv->minimum_word_size = g_value_get_uint (value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void
+xed_wordcompletion_provider_get_property (GObject    *object,
+                                          guint       prop_id,
+                                          GValue     *value,
+                                          GParamSpec *pspec)
+{
+    XedWordCompletionProvider *provider = XED_WORDCOMPLETION_PROVIDER (object);
+
+    switch (prop_id)
+    {
+        case PROP_ACTIVATION:
+            g_value_set_flags (value, provider->priv->activation);
+            break;
+        case PROP_MINIMUM_WORD_SIZE:
+            g_value_set_uint (value, provider->priv->minimum_word_size);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void
+xed_wordcompletion_provider_class_init (XedWordCompletionProviderClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->set_property = xed_wordcompletion_provider_set_property;
+    object_class->get_property = xed_wordcompletion_provider_get_property;
+
+    g_object_class_install_property (object_class, PROP_ACTIVATION,
+                                     g_param_spec_flags ("activation",
+                                                         "Activation",
+                                                         "The type of activation",
+                                                         GTK_SOURCE_TYPE_COMPLETION_ACTIVATION,
+                                                         GTK_SOURCE_COMPLETION_ACTIVATION_INTERACTIVE |
+                                                         GTK_SOURCE_COMPLETION_ACTIVATION_USER_REQUESTED,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+
+    g_object_class_install_property (object_class, PROP_MINIMUM_WORD_SIZE,
+                                     g_param_spec_uint ("minimum-word-size",
+                                                        "Minimum Word Size",
+                                                        "The minimum word size to complete",
+                                                        2,
+                                                        G_MAXUINT,
+                                                        2,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS));
+}
+
+static void
+xed_wordcompletion_provider_class_finalize (XedWordCompletionProviderClass *klass)
+{
+}
+
+static void
+xed_wordcompletion_provider_init (XedWordCompletionProvider *provider)
+{
+    provider->priv = xed_wordcompletion_provider_get_instance_private (provider);
+
+    provider->priv->activation = GTK_SOURCE_COMPLETION_ACTIVATION_INTERACTIVE |
+                                 GTK_SOURCE_COMPLETION_ACTIVATION_USER_REQUESTED;
+    provider->priv->minimum_word_size = 2;
+}
+
+/* Moves @start back to the start of the word ending at @end */
+static void
+get_word_start (const GtkTextIter *end,
+                GtkTextIter       *start)
+{
+    *start = *end;
+
+    while (gtk_text_iter_backward_char (start))
+    {
+        if (!xed_wordcompletion_index_is_word_char (gtk_text_iter_get_char (start)))
+        {
+            gtk_text_iter_forward_char (start);
+            break;
+        }
+    }
+}
+
+static gchar *
+provider_get_name (GtkSourceCompletionProvider *provider)
+{
+    return g_strdup (_("Word completion"));
+}
+
+static void
+provider_populate (GtkSourceCompletionProvider *completion_provider,
+                   GtkSourceCompletionContext  *context)
+{
+    XedWordCompletionProvider *provider = XED_WORDCOMPLETION_PROVIDER (completion_provider);
+    XedWordCompletionIndex *index;
+    GtkTextIter start;
+    GtkTextIter end;
+    gchar *prefix;
+    GPtrArray *words;
+    GList *proposals = NULL;
+    gint i;
+
+    if (!gtk_source_completion_context_get_iter (context, &end))
+    {
+        gtk_source_completion_context_add_proposals (context, completion_provider, NULL, TRUE);
+        return;
+    }
+
+    /* The words written in the language of the buffer */
+    index = xed_wordcompletion_index_get_for_buffer (gtk_text_iter_get_buffer (&end));
+
+    if (index == NULL)
+    {
+        gtk_source_completion_context_add_proposals (context, completion_provider, NULL, TRUE);
+        return;
+    }
+
+    get_word_start (&end, &start);
+    prefix = gtk_text_iter_get_slice (&start, &end);
+
+    if (*prefix == '\0' ||
+        (gtk_source_completion_context_get_activation (context) == GTK_SOURCE_COMPLETION_ACTIVATION_INTERACTIVE &&
+         g_utf8_strlen (prefix, -1) < provider->priv->minimum_word_size))
+    {
+        gtk_source_completion_context_add_proposals (context, completion_provider, NULL, TRUE);
+        g_free (prefix);
+        return;
+    }
+
+    /* The index answers from memory, no need to populate in chunks */
+    words = xed_wordcompletion_index_query (index, prefix, MAX_PROPOSALS);
+
+    for (i = words->len - 1; i >= 0; i--)
+    {
+        const gchar *word = g_ptr_array_index (words, i);
+        GtkSourceCompletionItem *item;
+
+        item = gtk_source_completion_item_new ();
+        gtk_source_completion_item_set_label (item, word);
+        gtk_source_completion_item_set_text (item, word);
+
+        proposals = g_list_prepend (proposals, item);
+    }
+
+    gtk_source_completion_context_add_proposals (context, completion_provider, proposals, TRUE);
+
+    g_list_free_full (proposals, g_object_unref);
+    g_ptr_array_unref (words);
+    g_free (prefix);
+}
+
+static GtkSourceCompletionActivation
+provider_get_activation (GtkSourceCompletionProvider *provider)
+{
+    return XED_WORDCOMPLETION_PROVIDER (provider)->priv->activation;
+}
+
+static gboolean
+provider_get_start_iter (GtkSourceCompletionProvider *provider,
+                         GtkSourceCompletionContext  *context,
+                         GtkSourceCompletionProposal *proposal,
+                         GtkTextIter                 *iter)
+{
+    GtkTextIter end;
+
+    if (!gtk_source_completion_context_get_iter (context, &end))
+    {
+        return FALSE;
+    }
+
+    get_word_start (&end, iter);
+
+    return TRUE;
+}
+
+static gint
+provider_get_interactive_delay (GtkSourceCompletionProvider *provider)
+{
+    return INTERACTIVE_DELAY;
+}
+
+static void
+xed_wordcompletion_provider_iface_init (GtkSourceCompletionProviderIface *iface)
+{
+    iface->get_name = provider_get_name;
+    iface->populate = provider_populate;
+    iface->get_activation = provider_get_activation;
+    iface->get_start_iter = provider_get_start_iter;
+    iface->get_interactive_delay = provider_get_interactive_delay;
+}
+
+void
+_xed_wordcompletion_provider_register_type (GTypeModule *type_module)
+{
+    xed_wordcompletion_provider_register_type (type_module);
+}
+
+XedWordCompletionProvider *
+xed_wordcompletion_provider_new (void)
+{
+    return g_object_new (XED_TYPE_WORDCOMPLETION_PROVIDER, NULL);
+}
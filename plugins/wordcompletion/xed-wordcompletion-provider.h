@@ -0,0 +1,59 @@
+/*
+ * xed-wordcompletion-provider.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_WORDCOMPLETION_PROVIDER_H__
+#define __XED_WORDCOMPLETION_PROVIDER_H__
+
+#include <gtksourceview/gtksource.h>
+
+#include "xed-wordcompletion-index.h"
+
+G_BEGIN_DECLS
+
+#define XED_TYPE_WORDCOMPLETION_PROVIDER            (xed_wordcompletion_provider_get_type ())
+#define XED_WORDCOMPLETION_PROVIDER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), XED_TYPE_WORDCOMPLETION_PROVIDER, XedWordCompletionProvider))
+#define XED_WORDCOMPLETION_PROVIDER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), XED_TYPE_WORDCOMPLETION_PROVIDER, XedWordCompletionProviderClass))
+#define XED_IS_WORDCOMPLETION_PROVIDER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XED_TYPE_WORDCOMPLETION_PROVIDER))
+#define XED_IS_WORDCOMPLETION_PROVIDER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), XED_TYPE_WORDCOMPLETION_PROVIDER))
+#define XED_WORDCOMPLETION_PROVIDER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), XED_TYPE_WORDCOMPLETION_PROVIDER, XedWordCompletionProviderClass))
+
+typedef struct _XedWordCompletionProvider        XedWordCompletionProvider;
+typedef struct _XedWordCompletionProviderClass   XedWordCompletionProviderClass;
+typedef struct _XedWordCompletionProviderPrivate XedWordCompletionProviderPrivate;
+
+struct _XedWordCompletionProvider
+{
+    GObject parent;
+
+    XedWordCompletionProviderPrivate *priv;
+};
+
+struct _XedWordCompletionProviderClass
+{
+    GObjectClass parent_class;
+};
+
+GType                      xed_wordcompletion_provider_get_type       (void) G_GNUC_CONST;
+void                       _xed_wordcompletion_provider_register_type (GTypeModule            *type_module);
+
+XedWordCompletionProvider *xed_wordcompletion_provider_new            (void);
+
+G_END_DECLS
+
+#endif /* __XED_WORDCOMPLETION_PROVIDER_H__ */
@@ -55,6 +55,7 @@
 #include "xed-app-activatable.h"
 #include "xed-plugins-engine.h"
 #include "xed-settings.h"
+#include "xed-trace.h"
 
 #ifndef ENABLE_GVFS_METADATA
 #include "xed-metadata-manager.h"
@@ -198,7 +199,9 @@ extension_added (PeasExtensionSet *extensions,
                  PeasExtension    *exten,
                  XedApp           *app)
 {
+    xed_trace_begin ("app-plugins", peas_plugin_info_get_module_name (info));
     peas_extension_call (exten, "activate");
+    xed_trace_end ("app-plugins", peas_plugin_info_get_module_name (info));
 }
 
 static void
@@ -299,14 +302,22 @@ xed_app_startup (GApplication *application)
     GFile *css_file;
     GtkCssProvider *provider;
 
+    xed_trace_init ();
+    xed_trace_begin ("startup", "startup");
+
     G_APPLICATION_CLASS (xed_app_parent_class)->startup (application);
+
+    xed_trace_begin ("startup", "accels");
     load_accels ();
+    xed_trace_end ("startup", "accels");
 
     /* Setup debugging */
     xed_debug_init ();
     xed_debug_message (DEBUG_APP, "Startup");
     xed_debug_message (DEBUG_APP, "Set icon");
 
+    xed_trace_begin ("startup", "theme");
+
     dir = xed_dirs_get_xed_data_dir ();
     icon_dir = g_build_filename (dir, "icons", NULL);
 
@@ -315,7 +326,11 @@ xed_app_startup (GApplication *application)
 
     setup_theme_extensions ();
 
+    xed_trace_end ("startup", "theme");
+
 #ifndef ENABLE_GVFS_METADATA
+    xed_trace_begin ("startup", "metadata");
+
     /* Setup metadata-manager */
     cache_dir = xed_dirs_get_user_cache_dir ();
 
@@ -324,15 +339,27 @@ xed_app_startup (GApplication *application)
     xed_metadata_manager_init (metadata_filename);
 
     g_free (metadata_filename);
+
+    xed_trace_end ("startup", "metadata");
 #endif
 
+    xed_trace_begin ("startup", "settings");
+
     /* Load settings */
     app->priv->settings = xed_settings_new ();
     app->priv->window_settings = g_settings_new ("org.x.editor.state.window");
     app->priv->editor_settings = g_settings_new ("org.x.editor.preferences.editor");
 
+#ifndef ENABLE_GVFS_METADATA
+    xed_metadata_manager_set_max_items (g_settings_get_uint (app->priv->editor_settings,
+                                                             XED_SETTINGS_MAX_METADATA_ITEMS));
+#endif
+
     set_initial_theme_style (app);
 
+    xed_trace_end ("startup", "settings");
+    xed_trace_begin ("startup", "css");
+
     /* Load custom css */
     css_file = g_file_new_for_uri ("resource:///org/x/editor/css/xed-style.css");
     provider = gtk_css_provider_new ();
@@ -350,6 +377,9 @@ xed_app_startup (GApplication *application)
 
     g_object_unref (css_file);
 
+    xed_trace_end ("startup", "css");
+    xed_trace_begin ("startup", "style-schemes");
+
     /*
      * We use the default gtksourceview style scheme manager so that plugins
      * can obtain it easily without a xed specific api, but we need to
@@ -358,7 +388,13 @@ xed_app_startup (GApplication *application)
     manager = gtk_source_style_scheme_manager_get_default ();
     gtk_source_style_scheme_manager_append_search_path (manager, xed_dirs_get_user_styles_dir ());
 
+    xed_trace_end ("startup", "style-schemes");
+
+    xed_trace_begin ("startup", "plugins-engine");
     app->priv->engine = xed_plugins_engine_get_default ();
+    xed_trace_end ("startup", "plugins-engine");
+
+    xed_trace_begin ("startup", "app-plugins");
     app->priv->extensions = peas_extension_set_new (PEAS_ENGINE (app->priv->engine),
                                                     XED_TYPE_APP_ACTIVATABLE,
                                                     "app", app,
@@ -373,6 +409,9 @@ xed_app_startup (GApplication *application)
     peas_extension_set_foreach (app->priv->extensions,
                                 (PeasExtensionSetForeachFunc) extension_added,
                                 app);
+
+    xed_trace_end ("startup", "app-plugins");
+    xed_trace_end ("startup", "startup");
 }
 
 static gboolean
@@ -893,6 +932,8 @@ xed_app_shutdown (GApplication *app)
 #endif
 
     xed_dirs_shutdown ();
+
+    xed_trace_shutdown ();
 }
 
 static void
@@ -1045,6 +1086,35 @@ gen_role (void)
                             g_get_host_name ());
 }
 
+/* Once a window is drawn, the end of a cold start for the first one, the
+ * plugins which could wait are loaded */
+static gboolean
+window_draw_cb (GtkWidget *window,
+                cairo_t   *cr,
+                XedApp    *app)
+{
+    xed_trace_mark ("window", "first-draw");
+
+    g_signal_handlers_disconnect_by_func (window, window_draw_cb, app);
+
+    xed_plugins_engine_start_deferred (app->priv->engine);
+
+    return FALSE;
+}
+
+/* The first key or click loads the plugins waiting to be used */
+static gboolean
+window_input_cb (GtkWidget *window,
+                 GdkEvent  *event,
+                 XedApp    *app)
+{
+    g_signal_handlers_disconnect_by_func (window, window_input_cb, app);
+
+    xed_plugins_engine_load_on_demand (app->priv->engine, NULL);
+
+    return FALSE;
+}
+
 static XedWindow *
 xed_app_create_window_real (XedApp      *app,
                             gboolean     set_geometry,
@@ -1052,10 +1122,16 @@ xed_app_create_window_real (XedApp      *app,
 {
     XedWindow *window;
 
+    xed_trace_begin ("window", "create-window");
     window = g_object_new (XED_TYPE_WINDOW, "application", app, NULL);
+    xed_trace_end ("window", "create-window");
 
     xed_debug_message (DEBUG_APP, "Window created");
 
+    g_signal_connect (window, "draw", G_CALLBACK (window_draw_cb), app);
+    g_signal_connect (window, "key-press-event", G_CALLBACK (window_input_cb), app);
+    g_signal_connect (window, "button-press-event", G_CALLBACK (window_input_cb), app);
+
     if (role != NULL)
     {
         gtk_window_set_role (GTK_WINDOW (window), role);
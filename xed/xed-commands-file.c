@@ -65,49 +65,34 @@ _xed_cmd_file_new (GtkAction   *action,
     xed_window_create_tab (window, TRUE);
 }
 
-static XedTab *
-get_tab_from_file (GList *docs,
-                   GFile *file)
+/* Maps the location of every document in the window to its tab, so that
+ * opening many files does not compare each of them with every document */
+static GHashTable *
+get_tabs_by_location (XedWindow *window)
 {
-    XedTab *tab = NULL;
+    GHashTable *tabs;
+    GList *docs;
+    GList *l;
+
+    tabs = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+    docs = xed_window_get_documents (window);
 
-    while (docs != NULL)
+    for (l = docs; l != NULL; l = g_list_next (l))
     {
-        XedDocument *d;
-        GtkSourceFile *source_file;
-        GFile *l;
+        XedDocument *doc = XED_DOCUMENT (l->data);
+        GFile *location;
 
-        d = XED_DOCUMENT (docs->data);
-        source_file = xed_document_get_file (d);
+        location = gtk_source_file_get_location (xed_document_get_file (doc));
 
-        l = gtk_source_file_get_location (source_file);
-        if (l != NULL && g_file_equal (l, file))
+        if (location != NULL && !g_hash_table_contains (tabs, location))
         {
-            tab = xed_tab_get_from_document (d);
-            break;
+            g_hash_table_insert (tabs, location, xed_tab_get_from_document (doc));
         }
-
-        docs = g_list_next (docs);
     }
 
-    return tab;
-}
-
-static gboolean
-is_duplicated_file (GSList *files,
-                    GFile *file)
-{
-    while (files != NULL)
-    {
-        if (g_file_equal (files->data, file))
-        {
-            return TRUE;
-        }
-
-        files = g_slist_next (files);
-    }
+    g_list_free (docs);
 
-    return FALSE;
+    return tabs;
 }
 
 /* File loading */
@@ -121,35 +106,34 @@ load_file_list (XedWindow               *window,
     XedTab *tab;
     GSList *loaded_files = NULL; /* Number of files to load */
     gboolean jump_to = TRUE; /* Whether to jump to the new tab */
-    GList *win_docs;
+    GHashTable *open_tabs;
+    GHashTable *seen;
     GSList *files_to_load = NULL;
     const GSList *l;
     gint num_loaded_files = 0;
 
     xed_debug (DEBUG_COMMANDS);
 
-    win_docs = xed_window_get_documents (window);
+    open_tabs = get_tabs_by_location (window);
+    seen = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
 
     /* Remove the uris corresponding to documents already open
      * in "window" and remove duplicates from "uris" list */
     for (l = files; l != NULL; l = l->next)
     {
-        if (!is_duplicated_file (files_to_load, l->data))
+        if (g_hash_table_add (seen, l->data))
         {
-            tab = get_tab_from_file (win_docs, l->data);
+            tab = g_hash_table_lookup (open_tabs, l->data);
             if (tab != NULL)
             {
                 if (l == files)
                 {
-                    XedDocument *doc;
-
                     xed_window_set_active_tab (window, tab);
                     jump_to = FALSE;
-                    doc = xed_tab_get_document (tab);
 
                     if (line_pos > 0)
                     {
-                        xed_document_goto_line (doc, line_pos - 1);
+                        _xed_tab_goto_line (tab, line_pos - 1, 0);
                         xed_view_scroll_to_cursor (xed_tab_get_view (tab));
                     }
                 }
@@ -164,7 +148,8 @@ load_file_list (XedWindow               *window,
         }
     }
 
-    g_list_free (win_docs);
+    g_hash_table_destroy (open_tabs);
+    g_hash_table_destroy (seen);
 
     if (files_to_load == NULL)
     {
@@ -781,6 +766,16 @@ xed_commands_save_document_async (XedDocument         *document,
 
     tab = xed_tab_get_from_document (document);
 
+    /* Only a window of the lines of a large file is in the buffer */
+    if (_xed_tab_is_large_file (tab))
+    {
+        xed_debug_message (DEBUG_COMMANDS, "Large file, not saved");
+
+        g_task_return_boolean (task, FALSE);
+        g_object_unref (task);
+        return;
+    }
+
     if (xed_document_is_untitled (document) ||
         xed_document_get_readonly (document))
     {
@@ -1061,9 +1056,19 @@ save_documents_list (XedWindow *window,
         g_return_if_fail (state != XED_TAB_STATE_PRINT_PREVIEWING);
         g_return_if_fail (state != XED_TAB_STATE_CLOSING);
 
-        if ((state == XED_TAB_STATE_NORMAL) ||
-            (state == XED_TAB_STATE_SHOWING_PRINT_PREVIEW) ||
-            (state == XED_TAB_STATE_GENERIC_NOT_EDITABLE))
+        /* Tabs not loaded yet or unloaded hold an empty buffer, and their
+         * file is already what they show */
+        if (_xed_document_get_unloaded (doc))
+        {
+            xed_debug_message (DEBUG_COMMANDS, "Unloaded, not saved");
+        }
+        else if (_xed_tab_is_large_file (t))
+        {
+            xed_debug_message (DEBUG_COMMANDS, "Large file, not saved");
+        }
+        else if ((state == XED_TAB_STATE_NORMAL) ||
+                 (state == XED_TAB_STATE_SHOWING_PRINT_PREVIEW) ||
+                 (state == XED_TAB_STATE_GENERIC_NOT_EDITABLE))
         {
             /* FIXME: manage the case of local readonly files owned by the
                user is running xed - Paolo (Dec. 8, 2005) */
@@ -7,9 +7,11 @@
 #include "xed-commands.h"
 #include "xed-debug.h"
 #include "xed-window.h"
+#include "xed-window-private.h"
 #include "xed-utils.h"
 #include "xed-searchbar.h"
 #include "xed-view-frame.h"
+#include "xed-search-results-panel.h"
 
 // void
 // _xed_cmd_search_find (GtkAction *action,
@@ -48,6 +50,35 @@ _xed_cmd_search_find_prev (GtkAction *action,
     xed_searchbar_find_again (XED_SEARCHBAR (xed_window_get_searchbar (window)), TRUE);
 }
 
+void
+_xed_cmd_search_find_in_documents (GtkAction *action,
+                                   XedWindow *window)
+{
+    XedSearchbar *searchbar;
+    const gchar *search_text;
+    GtkWidget *panel;
+    GtkAction *pane_action;
+
+    xed_debug (DEBUG_COMMANDS);
+
+    searchbar = XED_SEARCHBAR (xed_window_get_searchbar (window));
+    search_text = xed_searchbar_get_search_text (searchbar);
+
+    /* Nothing to look for yet */
+    if (search_text == NULL || *search_text == '\0')
+    {
+        xed_searchbar_show (searchbar, XED_SEARCH_MODE_SEARCH);
+        return;
+    }
+
+    panel = _xed_window_get_search_results_panel (window);
+    xed_search_results_panel_find (XED_SEARCH_RESULTS_PANEL (panel), xed_searchbar_get_search_settings (searchbar));
+
+    pane_action = gtk_action_group_get_action (window->priv->panes_action_group, "ViewBottomPane");
+    gtk_toggle_action_set_active (GTK_TOGGLE_ACTION (pane_action), TRUE);
+    xed_panel_activate_item (xed_window_get_bottom_panel (window), panel);
+}
+
 void
 _xed_cmd_search_clear_highlight (XedWindow *window)
 {
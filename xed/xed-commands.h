@@ -61,6 +61,7 @@ void _xed_cmd_search_find (GtkAction *action, XedWindow *window);
 
 void _xed_cmd_search_find_next (GtkAction *action, XedWindow *window);
 void _xed_cmd_search_find_prev (GtkAction *action, XedWindow *window);
+void _xed_cmd_search_find_in_documents (GtkAction *action, XedWindow *window);
 void _xed_cmd_search_replace (GtkAction *action, XedWindow *window);
 void _xed_cmd_search_clear_highlight (XedWindow *window);
 void _xed_cmd_search_goto_line (GtkAction *action, XedWindow *window);
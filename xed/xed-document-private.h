@@ -16,6 +16,22 @@ void         _xed_document_set_create                           (XedDocument
 
 gboolean     _xed_document_get_create                           (XedDocument       *doc);
 
+void         _xed_document_set_stop_cursor_moved_emission       (XedDocument       *doc,
+                                                                 gboolean           stop);
+
+void         _xed_document_set_undo_blocked                     (XedDocument       *doc,
+                                                                 gboolean           blocked);
+
+gboolean     _xed_document_can_undo                             (XedDocument       *doc);
+
+gboolean     _xed_document_can_redo                             (XedDocument       *doc);
+
+void         _xed_document_set_unloaded                         (XedDocument       *doc,
+                                                                 gboolean           unloaded,
+                                                                 gint               position);
+
+gboolean     _xed_document_get_unloaded                         (XedDocument       *doc);
+
 G_END_DECLS
 
 #endif /* __XED_DOCUMENT_PRIVATE_H__ */
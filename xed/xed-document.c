@@ -72,6 +72,12 @@ typedef struct
     guint last_save_was_manually : 1;
     guint language_set_by_user : 1;
     guint stop_cursor_moved_emission : 1;
+    guint undo_blocked : 1;
+
+    /* The text is not in the buffer: the cursor position saved in the
+     * metadata is unloaded_position, or the stored one when it is -1 */
+    guint unloaded : 1;
+    gint unloaded_position;
     guint use_gvfs_metadata : 1;
 
     /* Create file if location points to a non existing file (for example
@@ -156,7 +162,7 @@ save_metadata (XedDocument *doc)
     XedDocumentPrivate *priv;
     const gchar *language = NULL;
     GtkTextIter iter;
-    gchar *position;
+    gchar *position = NULL;
 
     priv = xed_document_get_instance_private (doc);
     if (priv->language_set_by_user)
@@ -164,22 +170,35 @@ save_metadata (XedDocument *doc)
         language = get_language_string (doc);
     }
 
-    gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc),
-                                      &iter,
-                                      gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (doc)));
+    if (!priv->unloaded)
+    {
+        gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc),
+                                          &iter,
+                                          gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (doc)));
 
-    position = g_strdup_printf ("%d", gtk_text_iter_get_offset (&iter));
+        position = g_strdup_printf ("%d", gtk_text_iter_get_offset (&iter));
+    }
+    else if (priv->unloaded_position >= 0)
+    {
+        position = g_strdup_printf ("%d", priv->unloaded_position);
+    }
 
-    if (language == NULL)
+    if (position != NULL && language != NULL)
     {
         xed_document_set_metadata (doc,
                                    XED_METADATA_ATTRIBUTE_POSITION, position,
+                                   XED_METADATA_ATTRIBUTE_LANGUAGE, language,
                                    NULL);
     }
-    else
+    else if (position != NULL)
     {
         xed_document_set_metadata (doc,
                                    XED_METADATA_ATTRIBUTE_POSITION, position,
+                                   NULL);
+    }
+    else if (language != NULL)
+    {
+        xed_document_set_metadata (doc,
                                    XED_METADATA_ATTRIBUTE_LANGUAGE, language,
                                    NULL);
     }
@@ -368,6 +387,32 @@ xed_document_changed (GtkTextBuffer *buffer)
     GTK_TEXT_BUFFER_CLASS (xed_document_parent_class)->changed (buffer);
 }
 
+static void
+xed_document_undo (GtkSourceBuffer *buffer)
+{
+    XedDocumentPrivate *priv;
+
+    priv = xed_document_get_instance_private (XED_DOCUMENT (buffer));
+
+    if (!priv->undo_blocked)
+    {
+        GTK_SOURCE_BUFFER_CLASS (xed_document_parent_class)->undo (buffer);
+    }
+}
+
+static void
+xed_document_redo (GtkSourceBuffer *buffer)
+{
+    XedDocumentPrivate *priv;
+
+    priv = xed_document_get_instance_private (XED_DOCUMENT (buffer));
+
+    if (!priv->undo_blocked)
+    {
+        GTK_SOURCE_BUFFER_CLASS (xed_document_parent_class)->redo (buffer);
+    }
+}
+
 static void
 xed_document_constructed (GObject *object)
 {
@@ -390,6 +435,7 @@ xed_document_class_init (XedDocumentClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
     GtkTextBufferClass *buf_class = GTK_TEXT_BUFFER_CLASS (klass);
+    GtkSourceBufferClass *source_buf_class = GTK_SOURCE_BUFFER_CLASS (klass);
 
     object_class->dispose = xed_document_dispose;
     object_class->finalize = xed_document_finalize;
@@ -402,6 +448,9 @@ xed_document_class_init (XedDocumentClass *klass)
     buf_class->mark_set = xed_document_mark_set;
     buf_class->changed = xed_document_changed;
 
+    source_buf_class->undo = xed_document_undo;
+    source_buf_class->redo = xed_document_redo;
+
     klass->loaded = xed_document_loaded_real;
     klass->saved = xed_document_saved_real;
 
@@ -1695,3 +1744,108 @@ _xed_document_get_create (XedDocument *doc)
 
     return priv->create;
 }
+
+/* Used around a long run of edits, so that the cursor position is not
+ * looked up after each of them. Emits the signal once on the way back. */
+void
+_xed_document_set_stop_cursor_moved_emission (XedDocument *doc,
+                                              gboolean     stop)
+{
+    XedDocumentPrivate *priv;
+
+    g_return_if_fail (XED_IS_DOCUMENT (doc));
+
+    priv = xed_document_get_instance_private (doc);
+
+    if (priv->stop_cursor_moved_emission == (stop != FALSE))
+    {
+        return;
+    }
+
+    priv->stop_cursor_moved_emission = stop != FALSE;
+
+    if (!stop)
+    {
+        emit_cursor_moved (doc);
+    }
+}
+
+/* Used while the document is edited in several steps which must not be
+ * interleaved with an undo, like a replace all run from idles */
+void
+_xed_document_set_undo_blocked (XedDocument *doc,
+                                gboolean     blocked)
+{
+    XedDocumentPrivate *priv;
+
+    g_return_if_fail (XED_IS_DOCUMENT (doc));
+
+    priv = xed_document_get_instance_private (doc);
+
+    if (priv->undo_blocked == (blocked != FALSE))
+    {
+        return;
+    }
+
+    priv->undo_blocked = blocked != FALSE;
+
+    g_object_notify (G_OBJECT (doc), "can-undo");
+    g_object_notify (G_OBJECT (doc), "can-redo");
+}
+
+/* Used by tabs which are not loaded yet or were unloaded, so that closing
+ * them doesn't overwrite the saved cursor position with the one of an
+ * empty buffer. @position is the offset to save instead, or -1 to keep the
+ * saved one. */
+void
+_xed_document_set_unloaded (XedDocument *doc,
+                            gboolean     unloaded,
+                            gint         position)
+{
+    XedDocumentPrivate *priv;
+
+    g_return_if_fail (XED_IS_DOCUMENT (doc));
+
+    priv = xed_document_get_instance_private (doc);
+
+    priv->unloaded = unloaded != FALSE;
+    priv->unloaded_position = unloaded ? position : -1;
+}
+
+/* The buffer of an unloaded document is empty, and must not be saved over
+ * the file */
+gboolean
+_xed_document_get_unloaded (XedDocument *doc)
+{
+    XedDocumentPrivate *priv;
+
+    g_return_val_if_fail (XED_IS_DOCUMENT (doc), FALSE);
+
+    priv = xed_document_get_instance_private (doc);
+
+    return priv->unloaded;
+}
+
+gboolean
+_xed_document_can_undo (XedDocument *doc)
+{
+    XedDocumentPrivate *priv;
+
+    g_return_val_if_fail (XED_IS_DOCUMENT (doc), FALSE);
+
+    priv = xed_document_get_instance_private (doc);
+
+    return !priv->undo_blocked && gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (doc));
+}
+
+gboolean
+_xed_document_can_redo (XedDocument *doc)
+{
+    XedDocumentPrivate *priv;
+
+    g_return_val_if_fail (XED_IS_DOCUMENT (doc), FALSE);
+
+    priv = xed_document_get_instance_private (doc);
+
+    return !priv->undo_blocked && gtk_source_buffer_can_redo (GTK_SOURCE_BUFFER (doc));
+}
@@ -0,0 +1,450 @@
+/*
+ * xed-large-file.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "xed-large-file.h"
+#include "xed-line-index.h"
+#include "xed-utils.h"
+#include "xed-debug.h"
+
+/* Bytes scanned between two looks at the cancellable */
+#define INDEX_CHUNK_SIZE (16 * 1024 * 1024)
+
+/* Most text read at once, so that a file without newlines can be shown */
+#define MAX_TEXT_LENGTH (64 * 1024 * 1024)
+
+/* U+FFFD, shown in place of bytes which are not valid UTF-8 */
+#define REPLACEMENT_CHARACTER "\357\277\275"
+
+struct _XedLargeFile
+{
+    gchar *path;
+
+    /* Kept open to see whether the file shrank since it was mapped */
+    gint fd;
+
+    GMappedFile *mapped;
+    const gchar *data;
+    gsize size;
+
+    XedLineIndex *line_index;
+    guint n_lines;
+
+    /* Per mille of the file and lines indexed, written by the worker */
+    gint progress;
+    gint n_lines_indexed;
+};
+
+XedLargeFile *
+xed_large_file_new (GFile *location)
+{
+    XedLargeFile *file;
+
+    g_return_val_if_fail (G_IS_FILE (location), NULL);
+    g_return_val_if_fail (g_file_is_native (location), NULL);
+
+    file = g_new0 (XedLargeFile, 1);
+    file->path = g_file_get_path (location);
+    file->fd = -1;
+
+    return file;
+}
+
+void
+xed_large_file_free (XedLargeFile *file)
+{
+    if (file == NULL)
+    {
+        return;
+    }
+
+    if (file->mapped != NULL)
+    {
+        g_mapped_file_unref (file->mapped);
+    }
+
+    if (file->fd != -1)
+    {
+        close (file->fd);
+    }
+
+    xed_line_index_free (file->line_index);
+    g_free (file->path);
+    g_free (file);
+}
+
+/**
+ * xed_large_file_should_open:
+ * @location: the file about to be loaded
+ * @threshold: the size in megabytes from which a file is large, 0 if
+ * large files should be loaded like any other
+ *
+ * Returns: %TRUE if @location is a local regular file of at least
+ * @threshold megabytes
+ */
+gboolean
+xed_large_file_should_open (GFile *location,
+                            guint  threshold)
+{
+    GFileInfo *info;
+    gboolean large;
+
+    if (threshold == 0 || !g_file_is_native (location))
+    {
+        return FALSE;
+    }
+
+    info = g_file_query_info (location,
+                              G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                              G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                              G_FILE_QUERY_INFO_NONE,
+                              NULL,
+                              NULL);
+
+    if (info == NULL)
+    {
+        return FALSE;
+    }
+
+    large = (g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR &&
+             g_file_info_get_size (info) >= (goffset) threshold * 1024 * 1024);
+
+    g_object_unref (info);
+
+    return large;
+}
+
+typedef struct
+{
+    XedLargeFile *file;
+    GCancellable *cancellable;
+} IndexLinesData;
+
+static void
+index_lines_mapped (IndexLinesData *data)
+{
+    XedLargeFile *file = data->file;
+    const gchar *end;
+    const gchar *p;
+
+    p = file->data;
+    end = file->data + file->size;
+
+    while (p < end && !g_cancellable_is_cancelled (data->cancellable))
+    {
+        gsize chunk_length;
+
+        chunk_length = MIN ((gsize) (end - p), INDEX_CHUNK_SIZE);
+        xed_line_index_append (file->line_index, p, chunk_length);
+        p += chunk_length;
+
+        g_atomic_int_set (&file->progress, (gint) ((gdouble) (p - file->data) / file->size * 1000));
+        g_atomic_int_set (&file->n_lines_indexed, xed_line_index_get_n_lines (file->line_index));
+    }
+
+    /* Unlike in a text buffer, there is no empty line after the last
+     * newline */
+    file->n_lines = xed_line_index_get_n_lines (file->line_index);
+
+    if (file->size == 0 || file->data[file->size - 1] == '\n')
+    {
+        file->n_lines--;
+    }
+}
+
+/* Returns FALSE if the file shrank while it was being indexed, as with the
+ * copytruncate of logrotate */
+static gboolean
+index_lines (XedLargeFile *file,
+             GCancellable *cancellable)
+{
+    IndexLinesData data;
+
+    data.file = file;
+    data.cancellable = cancellable;
+
+    return xed_utils_read_mapped_guarded ((XedMappedReadFunc) index_lines_mapped, &data);
+}
+
+static void
+load_thread (GTask        *task,
+             gpointer      source_object,
+             XedLargeFile *file,
+             GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    file->fd = g_open (file->path, O_RDONLY, 0);
+
+    if (file->fd == -1)
+    {
+        gint errsv = errno;
+
+        g_task_return_new_error (task, G_IO_ERROR, g_io_error_from_errno (errsv),
+                                 "%s", g_strerror (errsv));
+        return;
+    }
+
+    file->mapped = g_mapped_file_new_from_fd (file->fd, FALSE, &error);
+
+    if (file->mapped == NULL)
+    {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    file->data = g_mapped_file_get_contents (file->mapped);
+    file->size = g_mapped_file_get_length (file->mapped);
+    file->line_index = xed_line_index_new ();
+
+    if (!index_lines (file, cancellable))
+    {
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                 _("The file was truncated while it was being loaded"));
+        return;
+    }
+
+    if (g_task_return_error_if_cancelled (task))
+    {
+        return;
+    }
+
+    xed_debug_message (DEBUG_DOCUMENT, "Indexed %u lines", file->n_lines);
+
+    g_task_return_boolean (task, TRUE);
+}
+
+void
+xed_large_file_load_async (XedLargeFile        *file,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    GTask *task;
+
+    g_return_if_fail (file != NULL);
+    g_return_if_fail (file->mapped == NULL);
+
+    g_atomic_int_set (&file->progress, 0);
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_task_data (task, file, NULL);
+    g_task_run_in_thread (task, (GTaskThreadFunc) load_thread);
+    g_object_unref (task);
+}
+
+gboolean
+xed_large_file_load_finish (XedLargeFile  *file,
+                            GAsyncResult  *result,
+                            GError       **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* Safe to call from the main thread while the file is being loaded */
+gdouble
+xed_large_file_get_progress (XedLargeFile *file,
+                             guint        *n_lines)
+{
+    if (n_lines != NULL)
+    {
+        *n_lines = g_atomic_int_get (&file->n_lines_indexed);
+    }
+
+    return g_atomic_int_get (&file->progress) / 1000.0;
+}
+
+guint
+xed_large_file_get_n_lines (XedLargeFile *file)
+{
+    return file->n_lines;
+}
+
+static gsize
+get_line_start (XedLargeFile *file,
+                guint         line)
+{
+    gsize offset;
+
+    if (line >= file->n_lines ||
+        !xed_line_index_get_line_offset (file->line_index, file->data, line, &offset))
+    {
+        return file->size;
+    }
+
+    return offset;
+}
+
+typedef struct
+{
+    XedLargeFile *file;
+    guint first_line;
+    guint n_lines;
+    gchar *copy;
+    gsize length;
+} CopyLinesData;
+
+static void
+copy_lines_mapped (CopyLinesData *data)
+{
+    XedLargeFile *file = data->file;
+    gsize start;
+    gsize end;
+
+    start = get_line_start (file, data->first_line);
+    end = get_line_start (file, data->first_line + data->n_lines);
+    end = MIN (end, start + MAX_TEXT_LENGTH);
+
+    if (end > start && file->data[end - 1] == '\n')
+    {
+        end--;
+
+        if (end > start && file->data[end - 1] == '\r')
+        {
+            end--;
+        }
+    }
+
+    data->copy = g_malloc (end - start + 1);
+    memcpy (data->copy, file->data + start, end - start);
+    data->length = end - start;
+}
+
+/* Copies the lines out of the mapping, FALSE if the file shrank meanwhile */
+static gboolean
+copy_lines (XedLargeFile  *file,
+            guint          first_line,
+            guint          n_lines,
+            gchar        **text,
+            gsize         *length)
+{
+    CopyLinesData data;
+    struct stat st;
+
+    /* A file truncated before now is caught without a fault */
+    if (fstat (file->fd, &st) != 0 || (gsize) st.st_size < file->size)
+    {
+        return FALSE;
+    }
+
+    data.file = file;
+    data.first_line = first_line;
+    data.n_lines = n_lines;
+    data.copy = NULL;
+    data.length = 0;
+
+    if (!xed_utils_read_mapped_guarded ((XedMappedReadFunc) copy_lines_mapped, &data))
+    {
+        g_free (data.copy);
+        return FALSE;
+    }
+
+    *text = data.copy;
+    *length = data.length;
+
+    return TRUE;
+}
+
+static gchar *
+make_valid_utf8 (const gchar *text,
+                 gsize        length,
+                 gsize       *valid_length)
+{
+    GString *str;
+    const gchar *end;
+
+    if (g_utf8_validate (text, length, NULL))
+    {
+        *valid_length = length;
+        return g_strndup (text, length);
+    }
+
+    str = g_string_sized_new (length + 16);
+
+    /* Also catches the nul bytes, which a text buffer can't hold */
+    while (!g_utf8_validate (text, length, &end))
+    {
+        g_string_append_len (str, text, end - text);
+        g_string_append (str, REPLACEMENT_CHARACTER);
+
+        length -= end - text + 1;
+        text = end + 1;
+    }
+
+    g_string_append_len (str, text, length);
+
+    *valid_length = str->len;
+
+    return g_string_free (str, FALSE);
+}
+
+/**
+ * xed_large_file_get_lines:
+ * @file: an indexed #XedLargeFile
+ * @first_line: the first line to read, starting from 0
+ * @n_lines: how many lines to read
+ * @length: (out): return location for the length of the text
+ *
+ * Reads a range of lines, without the newline ending the last one. Bytes
+ * which are not valid UTF-8 are replaced, and the text is cut after 64
+ * megabytes. The text is empty if the file was truncated since it was
+ * loaded.
+ *
+ * Returns: the lines, free with g_free()
+ */
+gchar *
+xed_large_file_get_lines (XedLargeFile *file,
+                          guint         first_line,
+                          guint         n_lines,
+                          gsize        *length)
+{
+    gchar *copy;
+    gsize copy_length;
+    gchar *text;
+
+    g_return_val_if_fail (file != NULL, NULL);
+    g_return_val_if_fail (length != NULL, NULL);
+
+    first_line = MIN (first_line, file->n_lines);
+    n_lines = MIN (n_lines, file->n_lines - first_line);
+
+    if (!copy_lines (file, first_line, n_lines, &copy, &copy_length))
+    {
+        xed_debug_message (DEBUG_DOCUMENT, "%s was truncated", file->path);
+
+        *length = 0;
+        return g_strdup ("");
+    }
+
+    text = make_valid_utf8 (copy, copy_length, length);
+    g_free (copy);
+
+    return text;
+}
@@ -0,0 +1,57 @@
+/*
+ * xed-large-file.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_LARGE_FILE_H__
+#define __XED_LARGE_FILE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* A file too big to be put in a text buffer as a whole. Loading maps it
+ * in memory and indexes its lines on a worker thread, after which any range
+ * of lines can be read back cheaply. */
+typedef struct _XedLargeFile XedLargeFile;
+
+XedLargeFile *xed_large_file_new            (GFile                *location);
+void          xed_large_file_free           (XedLargeFile         *file);
+
+gboolean      xed_large_file_should_open    (GFile                *location,
+                                             guint                 threshold);
+
+void          xed_large_file_load_async     (XedLargeFile         *file,
+                                             GCancellable         *cancellable,
+                                             GAsyncReadyCallback   callback,
+                                             gpointer              user_data);
+gboolean      xed_large_file_load_finish    (XedLargeFile         *file,
+                                             GAsyncResult         *result,
+                                             GError              **error);
+gdouble       xed_large_file_get_progress   (XedLargeFile         *file,
+                                             guint                *n_lines);
+
+guint         xed_large_file_get_n_lines    (XedLargeFile         *file);
+gchar        *xed_large_file_get_lines      (XedLargeFile         *file,
+                                             guint                 first_line,
+                                             guint                 n_lines,
+                                             gsize                *length);
+
+G_END_DECLS
+
+#endif /* __XED_LARGE_FILE_H__ */
@@ -0,0 +1,149 @@
+/*
+ * xed-line-index.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "xed-line-index.h"
+
+/* The offset of every LINE_INDEX_STEP-th line is kept, the lines in
+ * between are found again by scanning the text. memchr() goes through a
+ * vector register at a time, so rescanning 64 lines is cheap. */
+#define LINE_INDEX_STEP 64
+
+struct _XedLineIndex
+{
+    GArray *checkpoints;
+    gsize length;
+
+    /* Like in a text buffer, the newlines plus one */
+    guint n_lines;
+};
+
+XedLineIndex *
+xed_line_index_new (void)
+{
+    XedLineIndex *index;
+    gsize offset = 0;
+
+    index = g_new0 (XedLineIndex, 1);
+    index->checkpoints = g_array_new (FALSE, FALSE, sizeof (gsize));
+    index->n_lines = 1;
+
+    g_array_append_val (index->checkpoints, offset);
+
+    return index;
+}
+
+void
+xed_line_index_free (XedLineIndex *index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+
+    g_array_unref (index->checkpoints);
+    g_free (index);
+}
+
+/**
+ * xed_line_index_append:
+ * @index: a #XedLineIndex
+ * @text: the bytes following the ones already indexed
+ * @length: the length of @text
+ *
+ * Indexes the lines starting in @text.
+ */
+void
+xed_line_index_append (XedLineIndex *index,
+                       const gchar  *text,
+                       gsize         length)
+{
+    const gchar *end = text + length;
+    const gchar *p = text;
+
+    g_return_if_fail (index != NULL);
+
+    while ((p = memchr (p, '\n', end - p)) != NULL)
+    {
+        p++;
+
+        if (index->n_lines % LINE_INDEX_STEP == 0)
+        {
+            gsize offset = index->length + (p - text);
+
+            g_array_append_val (index->checkpoints, offset);
+        }
+
+        index->n_lines++;
+    }
+
+    index->length += length;
+}
+
+guint
+xed_line_index_get_n_lines (XedLineIndex *index)
+{
+    g_return_val_if_fail (index != NULL, 0);
+
+    return index->n_lines;
+}
+
+/**
+ * xed_line_index_get_line_offset:
+ * @index: a #XedLineIndex
+ * @text: all the text indexed so far
+ * @line: a line number, starting from 0
+ * @offset: (out): return location for the offset of the start of @line
+ *
+ * Returns: %FALSE if @line is past the lines indexed so far
+ */
+gboolean
+xed_line_index_get_line_offset (XedLineIndex *index,
+                                const gchar  *text,
+                                guint         line,
+                                gsize        *offset)
+{
+    const gchar *end;
+    const gchar *p;
+    guint n;
+
+    g_return_val_if_fail (index != NULL, FALSE);
+    g_return_val_if_fail (offset != NULL, FALSE);
+
+    if (line >= index->n_lines)
+    {
+        return FALSE;
+    }
+
+    end = text + index->length;
+    p = text + g_array_index (index->checkpoints, gsize, line / LINE_INDEX_STEP);
+
+    for (n = line % LINE_INDEX_STEP; n > 0; n--)
+    {
+        p = memchr (p, '\n', end - p);
+        p++;
+    }
+
+    *offset = p - text;
+
+    return TRUE;
+}
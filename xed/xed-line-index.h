@@ -0,0 +1,50 @@
+/*
+ * xed-line-index.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_LINE_INDEX_H__
+#define __XED_LINE_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Maps lines to byte offsets in text which is not in a text
+ * buffer, such as a file being read. The text is fed in pieces with
+ * xed_line_index_append(); the index only keeps a few offsets, so the
+ * lookups need the whole text again. */
+typedef struct _XedLineIndex XedLineIndex;
+
+XedLineIndex *xed_line_index_new                (void);
+void          xed_line_index_free               (XedLineIndex *index);
+
+void          xed_line_index_append             (XedLineIndex *index,
+                                                 const gchar  *text,
+                                                 gsize         length);
+
+guint         xed_line_index_get_n_lines        (XedLineIndex *index);
+
+gboolean      xed_line_index_get_line_offset    (XedLineIndex *index,
+                                                 const gchar  *text,
+                                                 guint         line,
+                                                 gsize        *offset);
+
+G_END_DECLS
+
+#endif /* __XED_LINE_INDEX_H__ */
@@ -1,4 +1,5 @@
 #include "xed-message-bus.h"
+#include "xed-message-private.h"
 
 #include <string.h>
 #include <stdarg.h>
@@ -88,12 +89,29 @@
  *                         NULL);
  * </programlisting>
  * </example>
+ *
+ * Messages sent asynchronously are queued and dispatched in batches from
+ * an idle. Message types for which only the latest message matters, like
+ * a notification that something changed, can be coalesced (see
+ * xed_message_bus_set_coalesce()) so that each batch carries at most one
+ * of them.
+ *
+ * Message types are identified by a #GQuark interned from their object path
+ * and method (see xed_message_type_identifier_quark()), which can also be
+ * used to look them up and send them directly.
  */
 
+/* Initial size of the queue of asynchronous messages, a power of two */
+#define QUEUE_INITIAL_SIZE 32
+
+/* Messages kept per type to be filled again by xed_message_bus_send() */
+#define MAX_POOLED_MESSAGES 8
+
 typedef struct
 {
     gchar *object_path;
     gchar *method;
+    GQuark identifier;
 
     GList *listeners;
 } Message;
@@ -114,19 +132,43 @@ typedef struct
     GList   *listener;
 } IdMap;
 
+typedef struct
+{
+    XedMessage *message;
+
+    /* The bus created the message and may fill it again once dispatched */
+    gboolean recycle;
+} QueueItem;
+
+typedef struct
+{
+    gboolean queued;
+    guint    seq;
+} CoalesceInfo;
+
 struct _XedMessageBusPrivate
 {
-    GHashTable *messages;
+    GHashTable *messages; /* mapping from identifier quark to Message */
     GHashTable *idmap;
 
-    GList *message_queue;
-    guint  idle_id;
+    /* Ring buffer of asynchronous messages. Head and tail count the
+     * messages ever dequeued and queued, so they wrap around together and
+     * a queued message keeps its sequence number when the ring grows */
+    QueueItem *queue;
+    guint      queue_size;
+    guint      queue_head;
+    guint      queue_tail;
+    guint      idle_id;
 
     guint next_id;
 
-    GHashTable *types; /* mapping from identifier to XedMessageType */
+    GHashTable *types; /* mapping from identifier quark to XedMessageType */
+    GHashTable *pool; /* mapping from identifier quark to a GPtrArray of messages */
+    GHashTable *coalesce; /* mapping from identifier quark to CoalesceInfo */
 };
 
+#define QUEUE_ITEM(priv, seq) (&(priv)->queue[(seq) & ((priv)->queue_size - 1)])
+
 /* signals */
 enum
 {
@@ -167,10 +209,99 @@ message_free (Message *message)
 }
 
 static void
-message_queue_free (GList *queue)
+release_message (XedMessageBus *bus,
+                 QueueItem     *item)
+{
+    XedMessageType *message_type;
+    GPtrArray *pool;
+    GQuark identifier;
+
+    /* Only put back in the pool what nobody else holds on to */
+    if (!item->recycle || G_OBJECT (item->message)->ref_count != 1)
+    {
+        g_object_unref (item->message);
+        return;
+    }
+
+    message_type = _xed_message_get_message_type (item->message);
+    identifier = xed_message_type_get_identifier_quark (message_type);
+
+    /* The type might have been unregistered, or registered again */
+    if (g_hash_table_lookup (bus->priv->types, GUINT_TO_POINTER (identifier)) != message_type)
+    {
+        g_object_unref (item->message);
+        return;
+    }
+
+    pool = g_hash_table_lookup (bus->priv->pool, GUINT_TO_POINTER (identifier));
+
+    if (pool == NULL)
+    {
+        pool = g_ptr_array_new ();
+        g_hash_table_insert (bus->priv->pool, GUINT_TO_POINTER (identifier), pool);
+    }
+
+    if (pool->len >= MAX_POOLED_MESSAGES)
+    {
+        g_object_unref (item->message);
+        return;
+    }
+
+    _xed_message_reset (item->message);
+    g_ptr_array_add (pool, item->message);
+}
+
+static void
+pool_free (GPtrArray *pool)
+{
+    g_ptr_array_foreach (pool, (GFunc)g_object_unref, NULL);
+    g_ptr_array_free (pool, TRUE);
+}
+
+static void
+message_queue_free (XedMessageBus *bus)
+{
+    XedMessageBusPrivate *priv = bus->priv;
+
+    while (priv->queue_head != priv->queue_tail)
+    {
+        g_object_unref (QUEUE_ITEM (priv, priv->queue_head)->message);
+        priv->queue_head++;
+    }
+
+    g_free (priv->queue);
+}
+
+static void
+message_queue_push (XedMessageBus *bus,
+                    XedMessage    *message,
+                    gboolean       recycle)
 {
-    g_list_foreach (queue, (GFunc)g_object_unref, NULL);
-    g_list_free (queue);
+    XedMessageBusPrivate *priv = bus->priv;
+    QueueItem *item;
+
+    if (priv->queue_tail - priv->queue_head == priv->queue_size)
+    {
+        QueueItem *queue = priv->queue;
+        guint size = priv->queue_size;
+        guint seq;
+
+        priv->queue_size = size != 0 ? size * 2 : QUEUE_INITIAL_SIZE;
+        priv->queue = g_new (QueueItem, priv->queue_size);
+
+        for (seq = priv->queue_head; seq != priv->queue_tail; seq++)
+        {
+            *QUEUE_ITEM (priv, seq) = queue[seq & (size - 1)];
+        }
+
+        g_free (queue);
+    }
+
+    item = QUEUE_ITEM (priv, priv->queue_tail);
+    item->message = g_object_ref (message);
+    item->recycle = recycle;
+
+    priv->queue_tail++;
 }
 
 static void
@@ -183,10 +314,12 @@ xed_message_bus_finalize (GObject *object)
         g_source_remove (bus->priv->idle_id);
     }
 
-    message_queue_free (bus->priv->message_queue);
+    message_queue_free (bus);
 
     g_hash_table_destroy (bus->priv->messages);
     g_hash_table_destroy (bus->priv->idmap);
+    g_hash_table_destroy (bus->priv->pool);
+    g_hash_table_destroy (bus->priv->coalesce);
     g_hash_table_destroy (bus->priv->types);
 
     G_OBJECT_CLASS (xed_message_bus_parent_class)->finalize (object);
@@ -273,9 +406,10 @@ message_new (XedMessageBus *bus,
 
     message->object_path = g_strdup (object_path);
     message->method = g_strdup (method);
+    message->identifier = xed_message_type_identifier_quark (object_path, method);
     message->listeners = NULL;
 
-    g_hash_table_insert (bus->priv->messages, xed_message_type_identifier (object_path, method), message);
+    g_hash_table_insert (bus->priv->messages, GUINT_TO_POINTER (message->identifier), message);
     return message;
 }
 
@@ -285,12 +419,16 @@ lookup_message (XedMessageBus *bus,
                 const gchar   *method,
                 gboolean       create)
 {
-    gchar *identifier;
-    Message *message;
+    GQuark identifier;
+    Message *message = NULL;
 
-    identifier = xed_message_type_identifier (object_path, method);
-    message = (Message *)g_hash_table_lookup (bus->priv->messages, identifier);
-    g_free (identifier);
+    /* Nothing can be registered for an identifier never interned */
+    identifier = _xed_message_type_try_identifier_quark (object_path, method);
+
+    if (identifier != 0)
+    {
+        message = (Message *)g_hash_table_lookup (bus->priv->messages, GUINT_TO_POINTER (identifier));
+    }
 
     if (!message && !create)
     {
@@ -345,14 +483,9 @@ remove_listener (XedMessageBus *bus,
     g_hash_table_remove (bus->priv->idmap, GINT_TO_POINTER (lst->id));
     listener_free (lst);
 
-    /* remove from list of listeners */
+    /* remove from list of listeners, the message itself is kept as it
+       might be in the middle of being dispatched */
     message->listeners = g_list_delete_link (message->listeners, listener);
-
-    if (!message->listeners)
-    {
-        /* remove message because it does not have any listeners */
-        g_hash_table_remove (bus->priv->messages, message);
-    }
 }
 
 static void
@@ -399,14 +532,11 @@ static void
 xed_message_bus_dispatch_real (XedMessageBus *bus,
                                XedMessage    *message)
 {
-    const gchar *object_path;
-    const gchar *method;
+    GQuark identifier;
     Message *msg;
 
-    object_path = xed_message_get_object_path (message);
-    method = xed_message_get_method (message);
-
-    msg = lookup_message (bus, object_path, method, FALSE);
+    identifier = xed_message_type_get_identifier_quark (_xed_message_get_message_type (message));
+    msg = (Message *)g_hash_table_lookup (bus->priv->messages, GUINT_TO_POINTER (identifier));
 
     if (msg)
     {
@@ -418,31 +548,50 @@ static void
 dispatch_message (XedMessageBus *bus,
                   XedMessage    *message)
 {
+    /* Unless something customizes the dispatch, there is no need to go
+       through a signal emission */
+    if (!g_signal_has_handler_pending (bus, message_bus_signals[DISPATCH], 0, FALSE))
+    {
+        XED_MESSAGE_BUS_GET_CLASS (bus)->dispatch (bus, message);
+        return;
+    }
+
     g_signal_emit (bus, message_bus_signals[DISPATCH], 0, message);
 }
 
 static gboolean
 idle_dispatch (XedMessageBus *bus)
 {
-    GList *list;
-    GList *item;
+    XedMessageBusPrivate *priv = bus->priv;
+    guint end;
 
     /* make sure to set idle_id to 0 first so that any new async messages
        will be queued properly */
-    bus->priv->idle_id = 0;
+    priv->idle_id = 0;
 
-    /* reverse queue to get correct delivery order */
-    list = g_list_reverse (bus->priv->message_queue);
-    bus->priv->message_queue = NULL;
+    /* messages sent while dispatching go to the next batch */
+    end = priv->queue_tail;
 
-    for (item = list; item; item = item->next)
+    while ((gint) (end - priv->queue_head) > 0)
     {
-        XedMessage *msg = XED_MESSAGE (item->data);
+        QueueItem item = *QUEUE_ITEM (priv, priv->queue_head);
+        GQuark identifier;
+        CoalesceInfo *info;
+
+        identifier = xed_message_type_get_identifier_quark (_xed_message_get_message_type (item.message));
+        info = g_hash_table_lookup (priv->coalesce, GUINT_TO_POINTER (identifier));
+
+        if (info != NULL && info->queued && info->seq == priv->queue_head)
+        {
+            info->queued = FALSE;
+        }
+
+        priv->queue_head++;
 
-        dispatch_message (bus, msg);
+        dispatch_message (bus, item.message);
+        release_message (bus, &item);
     }
 
-    message_queue_free (list);
     return FALSE;
 }
 
@@ -504,9 +653,9 @@ xed_message_bus_init (XedMessageBus *self)
 {
     self->priv = xed_message_bus_get_instance_private (self);
 
-    self->priv->messages = g_hash_table_new_full (g_str_hash,
-                                                  g_str_equal,
-                                                  (GDestroyNotify)g_free,
+    self->priv->messages = g_hash_table_new_full (g_direct_hash,
+                                                  g_direct_equal,
+                                                  NULL,
                                                   (GDestroyNotify)message_free);
 
     self->priv->idmap = g_hash_table_new_full (g_direct_hash,
@@ -514,10 +663,20 @@ xed_message_bus_init (XedMessageBus *self)
                                                NULL,
                                                (GDestroyNotify)g_free);
 
-    self->priv->types = g_hash_table_new_full (g_str_hash,
-                                               g_str_equal,
-                                               (GDestroyNotify)g_free,
+    self->priv->types = g_hash_table_new_full (g_direct_hash,
+                                               g_direct_equal,
+                                               NULL,
                                                (GDestroyNotify)xed_message_type_unref);
+
+    self->priv->pool = g_hash_table_new_full (g_direct_hash,
+                                              g_direct_equal,
+                                              NULL,
+                                              (GDestroyNotify)pool_free);
+
+    self->priv->coalesce = g_hash_table_new_full (g_direct_hash,
+                                                  g_direct_equal,
+                                                  NULL,
+                                                  g_free);
 }
 
 /**
@@ -576,18 +735,38 @@ xed_message_bus_lookup (XedMessageBus *bus,
                         const gchar   *object_path,
                         const gchar   *method)
 {
-    gchar *identifier;
-    XedMessageType *message_type;
-
     g_return_val_if_fail (XED_IS_MESSAGE_BUS (bus), NULL);
     g_return_val_if_fail (object_path != NULL, NULL);
     g_return_val_if_fail (method != NULL, NULL);
 
-    identifier = xed_message_type_identifier (object_path, method);
-    message_type = XED_MESSAGE_TYPE (g_hash_table_lookup (bus->priv->types, identifier));
+    return xed_message_bus_lookup_by_identifier (bus, _xed_message_type_try_identifier_quark (object_path, method));
+}
 
-    g_free (identifier);
-    return message_type;
+/**
+ * xed_message_bus_lookup_by_identifier:
+ * @bus: a #XedMessageBus
+ * @identifier: the identifier quark of the message type
+ *
+ * Get the registered #XedMessageType for @identifier, as returned by
+ * xed_message_type_identifier_quark(). The returned #XedMessageType is
+ * owned by the bus and should not be unreffed.
+ *
+ * Return value: the registered #XedMessageType or %NULL if no message type
+ *               is registered for @identifier
+ *
+ */
+XedMessageType *
+xed_message_bus_lookup_by_identifier (XedMessageBus *bus,
+                                      GQuark         identifier)
+{
+    g_return_val_if_fail (XED_IS_MESSAGE_BUS (bus), NULL);
+
+    if (identifier == 0)
+    {
+        return NULL;
+    }
+
+    return XED_MESSAGE_TYPE (g_hash_table_lookup (bus->priv->types, GUINT_TO_POINTER (identifier)));
 }
 
 /**
@@ -619,7 +798,6 @@ xed_message_bus_register (XedMessageBus *bus,
                           guint          num_optional,
                                          ...)
 {
-    gchar *identifier;
     va_list var_args;
     XedMessageType *message_type;
 
@@ -632,21 +810,17 @@ xed_message_bus_register (XedMessageBus *bus,
         return NULL;
     }
 
-    identifier = xed_message_type_identifier (object_path, method);
-
     va_start (var_args, num_optional);
     message_type = xed_message_type_new_valist (object_path, method, num_optional, var_args);
     va_end (var_args);
 
     if (message_type)
     {
-        g_hash_table_insert (bus->priv->types, identifier, message_type);
+        g_hash_table_insert (bus->priv->types,
+                             GUINT_TO_POINTER (xed_message_type_get_identifier_quark (message_type)),
+                             message_type);
         g_signal_emit (bus, message_bus_signals[REGISTERED], 0, message_type);
     }
-    else
-    {
-        g_free (identifier);
-    }
 
     return message_type;
 }
@@ -656,23 +830,22 @@ xed_message_bus_unregister_real (XedMessageBus  *bus,
                                  XedMessageType *message_type,
                                  gboolean        remove_from_store)
 {
-    gchar *identifier;
+    gpointer identifier;
 
     g_return_if_fail (XED_IS_MESSAGE_BUS (bus));
 
-    identifier = xed_message_type_identifier (xed_message_type_get_object_path (message_type),
-                                              xed_message_type_get_method (message_type));
+    identifier = GUINT_TO_POINTER (xed_message_type_get_identifier_quark (message_type));
 
     /* Keep message type alive for signal emission */
     xed_message_type_ref (message_type);
 
     if (!remove_from_store || g_hash_table_remove (bus->priv->types, identifier))
     {
+        g_hash_table_remove (bus->priv->pool, identifier);
         g_signal_emit (bus, message_bus_signals[UNREGISTERED], 0, message_type);
     }
 
     xed_message_type_unref (message_type);
-    g_free (identifier);
 }
 
 /**
@@ -701,7 +874,7 @@ typedef struct
 } UnregisterInfo;
 
 static gboolean
-unregister_each (const gchar    *identifier,
+unregister_each (gpointer        identifier,
                  XedMessageType *message_type,
                  UnregisterInfo *info)
 {
@@ -757,18 +930,11 @@ xed_message_bus_is_registered (XedMessageBus *bus,
                                const gchar   *object_path,
                                const gchar   *method)
 {
-    gchar *identifier;
-    gboolean ret;
-
     g_return_val_if_fail (XED_IS_MESSAGE_BUS (bus), FALSE);
     g_return_val_if_fail (object_path != NULL, FALSE);
     g_return_val_if_fail (method != NULL, FALSE);
 
-    identifier = xed_message_type_identifier (object_path, method);
-    ret = g_hash_table_lookup (bus->priv->types, identifier) != NULL;
-
-    g_free(identifier);
-    return ret;
+    return xed_message_bus_lookup (bus, object_path, method) != NULL;
 }
 
 typedef struct
@@ -778,7 +944,7 @@ typedef struct
 } ForeachInfo;
 
 static void
-foreach_type (const gchar    *key,
+foreach_type (gpointer        key,
               XedMessageType *message_type,
               ForeachInfo    *info)
 {
@@ -985,14 +1151,41 @@ validate_message (XedMessage *message)
 
 static void
 send_message_real (XedMessageBus *bus,
-                   XedMessage    *message)
+                   XedMessage    *message,
+                   gboolean       recycle)
 {
+    XedMessageBusPrivate *priv = bus->priv;
+    GQuark identifier;
+    CoalesceInfo *info;
+
     if (!validate_message (message))
     {
         return;
     }
 
-    bus->priv->message_queue = g_list_prepend (bus->priv->message_queue, g_object_ref (message));
+    identifier = xed_message_type_get_identifier_quark (_xed_message_get_message_type (message));
+    info = g_hash_table_lookup (priv->coalesce, GUINT_TO_POINTER (identifier));
+
+    if (info != NULL && info->queued)
+    {
+        /* take the place of the one still waiting */
+        QueueItem *item = QUEUE_ITEM (priv, info->seq);
+        QueueItem replaced = *item;
+
+        item->message = g_object_ref (message);
+        item->recycle = recycle;
+        release_message (bus, &replaced);
+
+        return;
+    }
+
+    if (info != NULL)
+    {
+        info->queued = TRUE;
+        info->seq = priv->queue_tail;
+    }
+
+    message_queue_push (bus, message, recycle);
 
     if (bus->priv->idle_id == 0)
     {
@@ -1021,7 +1214,7 @@ xed_message_bus_send_message (XedMessageBus *bus,
     g_return_if_fail (XED_IS_MESSAGE_BUS (bus));
     g_return_if_fail (XED_IS_MESSAGE (message));
 
-    send_message_real (bus, message);
+    send_message_real (bus, message, FALSE);
 }
 
 static void
@@ -1057,6 +1250,28 @@ xed_message_bus_send_message_sync (XedMessageBus *bus,
     send_message_sync_real (bus, message);
 }
 
+static XedMessage *
+create_message_for_type (XedMessageBus  *bus,
+                         XedMessageType *message_type,
+                         va_list         var_args)
+{
+    GPtrArray *pool;
+    XedMessage *message;
+
+    pool = g_hash_table_lookup (bus->priv->pool,
+                                GUINT_TO_POINTER (xed_message_type_get_identifier_quark (message_type)));
+
+    if (pool == NULL || pool->len == 0)
+    {
+        return xed_message_type_instantiate_valist (message_type, var_args);
+    }
+
+    message = g_ptr_array_remove_index_fast (pool, pool->len - 1);
+    xed_message_set_valist (message, var_args);
+
+    return message;
+}
+
 static XedMessage *
 create_message (XedMessageBus *bus,
                 const gchar   *object_path,
@@ -1073,7 +1288,7 @@ create_message (XedMessageBus *bus,
         return NULL;
     }
 
-    return xed_message_type_instantiate_valist (message_type, var_args);
+    return create_message_for_type (bus, message_type, var_args);
 }
 
 /**
@@ -1104,7 +1319,7 @@ xed_message_bus_send (XedMessageBus *bus,
 
     if (message)
     {
-        send_message_real (bus, message);
+        send_message_real (bus, message, TRUE);
         g_object_unref (message);
     }
     else
@@ -1115,6 +1330,83 @@ xed_message_bus_send (XedMessageBus *bus,
     va_end (var_args);
 }
 
+/**
+ * xed_message_bus_send_by_identifier:
+ * @bus: a #XedMessageBus
+ * @identifier: the identifier quark of the message type
+ * @...: NULL terminated list of key/value pairs
+ *
+ * Like xed_message_bus_send(), but for the message type registered for
+ * @identifier (see xed_message_type_identifier_quark()). Plugins sending
+ * the same message often can get the identifier once and skip looking up
+ * the message type by name each time.
+ *
+ */
+void
+xed_message_bus_send_by_identifier (XedMessageBus *bus,
+                                    GQuark         identifier,
+                                    ...)
+{
+    va_list var_args;
+    XedMessageType *message_type;
+    XedMessage *message;
+
+    g_return_if_fail (XED_IS_MESSAGE_BUS (bus));
+
+    message_type = xed_message_bus_lookup_by_identifier (bus, identifier);
+
+    if (!message_type)
+    {
+        g_warning ("Could not find message type for '%s'", g_quark_to_string (identifier));
+        return;
+    }
+
+    va_start (var_args, identifier);
+    message = create_message_for_type (bus, message_type, var_args);
+    va_end (var_args);
+
+    send_message_real (bus, message, TRUE);
+    g_object_unref (message);
+}
+
+/**
+ * xed_message_bus_set_coalesce:
+ * @bus: a #XedMessageBus
+ * @object_path: the object path
+ * @method: the method
+ * @coalesce: whether to coalesce the messages
+ *
+ * Sets whether messages @method at @object_path sent asynchronously are
+ * coalesced. A coalesced message replaces the one of the same type still
+ * waiting to be dispatched, if any, and takes its place in the queue, so
+ * that the callbacks only see the latest one. Messages sent synchronously
+ * are never coalesced.
+ *
+ */
+void
+xed_message_bus_set_coalesce (XedMessageBus *bus,
+                              const gchar   *object_path,
+                              const gchar   *method,
+                              gboolean       coalesce)
+{
+    gpointer identifier;
+
+    g_return_if_fail (XED_IS_MESSAGE_BUS (bus));
+    g_return_if_fail (object_path != NULL);
+    g_return_if_fail (method != NULL);
+
+    identifier = GUINT_TO_POINTER (xed_message_type_identifier_quark (object_path, method));
+
+    if (!coalesce)
+    {
+        g_hash_table_remove (bus->priv->coalesce, identifier);
+    }
+    else if (!g_hash_table_contains (bus->priv->coalesce, identifier))
+    {
+        g_hash_table_insert (bus->priv->coalesce, identifier, g_new0 (CoalesceInfo, 1));
+    }
+}
+
 /**
  * xed_message_bus_send_sync:
  * @bus: a #XedMessageBus
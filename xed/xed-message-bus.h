@@ -52,6 +52,8 @@ XedMessageBus *xed_message_bus_new		(void);
 XedMessageType *xed_message_bus_lookup	(XedMessageBus 	*bus,
 						 const gchar		*object_path,
 						 const gchar		*method);
+XedMessageType *xed_message_bus_lookup_by_identifier (XedMessageBus *bus,
+						 GQuark			 identifier);
 XedMessageType *xed_message_bus_register	(XedMessageBus		*bus,
 					   	 const gchar 		*object_path,
 					  	 const gchar		*method,
@@ -121,6 +123,15 @@ XedMessage *xed_message_bus_send_sync (XedMessageBus	*bus,
 					   const gchar		*object_path,
 					   const gchar		*method,
 					   ...) G_GNUC_NULL_TERMINATED;
+void xed_message_bus_send_by_identifier (XedMessageBus	*bus,
+					   GQuark		 identifier,
+					   ...) G_GNUC_NULL_TERMINATED;
+
+/* coalescing asynchronous messages */
+void xed_message_bus_set_coalesce	  (XedMessageBus	*bus,
+					   const gchar		*object_path,
+					   const gchar		*method,
+					   gboolean		 coalesce);
 
 G_END_DECLS
 
@@ -0,0 +1,24 @@
+#ifndef __XED_MESSAGE_PRIVATE_H__
+#define __XED_MESSAGE_PRIVATE_H__
+
+#include "xed-message.h"
+#include "xed-message-type.h"
+
+G_BEGIN_DECLS
+
+GQuark          _xed_message_type_try_identifier_quark (const gchar    *object_path,
+                                                        const gchar    *method);
+
+gint            _xed_message_type_lookup_slot          (XedMessageType *message_type,
+                                                        const gchar    *key,
+                                                        GType          *type);
+
+guint           _xed_message_type_get_n_slots          (XedMessageType *message_type);
+
+XedMessageType *_xed_message_get_message_type          (XedMessage     *message);
+
+void            _xed_message_reset                     (XedMessage     *message);
+
+G_END_DECLS
+
+#endif /* __XED_MESSAGE_PRIVATE_H__ */
@@ -1,4 +1,7 @@
 #include "xed-message-type.h"
+#include "xed-message-private.h"
+
+#include <string.h>
 
 /**
  * SECTION:xed-message-type
@@ -38,6 +41,7 @@ typedef struct
 {
 	GType type;
 	gboolean required;
+	guint slot;
 } ArgumentInfo;
 
 struct _XedMessageType
@@ -47,6 +51,7 @@ struct _XedMessageType
 
 	gchar *object_path;
 	gchar *method;
+	GQuark identifier;
 
 	guint num_arguments;
 	guint num_required;
@@ -134,6 +139,66 @@ xed_message_type_identifier (const gchar *object_path,
 	return g_strconcat (object_path, ".", method, NULL);
 }
 
+static GQuark
+identifier_quark (const gchar *object_path,
+		  const gchar *method,
+		  gboolean     intern)
+{
+	gchar buffer[256];
+	gsize path_length = strlen (object_path);
+	gsize method_length = strlen (method);
+	gchar *identifier;
+	GQuark quark;
+
+	/* build the identifier on the stack, it is only copied when
+	   interned for the first time */
+	if (path_length + method_length + 2 <= sizeof (buffer))
+	{
+		memcpy (buffer, object_path, path_length);
+		buffer[path_length] = '.';
+		memcpy (buffer + path_length + 1, method, method_length + 1);
+
+		return intern ? g_quark_from_string (buffer) : g_quark_try_string (buffer);
+	}
+
+	identifier = xed_message_type_identifier (object_path, method);
+	quark = intern ? g_quark_from_string (identifier) : g_quark_try_string (identifier);
+	g_free (identifier);
+
+	return quark;
+}
+
+/**
+ * xed_message_type_identifier_quark:
+ * @object_path: (allow-none): the object path
+ * @method: (allow-none): the method
+ *
+ * Get the interned identifier of @method at @object_path, a handle with
+ * which messages can be looked up on a #XedMessageBus without building
+ * the identifier string again.
+ *
+ * Return value: the identifier as a #GQuark
+ *
+ */
+GQuark
+xed_message_type_identifier_quark (const gchar *object_path,
+				     const gchar *method)
+{
+	g_return_val_if_fail (object_path != NULL, 0);
+	g_return_val_if_fail (method != NULL, 0);
+
+	return identifier_quark (object_path, method, TRUE);
+}
+
+/* Like xed_message_type_identifier_quark(), but without interning: 0 means
+ * that nothing was ever registered or connected for @method at @object_path */
+GQuark
+_xed_message_type_try_identifier_quark (const gchar *object_path,
+					  const gchar *method)
+{
+	return identifier_quark (object_path, method, FALSE);
+}
+
 /**
  * xed_message_type_is_valid_object_path:
  * @object_path: (allow-none): the object path
@@ -253,6 +318,7 @@ xed_message_type_new_valist (const gchar *object_path,
 	message_type->ref_count = 1;
 	message_type->object_path = g_strdup(object_path);
 	message_type->method = g_strdup(method);
+	message_type->identifier = identifier_quark (object_path, method, TRUE);
 	message_type->num_arguments = 0;
 	message_type->arguments = g_hash_table_new_full (g_str_hash,
 							 g_str_equal,
@@ -357,6 +423,7 @@ xed_message_type_set_valist (XedMessageType *message_type,
 		info = g_new(ArgumentInfo, 1);
 		info->type = gtype;
 		info->required = TRUE;
+		info->slot = message_type->num_arguments;
 
 		g_hash_table_insert (message_type->arguments, g_strdup (key), info);
 
@@ -467,6 +534,22 @@ xed_message_type_get_method (XedMessageType *message_type)
 	return message_type->method;
 }
 
+/**
+ * xed_message_type_get_identifier_quark:
+ * @message_type: the #XedMessageType
+ *
+ * Get the interned identifier of the message type, see
+ * xed_message_type_identifier_quark().
+ *
+ * Return value: the message type identifier as a #GQuark
+ *
+ */
+GQuark
+xed_message_type_get_identifier_quark (XedMessageType *message_type)
+{
+	return message_type->identifier;
+}
+
 /**
  * xed_message_type_lookup:
  * @message_type: the #XedMessageType
@@ -489,6 +572,28 @@ xed_message_type_lookup (XedMessageType *message_type,
 	return info->type;
 }
 
+/* Arguments are numbered in the order in which they were added, messages
+ * keep their values in an array indexed by these slots */
+gint
+_xed_message_type_lookup_slot (XedMessageType *message_type,
+				 const gchar      *key,
+				 GType            *type)
+{
+	ArgumentInfo *info = g_hash_table_lookup (message_type->arguments, key);
+
+	if (!info)
+		return -1;
+
+	*type = info->type;
+	return info->slot;
+}
+
+guint
+_xed_message_type_get_n_slots (XedMessageType *message_type)
+{
+	return message_type->num_arguments;
+}
+
 typedef struct
 {
 	XedMessageTypeForeach func;
@@ -23,6 +23,8 @@ GType xed_message_type_get_type 		 (void) G_GNUC_CONST;
 gboolean xed_message_type_is_supported 	 (GType type);
 gchar *xed_message_type_identifier		 (const gchar *object_path,
 						  const gchar *method);
+GQuark xed_message_type_identifier_quark	 (const gchar *object_path,
+						  const gchar *method);
 gboolean xed_message_type_is_valid_object_path (const gchar *object_path);
 
 XedMessageType *xed_message_type_new	 (const gchar *object_path,
@@ -52,6 +54,7 @@ XedMessage *xed_message_type_instantiate 	 (XedMessageType *message_type,
 
 const gchar *xed_message_type_get_object_path	 (XedMessageType *message_type);
 const gchar *xed_message_type_get_method	 (XedMessageType *message_type);
+GQuark xed_message_type_get_identifier_quark (XedMessageType *message_type);
 
 GType xed_message_type_lookup			 (XedMessageType *message_type,
 						  const gchar      *key);
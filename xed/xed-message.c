@@ -1,5 +1,6 @@
 #include "xed-message.h"
 #include "xed-message-type.h"
+#include "xed-message-private.h"
 
 #include <string.h>
 #include <gobject/gvaluecollector.h>
@@ -32,7 +33,9 @@ struct _XedMessagePrivate
 	XedMessageType *type;
 	gboolean valid;
 
-	GHashTable *values;
+	/* indexed by the argument slots of the type, unset until given a value */
+	GValue *values;
+	guint n_values;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (XedMessage, xed_message, G_TYPE_OBJECT)
@@ -42,8 +45,9 @@ xed_message_finalize (GObject *object)
 {
 	XedMessage *message = XED_MESSAGE (object);
 
+	_xed_message_reset (message);
+	g_free (message->priv->values);
 	xed_message_type_unref (message->priv->type);
-	g_hash_table_destroy (message->priv->values);
 
 	G_OBJECT_CLASS (xed_message_parent_class)->finalize (object);
 }
@@ -85,6 +89,8 @@ xed_message_set_property (GObject      *object,
 	{
 		case PROP_TYPE:
 			msg->priv->type = XED_MESSAGE_TYPE (g_value_dup_boxed (value));
+			msg->priv->n_values = _xed_message_type_get_n_slots (msg->priv->type);
+			msg->priv->values = g_new0 (GValue, msg->priv->n_values);
 			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -92,25 +98,6 @@ xed_message_set_property (GObject      *object,
 	}
 }
 
-static GValue *
-add_value (XedMessage *message,
-	   const gchar  *key)
-{
-	GValue *value;
-	GType type = xed_message_type_lookup (message->priv->type, key);
-
-	if (type == G_TYPE_INVALID)
-		return NULL;
-
-	value = g_new0 (GValue, 1);
-	g_value_init (value, type);
-	g_value_reset (value);
-
-	g_hash_table_insert (message->priv->values, g_strdup (key), value);
-
-	return value;
-}
-
 static void
 xed_message_class_init (XedMessageClass *klass)
 {
@@ -164,22 +151,10 @@ xed_message_class_init (XedMessageClass *klass)
 					 		     G_PARAM_STATIC_STRINGS));
 }
 
-static void
-destroy_value (GValue *value)
-{
-	g_value_unset (value);
-	g_free (value);
-}
-
 static void
 xed_message_init (XedMessage *self)
 {
 	self->priv = xed_message_get_instance_private (self);
-
-	self->priv->values = g_hash_table_new_full (g_str_hash,
-						    g_str_equal,
-						    (GDestroyNotify)g_free,
-						    (GDestroyNotify)destroy_value);
 }
 
 static gboolean
@@ -215,12 +190,38 @@ value_lookup (XedMessage *message,
 	      const gchar  *key,
 	      gboolean	    create)
 {
-	GValue *ret = (GValue *)g_hash_table_lookup (message->priv->values, key);
+	GValue *value;
+	GType type;
+	gint slot;
+
+	slot = _xed_message_type_lookup_slot (message->priv->type, key, &type);
 
-	if (!ret && create)
-		ret = add_value (message, key);
+	if (slot < 0)
+		return NULL;
+
+	/* the type got more arguments after the message was created */
+	if ((guint)slot >= message->priv->n_values)
+	{
+		if (!create)
+			return NULL;
 
-	return ret;
+		message->priv->values = g_renew (GValue, message->priv->values, slot + 1);
+		memset (message->priv->values + message->priv->n_values, 0,
+			(slot + 1 - message->priv->n_values) * sizeof (GValue));
+		message->priv->n_values = slot + 1;
+	}
+
+	value = &message->priv->values[slot];
+
+	if (!G_IS_VALUE (value))
+	{
+		if (!create)
+			return NULL;
+
+		g_value_init (value, type);
+	}
+
+	return value;
 }
 
 /**
@@ -585,4 +586,25 @@ xed_message_validate (XedMessage *message)
 	return message->priv->valid;
 }
 
+XedMessageType *
+_xed_message_get_message_type (XedMessage *message)
+{
+	return message->priv->type;
+}
+
+/* Unsets all the values, for the message to be filled again */
+void
+_xed_message_reset (XedMessage *message)
+{
+	guint i;
+
+	for (i = 0; i < message->priv->n_values; i++)
+	{
+		if (G_IS_VALUE (&message->priv->values[i]))
+			g_value_unset (&message->priv->values[i]);
+	}
+
+	message->priv->valid = FALSE;
+}
+
 // ex:ts=8:noet:
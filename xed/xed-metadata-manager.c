@@ -21,6 +21,11 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <libxml/globals.h>
 #include <libxml/xmlreader.h>
 #include "xed-metadata-manager.h"
@@ -30,7 +35,15 @@
 #define XED_METADATA_VERBOSE_DEBUG  1
 */
 
-#define MAX_ITEMS   50
+#define DEFAULT_MAX_ITEMS   50
+
+/* Changes are appended to a journal next to the metadata file. The journal
+ * is folded back into the metadata file once it holds this many entries
+ * per remembered file (and at least JOURNAL_MIN_ENTRIES) */
+#define JOURNAL_SUFFIX          ".journal"
+#define LOCK_SUFFIX             ".lock"
+#define JOURNAL_ENTRIES_FACTOR  4
+#define JOURNAL_MIN_ENTRIES     200
 
 typedef struct _XedMetadataManager XedMetadataManager;
 
@@ -38,9 +51,15 @@ typedef struct _Item Item;
 
 struct _Item
 {
+    gchar       *uri;
+
     gint64       atime; /* time of last access in seconds since January 1, 1970 UTC */
 
     GHashTable  *values;
+    gboolean     values_shared; /* values are referenced by a snapshot
+                                   being saved, copy them before a change */
+
+    GList        lru_link; /* link in the LRU queue, its data is the item */
 };
 
 struct _XedMetadataManager
@@ -50,12 +69,63 @@ struct _XedMetadataManager
 
     guint        timeout_id;
 
-    GHashTable  *items;
+    GHashTable  *items; /* uri -> Item */
+
+    /* Items from the most to the least recently used */
+    GQueue       lru;
+    guint        max_items;
 
     gchar *metadata_filename;
+    gchar *journal_filename;
+    gchar *lock_filename;
+
+    /* Journal entries not written to disk yet */
+    GString     *pending;
+
+    /* URIs of the items read since the last save. Their access time is
+     * only journaled with the next save, a read alone doesn't cause one */
+    GHashTable  *touched;
+    guint        journal_entries;
+    gboolean     needs_rewrite;
+
+    gboolean     save_in_progress;
+};
+
+/* Everything a save needs, detached from the manager so that it can be
+ * written by a worker thread while the main thread keeps going */
+typedef struct _SaveData SaveData;
+
+struct _SaveData
+{
+    gchar     *metadata_filename;
+    gchar     *journal_filename;
+    gchar     *lock_filename;
+
+    GString   *journal;  /* entries to append to the journal */
+    GPtrArray *snapshot; /* items to rewrite the metadata file with, or NULL */
 };
 
+/* Serializes the saves of this process, the lock file only guards
+ * against other processes */
+static GMutex save_mutex;
+
+/* Signalled when the save running on a worker thread is done, so that
+ * the last save at shutdown can't be overtaken by an older one */
+static GCond save_cond;
+static gboolean save_running = FALSE;
+
+/* Length of the head of the journal whose entries are all in the items of
+ * this process. Other xed processes may append to the journal too, so only
+ * that head can be dropped when the metadata file is rewritten. Guarded by
+ * save_mutex. */
+static gsize journal_folded = 0;
+
 static gboolean xed_metadata_manager_save (gpointer data);
+static SaveData *save_data_new (void);
+static void save_data_free (SaveData *save);
+static void release_snapshot (SaveData *save);
+static gboolean write_metadata (SaveData *save, GError **error);
+static gboolean load_metadata_file (void);
 
 
 static XedMetadataManager *xed_metadata_manager = NULL;
@@ -74,11 +144,129 @@ item_free (gpointer data)
     item = (Item *)data;
 
     if (item->values != NULL)
-        g_hash_table_destroy (item->values);
+        g_hash_table_unref (item->values);
 
+    g_free (item->uri);
     g_free (item);
 }
 
+static Item *
+item_new (const gchar *uri)
+{
+    Item *item;
+
+    item = g_new0 (Item, 1);
+    item->uri = g_strdup (uri);
+    item->lru_link.data = item;
+
+    g_hash_table_insert (xed_metadata_manager->items, item->uri, item);
+    g_queue_push_head_link (&xed_metadata_manager->lru, &item->lru_link);
+
+    return item;
+}
+
+static void
+item_remove (Item *item)
+{
+    g_queue_unlink (&xed_metadata_manager->lru, &item->lru_link);
+    g_hash_table_remove (xed_metadata_manager->items, item->uri);
+}
+
+/* Marks the item as the most recently used one */
+static void
+item_touch (Item   *item,
+            gint64  atime)
+{
+    item->atime = atime;
+
+    if (xed_metadata_manager->lru.head != &item->lru_link)
+    {
+        g_queue_unlink (&xed_metadata_manager->lru, &item->lru_link);
+        g_queue_push_head_link (&xed_metadata_manager->lru, &item->lru_link);
+    }
+}
+
+static void
+item_set_value (Item        *item,
+                const gchar *key,
+                const gchar *value)
+{
+    if (item->values_shared)
+    {
+        GHashTable *values;
+        GHashTableIter iter;
+        gpointer k, v;
+
+        values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+        g_hash_table_iter_init (&iter, item->values);
+        while (g_hash_table_iter_next (&iter, &k, &v))
+        {
+            g_hash_table_insert (values, g_strdup (k), g_strdup (v));
+        }
+
+        g_hash_table_unref (item->values);
+        item->values = values;
+        item->values_shared = FALSE;
+    }
+
+    if (item->values == NULL)
+         item->values = g_hash_table_new_full (g_str_hash,
+                               g_str_equal,
+                               g_free,
+                               g_free);
+    if (value != NULL)
+        g_hash_table_insert (item->values,
+                     g_strdup (key),
+                     g_strdup (value));
+    else
+        g_hash_table_remove (item->values,
+                     key);
+}
+
+/* Forgets the least recently used items */
+static void
+resize_items (void)
+{
+    while (xed_metadata_manager->lru.length > xed_metadata_manager->max_items)
+    {
+        item_remove ((Item *)xed_metadata_manager->lru.tail->data);
+    }
+}
+
+static void
+journal_append (const gchar *op,
+                const Item  *item,
+                const gchar *key,
+                const gchar *value)
+{
+    gchar *escaped;
+
+    escaped = g_strescape (item->uri, NULL);
+    g_string_append_printf (xed_metadata_manager->pending,
+                            "%s\t%s\t%" G_GINT64_FORMAT,
+                            op, escaped, item->atime);
+    g_free (escaped);
+
+    if (key != NULL)
+    {
+        escaped = g_strescape (key, NULL);
+        g_string_append_c (xed_metadata_manager->pending, '\t');
+        g_string_append (xed_metadata_manager->pending, escaped);
+        g_free (escaped);
+    }
+
+    if (value != NULL)
+    {
+        escaped = g_strescape (value, NULL);
+        g_string_append_c (xed_metadata_manager->pending, '\t');
+        g_string_append (xed_metadata_manager->pending, escaped);
+        g_free (escaped);
+    }
+
+    g_string_append_c (xed_metadata_manager->pending, '\n');
+}
+
 static void
 xed_metadata_manager_arm_timeout (void)
 {
@@ -115,14 +303,52 @@ xed_metadata_manager_init (const gchar *metadata_filename)
     xed_metadata_manager->items =
         g_hash_table_new_full (g_str_hash,
                        g_str_equal,
-                       g_free,
+                       NULL,
                        item_free);
 
+    g_queue_init (&xed_metadata_manager->lru);
+    xed_metadata_manager->max_items = DEFAULT_MAX_ITEMS;
+
     xed_metadata_manager->metadata_filename = g_strdup (metadata_filename);
 
+    if (metadata_filename != NULL)
+    {
+        xed_metadata_manager->journal_filename = g_strconcat (metadata_filename, JOURNAL_SUFFIX, NULL);
+        xed_metadata_manager->lock_filename = g_strconcat (metadata_filename, LOCK_SUFFIX, NULL);
+    }
+
+    xed_metadata_manager->pending = g_string_new (NULL);
+    xed_metadata_manager->touched = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
     return;
 }
 
+/**
+ * xed_metadata_manager_set_max_items:
+ * @max_items: the number of files to remember.
+ *
+ * Sets how many files the metadata manager remembers. When more files are
+ * added, the least recently used ones are forgotten.
+ */
+void
+xed_metadata_manager_set_max_items (guint max_items)
+{
+    g_return_if_fail (xed_metadata_manager != NULL);
+    g_return_if_fail (max_items > 0);
+
+    xed_metadata_manager->max_items = max_items;
+
+    if (xed_metadata_manager->values_loaded &&
+        xed_metadata_manager->lru.length > max_items)
+    {
+        resize_items ();
+
+        /* the journal does not record evictions, rewrite everything */
+        xed_metadata_manager->needs_rewrite = TRUE;
+        xed_metadata_manager_arm_timeout ();
+    }
+}
+
 /**
  * xed_metadata_manager_shutdown:
  *
@@ -141,13 +367,37 @@ xed_metadata_manager_shutdown (void)
     {
         g_source_remove (xed_metadata_manager->timeout_id);
         xed_metadata_manager->timeout_id = 0;
-        xed_metadata_manager_save (NULL);
+    }
+
+    /* A save still running holds older entries, they must be written
+     * before the last ones */
+    g_mutex_lock (&save_mutex);
+    while (save_running)
+        g_cond_wait (&save_cond, &save_mutex);
+    g_mutex_unlock (&save_mutex);
+
+    /* Write what is left synchronously */
+    if (xed_metadata_manager->metadata_filename != NULL &&
+        (xed_metadata_manager->pending->len > 0 ||
+         xed_metadata_manager->needs_rewrite ||
+         g_hash_table_size (xed_metadata_manager->touched) > 0))
+    {
+        SaveData *save;
+
+        save = save_data_new ();
+        write_metadata (save, NULL);
+        release_snapshot (save);
+        save_data_free (save);
     }
 
     if (xed_metadata_manager->items != NULL)
         g_hash_table_destroy (xed_metadata_manager->items);
 
+    g_string_free (xed_metadata_manager->pending, TRUE);
+    g_hash_table_destroy (xed_metadata_manager->touched);
     g_free (xed_metadata_manager->metadata_filename);
+    g_free (xed_metadata_manager->journal_filename);
+    g_free (xed_metadata_manager->lock_filename);
     g_free (xed_metadata_manager);
     xed_metadata_manager = NULL;
 }
@@ -178,14 +428,17 @@ parseItem (xmlDocPtr doc, xmlNodePtr cur)
         return;
     }
 
-    item = g_new0 (Item, 1);
+    item = g_hash_table_lookup (xed_metadata_manager->items, (gchar *)uri);
+    if (item == NULL)
+        item = item_new ((gchar *)uri);
 
     item->atime = g_ascii_strtoll ((char *)atime, NULL, 0);
 
-    item->values = g_hash_table_new_full (g_str_hash,
-                          g_str_equal,
-                          g_free,
-                          g_free);
+    if (item->values == NULL)
+        item->values = g_hash_table_new_full (g_str_hash,
+                              g_str_equal,
+                              g_free,
+                              g_free);
 
     cur = cur->xmlChildrenNode;
 
@@ -213,16 +466,154 @@ parseItem (xmlDocPtr doc, xmlNodePtr cur)
         cur = cur->next;
     }
 
-    g_hash_table_insert (xed_metadata_manager->items,
-                 g_strdup ((gchar *)uri),
-                 item);
-
     xmlFree (uri);
     xmlFree (atime);
 }
 
+static gint
+compare_atime (gconstpointer a,
+               gconstpointer b,
+               gpointer      user_data)
+{
+    const Item *item_a = a;
+    const Item *item_b = b;
+
+    /* most recent first */
+    return (item_a->atime < item_b->atime) - (item_a->atime > item_b->atime);
+}
+
+static void
+replay_journal_entry (gchar **fields)
+{
+    Item *item;
+    gchar *uri;
+    gint64 atime;
+    guint n_fields;
+
+    n_fields = g_strv_length (fields);
+    if (n_fields < 3)
+        return;
+
+    uri = g_strcompress (fields[1]);
+    atime = g_ascii_strtoll (fields[2], NULL, 0);
+
+    item = g_hash_table_lookup (xed_metadata_manager->items, uri);
+    if (item == NULL)
+        item = item_new (uri);
+
+    item_touch (item, atime);
+
+    if (strcmp (fields[0], "set") == 0 && n_fields == 5)
+    {
+        gchar *key = g_strcompress (fields[3]);
+        gchar *value = g_strcompress (fields[4]);
+
+        item_set_value (item, key, value);
+
+        g_free (key);
+        g_free (value);
+    }
+    else if (strcmp (fields[0], "unset") == 0 && n_fields == 4)
+    {
+        gchar *key = g_strcompress (fields[3]);
+
+        item_set_value (item, key, NULL);
+
+        g_free (key);
+    }
+
+    g_free (uri);
+}
+
+/* Applies the changes recorded since the metadata file was written */
+static void
+replay_journal (void)
+{
+    gchar *contents;
+    gchar **lines;
+    gsize folded;
+    gint i;
+
+    if (xed_metadata_manager->journal_filename == NULL ||
+        !g_file_get_contents (xed_metadata_manager->journal_filename, &contents, NULL, NULL))
+    {
+        return;
+    }
+
+    lines = g_strsplit (contents, "\n", -1);
+    folded = 0;
+
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        gchar **fields;
+
+        /* the last line may have been cut short by a crash */
+        if (lines[i + 1] == NULL)
+            break;
+
+        fields = g_strsplit (lines[i], "\t", 5);
+        replay_journal_entry (fields);
+        g_strfreev (fields);
+
+        xed_metadata_manager->journal_entries++;
+        folded += strlen (lines[i]) + 1;
+    }
+
+    g_mutex_lock (&save_mutex);
+    journal_folded = folded;
+    g_mutex_unlock (&save_mutex);
+
+    g_strfreev (lines);
+    g_free (contents);
+}
+
+/* Orders the LRU queue by access time, once the metadata file is read */
+static void
+sort_items (void)
+{
+    GQueue *lru = &xed_metadata_manager->lru;
+    GList *items = NULL;
+    GList *l;
+
+    while (lru->head != NULL)
+    {
+        Item *item = lru->head->data;
+
+        g_queue_unlink (lru, &item->lru_link);
+        items = g_list_prepend (items, item);
+    }
+
+    items = g_list_sort_with_data (items, compare_atime, NULL);
+
+    for (l = items; l != NULL; l = l->next)
+    {
+        Item *item = l->data;
+
+        g_queue_push_tail_link (lru, &item->lru_link);
+    }
+
+    g_list_free (items);
+}
+
 static gboolean
 load_values (void)
+{
+    gboolean ret;
+
+    ret = load_metadata_file ();
+
+    if (ret)
+    {
+        sort_items ();
+        replay_journal ();
+        resize_items ();
+    }
+
+    return ret;
+}
+
+static gboolean
+load_metadata_file (void)
 {
     xmlDocPtr doc;
     xmlNodePtr cur;
@@ -236,7 +627,6 @@ load_values (void)
 
     xmlKeepBlanksDefault (0);
 
-    /* FIXME: file locking - Paolo */
     if (xed_metadata_manager->metadata_filename == NULL)
     {
         return FALSE;
@@ -330,7 +720,8 @@ xed_metadata_manager_get (GFile *location,
     if (item == NULL)
         return NULL;
 
-    item->atime = g_get_real_time () / 1000;
+    item_touch (item, g_get_real_time () / 1000);
+    g_hash_table_add (xed_metadata_manager->touched, g_strdup (item->uri));
 
     if (item->values == NULL)
         return NULL;
@@ -384,27 +775,19 @@ xed_metadata_manager_set (GFile *location,
 
     if (item == NULL)
     {
-        item = g_new0 (Item, 1);
-
-        g_hash_table_insert (xed_metadata_manager->items,
-                     g_strdup (uri),
-                     item);
+        item = item_new (uri);
     }
 
-    if (item->values == NULL)
-         item->values = g_hash_table_new_full (g_str_hash,
-                               g_str_equal,
-                               g_free,
-                               g_free);
+    item_set_value (item, key, value);
+    item_touch (item, g_get_real_time () / 1000);
+    g_hash_table_remove (xed_metadata_manager->touched, uri);
+
     if (value != NULL)
-        g_hash_table_insert (item->values,
-                     g_strdup (key),
-                     g_strdup (value));
+        journal_append ("set", item, key, value);
     else
-        g_hash_table_remove (item->values,
-                     key);
+        journal_append ("unset", item, key, NULL);
 
-    item->atime = g_get_real_time () / 1000;
+    resize_items ();
 
     g_free (uri);
 
@@ -443,10 +826,9 @@ save_values (const gchar *key, const gchar *value, xmlNodePtr parent)
 }
 
 static void
-save_item (const gchar *key, const gpointer *data, xmlNodePtr parent)
+save_item (const gchar *key, const Item *item, xmlNodePtr parent)
 {
     xmlNodePtr xml_node;
-    const Item *item = (const Item *)data;
     gchar *atime;
 
 #ifdef XED_METADATA_VERBOSE_DEBUG
@@ -475,99 +857,427 @@ save_item (const gchar *key, const gpointer *data, xmlNodePtr parent)
 
     g_free (atime);
 
+    if (item->values != NULL)
         g_hash_table_foreach (item->values,
                   (GHFunc)save_values,
                   xml_node);
 }
 
+static Item *
+snapshot_item (Item *item)
+{
+    Item *copy;
+
+    copy = g_new0 (Item, 1);
+    copy->uri = g_strdup (item->uri);
+    copy->atime = item->atime;
+
+    if (item->values != NULL)
+    {
+        copy->values = g_hash_table_ref (item->values);
+        item->values_shared = TRUE;
+    }
+
+    return copy;
+}
+
+/* Called on the main thread once the save is done with the snapshot, the
+ * items whose values it still shares can change them in place again */
 static void
-get_oldest (const gchar *key, const gpointer value, const gchar ** key_to_remove)
+release_snapshot (SaveData *save)
 {
-    const Item *item = (const Item *)value;
+    guint i;
 
-    if (*key_to_remove == NULL)
+    if (save->snapshot == NULL)
+        return;
+
+    for (i = 0; i < save->snapshot->len; i++)
     {
-        *key_to_remove = key;
+        Item *copy = g_ptr_array_index (save->snapshot, i);
+        Item *item;
+
+        item = g_hash_table_lookup (xed_metadata_manager->items, copy->uri);
+
+        if (item != NULL && item->values == copy->values)
+            item->values_shared = FALSE;
     }
-    else
+
+    g_ptr_array_unref (save->snapshot);
+    save->snapshot = NULL;
+}
+
+static void
+snapshot_item_free (Item *item)
+{
+    if (item->values != NULL)
+        g_hash_table_unref (item->values);
+
+    g_free (item->uri);
+    g_free (item);
+}
+
+static guint
+count_entries (const GString *journal)
+{
+    const gchar *p;
+    guint n_entries = 0;
+
+    for (p = journal->str; *p != '\0'; p++)
     {
-        const Item *item_to_remove =
-            g_hash_table_lookup (xed_metadata_manager->items,
-                         *key_to_remove);
+        if (*p == '\n')
+            n_entries++;
+    }
+
+    return n_entries;
+}
 
-        g_return_if_fail (item_to_remove != NULL);
+/* Journals the access time of the items read since the last save */
+static void
+journal_touched (void)
+{
+    GHashTableIter iter;
+    gpointer uri;
 
-        if (item->atime < item_to_remove->atime)
+    g_hash_table_iter_init (&iter, xed_metadata_manager->touched);
+    while (g_hash_table_iter_next (&iter, &uri, NULL))
+    {
+        Item *item = g_hash_table_lookup (xed_metadata_manager->items, uri);
+
+        if (item != NULL)
+            journal_append ("touch", item, NULL, NULL);
+    }
+
+    g_hash_table_remove_all (xed_metadata_manager->touched);
+}
+
+/* Takes the pending journal entries and, when the journal has grown too
+ * long, a copy on write snapshot of the items */
+static SaveData *
+save_data_new (void)
+{
+    SaveData *save;
+    guint max_entries;
+
+    journal_touched ();
+
+    save = g_slice_new0 (SaveData);
+    save->metadata_filename = g_strdup (xed_metadata_manager->metadata_filename);
+    save->journal_filename = g_strdup (xed_metadata_manager->journal_filename);
+    save->lock_filename = g_strdup (xed_metadata_manager->lock_filename);
+
+    save->journal = xed_metadata_manager->pending;
+    xed_metadata_manager->pending = g_string_new (NULL);
+    xed_metadata_manager->journal_entries += count_entries (save->journal);
+
+    max_entries = MAX (JOURNAL_MIN_ENTRIES,
+                       JOURNAL_ENTRIES_FACTOR * xed_metadata_manager->max_items);
+
+    if (xed_metadata_manager->needs_rewrite ||
+        xed_metadata_manager->journal_entries > max_entries)
+    {
+        GList *l;
+
+        resize_items ();
+
+        save->snapshot = g_ptr_array_new_full (xed_metadata_manager->lru.length,
+                                               (GDestroyNotify)snapshot_item_free);
+
+        for (l = xed_metadata_manager->lru.head; l != NULL; l = l->next)
         {
-            *key_to_remove = key;
+            g_ptr_array_add (save->snapshot, snapshot_item (l->data));
         }
+
+        xed_metadata_manager->journal_entries = 0;
+        xed_metadata_manager->needs_rewrite = FALSE;
     }
+
+    return save;
 }
 
 static void
-resize_items (void)
+save_data_free (SaveData *save)
 {
-    while (g_hash_table_size (xed_metadata_manager->items) > MAX_ITEMS)
+    g_free (save->metadata_filename);
+    g_free (save->journal_filename);
+    g_free (save->lock_filename);
+    g_string_free (save->journal, TRUE);
+
+    if (save->snapshot != NULL)
+        g_ptr_array_unref (save->snapshot);
+
+    g_slice_free (SaveData, save);
+}
+
+/* Takes the lock shared with the other xed processes, it is released
+ * when the returned descriptor is closed */
+static gint
+lock_metadata (const gchar  *lock_filename,
+               GError      **error)
+{
+    gint fd;
+
+    fd = g_open (lock_filename, O_RDWR | O_CREAT, 0600);
+    if (fd == -1)
     {
-        gpointer key_to_remove = NULL;
+        gint errsv = errno;
 
-        g_hash_table_foreach (xed_metadata_manager->items,
-                      (GHFunc)get_oldest,
-                      &key_to_remove);
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Could not open '%s': %s", lock_filename, g_strerror (errsv));
+        return -1;
+    }
+
+    while (lockf (fd, F_LOCK, 0) == -1)
+    {
+        gint errsv = errno;
 
-        g_return_if_fail (key_to_remove != NULL);
+        if (errsv == EINTR)
+            continue;
 
-        g_hash_table_remove (xed_metadata_manager->items,
-                     key_to_remove);
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Could not lock '%s': %s", lock_filename, g_strerror (errsv));
+        close (fd);
+        return -1;
     }
+
+    return fd;
 }
 
 static gboolean
-xed_metadata_manager_save (gpointer data)
+append_journal (SaveData  *save,
+                GError   **error)
 {
-    xmlDocPtr  doc;
-    xmlNodePtr root;
+    FILE *journal;
+    GStatBuf buf;
+    gsize length;
+    gboolean ret;
 
-    xed_debug (DEBUG_METADATA);
+    length = g_stat (save->journal_filename, &buf) == 0 ? buf.st_size : 0;
 
-    xed_metadata_manager->timeout_id = 0;
+    journal = g_fopen (save->journal_filename, "a");
+    if (journal == NULL)
+    {
+        gint errsv = errno;
 
-    resize_items ();
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                     "Could not open '%s': %s", save->journal_filename, g_strerror (errsv));
+        return FALSE;
+    }
+
+    ret = fwrite (save->journal->str, 1, save->journal->len, journal) == save->journal->len;
+    ret = fclose (journal) == 0 && ret;
+
+    if (!ret)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Could not write '%s'", save->journal_filename);
+    }
+    /* Nothing was appended by another process since our last look, so
+     * the whole journal is still known */
+    else if (length == 0 || length == journal_folded)
+    {
+        journal_folded = length + save->journal->len;
+    }
+
+    return ret;
+}
+
+/* Removes the head of the journal which is in the metadata file now, and
+ * keeps what other processes appended after it */
+static gboolean
+drop_folded_journal (SaveData  *save,
+                     GError   **error)
+{
+    gchar *contents;
+    gsize length;
+    gboolean ret = TRUE;
+
+    if (!g_file_get_contents (save->journal_filename, &contents, &length, NULL))
+    {
+        journal_folded = 0;
+        return TRUE;
+    }
+
+    if (length <= journal_folded)
+        g_unlink (save->journal_filename);
+    else
+        ret = g_file_set_contents (save->journal_filename,
+                                   contents + journal_folded,
+                                   length - journal_folded,
+                                   error);
+
+    /* What is left was never folded in */
+    if (ret)
+        journal_folded = 0;
+
+    g_free (contents);
+
+    return ret;
+}
+
+/* Rewrites the whole metadata file from the snapshot. The file is written
+ * next to the old one and renamed over it, so it is never seen half written */
+static gboolean
+write_metadata_file (SaveData  *save,
+                     GError   **error)
+{
+    xmlDocPtr  doc;
+    xmlNodePtr root;
+    xmlChar   *contents;
+    gint       length;
+    gboolean   ret;
+    guint      i;
 
     xmlIndentTreeOutput = TRUE;
 
     doc = xmlNewDoc ((const xmlChar *)"1.0");
     if (doc == NULL)
-        return TRUE;
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             "Could not create the metadata document");
+        return FALSE;
+    }
 
     /* Create metadata root */
     root = xmlNewDocNode (doc, NULL, (const xmlChar *)"metadata", NULL);
     xmlDocSetRootElement (doc, root);
 
-        g_hash_table_foreach (xed_metadata_manager->items,
-                  (GHFunc)save_item,
-                  root);
+    for (i = 0; i < save->snapshot->len; i++)
+    {
+        Item *item = g_ptr_array_index (save->snapshot, i);
+
+        save_item (item->uri, item, root);
+    }
+
+    xmlDocDumpFormatMemory (doc, &contents, &length, 1);
+    xmlFreeDoc (doc);
+
+    ret = g_file_set_contents (save->metadata_filename, (const gchar *)contents, length, error);
+    xmlFree (contents);
+
+    if (ret)
+        ret = drop_folded_journal (save, error);
+
+    return ret;
+}
+
+static gboolean
+write_metadata (SaveData  *save,
+                GError   **error)
+{
+    gchar *cache_dir;
+    gint lock_fd;
+    gboolean ret = TRUE;
+
+    g_mutex_lock (&save_mutex);
+
+    /* make sure the cache dir exists */
+    cache_dir = g_path_get_dirname (save->metadata_filename);
+    g_mkdir_with_parents (cache_dir, 0755);
+    g_free (cache_dir);
 
-    /* FIXME: lock file - Paolo */
-    if (xed_metadata_manager->metadata_filename != NULL)
+    lock_fd = lock_metadata (save->lock_filename, error);
+    if (lock_fd == -1)
     {
-        gchar *cache_dir;
-        int res;
+        g_mutex_unlock (&save_mutex);
+        return FALSE;
+    }
 
-        /* make sure the cache dir exists */
-        cache_dir = g_path_get_dirname (xed_metadata_manager->metadata_filename);
-        res = g_mkdir_with_parents (cache_dir, 0755);
-        if (res != -1)
-        {
-            xmlSaveFormatFile (xed_metadata_manager->metadata_filename, doc, 1);
-        }
+    /* The journal is appended even when the metadata file is rewritten,
+     * nothing is lost if the rewrite fails */
+    if (save->journal->len > 0)
+        ret = append_journal (save, error);
+
+    if (ret && save->snapshot != NULL)
+        ret = write_metadata_file (save, error);
 
-        g_free (cache_dir);
+    close (lock_fd);
+
+    g_mutex_unlock (&save_mutex);
+
+    return ret;
+}
+
+static void
+save_thread (GTask        *task,
+             gpointer      source_object,
+             gpointer      task_data,
+             GCancellable *cancellable)
+{
+    GError *error = NULL;
+    gboolean ret;
+
+    ret = write_metadata (task_data, &error);
+
+    g_mutex_lock (&save_mutex);
+    save_running = FALSE;
+    g_cond_broadcast (&save_cond);
+    g_mutex_unlock (&save_mutex);
+
+    if (ret)
+        g_task_return_boolean (task, TRUE);
+    else
+        g_task_return_error (task, error);
+}
+
+static void
+save_ready_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+    GError *error = NULL;
+
+    if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+        g_warning ("Could not save the metadata: %s", error->message);
+        g_error_free (error);
     }
 
-    xmlFreeDoc (doc);
+    /* the manager may be gone if xed is shutting down */
+    if (xed_metadata_manager == NULL)
+        return;
+
+    release_snapshot (g_task_get_task_data (G_TASK (result)));
+
+    xed_metadata_manager->save_in_progress = FALSE;
+
+    if (xed_metadata_manager->pending->len > 0 || xed_metadata_manager->needs_rewrite)
+        xed_metadata_manager_arm_timeout ();
 
     xed_debug_message (DEBUG_METADATA, "DONE");
+}
+
+static gboolean
+xed_metadata_manager_save (gpointer data)
+{
+    GTask *task;
+
+    xed_debug (DEBUG_METADATA);
+
+    xed_metadata_manager->timeout_id = 0;
+
+    if (xed_metadata_manager->metadata_filename == NULL)
+    {
+        g_string_truncate (xed_metadata_manager->pending, 0);
+        return FALSE;
+    }
+
+    /* save_ready_cb () arms the timeout again if needed */
+    if (xed_metadata_manager->save_in_progress)
+        return FALSE;
+
+    if (xed_metadata_manager->pending->len == 0 && !xed_metadata_manager->needs_rewrite)
+        return FALSE;
+
+    xed_metadata_manager->save_in_progress = TRUE;
+
+    g_mutex_lock (&save_mutex);
+    save_running = TRUE;
+    g_mutex_unlock (&save_mutex);
+
+    task = g_task_new (NULL, NULL, save_ready_cb, NULL);
+    g_task_set_task_data (task, save_data_new (), (GDestroyNotify)save_data_free);
+    g_task_run_in_thread (task, save_thread);
+    g_object_unref (task);
 
     return FALSE;
 }
@@ -36,6 +36,8 @@ G_BEGIN_DECLS
 
 void xed_metadata_manager_init (const gchar *metadata_filename);
 
+void xed_metadata_manager_set_max_items (guint max_items);
+
 /* This function must be called before exiting xed */
 void xed_metadata_manager_shutdown (void);
 
@@ -31,6 +31,7 @@
 #include <config.h>
 #include <string.h>
 #include <glib/gi18n.h>
+#include <gmodule.h>
 #if PYGOBJECT_MAJOR_VERSION > 3 || (PYGOBJECT_MAJOR_VERSION == 3 && PYGOBJECT_MINOR_VERSION > 50)
 #include <girepository/girepository.h>
 #else
@@ -42,29 +43,99 @@
 #include "xed-app.h"
 #include "xed-dirs.h"
 #include "xed-settings.h"
+#include "xed-trace.h"
 #include "xed-utils.h"
 
+/*
+ * Plugins are not all loaded before the first window. The key
+ * X-Activation of a .plugin file tells when a plugin is:
+ *
+ *  - eager: while the engine is created, the default for C plugins
+ *  - deferred: from idles once a window was drawn, the default for the
+ *    plugins of other loaders, which start an interpreter
+ *  - on-demand: when asked for, or once the user starts using a window
+ */
+typedef enum
+{
+    ACTIVATION_EAGER,
+    ACTIVATION_DEFERRED,
+    ACTIVATION_ON_DEMAND
+} ActivationPolicy;
+
 struct _XedPluginsEnginePrivate
 {
     GSettings *plugin_settings;
+
+    /* Plugins to load, which count as active in the settings meanwhile */
+    GQueue deferred;
+    GQueue on_demand;
+    guint deferred_idle_id;
+    gboolean deferred_started;
+
+    gboolean python_ready;
+
+    /* Set while the active plugins are synced with the settings */
+    gboolean syncing;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (XedPluginsEngine, xed_plugins_engine, PEAS_TYPE_ENGINE)
 
 XedPluginsEngine *default_engine = NULL;
 
+/* libpeas doesn't tell the loader, but only C plugins are libraries */
+static gboolean
+is_c_plugin (PeasPluginInfo *info)
+{
+    gchar *module_path;
+    gboolean exists;
+
+    module_path = g_module_build_path (peas_plugin_info_get_module_dir (info),
+                                       peas_plugin_info_get_module_name (info));
+    exists = g_file_test (module_path, G_FILE_TEST_EXISTS);
+    g_free (module_path);
+
+    return exists;
+}
+
+static ActivationPolicy
+get_activation_policy (PeasPluginInfo *info)
+{
+    const gchar *activation;
+
+    activation = peas_plugin_info_get_external_data (info, "Activation");
+
+    if (g_strcmp0 (activation, "eager") == 0)
+    {
+        return ACTIVATION_EAGER;
+    }
+    else if (g_strcmp0 (activation, "deferred") == 0)
+    {
+        return ACTIVATION_DEFERRED;
+    }
+    else if (g_strcmp0 (activation, "on-demand") == 0)
+    {
+        return ACTIVATION_ON_DEMAND;
+    }
+
+    return is_c_plugin (info) ? ACTIVATION_EAGER : ACTIVATION_DEFERRED;
+}
+
+/* Done before the first python plugin is loaded rather than at startup, as
+ * the typelibs are only needed there */
 static void
-xed_plugins_engine_init (XedPluginsEngine *engine)
+ensure_python_support (XedPluginsEngine *engine)
 {
     gchar *typelib_dir;
     GError *error = NULL;
-    const GList *all_plugins, *l;
 
-    xed_debug (DEBUG_PLUGINS);
+    if (engine->priv->python_ready)
+    {
+        return;
+    }
 
-    engine->priv = xed_plugins_engine_get_instance_private (engine);
+    engine->priv->python_ready = TRUE;
 
-    engine->priv->plugin_settings = g_settings_new ("org.x.editor.plugins");
+    xed_trace_begin ("plugins", "python-support");
 
     peas_engine_enable_loader (PEAS_ENGINE (engine), "python3");
 
@@ -106,6 +177,238 @@ xed_plugins_engine_init (XedPluginsEngine *engine)
         error = NULL;
     }
 
+    xed_trace_end ("plugins", "python-support");
+}
+
+static gboolean
+is_pending (XedPluginsEngine *engine,
+            PeasPluginInfo   *info)
+{
+    return g_queue_find (&engine->priv->deferred, info) != NULL ||
+           g_queue_find (&engine->priv->on_demand, info) != NULL;
+}
+
+static void
+load_plugin_now (XedPluginsEngine *engine,
+                 PeasPluginInfo   *info)
+{
+    g_queue_remove (&engine->priv->deferred, info);
+    g_queue_remove (&engine->priv->on_demand, info);
+
+    if (!peas_engine_load_plugin (PEAS_ENGINE (engine), info))
+    {
+        g_warning ("Failed to load plugin: %s", peas_plugin_info_get_name (info));
+    }
+}
+
+static gboolean
+load_deferred_idle (XedPluginsEngine *engine)
+{
+    PeasPluginInfo *info;
+
+    /* One plugin at a time, so that the windows stay responsive */
+    info = g_queue_peek_head (&engine->priv->deferred);
+
+    if (info != NULL)
+    {
+        load_plugin_now (engine, info);
+    }
+
+    if (g_queue_is_empty (&engine->priv->deferred))
+    {
+        engine->priv->deferred_idle_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+schedule_deferred (XedPluginsEngine *engine)
+{
+    if (engine->priv->deferred_started &&
+        engine->priv->deferred_idle_id == 0 &&
+        !g_queue_is_empty (&engine->priv->deferred))
+    {
+        engine->priv->deferred_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                                          (GSourceFunc) load_deferred_idle,
+                                                          engine,
+                                                          NULL);
+    }
+}
+
+static void
+schedule_plugin (XedPluginsEngine *engine,
+                 PeasPluginInfo   *info)
+{
+    if (peas_plugin_info_is_loaded (info) || is_pending (engine, info))
+    {
+        return;
+    }
+
+    switch (get_activation_policy (info))
+    {
+        case ACTIVATION_EAGER:
+            load_plugin_now (engine, info);
+            break;
+        case ACTIVATION_DEFERRED:
+            g_queue_push_tail (&engine->priv->deferred, info);
+            schedule_deferred (engine);
+            break;
+        case ACTIVATION_ON_DEMAND:
+            g_queue_push_tail (&engine->priv->on_demand, info);
+            break;
+    }
+}
+
+static void
+append_pending (GPtrArray *names,
+                GQueue    *pending)
+{
+    GList *l;
+
+    for (l = pending->head; l != NULL; l = l->next)
+    {
+        g_ptr_array_add (names, (gpointer) peas_plugin_info_get_module_name (l->data));
+    }
+}
+
+static gboolean
+strv_contains (gchar       **strv,
+               const gchar  *str)
+{
+    for (; *strv != NULL; strv++)
+    {
+        if (g_strcmp0 (*strv, str) == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Plugins waiting to be loaded stay active, as they were */
+static void
+save_active_plugins (XedPluginsEngine *engine)
+{
+    GPtrArray *names;
+    gchar **loaded;
+    gchar **active;
+    gchar **l;
+    gboolean changed;
+    guint i;
+
+    if (engine->priv->syncing)
+    {
+        return;
+    }
+
+    names = g_ptr_array_new ();
+    loaded = peas_engine_get_loaded_plugins (PEAS_ENGINE (engine));
+
+    for (l = loaded; *l != NULL; l++)
+    {
+        g_ptr_array_add (names, *l);
+    }
+
+    append_pending (names, &engine->priv->deferred);
+    append_pending (names, &engine->priv->on_demand);
+
+    /* A deferred plugin being loaded changes nothing */
+    active = g_settings_get_strv (engine->priv->plugin_settings, XED_SETTINGS_ACTIVE_PLUGINS);
+    changed = names->len != g_strv_length (active);
+
+    for (i = 0; i < names->len && !changed; i++)
+    {
+        changed = !strv_contains (active, g_ptr_array_index (names, i));
+    }
+
+    g_ptr_array_add (names, NULL);
+
+    if (changed)
+    {
+        engine->priv->syncing = TRUE;
+        g_settings_set_strv (engine->priv->plugin_settings,
+                             XED_SETTINGS_ACTIVE_PLUGINS,
+                             (const gchar * const *) names->pdata);
+        engine->priv->syncing = FALSE;
+    }
+
+    g_ptr_array_free (names, TRUE);
+    g_strfreev (active);
+    g_strfreev (loaded);
+}
+
+static void
+load_active_plugins (XedPluginsEngine *engine)
+{
+    const GList *l;
+    gchar **active;
+
+    active = g_settings_get_strv (engine->priv->plugin_settings, XED_SETTINGS_ACTIVE_PLUGINS);
+
+    engine->priv->syncing = TRUE;
+
+    for (l = peas_engine_get_plugin_list (PEAS_ENGINE (engine)); l != NULL; l = l->next)
+    {
+        PeasPluginInfo *info = l->data;
+        gboolean is_active;
+
+        is_active = peas_plugin_info_is_builtin (info) ||
+                    strv_contains (active, peas_plugin_info_get_module_name (info));
+
+        if (is_active)
+        {
+            schedule_plugin (engine, info);
+        }
+        else if (is_pending (engine, info))
+        {
+            g_queue_remove (&engine->priv->deferred, info);
+            g_queue_remove (&engine->priv->on_demand, info);
+        }
+        else if (peas_plugin_info_is_loaded (info))
+        {
+            peas_engine_unload_plugin (PEAS_ENGINE (engine), info);
+        }
+    }
+
+    engine->priv->syncing = FALSE;
+
+    g_strfreev (active);
+}
+
+static void
+on_active_plugins_changed (GSettings        *settings,
+                           const gchar      *key,
+                           XedPluginsEngine *engine)
+{
+    if (!engine->priv->syncing)
+    {
+        load_active_plugins (engine);
+    }
+}
+
+static void
+on_loaded_plugins_changed (XedPluginsEngine *engine,
+                           GParamSpec       *pspec,
+                           gpointer          user_data)
+{
+    save_active_plugins (engine);
+}
+
+static void
+xed_plugins_engine_init (XedPluginsEngine *engine)
+{
+    xed_debug (DEBUG_PLUGINS);
+
+    engine->priv = xed_plugins_engine_get_instance_private (engine);
+
+    engine->priv->plugin_settings = g_settings_new ("org.x.editor.plugins");
+
+    g_queue_init (&engine->priv->deferred);
+    g_queue_init (&engine->priv->on_demand);
+
     peas_engine_add_search_path (PEAS_ENGINE (engine),
                                  xed_dirs_get_user_plugins_dir (),
                                  xed_dirs_get_user_plugins_dir ());
@@ -114,28 +417,43 @@ xed_plugins_engine_init (XedPluginsEngine *engine)
                                  xed_dirs_get_xed_plugins_dir(),
                                  xed_dirs_get_xed_plugins_data_dir());
 
-    g_settings_bind (engine->priv->plugin_settings,
-                     XED_SETTINGS_ACTIVE_PLUGINS,
-                     engine,
-                     "loaded-plugins",
-                     G_SETTINGS_BIND_DEFAULT);
+    /* Rather than binding the settings to "loaded-plugins", which would
+     * load all the plugins right away */
+    load_active_plugins (engine);
 
-    /* Load our builtin plugins */
-    all_plugins = peas_engine_get_plugin_list (PEAS_ENGINE (engine));
+    g_signal_connect (engine->priv->plugin_settings,
+                      "changed::" XED_SETTINGS_ACTIVE_PLUGINS,
+                      G_CALLBACK (on_active_plugins_changed),
+                      engine);
 
-    for (l = all_plugins; l != NULL; l = l->next)
-    {
-        if (peas_plugin_info_is_builtin (l->data))
-        {
-            gboolean loaded;
+    g_signal_connect (engine,
+                      "notify::loaded-plugins",
+                      G_CALLBACK (on_loaded_plugins_changed),
+                      NULL);
+}
 
-            loaded = peas_engine_load_plugin (PEAS_ENGINE (engine), l->data);
-            if (!loaded)
-            {
-                g_warning ("Failed to load builtin plugin: %s", peas_plugin_info_get_name (l->data));
-            }
-        }
+static void
+xed_plugins_engine_load_plugin (PeasEngine     *engine,
+                                PeasPluginInfo *info)
+{
+    const gchar *module_name;
+    gint64 start_time;
+
+    if (!is_c_plugin (info))
+    {
+        ensure_python_support (XED_PLUGINS_ENGINE (engine));
     }
+
+    module_name = peas_plugin_info_get_module_name (info);
+    start_time = g_get_monotonic_time ();
+
+    /* Activating the extensions in the open windows is part of it */
+    xed_trace_begin ("plugins", module_name);
+    PEAS_ENGINE_CLASS (xed_plugins_engine_parent_class)->load_plugin (engine, info);
+    xed_trace_end ("plugins", module_name);
+
+    xed_debug_message (DEBUG_PLUGINS, "Loaded %s in %.2f ms",
+                       module_name, (g_get_monotonic_time () - start_time) / 1000.0);
 }
 
 static void
@@ -143,6 +461,15 @@ xed_plugins_engine_dispose (GObject *object)
 {
     XedPluginsEngine *engine = XED_PLUGINS_ENGINE (object);
 
+    if (engine->priv->deferred_idle_id != 0)
+    {
+        g_source_remove (engine->priv->deferred_idle_id);
+        engine->priv->deferred_idle_id = 0;
+    }
+
+    g_queue_clear (&engine->priv->deferred);
+    g_queue_clear (&engine->priv->on_demand);
+
     if (engine->priv->plugin_settings != NULL)
     {
         g_object_unref (engine->priv->plugin_settings);
@@ -156,8 +483,11 @@ static void
 xed_plugins_engine_class_init (XedPluginsEngineClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    PeasEngineClass *engine_class = PEAS_ENGINE_CLASS (klass);
 
     object_class->dispose = xed_plugins_engine_dispose;
+
+    engine_class->load_plugin = xed_plugins_engine_load_plugin;
 }
 
 XedPluginsEngine *
@@ -171,3 +501,78 @@ xed_plugins_engine_get_default (void)
 
     return default_engine;
 }
+
+/**
+ * xed_plugins_engine_start_deferred:
+ * @engine: a #XedPluginsEngine
+ *
+ * Starts loading the deferred plugins from idles, once a window was drawn.
+ */
+void
+xed_plugins_engine_start_deferred (XedPluginsEngine *engine)
+{
+    g_return_if_fail (XED_IS_PLUGINS_ENGINE (engine));
+
+    if (engine->priv->deferred_started)
+    {
+        return;
+    }
+
+    xed_debug_message (DEBUG_PLUGINS, "%u deferred plugins", g_queue_get_length (&engine->priv->deferred));
+
+    engine->priv->deferred_started = TRUE;
+    schedule_deferred (engine);
+}
+
+/**
+ * xed_plugins_engine_load_on_demand:
+ * @engine: a #XedPluginsEngine
+ * @module_name: (nullable): the module of the plugin, or %NULL for all
+ * the plugins loaded on demand
+ *
+ * Loads a plugin waiting to be used now, if it is active.
+ */
+void
+xed_plugins_engine_load_on_demand (XedPluginsEngine *engine,
+                                   const gchar      *module_name)
+{
+    GList *l;
+
+    g_return_if_fail (XED_IS_PLUGINS_ENGINE (engine));
+
+    l = engine->priv->on_demand.head;
+
+    while (l != NULL)
+    {
+        PeasPluginInfo *info = l->data;
+
+        l = l->next;
+
+        if (module_name == NULL || g_strcmp0 (peas_plugin_info_get_module_name (info), module_name) == 0)
+        {
+            load_plugin_now (engine, info);
+        }
+    }
+}
+
+/**
+ * xed_plugins_engine_load_pending:
+ * @engine: a #XedPluginsEngine
+ *
+ * Loads the active plugins still waiting to be loaded, deferred or on
+ * demand. The plugin manager only shows the loaded plugins as active.
+ */
+void
+xed_plugins_engine_load_pending (XedPluginsEngine *engine)
+{
+    PeasPluginInfo *info;
+
+    g_return_if_fail (XED_IS_PLUGINS_ENGINE (engine));
+
+    while ((info = g_queue_peek_head (&engine->priv->deferred)) != NULL)
+    {
+        load_plugin_now (engine, info);
+    }
+
+    xed_plugins_engine_load_on_demand (engine, NULL);
+}
@@ -59,9 +59,14 @@ struct _XedPluginsEngineClass
     PeasEngineClass parent_class;
 };
 
-GType             xed_plugins_engine_get_type    (void) G_GNUC_CONST;
+GType             xed_plugins_engine_get_type        (void) G_GNUC_CONST;
 
-XedPluginsEngine *xed_plugins_engine_get_default (void);
+XedPluginsEngine *xed_plugins_engine_get_default     (void);
+
+void              xed_plugins_engine_start_deferred  (XedPluginsEngine *engine);
+void              xed_plugins_engine_load_on_demand  (XedPluginsEngine *engine,
+                                                      const gchar      *module_name);
+void              xed_plugins_engine_load_pending    (XedPluginsEngine *engine);
 
 G_END_DECLS
 
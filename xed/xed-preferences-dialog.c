@@ -44,6 +44,7 @@
 #include "xed-debug.h"
 #include "xed-document.h"
 #include "xed-dirs.h"
+#include "xed-plugins-engine.h"
 #include "xed-settings.h"
 #include "xed-utils.h"
 
@@ -898,6 +899,9 @@ setup_plugins_page (XedPreferencesDialog *dlg)
 
     xed_debug (DEBUG_PREFS);
 
+    /* Otherwise the plugins not loaded yet would show as disabled */
+    xed_plugins_engine_load_pending (xed_plugins_engine_get_default ());
+
     page_content = peas_gtk_plugin_manager_new (NULL);
     g_return_if_fail (page_content != NULL);
 
@@ -223,3 +223,14 @@ xed_progress_info_bar_pulse (XedProgressInfoBar *bar)
 
     gtk_progress_bar_pulse (GTK_PROGRESS_BAR (bar->priv->progress));
 }
+
+/* Text shown over the progress bar, or NULL to hide it */
+void
+xed_progress_info_bar_set_progress_text (XedProgressInfoBar *bar,
+                                         const gchar        *text)
+{
+    g_return_if_fail (XED_IS_PROGRESS_INFO_BAR (bar));
+
+    gtk_progress_bar_set_text (GTK_PROGRESS_BAR (bar->priv->progress), text);
+    gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (bar->priv->progress), text != NULL);
+}
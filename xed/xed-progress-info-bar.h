@@ -79,6 +79,9 @@ void xed_progress_info_bar_set_fraction (XedProgressInfoBar *area,
 
 void xed_progress_info_bar_pulse (XedProgressInfoBar *area);
 
+void xed_progress_info_bar_set_progress_text (XedProgressInfoBar *area,
+                                              const gchar        *text);
+
 
 G_END_DECLS
 
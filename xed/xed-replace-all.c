@@ -0,0 +1,742 @@
+/*
+ * xed-replace-all.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Replaces all the occurrences of a search without blocking the main loop.
+ * The occurrences are taken from the XedSearchIndex of the context, which
+ * finds them a slice of time at a time. They are then replaced a batch per
+ * idle, all in the same user action so that a single undo reverts them.
+ * When the search is not a regex and there are many occurrences, the
+ * occurrences of each line are first merged on a worker thread into a
+ * single edit, which is far cheaper than one edit per occurrence while
+ * keeping the marks and the scroll position where they were.
+ *
+ * Undo and redo are blocked on the document for the whole run, and the
+ * run stops if the buffer is edited by anything else while occurrences are
+ * being replaced: the remaining offsets would point at the wrong text. */
+
+#include <config.h>
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "xed-replace-all.h"
+#include "xed-search-index.h"
+#include "xed-document-private.h"
+#include "xed-debug.h"
+
+/* Microseconds spent replacing occurrences per idle */
+#define REPLACE_TIME_SLICE 10000
+
+/* Occurrences of a literal search from which they are merged by line */
+#define MERGE_MIN_MATCHES 2000
+
+/* Occurrences merged on the worker thread between two looks at the
+ * cancellable */
+#define MERGE_CHECK_INTERVAL 4096
+
+typedef enum
+{
+    PHASE_SEARCHING,
+    PHASE_MERGING,
+    PHASE_REPLACING
+} Phase;
+
+/* The occurrences of a line with the text between them, replaced at once */
+typedef struct
+{
+    gint start;
+    gint end;
+    gchar *text;
+    guint n_matches;
+} ReplaceSpan;
+
+typedef struct
+{
+    GtkSourceSearchContext *search_context;
+    XedSearchIndex *search_index;
+    GtkTextBuffer *buffer;
+
+    gchar *replace;
+    gint replace_length;
+
+    XedReplaceAllProgressFunc progress_callback;
+    gpointer progress_callback_data;
+
+    Phase phase;
+    GArray *matches;
+    GArray *spans;
+    guint next_match;
+    gint delta;
+    gint n_replaced;
+
+    gulong index_changed_id;
+    gulong buffer_changed_id;
+    gulong cancelled_id;
+    guint idle_id;
+
+    guint literal : 1;
+    guint editing : 1;
+    guint buffer_modified : 1;
+} ReplaceAllData;
+
+/* Owned by the worker thread */
+typedef struct
+{
+    gchar *text;
+    GArray *matches;
+    gchar *replace;
+} MergeData;
+
+static gboolean step_cb (GTask *task);
+
+static void
+replace_all_data_free (ReplaceAllData *data)
+{
+    g_object_unref (data->search_index);
+    g_object_unref (data->search_context);
+    g_object_unref (data->buffer);
+    g_free (data->replace);
+
+    if (data->matches != NULL)
+    {
+        g_array_unref (data->matches);
+    }
+
+    if (data->spans != NULL)
+    {
+        g_array_unref (data->spans);
+    }
+
+    g_slice_free (ReplaceAllData, data);
+}
+
+static void
+merge_data_free (MergeData *data)
+{
+    g_free (data->text);
+    g_array_unref (data->matches);
+    g_free (data->replace);
+
+    g_slice_free (MergeData, data);
+}
+
+static void
+clear_span (ReplaceSpan *span)
+{
+    g_free (span->text);
+}
+
+static void
+report_progress (ReplaceAllData *data)
+{
+    if (data->progress_callback == NULL)
+    {
+        return;
+    }
+
+    if (data->phase == PHASE_SEARCHING)
+    {
+        data->progress_callback (-1,
+                                 xed_search_index_get_count (data->search_index),
+                                 data->progress_callback_data);
+    }
+    else
+    {
+        data->progress_callback (data->n_replaced,
+                                 data->matches->len,
+                                 data->progress_callback_data);
+    }
+}
+
+static void
+schedule_step (GTask *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+
+    if (data->idle_id == 0)
+    {
+        data->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                                         (GSourceFunc) step_cb,
+                                         g_object_ref (task),
+                                         g_object_unref);
+    }
+}
+
+static void
+begin_edits (ReplaceAllData *data)
+{
+    xed_search_index_freeze (data->search_index);
+
+    if (XED_IS_DOCUMENT (data->buffer))
+    {
+        _xed_document_set_stop_cursor_moved_emission (XED_DOCUMENT (data->buffer), TRUE);
+    }
+
+    gtk_text_buffer_begin_user_action (data->buffer);
+}
+
+static void
+end_edits (ReplaceAllData *data)
+{
+    gtk_text_buffer_end_user_action (data->buffer);
+
+    if (XED_IS_DOCUMENT (data->buffer))
+    {
+        _xed_document_set_stop_cursor_moved_emission (XED_DOCUMENT (data->buffer), FALSE);
+    }
+
+    xed_search_index_thaw (data->search_index);
+}
+
+/* Returns the result and drops the reference held while running */
+static void
+complete (GTask  *task,
+          GError *error)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+
+    if (data->idle_id != 0)
+    {
+        g_source_remove (data->idle_id);
+        data->idle_id = 0;
+    }
+
+    if (data->index_changed_id != 0)
+    {
+        g_signal_handler_disconnect (data->search_index, data->index_changed_id);
+        data->index_changed_id = 0;
+    }
+
+    if (data->buffer_changed_id != 0)
+    {
+        g_signal_handler_disconnect (data->buffer, data->buffer_changed_id);
+        data->buffer_changed_id = 0;
+    }
+
+    if (data->cancelled_id != 0)
+    {
+        g_signal_handler_disconnect (g_task_get_cancellable (task), data->cancelled_id);
+        data->cancelled_id = 0;
+    }
+
+    if (data->phase == PHASE_REPLACING)
+    {
+        end_edits (data);
+    }
+
+    if (XED_IS_DOCUMENT (data->buffer))
+    {
+        _xed_document_set_undo_blocked (XED_DOCUMENT (data->buffer), FALSE);
+    }
+
+    xed_debug_message (DEBUG_SEARCH, "%d occurrences replaced", data->n_replaced);
+
+    /* What was replaced before a cancellation stays, and can be undone */
+    if (error != NULL)
+    {
+        g_task_return_error (task, error);
+    }
+    else
+    {
+        g_task_return_int (task, data->n_replaced);
+    }
+
+    g_object_unref (task);
+}
+
+static void
+index_changed_cb (XedSearchIndex *search_index,
+                  GTask          *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+
+    if (xed_search_index_is_complete (search_index))
+    {
+        schedule_step (task);
+    }
+    else
+    {
+        report_progress (data);
+    }
+}
+
+static void
+buffer_changed_cb (GtkTextBuffer *buffer,
+                   GTask         *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+
+    if (!data->editing)
+    {
+        data->buffer_modified = TRUE;
+    }
+}
+
+static void
+cancelled_cb (GCancellable *cancellable,
+              GTask        *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+
+    /* The worker thread looks at the cancellable by itself */
+    if (data->phase != PHASE_MERGING)
+    {
+        schedule_step (task);
+    }
+}
+
+static void
+wait_for_matches (GTask *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+
+    data->phase = PHASE_SEARCHING;
+
+    if (xed_search_index_is_complete (data->search_index))
+    {
+        schedule_step (task);
+    }
+    else
+    {
+        report_progress (data);
+    }
+}
+
+static void
+flush_span (GArray      *spans,
+            ReplaceSpan *span,
+            GString     *text)
+{
+    span->text = g_string_free (text, FALSE);
+    g_array_append_val (spans, *span);
+}
+
+static void
+merge_thread (GTask        *task,
+              gpointer      source_object,
+              MergeData    *data,
+              GCancellable *cancellable)
+{
+    GArray *spans;
+    GString *text = NULL;
+    ReplaceSpan span = { 0 };
+    const gchar *p;
+    gint offset = 0;
+    guint i;
+
+    spans = g_array_new (FALSE, FALSE, sizeof (ReplaceSpan));
+    g_array_set_clear_func (spans, (GDestroyNotify) clear_span);
+
+    p = data->text;
+
+    for (i = 0; i < data->matches->len; i++)
+    {
+        XedSearchMatch *match = &g_array_index (data->matches, XedSearchMatch, i);
+        const gchar *match_start;
+
+        if (i % MERGE_CHECK_INTERVAL == 0 && g_task_return_error_if_cancelled (task))
+        {
+            if (text != NULL)
+            {
+                g_string_free (text, TRUE);
+            }
+
+            g_array_unref (spans);
+            return;
+        }
+
+        match_start = g_utf8_offset_to_pointer (p, match->start - offset);
+
+        /* Only the occurrences of a line are merged, so that the marks
+         * of the other lines stay where they are */
+        if (text != NULL && memchr (p, '\n', match_start - p) == NULL)
+        {
+            g_string_append_len (text, p, match_start - p);
+        }
+        else
+        {
+            if (text != NULL)
+            {
+                flush_span (spans, &span, text);
+            }
+
+            text = g_string_new (NULL);
+            span.start = match->start;
+            span.n_matches = 0;
+        }
+
+        g_string_append (text, data->replace);
+        span.end = match->end;
+        span.n_matches++;
+
+        p = g_utf8_offset_to_pointer (match_start, match->end - match->start);
+        offset = match->end;
+    }
+
+    if (text != NULL)
+    {
+        flush_span (spans, &span, text);
+    }
+
+    g_task_return_pointer (task, spans, (GDestroyNotify) g_array_unref);
+}
+
+static void
+begin_replacing (GTask *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+
+    data->phase = PHASE_REPLACING;
+    data->next_match = 0;
+    data->delta = 0;
+    data->buffer_modified = FALSE;
+
+    begin_edits (data);
+    schedule_step (task);
+}
+
+static void
+merge_cb (GObject      *source_object,
+          GAsyncResult *result,
+          GTask        *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+    GError *error = NULL;
+    GArray *spans;
+
+    spans = g_task_propagate_pointer (G_TASK (result), &error);
+
+    if (spans == NULL)
+    {
+        data->phase = PHASE_SEARCHING;
+        complete (task, error);
+        return;
+    }
+
+    /* The occurrences are stale, look again */
+    if (data->buffer_modified)
+    {
+        g_array_unref (spans);
+        wait_for_matches (task);
+        return;
+    }
+
+    xed_debug_message (DEBUG_SEARCH, "%u occurrences merged in %u edits",
+                       data->matches->len, spans->len);
+
+    data->spans = spans;
+    begin_replacing (task);
+}
+
+static void
+merge (GTask *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+    MergeData *merge_data;
+    GTask *merge_task;
+    GtkTextIter start;
+    GtkTextIter end;
+
+    gtk_text_buffer_get_bounds (data->buffer, &start, &end);
+
+    merge_data = g_slice_new0 (MergeData);
+    /* Pixbufs and child anchors are kept as one character, so that the
+     * offsets of the occurrences still hold */
+    merge_data->text = gtk_text_buffer_get_slice (data->buffer, &start, &end, TRUE);
+    merge_data->matches = g_array_ref (data->matches);
+    merge_data->replace = g_strdup (data->replace);
+
+    data->phase = PHASE_MERGING;
+    data->buffer_modified = FALSE;
+
+    merge_task = g_task_new (NULL,
+                             g_task_get_cancellable (task),
+                             (GAsyncReadyCallback) merge_cb,
+                             task);
+    g_task_set_task_data (merge_task, merge_data, (GDestroyNotify) merge_data_free);
+    g_task_run_in_thread (merge_task, (GTaskThreadFunc) merge_thread);
+    g_object_unref (merge_task);
+}
+
+static void
+start_replacing (GTask *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+    GArray *matches;
+
+    if (data->matches != NULL)
+    {
+        g_array_unref (data->matches);
+    }
+
+    if (data->spans != NULL)
+    {
+        g_array_unref (data->spans);
+        data->spans = NULL;
+    }
+
+    /* The index changes with the buffer, so work on a copy */
+    matches = xed_search_index_get_matches (data->search_index);
+    data->matches = g_array_sized_new (FALSE, FALSE, sizeof (XedSearchMatch), matches->len);
+    g_array_append_vals (data->matches, matches->data, matches->len);
+
+    xed_debug_message (DEBUG_SEARCH, "%u occurrences to replace", data->matches->len);
+
+    if (data->matches->len == 0)
+    {
+        complete (task, NULL);
+    }
+    else if (data->literal && data->matches->len >= MERGE_MIN_MATCHES)
+    {
+        merge (task);
+    }
+    else
+    {
+        begin_replacing (task);
+    }
+}
+
+static guint
+get_n_edits (ReplaceAllData *data)
+{
+    return data->spans != NULL ? data->spans->len : data->matches->len;
+}
+
+static void
+replace_range (ReplaceAllData *data,
+               GtkTextIter    *start,
+               GtkTextIter    *end,
+               const gchar    *text)
+{
+    gtk_text_buffer_delete (data->buffer, start, end);
+    gtk_text_buffer_insert (data->buffer, start, text, -1);
+}
+
+static void
+replace_next_match (ReplaceAllData *data)
+{
+    GtkTextIter start;
+    GtkTextIter end;
+    gint n_chars;
+    guint n_matches;
+
+    n_chars = gtk_text_buffer_get_char_count (data->buffer);
+    data->editing = TRUE;
+
+    if (data->spans != NULL)
+    {
+        ReplaceSpan *span = &g_array_index (data->spans, ReplaceSpan, data->next_match++);
+
+        gtk_text_buffer_get_iter_at_offset (data->buffer, &start, span->start + data->delta);
+        gtk_text_buffer_get_iter_at_offset (data->buffer, &end, span->end + data->delta);
+
+        replace_range (data, &start, &end, span->text);
+        n_matches = span->n_matches;
+    }
+    else if (data->literal)
+    {
+        XedSearchMatch *match = &g_array_index (data->matches, XedSearchMatch, data->next_match++);
+
+        gtk_text_buffer_get_iter_at_offset (data->buffer, &start, match->start + data->delta);
+        gtk_text_buffer_get_iter_at_offset (data->buffer, &end, match->end + data->delta);
+
+        replace_range (data, &start, &end, data->replace);
+        n_matches = 1;
+    }
+    else
+    {
+        XedSearchMatch *match = &g_array_index (data->matches, XedSearchMatch, data->next_match++);
+
+        gtk_text_buffer_get_iter_at_offset (data->buffer, &start, match->start + data->delta);
+        gtk_text_buffer_get_iter_at_offset (data->buffer, &end, match->end + data->delta);
+
+        /* Checks that the occurrence still matches, and expands the
+         * references to the groups of the regex */
+        n_matches = gtk_source_search_context_replace (data->search_context,
+                                                       &start,
+                                                       &end,
+                                                       data->replace,
+                                                       -1,
+                                                       NULL) ? 1 : 0;
+    }
+
+    data->editing = FALSE;
+    data->n_replaced += n_matches;
+    data->delta += gtk_text_buffer_get_char_count (data->buffer) - n_chars;
+}
+
+static gboolean
+step_cb (GTask *task)
+{
+    ReplaceAllData *data = g_task_get_task_data (task);
+    GError *error = NULL;
+    gint64 end_time;
+
+    data->idle_id = 0;
+
+    if (g_cancellable_set_error_if_cancelled (g_task_get_cancellable (task), &error))
+    {
+        complete (task, error);
+        return G_SOURCE_REMOVE;
+    }
+
+    switch (data->phase)
+    {
+        case PHASE_SEARCHING:
+            if (xed_search_index_is_complete (data->search_index))
+            {
+                start_replacing (task);
+            }
+            break;
+
+        case PHASE_REPLACING:
+            end_time = g_get_monotonic_time () + REPLACE_TIME_SLICE;
+
+            while (data->next_match < get_n_edits (data) &&
+                   !data->buffer_modified &&
+                   g_get_monotonic_time () < end_time)
+            {
+                replace_next_match (data);
+            }
+
+            /* Something else edited the buffer, the offsets of the
+             * remaining occurrences can't be trusted anymore */
+            if (data->buffer_modified)
+            {
+                complete (task, g_error_new_literal (G_IO_ERROR,
+                                                     G_IO_ERROR_CANCELLED,
+                                                     _("The document was modified during the replacement")));
+                break;
+            }
+
+            if (data->next_match == get_n_edits (data))
+            {
+                complete (task, NULL);
+                break;
+            }
+
+            report_progress (data);
+            schedule_step (task);
+            break;
+
+        case PHASE_MERGING:
+        default:
+            break;
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * xed_replace_all_async:
+ * @search_context: a #GtkSourceSearchContext
+ * @replace: the replacement text, already unescaped
+ * @cancellable: (nullable): optional #GCancellable
+ * @progress_callback: (nullable): function called as the occurrences are
+ * found and replaced
+ * @progress_callback_data: user data for @progress_callback
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied
+ * @user_data: the data to pass to @callback
+ *
+ * Replaces all the occurrences of the search of @search_context, like
+ * gtk_source_search_context_replace_all() but from idle callbacks. The
+ * buffer must not be edited by the user until @callback is called; the
+ * views should be made read-only meanwhile. Undo and redo are blocked on
+ * a #XedDocument until then, and an edit made while the occurrences are
+ * being replaced stops the run with %G_IO_ERROR_CANCELLED.
+ */
+void
+xed_replace_all_async (GtkSourceSearchContext    *search_context,
+                       const gchar               *replace,
+                       GCancellable              *cancellable,
+                       XedReplaceAllProgressFunc  progress_callback,
+                       gpointer                   progress_callback_data,
+                       GAsyncReadyCallback        callback,
+                       gpointer                   user_data)
+{
+    GTask *task;
+    ReplaceAllData *data;
+    GtkSourceSearchSettings *search_settings;
+
+    g_return_if_fail (GTK_SOURCE_IS_SEARCH_CONTEXT (search_context));
+    g_return_if_fail (replace != NULL);
+    g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+    search_settings = gtk_source_search_context_get_settings (search_context);
+
+    data = g_slice_new0 (ReplaceAllData);
+    data->search_context = g_object_ref (search_context);
+    data->search_index = g_object_ref (xed_search_index_get_for_context (search_context));
+    data->buffer = g_object_ref (GTK_TEXT_BUFFER (gtk_source_search_context_get_buffer (search_context)));
+    data->replace = g_strdup (replace);
+    data->replace_length = g_utf8_strlen (replace, -1);
+    data->literal = !gtk_source_search_settings_get_regex_enabled (search_settings);
+    data->progress_callback = progress_callback;
+    data->progress_callback_data = progress_callback_data;
+
+    if (cancellable == NULL)
+    {
+        cancellable = g_cancellable_new ();
+        task = g_task_new (search_context, cancellable, callback, user_data);
+        g_object_unref (cancellable);
+    }
+    else
+    {
+        task = g_task_new (search_context, cancellable, callback, user_data);
+    }
+
+    g_task_set_task_data (task, data, (GDestroyNotify) replace_all_data_free);
+
+    /* A cancellation only stops what is left to replace */
+    g_task_set_check_cancellable (task, FALSE);
+
+    /* Dropped in complete() */
+    data->index_changed_id = g_signal_connect (data->search_index, "changed",
+                                               G_CALLBACK (index_changed_cb), task);
+    data->buffer_changed_id = g_signal_connect (data->buffer, "changed",
+                                                G_CALLBACK (buffer_changed_cb), task);
+    data->cancelled_id = g_signal_connect (cancellable, "cancelled",
+                                           G_CALLBACK (cancelled_cb), task);
+
+    /* Unblocked in complete() */
+    if (XED_IS_DOCUMENT (data->buffer))
+    {
+        _xed_document_set_undo_blocked (XED_DOCUMENT (data->buffer), TRUE);
+    }
+
+    wait_for_matches (task);
+}
+
+/**
+ * xed_replace_all_finish:
+ * @search_context: a #GtkSourceSearchContext
+ * @result: a #GAsyncResult
+ * @error: a #GError, or %NULL
+ *
+ * Returns: the number of occurrences replaced, -1 on error
+ */
+gint
+xed_replace_all_finish (GtkSourceSearchContext  *search_context,
+                        GAsyncResult            *result,
+                        GError                 **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, search_context), -1);
+
+    return g_task_propagate_int (G_TASK (result), error);
+}
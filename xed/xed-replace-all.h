@@ -0,0 +1,52 @@
+/*
+ * xed-replace-all.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_REPLACE_ALL_H__
+#define __XED_REPLACE_ALL_H__
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+/**
+ * XedReplaceAllProgressFunc:
+ * @n_replaced: the occurrences replaced so far, -1 while they are still
+ * being looked for
+ * @n_matches: the occurrences found so far
+ * @user_data: user data
+ */
+typedef void (* XedReplaceAllProgressFunc) (gint     n_replaced,
+                                            gint     n_matches,
+                                            gpointer user_data);
+
+void    xed_replace_all_async   (GtkSourceSearchContext     *search_context,
+                                 const gchar                *replace,
+                                 GCancellable               *cancellable,
+                                 XedReplaceAllProgressFunc   progress_callback,
+                                 gpointer                    progress_callback_data,
+                                 GAsyncReadyCallback         callback,
+                                 gpointer                    user_data);
+gint    xed_replace_all_finish  (GtkSourceSearchContext     *search_context,
+                                 GAsyncResult               *result,
+                                 GError                    **error);
+
+G_END_DECLS
+
+#endif /* __XED_REPLACE_ALL_H__ */
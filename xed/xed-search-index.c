@@ -0,0 +1,580 @@
+/*
+ * xed-search-index.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The offsets of all the matches of a search context, sorted, so that
+ * the position of a match is a binary search away. The buffer is walked
+ * a slice of time per idle, and the edits only rescan the lines they
+ * touch. */
+
+#include <config.h>
+
+#include "xed-search-index.h"
+#include "xed-debug.h"
+
+#define XED_SEARCH_INDEX_KEY "xed-search-index-key"
+
+/* Microseconds spent walking the matches per idle */
+#define SCAN_TIME_SLICE 5000
+
+/* Least time between two "changed" while the buffer is being walked */
+#define CHANGED_INTERVAL 100000
+
+struct _XedSearchIndexPrivate
+{
+    GtkSourceSearchContext *search_context;
+    GtkTextBuffer *buffer;
+
+    GArray *matches;
+
+    /* The index is exact up to this offset */
+    gint scanned_to;
+
+    guint scan_id;
+    gint64 last_changed;
+
+    guint complete : 1;
+    guint frozen : 1;
+};
+
+enum
+{
+    CHANGED,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE_WITH_PRIVATE (XedSearchIndex, xed_search_index, G_TYPE_OBJECT)
+
+static void
+xed_search_index_dispose (GObject *object)
+{
+    XedSearchIndex *index = XED_SEARCH_INDEX (object);
+
+    if (index->priv->scan_id != 0)
+    {
+        g_source_remove (index->priv->scan_id);
+        index->priv->scan_id = 0;
+    }
+
+    G_OBJECT_CLASS (xed_search_index_parent_class)->dispose (object);
+}
+
+static void
+xed_search_index_finalize (GObject *object)
+{
+    XedSearchIndex *index = XED_SEARCH_INDEX (object);
+
+    g_array_unref (index->priv->matches);
+
+    G_OBJECT_CLASS (xed_search_index_parent_class)->finalize (object);
+}
+
+static void
+xed_search_index_class_init (XedSearchIndexClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = xed_search_index_dispose;
+    object_class->finalize = xed_search_index_finalize;
+
+    /**
+     * XedSearchIndex::changed:
+     * @index: the #XedSearchIndex
+     *
+     * Emitted when matches were found or lost.
+     */
+    signals[CHANGED] =
+        g_signal_new ("changed",
+                      G_OBJECT_CLASS_TYPE (object_class),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XedSearchIndexClass, changed),
+                      NULL, NULL, NULL,
+                      G_TYPE_NONE, 0);
+}
+
+static void
+xed_search_index_init (XedSearchIndex *index)
+{
+    index->priv = xed_search_index_get_instance_private (index);
+
+    index->priv->matches = g_array_new (FALSE, FALSE, sizeof (XedSearchMatch));
+}
+
+/* The first match starting at or after @offset */
+static guint
+lower_bound (XedSearchIndex *index,
+             gint            offset)
+{
+    guint low = 0;
+    guint high = index->priv->matches->len;
+
+    while (low < high)
+    {
+        guint middle = low + (high - low) / 2;
+
+        if (g_array_index (index->priv->matches, XedSearchMatch, middle).start < offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/* Walks the next matches, returns FALSE once past the last one */
+static gboolean
+scan_matches (XedSearchIndex *index,
+              gint64          deadline)
+{
+    XedSearchIndexPrivate *priv = index->priv;
+    GtkTextIter iter;
+
+    gtk_text_buffer_get_iter_at_offset (priv->buffer, &iter, priv->scanned_to);
+
+    do
+    {
+        GtkTextIter match_start;
+        GtkTextIter match_end;
+        gboolean wrapped = FALSE;
+        XedSearchMatch match;
+
+        if (!gtk_source_search_context_forward (priv->search_context, &iter, &match_start, &match_end, &wrapped) ||
+            wrapped)
+        {
+            return FALSE;
+        }
+
+        match.start = gtk_text_iter_get_offset (&match_start);
+        match.end = gtk_text_iter_get_offset (&match_end);
+
+        if (match.start < priv->scanned_to)
+        {
+            return FALSE;
+        }
+
+        g_array_append_val (priv->matches, match);
+
+        /* An empty match must not be found again */
+        iter = match_end;
+
+        if (match.start == match.end && !gtk_text_iter_forward_char (&iter))
+        {
+            return FALSE;
+        }
+
+        priv->scanned_to = gtk_text_iter_get_offset (&iter);
+    }
+    while (g_get_monotonic_time () < deadline);
+
+    return TRUE;
+}
+
+static gboolean
+scan_cb (XedSearchIndex *index)
+{
+    XedSearchIndexPrivate *priv = index->priv;
+    gint64 now = g_get_monotonic_time ();
+
+    if (!scan_matches (index, now + SCAN_TIME_SLICE))
+    {
+        xed_debug_message (DEBUG_SEARCH, "%u matches", priv->matches->len);
+
+        priv->scanned_to = G_MAXINT;
+        priv->complete = TRUE;
+        priv->scan_id = 0;
+
+        g_signal_emit (index, signals[CHANGED], 0);
+
+        return G_SOURCE_REMOVE;
+    }
+
+    if (now - priv->last_changed >= CHANGED_INTERVAL)
+    {
+        priv->last_changed = now;
+        g_signal_emit (index, signals[CHANGED], 0);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+reset (XedSearchIndex *index)
+{
+    XedSearchIndexPrivate *priv = index->priv;
+
+    if (priv->frozen)
+    {
+        return;
+    }
+
+    g_array_set_size (priv->matches, 0);
+    priv->scanned_to = 0;
+    priv->complete = FALSE;
+    priv->last_changed = g_get_monotonic_time ();
+
+    if (priv->scan_id == 0)
+    {
+        priv->scan_id = g_idle_add ((GSourceFunc) scan_cb, index);
+    }
+
+    g_signal_emit (index, signals[CHANGED], 0);
+}
+
+/* Moves the matches after an edit at @offset by @delta characters */
+static void
+shift_matches (XedSearchIndex *index,
+               gint            offset,
+               gint            delta)
+{
+    XedSearchIndexPrivate *priv = index->priv;
+    guint i;
+
+    for (i = lower_bound (index, offset); i < priv->matches->len; i++)
+    {
+        XedSearchMatch *match = &g_array_index (priv->matches, XedSearchMatch, i);
+
+        match->start += delta;
+        match->end += delta;
+    }
+
+    if (priv->scanned_to == G_MAXINT)
+    {
+        return;
+    }
+
+    if (priv->scanned_to >= offset)
+    {
+        priv->scanned_to += delta;
+    }
+    /* Deleted text the scan was in the middle of */
+    else if (priv->scanned_to > offset + delta)
+    {
+        priv->scanned_to = offset + delta;
+    }
+}
+
+/* Finds the matches of the lines between @start and @end again */
+static void
+rescan_lines (XedSearchIndex *index,
+              GtkTextIter    *start,
+              GtkTextIter    *end)
+{
+    XedSearchIndexPrivate *priv = index->priv;
+    GtkTextIter iter;
+    gint start_offset;
+    gint end_offset;
+    guint first;
+    guint last;
+    gboolean changed;
+
+    gtk_text_iter_set_line_offset (start, 0);
+
+    if (!gtk_text_iter_ends_line (end))
+    {
+        gtk_text_iter_forward_to_line_end (end);
+    }
+
+    start_offset = gtk_text_iter_get_offset (start);
+    end_offset = MIN (gtk_text_iter_get_offset (end), priv->scanned_to);
+
+    /* The scan has not got there yet */
+    if (start_offset >= end_offset)
+    {
+        return;
+    }
+
+    first = lower_bound (index, start_offset);
+    last = lower_bound (index, end_offset);
+    changed = (first != last);
+
+    g_array_remove_range (priv->matches, first, last - first);
+
+    iter = *start;
+
+    while (TRUE)
+    {
+        GtkTextIter match_start;
+        GtkTextIter match_end;
+        gboolean wrapped = FALSE;
+        XedSearchMatch match;
+
+        if (!gtk_source_search_context_forward (priv->search_context, &iter, &match_start, &match_end, &wrapped) ||
+            wrapped)
+        {
+            break;
+        }
+
+        match.start = gtk_text_iter_get_offset (&match_start);
+        match.end = gtk_text_iter_get_offset (&match_end);
+
+        if (match.start < start_offset || match.start >= end_offset)
+        {
+            break;
+        }
+
+        g_array_insert_val (priv->matches, first, match);
+        first++;
+        changed = TRUE;
+
+        iter = match_end;
+
+        if (match.start == match.end && !gtk_text_iter_forward_char (&iter))
+        {
+            break;
+        }
+    }
+
+    if (changed)
+    {
+        g_signal_emit (index, signals[CHANGED], 0);
+    }
+}
+
+static void
+insert_text_cb (GtkTextBuffer  *buffer,
+                GtkTextIter    *location,
+                const gchar    *text,
+                gint            length,
+                XedSearchIndex *index)
+{
+    GtkTextIter start;
+    GtkTextIter end;
+    gint n_chars;
+
+    if (index->priv->frozen)
+    {
+        return;
+    }
+
+    /* After the default handler, location is at the end of the text. It
+     * is handed to the next handlers, so it is not moved */
+    n_chars = g_utf8_strlen (text, length);
+    start = *location;
+    end = *location;
+    gtk_text_iter_backward_chars (&start, n_chars);
+
+    shift_matches (index, gtk_text_iter_get_offset (&start), n_chars);
+    rescan_lines (index, &start, &end);
+}
+
+static void
+delete_range_cb (GtkTextBuffer  *buffer,
+                 GtkTextIter    *start,
+                 GtkTextIter    *end,
+                 XedSearchIndex *index)
+{
+    XedSearchIndexPrivate *priv = index->priv;
+    gint start_offset;
+    gint end_offset;
+    guint first;
+    guint last;
+
+    if (priv->frozen)
+    {
+        return;
+    }
+
+    /* Before the default handler, the matches in the range go */
+    start_offset = gtk_text_iter_get_offset (start);
+    end_offset = gtk_text_iter_get_offset (end);
+
+    first = lower_bound (index, start_offset);
+    last = lower_bound (index, end_offset);
+    g_array_remove_range (priv->matches, first, last - first);
+
+    shift_matches (index, end_offset, start_offset - end_offset);
+}
+
+static void
+delete_range_after_cb (GtkTextBuffer  *buffer,
+                       GtkTextIter    *start,
+                       GtkTextIter    *end,
+                       XedSearchIndex *index)
+{
+    GtkTextIter line_start = *start;
+    GtkTextIter line_end = *end;
+
+    if (index->priv->frozen)
+    {
+        return;
+    }
+
+    rescan_lines (index, &line_start, &line_end);
+}
+
+/**
+ * xed_search_index_get_for_context:
+ * @search_context: a #GtkSourceSearchContext
+ *
+ * Returns: (transfer none): the index of the matches of @search_context,
+ * created and filled in the background on first use
+ */
+XedSearchIndex *
+xed_search_index_get_for_context (GtkSourceSearchContext *search_context)
+{
+    XedSearchIndex *index;
+    GtkSourceSearchSettings *settings;
+
+    g_return_val_if_fail (GTK_SOURCE_IS_SEARCH_CONTEXT (search_context), NULL);
+
+    index = g_object_get_data (G_OBJECT (search_context), XED_SEARCH_INDEX_KEY);
+
+    if (index != NULL)
+    {
+        return index;
+    }
+
+    index = g_object_new (XED_TYPE_SEARCH_INDEX, NULL);
+    index->priv->search_context = search_context;
+    index->priv->buffer = GTK_TEXT_BUFFER (gtk_source_search_context_get_buffer (search_context));
+
+    g_object_set_data_full (G_OBJECT (search_context), XED_SEARCH_INDEX_KEY, index, g_object_unref);
+
+    g_signal_connect_object (index->priv->buffer, "insert-text",
+                             G_CALLBACK (insert_text_cb), index, G_CONNECT_AFTER);
+    g_signal_connect_object (index->priv->buffer, "delete-range",
+                             G_CALLBACK (delete_range_cb), index, 0);
+    g_signal_connect_object (index->priv->buffer, "delete-range",
+                             G_CALLBACK (delete_range_after_cb), index, G_CONNECT_AFTER);
+
+    /* Any change to the search makes for other matches */
+    settings = gtk_source_search_context_get_settings (search_context);
+    g_signal_connect_object (settings, "notify",
+                             G_CALLBACK (reset), index, G_CONNECT_SWAPPED);
+
+    reset (index);
+
+    return index;
+}
+
+gboolean
+xed_search_index_is_complete (XedSearchIndex *index)
+{
+    g_return_val_if_fail (XED_IS_SEARCH_INDEX (index), FALSE);
+
+    return index->priv->complete;
+}
+
+/**
+ * xed_search_index_get_count:
+ * @index: a #XedSearchIndex
+ *
+ * Returns: the number of matches, or of those found so far if @index is
+ * not complete yet
+ */
+gint
+xed_search_index_get_count (XedSearchIndex *index)
+{
+    g_return_val_if_fail (XED_IS_SEARCH_INDEX (index), 0);
+
+    return index->priv->matches->len;
+}
+
+/**
+ * xed_search_index_get_position:
+ * @index: a #XedSearchIndex
+ * @match_start: the start of a possible match
+ * @match_end: the end of a possible match
+ *
+ * Like gtk_source_search_context_get_occurrence_position(), without
+ * walking the matches before.
+ *
+ * Returns: the position of the match, starting from 1, 0 if it is not a
+ * match, or -1 if that part of the buffer has not been looked at yet
+ */
+gint
+xed_search_index_get_position (XedSearchIndex    *index,
+                               const GtkTextIter *match_start,
+                               const GtkTextIter *match_end)
+{
+    XedSearchIndexPrivate *priv;
+    gint start_offset;
+    guint i;
+
+    g_return_val_if_fail (XED_IS_SEARCH_INDEX (index), 0);
+
+    priv = index->priv;
+    start_offset = gtk_text_iter_get_offset (match_start);
+    i = lower_bound (index, start_offset);
+
+    if (i < priv->matches->len)
+    {
+        XedSearchMatch *match = &g_array_index (priv->matches, XedSearchMatch, i);
+
+        if (match->start == start_offset && match->end == gtk_text_iter_get_offset (match_end))
+        {
+            return i + 1;
+        }
+    }
+
+    return start_offset < priv->scanned_to ? 0 : -1;
+}
+
+/**
+ * xed_search_index_get_matches:
+ * @index: a #XedSearchIndex
+ *
+ * Returns: (transfer none) (element-type XedSearchMatch): the matches
+ * found so far, sorted
+ */
+GArray *
+xed_search_index_get_matches (XedSearchIndex *index)
+{
+    g_return_val_if_fail (XED_IS_SEARCH_INDEX (index), NULL);
+
+    return index->priv->matches;
+}
+
+/**
+ * xed_search_index_freeze:
+ * @index: a #XedSearchIndex
+ *
+ * Stops following the edits of the buffer, for a caller about to make
+ * many of them. The index is filled again after xed_search_index_thaw().
+ */
+void
+xed_search_index_freeze (XedSearchIndex *index)
+{
+    g_return_if_fail (XED_IS_SEARCH_INDEX (index));
+
+    index->priv->frozen = TRUE;
+
+    if (index->priv->scan_id != 0)
+    {
+        g_source_remove (index->priv->scan_id);
+        index->priv->scan_id = 0;
+    }
+}
+
+void
+xed_search_index_thaw (XedSearchIndex *index)
+{
+    g_return_if_fail (XED_IS_SEARCH_INDEX (index));
+    g_return_if_fail (index->priv->frozen);
+
+    index->priv->frozen = FALSE;
+
+    reset (index);
+}
@@ -0,0 +1,79 @@
+/*
+ * xed-search-index.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_SEARCH_INDEX_H__
+#define __XED_SEARCH_INDEX_H__
+
+#include <gtksourceview/gtksource.h>
+
+G_BEGIN_DECLS
+
+#define XED_TYPE_SEARCH_INDEX              (xed_search_index_get_type ())
+#define XED_SEARCH_INDEX(obj)              (G_TYPE_CHECK_INSTANCE_CAST ((obj), XED_TYPE_SEARCH_INDEX, XedSearchIndex))
+#define XED_SEARCH_INDEX_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), XED_TYPE_SEARCH_INDEX, XedSearchIndexClass))
+#define XED_IS_SEARCH_INDEX(obj)           (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XED_TYPE_SEARCH_INDEX))
+#define XED_IS_SEARCH_INDEX_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), XED_TYPE_SEARCH_INDEX))
+#define XED_SEARCH_INDEX_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), XED_TYPE_SEARCH_INDEX, XedSearchIndexClass))
+
+typedef struct _XedSearchIndex        XedSearchIndex;
+typedef struct _XedSearchIndexClass   XedSearchIndexClass;
+typedef struct _XedSearchIndexPrivate XedSearchIndexPrivate;
+
+typedef struct _XedSearchMatch XedSearchMatch;
+
+/* Character offsets in the buffer */
+struct _XedSearchMatch
+{
+    gint start;
+    gint end;
+};
+
+struct _XedSearchIndex
+{
+    GObject parent;
+
+    XedSearchIndexPrivate *priv;
+};
+
+struct _XedSearchIndexClass
+{
+    GObjectClass parent_class;
+
+    /* Signals */
+    void (* changed) (XedSearchIndex *index);
+};
+
+GType           xed_search_index_get_type           (void) G_GNUC_CONST;
+
+XedSearchIndex *xed_search_index_get_for_context    (GtkSourceSearchContext *search_context);
+
+gboolean        xed_search_index_is_complete        (XedSearchIndex         *index);
+gint            xed_search_index_get_count          (XedSearchIndex         *index);
+gint            xed_search_index_get_position       (XedSearchIndex         *index,
+                                                     const GtkTextIter      *match_start,
+                                                     const GtkTextIter      *match_end);
+GArray         *xed_search_index_get_matches        (XedSearchIndex         *index);
+
+void            xed_search_index_freeze             (XedSearchIndex         *index);
+void            xed_search_index_thaw               (XedSearchIndex         *index);
+
+G_END_DECLS
+
+#endif /* __XED_SEARCH_INDEX_H__ */
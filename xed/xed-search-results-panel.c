@@ -0,0 +1,766 @@
+/*
+ * xed-search-results-panel.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Finds the text of the searchbar in all the documents of a window. The
+ * documents are copied on the main thread and searched on a pool of worker
+ * threads, one per core. Each document shows up in the list as soon as its
+ * search is over. Tabs which do not hold the whole file, because they are
+ * placeholders, large files or still loading, are read from disk by the
+ * workers instead. */
+
+#include <config.h>
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "xed-search-results-panel.h"
+#include "xed-tab.h"
+#include "xed-utils.h"
+#include "xed-debug.h"
+
+/* Lines listed at most for a document */
+#define MAX_LINES_PER_DOCUMENT 1000
+
+/* Matches between two looks at the cancellable */
+#define CHECK_INTERVAL 1024
+
+#define MAX_DOC_NAME_LENGTH 60
+
+enum
+{
+    PROP_0,
+    PROP_WINDOW
+};
+
+enum
+{
+    NAME_COLUMN,
+    LINE_COLUMN,
+    OFFSET_COLUMN,
+    TAB_COLUMN,
+    N_COLUMNS
+};
+
+/* Shared by the jobs of a search, @panel is only touched on the main
+ * thread and cleared when the search is stopped */
+typedef struct
+{
+    gint ref_count;
+
+    GRegex *regex;
+    GCancellable *cancellable;
+    XedSearchResultsPanel *panel;
+} Search;
+
+typedef struct
+{
+    gint line;
+    gint line_offset;
+    gchar *markup;
+} Result;
+
+typedef struct
+{
+    Search *search;
+    XedTab *tab;
+    gchar *name;
+
+    /* A copy of the buffer, or the file read by the worker */
+    GFile *location;
+    gchar *text;
+    gsize length;
+
+    GArray *results;
+    gboolean truncated;
+} Job;
+
+struct _XedSearchResultsPanelPrivate
+{
+    XedWindow *window;
+
+    GtkWidget *status_label;
+    GtkWidget *stop_button;
+    GtkWidget *treeview;
+    GtkTreeStore *store;
+
+    GThreadPool *pool;
+    Search *search;
+    guint n_jobs;
+    guint n_jobs_done;
+    guint n_lines;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (XedSearchResultsPanel, xed_search_results_panel, GTK_TYPE_BOX)
+
+static Search *
+search_ref (Search *search)
+{
+    g_atomic_int_inc (&search->ref_count);
+
+    return search;
+}
+
+static void
+search_unref (Search *search)
+{
+    if (g_atomic_int_dec_and_test (&search->ref_count))
+    {
+        g_regex_unref (search->regex);
+        g_object_unref (search->cancellable);
+        g_slice_free (Search, search);
+    }
+}
+
+static void
+result_clear (Result *result)
+{
+    g_free (result->markup);
+}
+
+static void
+job_free (Job *job)
+{
+    search_unref (job->search);
+    g_object_unref (job->tab);
+    g_free (job->name);
+
+    if (job->location != NULL)
+    {
+        g_object_unref (job->location);
+    }
+
+    g_free (job->text);
+    g_array_unref (job->results);
+
+    g_slice_free (Job, job);
+}
+
+static void
+read_file (Job *job)
+{
+    /* The file is read rather than mapped, a mapping would fault if the
+     * file is truncated while it is searched */
+    if (!g_file_load_contents (job->location, job->search->cancellable, &job->text, &job->length, NULL, NULL))
+    {
+        return;
+    }
+
+    /* Files in other encodings are left out, converting them is the
+     * business of the loader */
+    if (!g_utf8_validate (job->text, job->length, NULL))
+    {
+        xed_debug_message (DEBUG_SEARCH, "Not searching %s, not UTF-8", job->name);
+        g_clear_pointer (&job->text, g_free);
+    }
+}
+
+static void
+add_result (Job         *job,
+            gint         line,
+            const gchar *line_start,
+            const gchar *match_start,
+            const gchar *match_end,
+            const gchar *text_end)
+{
+    Result result;
+
+    result.line = line;
+    result.line_offset = g_utf8_strlen (line_start, match_start - line_start);
+    result.markup = xed_utils_make_match_snippet (line, line_start, match_start, match_end, text_end);
+
+    g_array_append_val (job->results, result);
+}
+
+/* Lists each line holding a match once */
+static void
+search_text (Job *job)
+{
+    const gchar *text = job->text;
+    const gchar *line_start = text;
+    const gchar *scanned = text;
+    GMatchInfo *match_info;
+    gint line = 0;
+    gint last_line = -1;
+    guint n_matches = 0;
+
+    g_regex_match_full (job->search->regex, text, job->length, 0, 0, &match_info, NULL);
+
+    while (g_match_info_matches (match_info))
+    {
+        const gchar *match_start;
+        const gchar *newline;
+        gint start;
+        gint end;
+
+        if (++n_matches % CHECK_INTERVAL == 0 &&
+            g_cancellable_is_cancelled (job->search->cancellable))
+        {
+            break;
+        }
+
+        g_match_info_fetch_pos (match_info, 0, &start, &end);
+        match_start = text + start;
+
+        while ((newline = memchr (scanned, '\n', match_start - scanned)) != NULL)
+        {
+            line++;
+            line_start = newline + 1;
+            scanned = newline + 1;
+        }
+
+        scanned = match_start;
+
+        if (line != last_line)
+        {
+            if (job->results->len == MAX_LINES_PER_DOCUMENT)
+            {
+                job->truncated = TRUE;
+                break;
+            }
+
+            add_result (job, line, line_start, match_start, text + end, text + job->length);
+            last_line = line;
+        }
+
+        g_match_info_next (match_info, NULL);
+    }
+
+    g_match_info_free (match_info);
+}
+
+static void
+add_job_results (XedSearchResultsPanel *panel,
+                 Job                   *job)
+{
+    GtkTreeIter parent;
+    GtkTreeIter iter;
+    GtkTreePath *path;
+    gchar *name;
+    guint i;
+
+    /* Closed meanwhile */
+    if (job->results->len == 0 || gtk_widget_get_parent (GTK_WIDGET (job->tab)) == NULL)
+    {
+        return;
+    }
+
+    if (job->truncated)
+    {
+        name = g_markup_printf_escaped ("<b>%s</b> (%u+)", job->name, job->results->len);
+    }
+    else
+    {
+        name = g_markup_printf_escaped ("<b>%s</b> (%u)", job->name, job->results->len);
+    }
+
+    gtk_tree_store_insert_with_values (panel->priv->store, &parent, NULL, -1,
+                                       NAME_COLUMN, name,
+                                       LINE_COLUMN, -1,
+                                       OFFSET_COLUMN, 0,
+                                       TAB_COLUMN, job->tab,
+                                       -1);
+    g_free (name);
+
+    for (i = 0; i < job->results->len; i++)
+    {
+        Result *result = &g_array_index (job->results, Result, i);
+
+        gtk_tree_store_insert_with_values (panel->priv->store, &iter, &parent, -1,
+                                           NAME_COLUMN, result->markup,
+                                           LINE_COLUMN, result->line,
+                                           OFFSET_COLUMN, result->line_offset,
+                                           TAB_COLUMN, job->tab,
+                                           -1);
+    }
+
+    path = gtk_tree_model_get_path (GTK_TREE_MODEL (panel->priv->store), &parent);
+    gtk_tree_view_expand_row (GTK_TREE_VIEW (panel->priv->treeview), path, FALSE);
+    gtk_tree_path_free (path);
+
+    panel->priv->n_lines += job->results->len;
+}
+
+static void
+update_status (XedSearchResultsPanel *panel)
+{
+    gchar *msg;
+
+    if (panel->priv->n_jobs_done < panel->priv->n_jobs)
+    {
+        msg = g_strdup_printf (_("Searching... %u of %u documents"),
+                               panel->priv->n_jobs_done, panel->priv->n_jobs);
+    }
+    else if (panel->priv->n_lines == 0)
+    {
+        msg = g_strdup (_("No matches found"));
+    }
+    else
+    {
+        msg = g_strdup_printf (ngettext ("Found %u matching line", "Found %u matching lines",
+                                         panel->priv->n_lines),
+                               panel->priv->n_lines);
+    }
+
+    gtk_label_set_text (GTK_LABEL (panel->priv->status_label), msg);
+    gtk_widget_set_sensitive (panel->priv->stop_button, panel->priv->n_jobs_done < panel->priv->n_jobs);
+
+    g_free (msg);
+}
+
+static gboolean
+job_done_cb (Job *job)
+{
+    XedSearchResultsPanel *panel = job->search->panel;
+
+    if (panel != NULL)
+    {
+        add_job_results (panel, job);
+        panel->priv->n_jobs_done++;
+        update_status (panel);
+    }
+
+    job_free (job);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+search_thread (Job      *job,
+               gpointer  user_data)
+{
+    if (!g_cancellable_is_cancelled (job->search->cancellable))
+    {
+        if (job->location != NULL)
+        {
+            read_file (job);
+        }
+
+        if (job->text != NULL)
+        {
+            search_text (job);
+        }
+    }
+
+    g_idle_add ((GSourceFunc) job_done_cb, job);
+}
+
+static Job *
+create_job (Search *search,
+            XedTab *tab)
+{
+    XedDocument *doc;
+    GFile *location;
+    XedTabState state;
+    Job *job;
+    gchar *name;
+
+    doc = xed_tab_get_document (tab);
+    location = gtk_source_file_get_location (xed_document_get_file (doc));
+    state = xed_tab_get_state (tab);
+
+    job = g_slice_new0 (Job);
+
+    /* The buffer of these holds part of the file, or nothing */
+    if (_xed_tab_is_placeholder (tab) ||
+        _xed_tab_is_large_file (tab) ||
+        state == XED_TAB_STATE_LOADING ||
+        state == XED_TAB_STATE_REVERTING)
+    {
+        if (location == NULL)
+        {
+            g_slice_free (Job, job);
+            return NULL;
+        }
+
+        job->location = g_object_ref (location);
+    }
+    else
+    {
+        GtkTextIter start;
+        GtkTextIter end;
+
+        gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc), &start, &end);
+        job->text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (doc), &start, &end, TRUE);
+        job->length = strlen (job->text);
+    }
+
+    name = xed_document_get_short_name_for_display (doc);
+    job->name = xed_utils_str_middle_truncate (name, MAX_DOC_NAME_LENGTH);
+    g_free (name);
+
+    job->search = search_ref (search);
+    job->tab = g_object_ref (tab);
+    job->results = g_array_new (FALSE, FALSE, sizeof (Result));
+    g_array_set_clear_func (job->results, (GDestroyNotify) result_clear);
+
+    return job;
+}
+
+static GRegex *
+create_regex (GtkSourceSearchSettings  *search_settings,
+              GError                  **error)
+{
+    const gchar *search_text;
+    gchar *pattern;
+    GRegexCompileFlags flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+    GRegex *regex;
+
+    search_text = gtk_source_search_settings_get_search_text (search_settings);
+
+    if (gtk_source_search_settings_get_regex_enabled (search_settings))
+    {
+        pattern = g_strdup (search_text);
+    }
+    else
+    {
+        pattern = g_regex_escape_string (search_text, -1);
+    }
+
+    if (gtk_source_search_settings_get_at_word_boundaries (search_settings))
+    {
+        gchar *tmp = pattern;
+
+        pattern = g_strdup_printf ("\\b(?:%s)\\b", tmp);
+        g_free (tmp);
+    }
+
+    if (!gtk_source_search_settings_get_case_sensitive (search_settings))
+    {
+        flags |= G_REGEX_CASELESS;
+    }
+
+    regex = g_regex_new (pattern, flags, 0, error);
+
+    g_free (pattern);
+
+    return regex;
+}
+
+/**
+ * xed_search_results_panel_find:
+ * @panel: a #XedSearchResultsPanel
+ * @search_settings: what to look for
+ *
+ * Searches all the documents of the window, replacing the results of the
+ * previous search.
+ */
+void
+xed_search_results_panel_find (XedSearchResultsPanel   *panel,
+                               GtkSourceSearchSettings *search_settings)
+{
+    Search *search;
+    GRegex *regex;
+    GList *tabs;
+    GList *l;
+    GError *error = NULL;
+
+    g_return_if_fail (XED_IS_SEARCH_RESULTS_PANEL (panel));
+    g_return_if_fail (GTK_SOURCE_IS_SEARCH_SETTINGS (search_settings));
+
+    if (gtk_source_search_settings_get_search_text (search_settings) == NULL)
+    {
+        return;
+    }
+
+    xed_search_results_panel_stop (panel);
+    gtk_tree_store_clear (panel->priv->store);
+
+    regex = create_regex (search_settings, &error);
+
+    if (regex == NULL)
+    {
+        gtk_label_set_text (GTK_LABEL (panel->priv->status_label), error->message);
+        g_error_free (error);
+        return;
+    }
+
+    search = g_slice_new0 (Search);
+    search->ref_count = 1;
+    search->regex = regex;
+    search->cancellable = g_cancellable_new ();
+    search->panel = panel;
+
+    panel->priv->search = search;
+    panel->priv->n_jobs = 0;
+    panel->priv->n_jobs_done = 0;
+    panel->priv->n_lines = 0;
+
+    tabs = gtk_container_get_children (GTK_CONTAINER (_xed_window_get_notebook (panel->priv->window)));
+
+    /* The workers start on the first documents while the next ones are
+     * being copied */
+    for (l = tabs; l != NULL; l = l->next)
+    {
+        Job *job = create_job (search, XED_TAB (l->data));
+
+        if (job != NULL)
+        {
+            panel->priv->n_jobs++;
+            g_thread_pool_push (panel->priv->pool, job, NULL);
+        }
+    }
+
+    g_list_free (tabs);
+
+    xed_debug_message (DEBUG_SEARCH, "Searching %u documents", panel->priv->n_jobs);
+
+    update_status (panel);
+}
+
+void
+xed_search_results_panel_stop (XedSearchResultsPanel *panel)
+{
+    g_return_if_fail (XED_IS_SEARCH_RESULTS_PANEL (panel));
+
+    if (panel->priv->search == NULL)
+    {
+        return;
+    }
+
+    /* The jobs left drop their results when they are done */
+    panel->priv->search->panel = NULL;
+    g_cancellable_cancel (panel->priv->search->cancellable);
+    search_unref (panel->priv->search);
+    panel->priv->search = NULL;
+
+    if (panel->priv->n_jobs_done < panel->priv->n_jobs)
+    {
+        gtk_label_set_text (GTK_LABEL (panel->priv->status_label), _("Stopped"));
+        gtk_widget_set_sensitive (panel->priv->stop_button, FALSE);
+    }
+}
+
+static void
+stop_button_clicked (GtkButton             *button,
+                     XedSearchResultsPanel *panel)
+{
+    xed_search_results_panel_stop (panel);
+}
+
+static void
+treeview_row_activated (GtkTreeView           *treeview,
+                        GtkTreePath           *path,
+                        GtkTreeViewColumn     *column,
+                        XedSearchResultsPanel *panel)
+{
+    GtkTreeIter iter;
+    gpointer tab;
+    gint line;
+    gint line_offset;
+    XedView *view;
+
+    if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (panel->priv->store), &iter, path))
+    {
+        return;
+    }
+
+    gtk_tree_model_get (GTK_TREE_MODEL (panel->priv->store), &iter,
+                        TAB_COLUMN, &tab,
+                        LINE_COLUMN, &line,
+                        OFFSET_COLUMN, &line_offset,
+                        -1);
+
+    /* Before the tab is shown, for a placeholder to load at that line */
+    if (line >= 0)
+    {
+        _xed_tab_goto_line (XED_TAB (tab), line, line_offset);
+    }
+
+    xed_window_set_active_tab (panel->priv->window, XED_TAB (tab));
+
+    view = xed_tab_get_view (XED_TAB (tab));
+    xed_view_scroll_to_cursor (view);
+    gtk_widget_grab_focus (GTK_WIDGET (view));
+}
+
+static void
+window_tab_removed (XedWindow             *window,
+                    XedTab                *tab,
+                    XedSearchResultsPanel *panel)
+{
+    GtkTreeModel *model = GTK_TREE_MODEL (panel->priv->store);
+    GtkTreeIter iter;
+    gboolean valid;
+
+    valid = gtk_tree_model_get_iter_first (model, &iter);
+
+    while (valid)
+    {
+        gpointer row_tab;
+
+        gtk_tree_model_get (model, &iter, TAB_COLUMN, &row_tab, -1);
+
+        if (row_tab == tab)
+        {
+            valid = gtk_tree_store_remove (panel->priv->store, &iter);
+        }
+        else
+        {
+            valid = gtk_tree_model_iter_next (model, &iter);
+        }
+    }
+}
+
+static void
+xed_search_results_panel_set_property (GObject      *object,
+                                       guint         prop_id,
+                                       const GValue *value,
+                                       GParamSpec   *pspec)
+{
+    XedSearchResultsPanel *panel = XED_SEARCH_RESULTS_PANEL (object);
+
+    switch (prop_id)
+    {
+        case PROP_WINDOW:
+            panel->priv->window = g_value_get_object (value);
+            g_signal_connect_object (panel->priv->window, "tab-removed",
+                                     G_CALLBACK (window_tab_removed), panel, 0);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void
+xed_search_results_panel_get_property (GObject    *object,
+                                       guint       prop_id,
+                                       GValue     *value,
+                                       GParamSpec *pspec)
+{
+    XedSearchResultsPanel *panel = XED_SEARCH_RESULTS_PANEL (object);
+
+    switch (prop_id)
+    {
+        case PROP_WINDOW:
+            g_value_set_object (value, panel->priv->window);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void
+xed_search_results_panel_dispose (GObject *object)
+{
+    XedSearchResultsPanel *panel = XED_SEARCH_RESULTS_PANEL (object);
+
+    if (panel->priv->search != NULL)
+    {
+        xed_search_results_panel_stop (panel);
+    }
+
+    /* The queued jobs are cancelled, let them run down without waiting */
+    if (panel->priv->pool != NULL)
+    {
+        g_thread_pool_free (panel->priv->pool, FALSE, FALSE);
+        panel->priv->pool = NULL;
+    }
+
+    G_OBJECT_CLASS (xed_search_results_panel_parent_class)->dispose (object);
+}
+
+static void
+xed_search_results_panel_class_init (XedSearchResultsPanelClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->dispose = xed_search_results_panel_dispose;
+    object_class->get_property = xed_search_results_panel_get_property;
+    object_class->set_property = xed_search_results_panel_set_property;
+
+    g_object_class_install_property (object_class,
+                                     PROP_WINDOW,
+                                     g_param_spec_object ("window",
+                                                          "Window",
+                                                          "The XedWindow this XedSearchResultsPanel is associated with",
+                                                          XED_TYPE_WINDOW,
+                                                          G_PARAM_READWRITE |
+                                                          G_PARAM_CONSTRUCT_ONLY |
+                                                          G_PARAM_STATIC_STRINGS));
+}
+
+static void
+xed_search_results_panel_init (XedSearchResultsPanel *panel)
+{
+    GtkWidget *hbox;
+    GtkWidget *sw;
+    GtkTreeViewColumn *column;
+    GtkCellRenderer *cell;
+
+    panel->priv = xed_search_results_panel_get_instance_private (panel);
+
+    gtk_orientable_set_orientation (GTK_ORIENTABLE (panel), GTK_ORIENTATION_VERTICAL);
+
+    hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_container_set_border_width (GTK_CONTAINER (hbox), 3);
+    gtk_box_pack_start (GTK_BOX (panel), hbox, FALSE, FALSE, 0);
+
+    panel->priv->status_label = gtk_label_new (NULL);
+    gtk_label_set_ellipsize (GTK_LABEL (panel->priv->status_label), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_halign (panel->priv->status_label, GTK_ALIGN_START);
+    gtk_box_pack_start (GTK_BOX (hbox), panel->priv->status_label, TRUE, TRUE, 0);
+
+    panel->priv->stop_button = gtk_button_new_with_mnemonic (_("_Stop"));
+    gtk_widget_set_sensitive (panel->priv->stop_button, FALSE);
+    gtk_box_pack_end (GTK_BOX (hbox), panel->priv->stop_button, FALSE, FALSE, 0);
+
+    g_signal_connect (panel->priv->stop_button, "clicked", G_CALLBACK (stop_button_clicked), panel);
+
+    gtk_widget_show_all (hbox);
+
+    sw = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (sw), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_widget_show (sw);
+    gtk_box_pack_start (GTK_BOX (panel), sw, TRUE, TRUE, 0);
+
+    panel->priv->store = gtk_tree_store_new (N_COLUMNS,
+                                             G_TYPE_STRING,
+                                             G_TYPE_INT,
+                                             G_TYPE_INT,
+                                             G_TYPE_POINTER);
+
+    panel->priv->treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL (panel->priv->store));
+    g_object_unref (panel->priv->store);
+    gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (panel->priv->treeview), FALSE);
+    gtk_tree_view_set_enable_search (GTK_TREE_VIEW (panel->priv->treeview), FALSE);
+    gtk_container_add (GTK_CONTAINER (sw), panel->priv->treeview);
+    gtk_widget_show (panel->priv->treeview);
+
+    column = gtk_tree_view_column_new ();
+    cell = gtk_cell_renderer_text_new ();
+    gtk_tree_view_column_pack_start (column, cell, TRUE);
+    gtk_tree_view_column_add_attribute (column, cell, "markup", NAME_COLUMN);
+    gtk_tree_view_append_column (GTK_TREE_VIEW (panel->priv->treeview), column);
+
+    g_signal_connect (panel->priv->treeview, "row-activated", G_CALLBACK (treeview_row_activated), panel);
+
+    panel->priv->pool = g_thread_pool_new ((GFunc) search_thread, NULL, g_get_num_processors (), FALSE, NULL);
+}
+
+GtkWidget *
+xed_search_results_panel_new (XedWindow *window)
+{
+    g_return_val_if_fail (XED_IS_WINDOW (window), NULL);
+
+    return GTK_WIDGET (g_object_new (XED_TYPE_SEARCH_RESULTS_PANEL,
+                                     "window", window,
+                                     NULL));
+}
@@ -0,0 +1,65 @@
+/*
+ * xed-search-results-panel.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_SEARCH_RESULTS_PANEL_H__
+#define __XED_SEARCH_RESULTS_PANEL_H__
+
+#include <gtk/gtk.h>
+#include <gtksourceview/gtksource.h>
+
+#include <xed/xed-window.h>
+
+G_BEGIN_DECLS
+
+#define XED_TYPE_SEARCH_RESULTS_PANEL              (xed_search_results_panel_get_type ())
+#define XED_SEARCH_RESULTS_PANEL(obj)              (G_TYPE_CHECK_INSTANCE_CAST ((obj), XED_TYPE_SEARCH_RESULTS_PANEL, XedSearchResultsPanel))
+#define XED_SEARCH_RESULTS_PANEL_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), XED_TYPE_SEARCH_RESULTS_PANEL, XedSearchResultsPanelClass))
+#define XED_IS_SEARCH_RESULTS_PANEL(obj)           (G_TYPE_CHECK_INSTANCE_TYPE ((obj), XED_TYPE_SEARCH_RESULTS_PANEL))
+#define XED_IS_SEARCH_RESULTS_PANEL_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), XED_TYPE_SEARCH_RESULTS_PANEL))
+#define XED_SEARCH_RESULTS_PANEL_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), XED_TYPE_SEARCH_RESULTS_PANEL, XedSearchResultsPanelClass))
+
+typedef struct _XedSearchResultsPanel        XedSearchResultsPanel;
+typedef struct _XedSearchResultsPanelClass   XedSearchResultsPanelClass;
+typedef struct _XedSearchResultsPanelPrivate XedSearchResultsPanelPrivate;
+
+struct _XedSearchResultsPanel
+{
+    GtkBox vbox;
+
+    /*< private > */
+    XedSearchResultsPanelPrivate *priv;
+};
+
+struct _XedSearchResultsPanelClass
+{
+    GtkBoxClass parent_class;
+};
+
+GType      xed_search_results_panel_get_type  (void) G_GNUC_CONST;
+
+GtkWidget *xed_search_results_panel_new       (XedWindow               *window);
+
+void       xed_search_results_panel_find      (XedSearchResultsPanel   *panel,
+                                               GtkSourceSearchSettings *search_settings);
+void       xed_search_results_panel_stop      (XedSearchResultsPanel   *panel);
+
+G_END_DECLS
+
+#endif /* __XED_SEARCH_RESULTS_PANEL_H__ */
@@ -7,6 +7,8 @@
 #include "xed-searchbar.h"
 #include "xed-statusbar.h"
 #include "xed-history-entry.h"
+#include "xed-search-index.h"
+#include "xed-replace-all.h"
 #include "xed-utils.h"
 #include "xed-marshal.h"
 #include "xed-dirs.h"
@@ -45,6 +47,12 @@ struct _XedSearchbarPrivate
     XedSearchMode search_mode;
 
     guint update_occurrence_count_id;
+
+    /* Set while a Replace All runs */
+    GCancellable *replace_all_cancellable;
+    XedView *replace_all_view;
+    gboolean replace_all_view_editable;
+    gint n_replaced;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (XedSearchbar, xed_searchbar, GTK_TYPE_BOX)
@@ -60,6 +68,13 @@ xed_searchbar_dispose (GObject *object)
         searchbar->priv->update_occurrence_count_id = 0;
     }
 
+    /* The window goes away with us, so the result is not reported */
+    if (searchbar->priv->replace_all_cancellable != NULL)
+    {
+        g_cancellable_cancel (searchbar->priv->replace_all_cancellable);
+        g_clear_object (&searchbar->priv->replace_all_cancellable);
+    }
+
     g_clear_object (&searchbar->priv->search_settings);
 
     G_OBJECT_CLASS (xed_searchbar_parent_class)->dispose (object);
@@ -261,6 +276,7 @@ update_occurrence_count (XedSearchbar *searchbar)
 {
     XedDocument *doc;
     GtkSourceSearchContext *search_context;
+    XedSearchIndex *search_index;
     GtkTextIter match_start;
     GtkTextIter match_end;
     gint count;
@@ -280,14 +296,30 @@ update_occurrence_count (XedSearchbar *searchbar)
         return;
     }
 
-    count = gtk_source_search_context_get_occurrences_count (search_context);
+    search_index = xed_search_index_get_for_context (search_context);
+    count = xed_search_index_get_count (search_index);
 
     gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (doc), &match_start, &match_end);
-    pos = gtk_source_search_context_get_occurrence_position (search_context, &match_start, &match_end);
+    pos = xed_search_index_get_position (search_index, &match_start, &match_end);
 
-    if (count == -1 || pos == -1)
+    /* Show the matches found so far while the buffer is being scanned */
+    if (!xed_search_index_is_complete (search_index))
     {
-        /* Wait for the buffer to be fully scanned */
+        if (pos > 0)
+        {
+            xed_statusbar_flash_message (XED_STATUSBAR (searchbar->window->priv->statusbar),
+                                         searchbar->window->priv->generic_message_cid,
+                                         ngettext ("%d of at least %d match", "%d of at least %d matches",
+                                         count),
+                                         pos, count);
+        }
+        else if (count > 0)
+        {
+            xed_statusbar_flash_message (XED_STATUSBAR (searchbar->window->priv->statusbar),
+                                         searchbar->window->priv->generic_message_cid,
+                                         ngettext ("At least %d match", "At least %d matches", count), count);
+        }
+
         return;
     }
 
@@ -359,6 +391,12 @@ do_find (XedSearchbar *searchbar,
     GtkSourceSearchContext *search_context;
     GtkSourceSearchSettings *search_settings;
 
+    /* A new search stops replacing the previous one */
+    if (searchbar->priv->replace_all_cancellable != NULL)
+    {
+        g_cancellable_cancel (searchbar->priv->replace_all_cancellable);
+    }
+
     search_settings = xed_searchbar_get_search_settings (searchbar);
     doc = xed_window_get_active_document (searchbar->window);
     search_context = xed_document_get_search_context (doc);
@@ -373,8 +411,8 @@ do_find (XedSearchbar *searchbar,
         g_signal_connect (GTK_TEXT_BUFFER (doc), "mark-set",
                           G_CALLBACK (mark_set_cb), searchbar);
 
-        g_signal_connect_swapped (search_context, "notify::occurrences-count",
-                                  G_CALLBACK (install_occurrence_count_idle), searchbar);
+        g_signal_connect_object (xed_search_index_get_for_context (search_context), "changed",
+                                 G_CALLBACK (install_occurrence_count_idle), searchbar, G_CONNECT_SWAPPED);
 
         g_object_unref (search_context);
     }
@@ -487,19 +525,113 @@ do_replace (XedSearchbar *searchbar)
     do_find (searchbar, FALSE, TRUE);
 }
 
+static void
+replace_all_progress_cb (gint          n_replaced,
+                         gint          n_matches,
+                         XedSearchbar *searchbar)
+{
+    if (searchbar->priv->replace_all_cancellable == NULL)
+    {
+        return;
+    }
+
+    if (n_replaced < 0)
+    {
+        xed_statusbar_flash_message (XED_STATUSBAR (searchbar->window->priv->statusbar),
+                                     searchbar->window->priv->generic_message_cid,
+                                     ngettext ("Searching... %d occurrence found", "Searching... %d occurrences found",
+                                     n_matches),
+                                     n_matches);
+        return;
+    }
+
+    searchbar->priv->n_replaced = n_replaced;
+
+    xed_statusbar_flash_message (XED_STATUSBAR (searchbar->window->priv->statusbar),
+                                 searchbar->window->priv->generic_message_cid,
+                                 ngettext ("Replaced %d of %d occurrence", "Replaced %d of %d occurrences",
+                                 n_matches),
+                                 n_replaced, n_matches);
+}
+
+static void
+replace_all_finished (GtkSourceSearchContext *search_context,
+                      GAsyncResult           *result,
+                      XedSearchbar           *searchbar)
+{
+    GError *error = NULL;
+    gint count;
+
+    count = xed_replace_all_finish (search_context, result, &error);
+
+    gtk_text_view_set_editable (GTK_TEXT_VIEW (searchbar->priv->replace_all_view),
+                                searchbar->priv->replace_all_view_editable);
+    g_clear_object (&searchbar->priv->replace_all_view);
+
+    /* Disposed meanwhile */
+    if (searchbar->priv->replace_all_cancellable == NULL)
+    {
+        g_clear_error (&error);
+        g_object_unref (searchbar);
+        return;
+    }
+
+    g_clear_object (&searchbar->priv->replace_all_cancellable);
+
+    gtk_button_set_label (GTK_BUTTON (searchbar->priv->replace_all_button), _("Replace _All"));
+    gtk_widget_set_sensitive (searchbar->priv->replace_button, TRUE);
+
+    if (error != NULL)
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            xed_statusbar_flash_message (XED_STATUSBAR (searchbar->window->priv->statusbar),
+                                         searchbar->window->priv->generic_message_cid,
+                                         ngettext ("Stopped after replacing %d occurrence",
+                                                   "Stopped after replacing %d occurrences",
+                                         searchbar->priv->n_replaced),
+                                         searchbar->priv->n_replaced);
+        }
+        else
+        {
+            g_warning ("Replace All: %s", error->message);
+        }
+
+        g_error_free (error);
+    }
+    else if (count > 0)
+    {
+        text_found (searchbar->window, count);
+    }
+    else
+    {
+        text_not_found (searchbar);
+    }
+
+    g_object_unref (searchbar);
+}
+
 static void
 do_replace_all (XedSearchbar *searchbar)
 {
     XedDocument *doc;
+    XedView *view;
     GtkSourceSearchContext *search_context;
     const gchar *replace_entry_text;
     gchar *unescaped_replace_text;
-    gint count;
     GtkSourceSearchSettings *search_settings;
 
+    /* The button stops the replacement running */
+    if (searchbar->priv->replace_all_cancellable != NULL)
+    {
+        g_cancellable_cancel (searchbar->priv->replace_all_cancellable);
+        return;
+    }
+
     search_settings = xed_searchbar_get_search_settings (searchbar);
 
     doc = xed_window_get_active_document (searchbar->window);
+    view = xed_window_get_active_view (searchbar->window);
 
     if (doc == NULL)
     {
@@ -518,6 +650,8 @@ do_replace_all (XedSearchbar *searchbar)
         search_context = gtk_source_search_context_new (GTK_SOURCE_BUFFER (doc), search_settings);
 
         xed_document_set_search_context (doc, search_context);
+
+        g_object_unref (search_context);
     }
 
     /* replace text may be "", we just delete all occurrences */
@@ -525,20 +659,28 @@ do_replace_all (XedSearchbar *searchbar)
     g_return_if_fail ((replace_entry_text) != NULL);
 
     unescaped_replace_text = gtk_source_utils_unescape_search_text (replace_entry_text);
-    count = gtk_source_search_context_replace_all (search_context, unescaped_replace_text, -1, NULL);
     searchbar->priv->search_mode = XED_SEARCH_MODE_REPLACE;
 
-    g_free (unescaped_replace_text);
-
-    if (count > 0)
-    {
-        text_found (searchbar->window, count);
-    }
-    else
-    {
-        text_not_found (searchbar);
-    }
+    /* The occurrences are replaced from idles, keep the user from
+     * editing the buffer in between */
+    searchbar->priv->replace_all_cancellable = g_cancellable_new ();
+    searchbar->priv->replace_all_view = g_object_ref (view);
+    searchbar->priv->replace_all_view_editable = gtk_text_view_get_editable (GTK_TEXT_VIEW (view));
+    searchbar->priv->n_replaced = 0;
+
+    gtk_text_view_set_editable (GTK_TEXT_VIEW (view), FALSE);
+    gtk_widget_set_sensitive (searchbar->priv->replace_button, FALSE);
+    gtk_button_set_label (GTK_BUTTON (searchbar->priv->replace_all_button), _("_Stop"));
+
+    xed_replace_all_async (search_context,
+                           unescaped_replace_text,
+                           searchbar->priv->replace_all_cancellable,
+                           (XedReplaceAllProgressFunc) replace_all_progress_cb,
+                           searchbar,
+                           (GAsyncReadyCallback) replace_all_finished,
+                           g_object_ref (searchbar));
 
+    g_free (unescaped_replace_text);
 }
 
 static void
@@ -851,6 +993,11 @@ xed_searchbar_hide (XedSearchbar *searchbar)
     gtk_revealer_set_transition_type (GTK_REVEALER (searchbar->priv->revealer), GTK_REVEALER_TRANSITION_TYPE_SLIDE_DOWN);
     gtk_revealer_set_reveal_child (GTK_REVEALER (searchbar->priv->revealer), FALSE);
 
+    if (searchbar->priv->replace_all_cancellable != NULL)
+    {
+        g_cancellable_cancel (searchbar->priv->replace_all_cancellable);
+    }
+
     // focus document
     active_view = xed_window_get_active_view (searchbar->window);
 
@@ -96,6 +96,10 @@ void xed_settings_set_list (GSettings    *settings,
 #define XED_SETTINGS_SMART_HOME_END             "smart-home-end"
 #define XED_SETTINGS_WRITABLE_VFS_SCHEMES       "writable-vfs-schemes"
 #define XED_SETTINGS_RESTORE_CURSOR_POSITION    "restore-cursor-position"
+#define XED_SETTINGS_MAX_METADATA_ITEMS         "max-metadata-items"
+#define XED_SETTINGS_LAZY_TAB_LOADING           "lazy-tab-loading"
+#define XED_SETTINGS_MAX_LOADED_TABS_SIZE       "max-loaded-tabs-size"
+#define XED_SETTINGS_LARGE_FILE_THRESHOLD       "large-file-threshold"
 #define XED_SETTINGS_SYNTAX_HIGHLIGHTING        "syntax-highlighting"
 #define XED_SETTINGS_SEARCH_HIGHLIGHTING        "search-highlighting"
 #define XED_SETTINGS_ENABLE_TAB_SCROLLING       "enable-tab-scrolling"
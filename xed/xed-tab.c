@@ -36,6 +36,7 @@
 #include "xed-tab.h"
 #include "xed-utils.h"
 #include "xed-io-error-info-bar.h"
+#include "xed-large-file.h"
 #include "xed-print-job.h"
 #include "xed-print-preview.h"
 #include "xed-progress-info-bar.h"
@@ -48,6 +49,13 @@
 
 #define XED_TAB_KEY "XED_TAB_KEY"
 
+/* Loads started at the same time. Opening many files queues the rest, so
+ * the first tabs become usable instead of all of them crawling along */
+#define MAX_CONCURRENT_LOADS 4
+
+/* Lines of a large file kept in the buffer at once */
+#define LARGE_FILE_WINDOW_LINES 20000
+
 struct _XedTabPrivate
 {
     GSettings *editor;
@@ -83,6 +91,23 @@ struct _XedTabPrivate
 
     /*tmp data for loading */
     guint user_requested_encoding : 1;
+    guint line_pos_reached : 1;
+
+    /* A placeholder tab only knows its location until it is shown */
+    const GtkSourceEncoding *placeholder_encoding;
+    gint placeholder_line_pos;
+    gint restore_offset;
+    guint placeholder : 1;
+    guint placeholder_create : 1;
+
+    /* Files over the large file threshold are shown part by part */
+    XedLargeFile *large_file;
+    GtkWidget *large_file_label;
+    guint large_file_first_line;
+    guint large_file_idle;
+    guint large_file_progress;
+    guint large_file_mode : 1;
+    guint large_file_updating : 1;
 };
 
 typedef struct _SaverData SaverData;
@@ -132,6 +157,10 @@ static void load (XedTab                  *tab,
 
 static void save (XedTab *tab);
 
+/* Tabs whose load waits for a free slot, each holding a reference */
+static GQueue pending_loads = G_QUEUE_INIT;
+static guint n_running_loads = 0;
+
 static SaverData *
 saver_data_new (void)
 {
@@ -299,19 +328,47 @@ xed_tab_finalize (GObject *object)
         tab->priv->idle_scroll = 0;
     }
 
+    if (tab->priv->large_file_idle != 0)
+    {
+        g_source_remove (tab->priv->large_file_idle);
+        tab->priv->large_file_idle = 0;
+    }
+
+    xed_large_file_free (tab->priv->large_file);
+
     G_OBJECT_CLASS (xed_tab_parent_class)->finalize (object);
 }
 
+static void
+xed_tab_map (GtkWidget *widget)
+{
+    GList *link;
+
+    /* The tab is being shown, so its load goes before the others */
+    link = g_queue_find (&pending_loads, widget);
+
+    if (link != NULL)
+    {
+        g_queue_unlink (&pending_loads, link);
+        g_queue_push_head_link (&pending_loads, link);
+    }
+
+    GTK_WIDGET_CLASS (xed_tab_parent_class)->map (widget);
+}
+
 static void
 xed_tab_class_init (XedTabClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
     object_class->dispose = xed_tab_dispose;
     object_class->finalize = xed_tab_finalize;
     object_class->get_property = xed_tab_get_property;
     object_class->set_property = xed_tab_set_property;
 
+    widget_class->map = xed_tab_map;
+
     g_object_class_install_property (object_class,
                                      PROP_NAME,
                                      g_param_spec_string ("name",
@@ -869,6 +926,24 @@ info_bar_set_progress (XedTab  *tab,
     }
 }
 
+static void
+info_bar_set_n_lines (XedTab *tab,
+                      guint   n_lines)
+{
+    gchar *text;
+
+    if (tab->priv->info_bar == NULL)
+    {
+        return;
+    }
+
+    g_return_if_fail (XED_IS_PROGRESS_INFO_BAR (tab->priv->info_bar));
+
+    text = g_strdup_printf (ngettext ("%u line", "%u lines", n_lines), n_lines);
+    xed_progress_info_bar_set_progress_text (XED_PROGRESS_INFO_BAR (tab->priv->info_bar), text);
+    g_free (text);
+}
+
 static gboolean
 scroll_to_cursor (XedTab *tab)
 {
@@ -1171,6 +1246,7 @@ xed_tab_init (XedTab *tab)
     tab->priv->state = XED_TAB_STATE_NORMAL;
     tab->priv->editable = TRUE;
     tab->priv->ask_if_externally_modified = TRUE;
+    tab->priv->restore_offset = -1;
 
     gtk_orientable_set_orientation (GTK_ORIENTABLE (tab), GTK_ORIENTATION_VERTICAL);
 
@@ -1240,6 +1316,41 @@ _xed_tab_new_from_location (GFile                   *location,
     return GTK_WIDGET (tab);
 }
 
+static void
+set_placeholder (XedTab                  *tab,
+                 const GtkSourceEncoding *encoding,
+                 gint                     line_pos,
+                 gboolean                 create)
+{
+    tab->priv->placeholder = TRUE;
+    tab->priv->placeholder_encoding = encoding;
+    tab->priv->placeholder_line_pos = line_pos;
+    tab->priv->placeholder_create = create != FALSE;
+}
+
+/* Like _xed_tab_new_from_location, but the file is only read once the tab
+ * is materialized, usually when it is shown for the first time */
+GtkWidget *
+_xed_tab_new_placeholder (GFile                   *location,
+                          const GtkSourceEncoding *encoding,
+                          gint                     line_pos,
+                          gboolean                 create)
+{
+    XedTab *tab;
+    XedDocument *doc;
+
+    g_return_val_if_fail (G_IS_FILE (location), NULL);
+
+    tab = XED_TAB (_xed_tab_new ());
+    doc = xed_tab_get_document (tab);
+
+    gtk_source_file_set_location (xed_document_get_file (doc), location);
+    _xed_document_set_unloaded (doc, TRUE, -1);
+    set_placeholder (tab, encoding, line_pos, create);
+
+    return GTK_WIDGET (tab);
+}
+
 GtkWidget *
 _xed_tab_new_from_stream (GInputStream            *stream,
                           const GtkSourceEncoding *encoding,
@@ -1574,9 +1685,11 @@ loader_progress_cb (goffset  size,
                     goffset  total_size,
                     XedTab  *tab)
 {
+    GtkTextBuffer *buffer;
     gdouble elapsed_time;
     gdouble total_time;
     gdouble remaining_time;
+    guint n_lines;
 
     g_return_if_fail (tab->priv->state == XED_TAB_STATE_LOADING ||
                       tab->priv->state == XED_TAB_STATE_REVERTING);
@@ -1599,7 +1712,25 @@ loader_progress_cb (goffset  size,
         show_loading_info_bar (tab);
     }
 
+    /* The loader fills the buffer as it reads, and the buffer keeps its
+     * line count, so the lines read so far come for free */
+    buffer = GTK_TEXT_BUFFER (xed_tab_get_document (tab));
+    n_lines = gtk_text_buffer_get_line_count (buffer);
+
     info_bar_set_progress (tab, size, total_size);
+    info_bar_set_n_lines (tab, n_lines);
+
+    /* Jump to the requested line as soon as it is complete rather than
+     * after the whole file */
+    if (tab->priv->tmp_line_pos > 0 &&
+        !tab->priv->line_pos_reached &&
+        n_lines > (guint) tab->priv->tmp_line_pos)
+    {
+        xed_document_goto_line (XED_DOCUMENT (buffer), tab->priv->tmp_line_pos - 1);
+        xed_view_scroll_to_cursor (xed_tab_get_view (tab));
+
+        tab->priv->line_pos_reached = TRUE;
+    }
 }
 
 static void
@@ -1608,15 +1739,35 @@ goto_line (XedTab *tab)
     XedDocument *doc = xed_tab_get_document (tab);
     GtkTextIter iter;
 
-    /* Move the cursor at the requested line if any. */
+    /* The buffer holds the text again, its cursor is the one to save */
+    _xed_document_set_unloaded (doc, FALSE, -1);
+
+    /* Move the cursor at the requested line if any, unless it was done
+     * while loading, and the user may have moved on since. */
     if (tab->priv->tmp_line_pos > 0)
     {
-        xed_document_goto_line_offset (doc, tab->priv->tmp_line_pos - 1, 0);
+        if (!tab->priv->line_pos_reached)
+        {
+            xed_document_goto_line_offset (doc, tab->priv->tmp_line_pos - 1, 0);
+        }
+
         return;
     }
 
+    /* Back where the cursor was when the tab was unloaded. */
+    if (tab->priv->restore_offset >= 0)
+    {
+        gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (doc), &iter, tab->priv->restore_offset);
+        tab->priv->restore_offset = -1;
+
+        if (!gtk_text_iter_is_cursor_position (&iter))
+        {
+            gtk_text_iter_set_line_offset (&iter, 0);
+        }
+    }
+
     /* If enabled, move to the position stored in the metadata. */
-    if (g_settings_get_boolean (tab->priv->editor, XED_SETTINGS_RESTORE_CURSOR_POSITION))
+    else if (g_settings_get_boolean (tab->priv->editor, XED_SETTINGS_RESTORE_CURSOR_POSITION))
     {
         gchar *pos;
         gint offset;
@@ -1646,6 +1797,34 @@ goto_line (XedTab *tab)
     gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (doc), &iter);
 }
 
+static void load_cb (GtkSourceFileLoader *loader,
+                     GAsyncResult        *result,
+                     XedTab              *tab);
+
+static void
+start_load (XedTab *tab)
+{
+    n_running_loads++;
+
+    gtk_source_file_loader_load_async (tab->priv->loader,
+                                       G_PRIORITY_DEFAULT,
+                                       tab->priv->cancellable,
+                                       (GFileProgressCallback) loader_progress_cb,
+                                       tab,
+                                       NULL,
+                                       (GAsyncReadyCallback) load_cb,
+                                       tab);
+}
+
+static void
+start_pending_loads (void)
+{
+    while (n_running_loads < MAX_CONCURRENT_LOADS && !g_queue_is_empty (&pending_loads))
+    {
+        start_load (g_queue_pop_head (&pending_loads));
+    }
+}
+
 static void
 load_cb (GtkSourceFileLoader *loader,
          GAsyncResult        *result,
@@ -1656,6 +1835,9 @@ load_cb (GtkSourceFileLoader *loader,
     gboolean create_named_new_doc;
     GError *error = NULL;
 
+    n_running_loads--;
+    start_pending_loads ();
+
     g_return_if_fail (tab->priv->state == XED_TAB_STATE_LOADING ||
                       tab->priv->state == XED_TAB_STATE_REVERTING);
 
@@ -1941,6 +2123,7 @@ load (XedTab                  *tab,
     g_slist_free (candidate_encodings);
 
     tab->priv->tmp_line_pos = line_pos;
+    tab->priv->line_pos_reached = FALSE;
 
     g_clear_object (&tab->priv->cancellable);
     tab->priv->cancellable = g_cancellable_new ();
@@ -1951,14 +2134,400 @@ load (XedTab                  *tab,
     /* Keep the tab alive during the async operation. */
     g_object_ref (tab);
 
-    gtk_source_file_loader_load_async (tab->priv->loader,
-                                       G_PRIORITY_DEFAULT,
-                                       tab->priv->cancellable,
-                                       (GFileProgressCallback) loader_progress_cb,
-                                       tab,
-                                       NULL,
-                                       (GAsyncReadyCallback) load_cb,
-                                       tab);
+    if (n_running_loads >= MAX_CONCURRENT_LOADS)
+    {
+        xed_debug_message (DEBUG_TAB, "Too many loads running, queueing");
+
+        if (gtk_widget_get_mapped (GTK_WIDGET (tab)))
+        {
+            g_queue_push_head (&pending_loads, tab);
+        }
+        else
+        {
+            g_queue_push_tail (&pending_loads, tab);
+        }
+
+        return;
+    }
+
+    start_load (tab);
+}
+
+static void
+large_file_info_bar_response (GtkWidget *info_bar,
+                              gint       response_id,
+                              XedTab    *tab)
+{
+    gtk_widget_destroy (info_bar);
+}
+
+static void
+update_large_file_info_bar (XedTab *tab)
+{
+    GtkTextBuffer *buffer;
+    gchar *msg;
+
+    if (tab->priv->large_file_label == NULL)
+    {
+        return;
+    }
+
+    buffer = GTK_TEXT_BUFFER (xed_tab_get_document (tab));
+
+    msg = g_strdup_printf (_("This file is too large to be edited. Showing lines %u to %u of %u."),
+                           tab->priv->large_file_first_line + 1,
+                           tab->priv->large_file_first_line + gtk_text_buffer_get_line_count (buffer),
+                           xed_large_file_get_n_lines (tab->priv->large_file));
+
+    gtk_label_set_text (GTK_LABEL (tab->priv->large_file_label), msg);
+
+    g_free (msg);
+}
+
+static void
+show_large_file_info_bar (XedTab *tab)
+{
+    GtkWidget *bar;
+    GtkWidget *label;
+
+    bar = gtk_info_bar_new ();
+    gtk_info_bar_set_message_type (GTK_INFO_BAR (bar), GTK_MESSAGE_INFO);
+    gtk_info_bar_set_show_close_button (GTK_INFO_BAR (bar), TRUE);
+
+    label = gtk_label_new (NULL);
+    gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+    gtk_label_set_xalign (GTK_LABEL (label), 0.0);
+    gtk_container_add (GTK_CONTAINER (gtk_info_bar_get_content_area (GTK_INFO_BAR (bar))), label);
+
+    tab->priv->large_file_label = label;
+    g_object_add_weak_pointer (G_OBJECT (label), (gpointer *) &tab->priv->large_file_label);
+
+    g_signal_connect (bar, "response",
+                      G_CALLBACK (large_file_info_bar_response), tab);
+
+    gtk_widget_show_all (bar);
+
+    set_info_bar (tab, bar);
+
+    update_large_file_info_bar (tab);
+}
+
+/* The first line of the window of lines centered on @line */
+static guint
+get_large_file_window_start (XedTab *tab,
+                             guint   line)
+{
+    guint n_lines = xed_large_file_get_n_lines (tab->priv->large_file);
+    guint first;
+
+    first = line > LARGE_FILE_WINDOW_LINES / 2 ? line - LARGE_FILE_WINDOW_LINES / 2 : 0;
+
+    return MIN (first, n_lines > LARGE_FILE_WINDOW_LINES ? n_lines - LARGE_FILE_WINDOW_LINES : 0);
+}
+
+/* Fills the buffer with the part of the file around @line and puts the
+ * cursor on it */
+static void
+show_large_file_lines (XedTab  *tab,
+                       guint    line,
+                       gdouble  yalign)
+{
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    guint n_lines;
+    guint first;
+    gchar *text;
+    gsize length;
+
+    buffer = GTK_TEXT_BUFFER (xed_tab_get_document (tab));
+    n_lines = xed_large_file_get_n_lines (tab->priv->large_file);
+
+    line = MIN (line, n_lines > 0 ? n_lines - 1 : 0);
+    first = get_large_file_window_start (tab, line);
+
+    text = xed_large_file_get_lines (tab->priv->large_file, first, LARGE_FILE_WINDOW_LINES, &length);
+
+    /* Replacing the text moves the scrollbar, which is not the user
+     * scrolling towards the end of the window */
+    tab->priv->large_file_updating = TRUE;
+
+    gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (buffer));
+    gtk_text_buffer_set_text (buffer, text, length);
+    gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (buffer));
+    gtk_text_buffer_set_modified (buffer, FALSE);
+
+    tab->priv->large_file_updating = FALSE;
+
+    g_free (text);
+
+    tab->priv->large_file_first_line = first;
+
+    gtk_text_buffer_get_iter_at_line (buffer, &iter, line - first);
+    gtk_text_buffer_place_cursor (buffer, &iter);
+
+    gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (xed_tab_get_view (tab)),
+                                  gtk_text_buffer_get_insert (buffer),
+                                  0.0, TRUE, 0.0, yalign);
+
+    update_large_file_info_bar (tab);
+}
+
+static gboolean
+shift_large_file_window (XedTab *tab)
+{
+    GtkTextView *view;
+    GdkRectangle rect;
+    GtkTextIter iter;
+    guint line;
+
+    tab->priv->large_file_idle = 0;
+
+    view = GTK_TEXT_VIEW (xed_tab_get_view (tab));
+    gtk_text_view_get_visible_rect (view, &rect);
+    gtk_text_view_get_line_at_y (view, &iter, rect.y, NULL);
+
+    line = tab->priv->large_file_first_line + gtk_text_iter_get_line (&iter);
+
+    /* Keep the top line where it is, with the window centered on it */
+    if (get_large_file_window_start (tab, line) != tab->priv->large_file_first_line)
+    {
+        show_large_file_lines (tab, line, 0.0);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+large_file_vadjustment_changed (GtkAdjustment *adjustment,
+                                XedTab        *tab)
+{
+    GtkTextBuffer *buffer;
+    gdouble value;
+    gdouble page_size;
+    gboolean more_above;
+    gboolean more_below;
+
+    if (tab->priv->large_file == NULL ||
+        tab->priv->large_file_updating ||
+        tab->priv->large_file_idle != 0 ||
+        tab->priv->state != XED_TAB_STATE_NORMAL)
+    {
+        return;
+    }
+
+    buffer = GTK_TEXT_BUFFER (xed_tab_get_document (tab));
+    value = gtk_adjustment_get_value (adjustment);
+    page_size = gtk_adjustment_get_page_size (adjustment);
+
+    more_above = tab->priv->large_file_first_line > 0;
+    more_below = (tab->priv->large_file_first_line + gtk_text_buffer_get_line_count (buffer) <
+                  xed_large_file_get_n_lines (tab->priv->large_file));
+
+    /* Scrolled close to either end of the window, move it along */
+    if ((more_above && value < page_size) ||
+        (more_below && value + 2 * page_size > gtk_adjustment_get_upper (adjustment)))
+    {
+        tab->priv->large_file_idle = g_idle_add ((GSourceFunc) shift_large_file_window, tab);
+    }
+}
+
+/* Turns off what would make a huge buffer slow, for good as the settings
+ * bindings are gone */
+static void
+set_large_file_mode (XedTab *tab)
+{
+    XedDocument *doc;
+    XedView *view;
+    GtkFrame *map_frame;
+    GtkAdjustment *vadjustment;
+
+    if (tab->priv->large_file_mode)
+    {
+        return;
+    }
+
+    tab->priv->large_file_mode = TRUE;
+
+    doc = xed_tab_get_document (tab);
+    view = xed_tab_get_view (tab);
+    map_frame = xed_view_frame_get_map_frame (tab->priv->frame);
+
+    g_settings_unbind (doc, "highlight-syntax");
+    g_settings_unbind (doc, "max-undo-levels");
+    gtk_source_buffer_set_highlight_syntax (GTK_SOURCE_BUFFER (doc), FALSE);
+    gtk_source_buffer_set_max_undo_levels (GTK_SOURCE_BUFFER (doc), 0);
+
+    /* The gutter would number the lines of the window, not of the file */
+    g_settings_unbind (view, "show-line-numbers");
+    g_settings_unbind (view, "wrap-mode");
+    gtk_source_view_set_show_line_numbers (GTK_SOURCE_VIEW (view), FALSE);
+    gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (view), GTK_WRAP_NONE);
+
+    g_settings_unbind (map_frame, "visible");
+    gtk_widget_hide (GTK_WIDGET (map_frame));
+
+    vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (view));
+    g_signal_connect (vadjustment, "value-changed",
+                      G_CALLBACK (large_file_vadjustment_changed), tab);
+}
+
+static gboolean
+large_file_progress_cb (XedTab *tab)
+{
+    gdouble fraction;
+    guint n_lines;
+
+    fraction = xed_large_file_get_progress (tab->priv->large_file, &n_lines);
+
+    show_loading_info_bar (tab);
+    info_bar_set_progress (tab, fraction * 1000, 1000);
+    info_bar_set_n_lines (tab, n_lines);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void load_large_file (XedTab *tab);
+
+static void
+large_file_error_info_bar_response (GtkWidget *info_bar,
+                                    gint       response_id,
+                                    XedTab    *tab)
+{
+    GFile *location;
+
+    location = gtk_source_file_get_location (xed_document_get_file (xed_tab_get_document (tab)));
+
+    if (response_id == GTK_RESPONSE_OK)
+    {
+        set_info_bar (tab, NULL);
+        xed_tab_set_state (tab, XED_TAB_STATE_LOADING);
+
+        load_large_file (tab);
+    }
+    else
+    {
+        _xed_recent_remove (XED_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (tab))), location);
+
+        remove_tab (tab);
+    }
+}
+
+static void
+large_file_load_cb (GObject      *source,
+                    GAsyncResult *result,
+                    XedTab       *tab)
+{
+    XedDocument *doc = xed_tab_get_document (tab);
+    GFile *location = gtk_source_file_get_location (xed_document_get_file (doc));
+    GError *error = NULL;
+
+    if (tab->priv->large_file_progress != 0)
+    {
+        g_source_remove (tab->priv->large_file_progress);
+        tab->priv->large_file_progress = 0;
+    }
+
+    set_info_bar (tab, NULL);
+
+    if (!xed_large_file_load_finish (tab->priv->large_file, result, &error))
+    {
+        GtkWidget *info_bar;
+
+        xed_debug_message (DEBUG_TAB, "Large file loading error: %s", error->message);
+
+        g_clear_pointer (&tab->priv->large_file, xed_large_file_free);
+
+        if (tab->priv->state == XED_TAB_STATE_REVERTING)
+        {
+            xed_tab_set_state (tab, XED_TAB_STATE_REVERTING_ERROR);
+
+            info_bar = xed_unrecoverable_reverting_error_info_bar_new (location, error);
+
+            g_signal_connect (info_bar, "response",
+                              G_CALLBACK (unrecoverable_reverting_error_info_bar_response), tab);
+        }
+        else if (error->domain == G_IO_ERROR && error->code == G_IO_ERROR_CANCELLED)
+        {
+            xed_tab_set_state (tab, XED_TAB_STATE_LOADING_ERROR);
+            remove_tab (tab);
+            goto end;
+        }
+        else
+        {
+            xed_tab_set_state (tab, XED_TAB_STATE_LOADING_ERROR);
+
+            info_bar = xed_io_loading_error_info_bar_new (location, NULL, error);
+
+            g_signal_connect (info_bar, "response",
+                              G_CALLBACK (large_file_error_info_bar_response), tab);
+        }
+
+        set_info_bar (tab, info_bar);
+        gtk_info_bar_set_default_response (GTK_INFO_BAR (info_bar), GTK_RESPONSE_CANCEL);
+        gtk_widget_show (info_bar);
+
+        goto end;
+    }
+
+    set_large_file_mode (tab);
+
+    if (tab->priv->state == XED_TAB_STATE_LOADING)
+    {
+        gchar *mime = xed_document_get_mime_type (doc);
+
+        _xed_recent_add (XED_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (tab))), location, mime);
+        g_free (mime);
+    }
+
+    tab->priv->editable = FALSE;
+    tab->priv->ask_if_externally_modified = FALSE;
+
+    xed_tab_set_state (tab, XED_TAB_STATE_NORMAL);
+
+    show_large_file_info_bar (tab);
+    show_large_file_lines (tab, MAX (tab->priv->tmp_line_pos - 1, 0), 0.0);
+
+    g_clear_object (&tab->priv->cancellable);
+
+    g_signal_emit_by_name (doc, "loaded");
+
+end:
+    /* Async operation finished. */
+    g_object_unref (tab);
+
+    g_clear_error (&error);
+}
+
+/* Maps the file and indexes its lines instead of going through the file
+ * loader, the buffer never holds more than a window of lines */
+static void
+load_large_file (XedTab *tab)
+{
+    XedDocument *doc;
+    GFile *location;
+
+    doc = xed_tab_get_document (tab);
+    location = gtk_source_file_get_location (xed_document_get_file (doc));
+
+    set_info_bar (tab, NULL);
+
+    xed_large_file_free (tab->priv->large_file);
+    tab->priv->large_file = xed_large_file_new (location);
+
+    g_clear_object (&tab->priv->cancellable);
+    tab->priv->cancellable = g_cancellable_new ();
+
+    g_signal_emit_by_name (doc, "load");
+
+    /* Keep the tab alive during the async operation. */
+    g_object_ref (tab);
+
+    tab->priv->large_file_progress = g_timeout_add (200, (GSourceFunc) large_file_progress_cb, tab);
+
+    xed_large_file_load_async (tab->priv->large_file,
+                               tab->priv->cancellable,
+                               (GAsyncReadyCallback) large_file_load_cb,
+                               tab);
 }
 
 void
@@ -1970,6 +2539,7 @@ _xed_tab_load (XedTab                  *tab,
 {
     XedDocument *doc;
     GtkSourceFile *file;
+    guint threshold;
 
     g_return_if_fail (XED_IS_TAB (tab));
     g_return_if_fail (G_IS_FILE (location));
@@ -1987,6 +2557,19 @@ _xed_tab_load (XedTab                  *tab,
     }
 
     gtk_source_file_set_location (file, location);
+
+    threshold = g_settings_get_uint (tab->priv->editor, XED_SETTINGS_LARGE_FILE_THRESHOLD);
+
+    if (xed_large_file_should_open (location, threshold))
+    {
+        tab->priv->loader = NULL;
+        tab->priv->tmp_line_pos = line_pos;
+        _xed_document_set_create (doc, FALSE);
+
+        load_large_file (tab);
+        return;
+    }
+
     tab->priv->loader = gtk_source_file_loader_new (GTK_SOURCE_BUFFER (doc), file);
 
     _xed_document_set_create (doc, create);
@@ -1997,6 +2580,14 @@ _xed_tab_load (XedTab                  *tab,
 void
 _xed_tab_cancel_load (XedTab *tab)
 {
+    /* Not started yet, so there is nothing to wait for */
+    if (g_queue_remove (&pending_loads, tab))
+    {
+        g_cancellable_cancel (tab->priv->cancellable);
+        g_object_unref (tab);
+        return;
+    }
+
     g_return_if_fail (XED_IS_PROGRESS_INFO_BAR (tab->priv->info_bar));
     g_return_if_fail (G_IS_CANCELLABLE (tab->priv->cancellable));
 
@@ -2059,6 +2650,19 @@ _xed_tab_revert (XedTab *tab)
 
     xed_tab_set_state (tab, XED_TAB_STATE_REVERTING);
 
+    /* Stay on the same line of the file */
+    if (tab->priv->large_file != NULL)
+    {
+        GtkTextIter iter;
+
+        gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc), &iter,
+                                          gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (doc)));
+        tab->priv->tmp_line_pos = tab->priv->large_file_first_line + gtk_text_iter_get_line (&iter) + 1;
+
+        load_large_file (tab);
+        return;
+    }
+
     if (tab->priv->loader != NULL)
     {
         g_warning ("XedTab: file loader already exists.");
@@ -2292,6 +2896,7 @@ _xed_tab_save_async (XedTab              *tab,
     g_return_if_fail ((tab->priv->state == XED_TAB_STATE_NORMAL) ||
                       (tab->priv->state == XED_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION) ||
                       (tab->priv->state == XED_TAB_STATE_SHOWING_PRINT_PREVIEW));
+    g_return_if_fail (!tab->priv->large_file_mode);
 
     if (tab->priv->task_saver != NULL)
     {
@@ -2305,6 +2910,14 @@ _xed_tab_save_async (XedTab              *tab,
 
     tab->priv->task_saver = g_task_new (tab, cancellable, callback, user_data);
 
+    /* The buffer is empty until the tab is loaded, the file on disk is
+     * the document */
+    if (_xed_document_get_unloaded (doc))
+    {
+        g_task_return_boolean (tab->priv->task_saver, TRUE);
+        return;
+    }
+
     data = saver_data_new ();
     g_task_set_task_data (tab->priv->task_saver,
                           data,
@@ -2438,6 +3051,7 @@ _xed_tab_save_as_async (XedTab                   *tab,
                       (tab->priv->state == XED_TAB_STATE_SHOWING_PRINT_PREVIEW));
     g_return_if_fail (G_IS_FILE (location));
     g_return_if_fail (encoding != NULL);
+    g_return_if_fail (!tab->priv->large_file_mode);
 
     if (tab->priv->task_saver != NULL)
     {
@@ -3014,3 +3628,152 @@ _xed_tab_get_view_frame (XedTab *tab)
 
     return GTK_WIDGET (tab->priv->frame);
 }
+
+gboolean
+_xed_tab_is_placeholder (XedTab *tab)
+{
+    g_return_val_if_fail (XED_IS_TAB (tab), FALSE);
+
+    return tab->priv->placeholder;
+}
+
+void
+_xed_tab_materialize (XedTab *tab)
+{
+    GFile *location;
+
+    g_return_if_fail (XED_IS_TAB (tab));
+
+    if (!tab->priv->placeholder)
+    {
+        return;
+    }
+
+    tab->priv->placeholder = FALSE;
+
+    location = gtk_source_file_get_location (xed_document_get_file (xed_tab_get_document (tab)));
+    g_return_if_fail (location != NULL);
+
+    /* _xed_tab_load sets the location again */
+    g_object_ref (location);
+
+    _xed_tab_load (tab,
+                   location,
+                   tab->priv->placeholder_encoding,
+                   tab->priv->placeholder_line_pos,
+                   tab->priv->placeholder_create);
+
+    g_object_unref (location);
+}
+
+/* Drops the contents of an untouched tab, turning it back into a
+ * placeholder. Returns FALSE when the tab has anything to lose */
+gboolean
+_xed_tab_unload (XedTab *tab)
+{
+    XedDocument *doc;
+    GtkTextBuffer *buffer;
+    GtkTextIter iter;
+    gint line_pos = 0;
+
+    g_return_val_if_fail (XED_IS_TAB (tab), FALSE);
+
+    doc = xed_tab_get_document (tab);
+    buffer = GTK_TEXT_BUFFER (doc);
+
+    if (tab->priv->placeholder ||
+        tab->priv->state != XED_TAB_STATE_NORMAL ||
+        tab->priv->info_bar != NULL ||
+        gtk_source_file_get_location (xed_document_get_file (doc)) == NULL ||
+        gtk_text_buffer_get_modified (buffer) ||
+        gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER (doc)) ||
+        gtk_source_buffer_can_redo (GTK_SOURCE_BUFFER (doc)))
+    {
+        return FALSE;
+    }
+
+    xed_debug (DEBUG_TAB);
+
+    gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+    tab->priv->restore_offset = gtk_text_iter_get_offset (&iter);
+
+    /* An offset in the part of a large file shown means nothing once
+     * it is loaded again, its line does */
+    if (tab->priv->large_file != NULL)
+    {
+        line_pos = tab->priv->large_file_first_line + gtk_text_iter_get_line (&iter) + 1;
+        tab->priv->restore_offset = -1;
+
+        g_clear_pointer (&tab->priv->large_file, xed_large_file_free);
+    }
+
+    gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+    gtk_text_buffer_set_text (buffer, "", 0);
+    gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+    gtk_text_buffer_set_modified (buffer, FALSE);
+
+    _xed_document_set_unloaded (doc, TRUE, tab->priv->restore_offset);
+    set_placeholder (tab, NULL, line_pos, FALSE);
+
+    return TRUE;
+}
+
+gboolean
+_xed_tab_is_large_file (XedTab *tab)
+{
+    g_return_val_if_fail (XED_IS_TAB (tab), FALSE);
+
+    return tab->priv->large_file_mode;
+}
+
+/* The line of the file shown on the first line of the buffer, which is
+ * only past the start for large files */
+guint
+_xed_tab_get_first_line (XedTab *tab)
+{
+    g_return_val_if_fail (XED_IS_TAB (tab), 0);
+
+    return tab->priv->large_file != NULL ? tab->priv->large_file_first_line : 0;
+}
+
+/* Like xed_document_goto_line_offset(), but @line counts from the start of
+ * the file even when only a part of it is shown */
+gboolean
+_xed_tab_goto_line (XedTab *tab,
+                    gint    line,
+                    gint    line_offset)
+{
+    XedDocument *doc;
+    gboolean moved;
+    gboolean moved_offset;
+
+    g_return_val_if_fail (XED_IS_TAB (tab), FALSE);
+    g_return_val_if_fail (line >= 0, FALSE);
+
+    /* Not loaded yet, the line is gone to once it is */
+    if (tab->priv->placeholder)
+    {
+        tab->priv->placeholder_line_pos = line + 1;
+        return TRUE;
+    }
+
+    if (tab->priv->state == XED_TAB_STATE_LOADING)
+    {
+        tab->priv->tmp_line_pos = line + 1;
+        tab->priv->line_pos_reached = FALSE;
+        return TRUE;
+    }
+
+    doc = xed_tab_get_document (tab);
+
+    if (tab->priv->large_file != NULL)
+    {
+        show_large_file_lines (tab, line, 0.5);
+        line -= tab->priv->large_file_first_line;
+    }
+
+    moved = xed_document_goto_line (doc, line);
+    moved_offset = xed_document_goto_line_offset (doc, line, line_offset);
+
+    return moved && moved_offset;
+}
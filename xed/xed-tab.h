@@ -113,6 +113,11 @@ GtkWidget *_xed_tab_new_from_location  (GFile                   *location,
                                         gint                     line_pos,
                                         gboolean                 create);
 
+GtkWidget *_xed_tab_new_placeholder    (GFile                   *location,
+                                        const GtkSourceEncoding *encoding,
+                                        gint                     line_pos,
+                                        gboolean                 create);
+
 GtkWidget *_xed_tab_new_from_stream (GInputStream            *stream,
                                      const GtkSourceEncoding *encoding,
                                      gint                     line_pos);
@@ -160,6 +165,14 @@ void _xed_tab_print_preview (XedTab *tab);
 void _xed_tab_mark_for_closing (XedTab *tab);
 gboolean _xed_tab_get_can_close (XedTab *tab);
 GtkWidget *_xed_tab_get_view_frame (XedTab *tab);
+gboolean _xed_tab_is_placeholder (XedTab *tab);
+void _xed_tab_materialize (XedTab *tab);
+gboolean _xed_tab_unload (XedTab *tab);
+gboolean _xed_tab_is_large_file (XedTab *tab);
+guint _xed_tab_get_first_line (XedTab *tab);
+gboolean _xed_tab_goto_line (XedTab *tab,
+                             gint    line,
+                             gint    line_offset);
 
 G_END_DECLS
 
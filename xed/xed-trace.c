@@ -0,0 +1,241 @@
+/*
+ * xed-trace.c
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <unistd.h>
+
+#include "xed-trace.h"
+
+typedef struct
+{
+    gchar phase;
+    const gchar *category;
+    gchar *name;
+    gint64 time;
+    gpointer thread;
+} TraceEvent;
+
+/* Where the trace is written, NULL when not tracing */
+static gchar *trace_filename = NULL;
+
+/* The worker threads may trace too */
+static GMutex trace_lock;
+static GArray *events = NULL;
+static gint64 start_time = 0;
+
+/* Threads are numbered in the order they first traced */
+static GHashTable *thread_ids = NULL;
+
+void
+xed_trace_init (void)
+{
+    const gchar *filename;
+
+    if (trace_filename != NULL)
+    {
+        return;
+    }
+
+    filename = g_getenv ("XED_TRACE");
+
+    if (filename == NULL || *filename == '\0')
+    {
+        return;
+    }
+
+    start_time = g_get_monotonic_time ();
+    events = g_array_sized_new (FALSE, FALSE, sizeof (TraceEvent), 256);
+    thread_ids = g_hash_table_new (NULL, NULL);
+
+    /* Set last, the other functions do nothing until it is */
+    trace_filename = g_strdup (filename);
+}
+
+static void
+add_event (gchar        phase,
+           const gchar *category,
+           const gchar *name)
+{
+    TraceEvent event;
+
+    if (G_LIKELY (trace_filename == NULL))
+    {
+        return;
+    }
+
+    event.phase = phase;
+    event.category = category;
+    event.name = g_strdup (name);
+    event.time = g_get_monotonic_time ();
+    event.thread = g_thread_self ();
+
+    g_mutex_lock (&trace_lock);
+
+    /* The trace was written meanwhile */
+    if (events == NULL)
+    {
+        g_mutex_unlock (&trace_lock);
+        g_free (event.name);
+        return;
+    }
+
+    if (!g_hash_table_contains (thread_ids, event.thread))
+    {
+        g_hash_table_insert (thread_ids, event.thread, GUINT_TO_POINTER (g_hash_table_size (thread_ids) + 1));
+    }
+
+    g_array_append_val (events, event);
+
+    g_mutex_unlock (&trace_lock);
+}
+
+/**
+ * xed_trace_begin:
+ * @category: a static string grouping the span with similar ones
+ * @name: what is being timed
+ *
+ * Starts a span, to be ended with xed_trace_end() on the same thread.
+ */
+void
+xed_trace_begin (const gchar *category,
+                 const gchar *name)
+{
+    add_event ('B', category, name);
+}
+
+void
+xed_trace_end (const gchar *category,
+               const gchar *name)
+{
+    add_event ('E', category, name);
+}
+
+/* A point in time rather than a span, like the first window shown */
+void
+xed_trace_mark (const gchar *category,
+                const gchar *name)
+{
+    add_event ('i', category, name);
+}
+
+static void
+append_json_string (GString     *json,
+                    const gchar *str)
+{
+    const gchar *p;
+
+    g_string_append_c (json, '"');
+
+    for (p = str; *p != '\0'; p++)
+    {
+        switch (*p)
+        {
+            case '"':
+                g_string_append (json, "\\\"");
+                break;
+            case '\\':
+                g_string_append (json, "\\\\");
+                break;
+            default:
+                if ((guchar) *p < 0x20)
+                {
+                    g_string_append_printf (json, "\\u%04x", (guint) *p);
+                }
+                else
+                {
+                    g_string_append_c (json, *p);
+                }
+                break;
+        }
+    }
+
+    g_string_append_c (json, '"');
+}
+
+static void
+write_trace (void)
+{
+    GString *json;
+    GError *error = NULL;
+    gint pid;
+    guint i;
+
+    pid = getpid ();
+    json = g_string_sized_new (events->len * 96);
+
+    g_string_append (json, "{\"traceEvents\":[\n");
+
+    for (i = 0; i < events->len; i++)
+    {
+        TraceEvent *event = &g_array_index (events, TraceEvent, i);
+
+        g_string_append (json, "{\"name\":");
+        append_json_string (json, event->name);
+        g_string_append (json, ",\"cat\":");
+        append_json_string (json, event->category);
+        g_string_append_printf (json,
+                                ",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%u%s}%s\n",
+                                event->phase,
+                                event->time - start_time,
+                                pid,
+                                GPOINTER_TO_UINT (g_hash_table_lookup (thread_ids, event->thread)),
+                                event->phase == 'i' ? ",\"s\":\"p\"" : "",
+                                i + 1 < events->len ? "," : "");
+    }
+
+    g_string_append (json, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    if (!g_file_set_contents (trace_filename, json->str, json->len, &error))
+    {
+        g_warning ("Could not write the trace to %s: %s", trace_filename, error->message);
+        g_error_free (error);
+    }
+
+    g_string_free (json, TRUE);
+}
+
+void
+xed_trace_shutdown (void)
+{
+    guint i;
+
+    if (trace_filename == NULL)
+    {
+        return;
+    }
+
+    g_mutex_lock (&trace_lock);
+
+    write_trace ();
+
+    for (i = 0; i < events->len; i++)
+    {
+        g_free (g_array_index (events, TraceEvent, i).name);
+    }
+
+    g_array_free (events, TRUE);
+    events = NULL;
+    g_hash_table_destroy (thread_ids);
+    thread_ids = NULL;
+
+    g_clear_pointer (&trace_filename, g_free);
+
+    g_mutex_unlock (&trace_lock);
+}
@@ -0,0 +1,45 @@
+/*
+ * xed-trace.h
+ * This file is part of xed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __XED_TRACE_H__
+#define __XED_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Timed spans, recorded when the XED_TRACE environment variable names a
+ * file. They are written to it on shutdown in the Chrome trace event
+ * format, which chrome://tracing and Perfetto open. Spans of a thread must
+ * be ended in the reverse order they were begun. */
+
+void     xed_trace_init         (void);
+void     xed_trace_shutdown     (void);
+
+void     xed_trace_begin        (const gchar *category,
+                                 const gchar *name);
+void     xed_trace_end          (const gchar *category,
+                                 const gchar *name);
+void     xed_trace_mark         (const gchar *category,
+                                 const gchar *name);
+
+G_END_DECLS
+
+#endif /* __XED_TRACE_H__ */
@@ -123,6 +123,8 @@ static const GtkActionEntry xed_menu_entries[] =
 	  N_("Search forwards for the same text"), G_CALLBACK (_xed_cmd_search_find_next) },
 	{ "SearchFindPrevious", NULL, N_("Find Pre_vious"), "<shift><control>G",
 	  N_("Search backwards for the same text"), G_CALLBACK (_xed_cmd_search_find_prev) },
+	{ "SearchFindInDocuments", NULL, N_("Find in Open _Documents"), "<shift><control>F",
+	  N_("Search for the same text in all the open documents"), G_CALLBACK (_xed_cmd_search_find_in_documents) },
 	{ "SearchReplace", "xsi-edit-find-replace-symbolic", N_("_Replace"), "<control>H",
 	  N_("Search for and replace text"), G_CALLBACK (_xed_cmd_search_replace) },
 	{ "SearchGoToLine", "xsi-go-jump-symbolic", N_("Go to _Line..."), "<control>I",
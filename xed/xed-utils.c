@@ -36,6 +36,8 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
 #include <string.h>
 #include <glib.h>
 #include <glib/gi18n.h>
@@ -54,6 +56,10 @@
 
 #define STDIN_DELAY_MICROSECONDS 100000
 
+/* Bytes of a line shown before a match, and at most in total */
+#define SNIPPET_CONTEXT 60
+#define SNIPPET_LENGTH  200
+
 /* FIXME: remove this with gtk 2.12, it has gdk_color_to_string */
 gchar *
 xed_gdk_color_to_string (GdkColor color)
@@ -1139,6 +1145,173 @@ xed_utils_drop_get_uris (GtkSelectionData *selection_data)
     return uri_list;
 }
 
+/**
+ * xed_utils_make_match_snippet:
+ * @line: the line of the match, counted from 0
+ * @line_start: the start of the line
+ * @match_start: the start of the match
+ * @match_end: the end of the match
+ * @text_end: the end of the text holding the line
+ *
+ * Builds the markup listing a match in search results: the line number
+ * followed by the line, with the match in bold. Leading blanks are dropped,
+ * and a long line is clipped around the match.
+ *
+ * Return value: (transfer full): the markup, to be freed with g_free
+ */
+gchar *
+xed_utils_make_match_snippet (gint         line,
+                              const gchar *line_start,
+                              const gchar *match_start,
+                              const gchar *match_end,
+                              const gchar *text_end)
+{
+    const gchar *line_end;
+    const gchar *snippet_start;
+    const gchar *snippet_end;
+    gboolean clipped = FALSE;
+    gchar *before;
+    gchar *match;
+    gchar *after;
+    gchar *markup;
+
+    line_end = memchr (match_start, '\n', text_end - match_start);
+
+    if (line_end == NULL)
+    {
+        line_end = text_end;
+    }
+
+    if (line_end > match_start && line_end[-1] == '\r')
+    {
+        line_end--;
+    }
+
+    snippet_start = line_start;
+
+    while (snippet_start < match_start && g_ascii_isspace (*snippet_start))
+    {
+        snippet_start++;
+    }
+
+    if (match_start - snippet_start > SNIPPET_CONTEXT)
+    {
+        snippet_start = match_start - SNIPPET_CONTEXT;
+        clipped = TRUE;
+
+        while ((*snippet_start & 0xc0) == 0x80)
+        {
+            snippet_start++;
+        }
+    }
+
+    snippet_end = line_end;
+
+    if (snippet_end - snippet_start > SNIPPET_LENGTH)
+    {
+        snippet_end = snippet_start + SNIPPET_LENGTH;
+
+        while ((*snippet_end & 0xc0) == 0x80)
+        {
+            snippet_end--;
+        }
+    }
+
+    match_end = MIN (match_end, snippet_end);
+
+    before = g_markup_escape_text (snippet_start, match_start - snippet_start);
+    match = g_markup_escape_text (match_start, match_end - match_start);
+    after = g_markup_escape_text (match_end, snippet_end - match_end);
+
+    markup = g_strdup_printf ("%d: %s%s<b>%s</b>%s%s",
+                              line + 1,
+                              clipped ? "..." : "",
+                              before,
+                              match,
+                              after,
+                              snippet_end < line_end ? "..." : "");
+
+    g_free (before);
+    g_free (match);
+    g_free (after);
+
+    return markup;
+}
+
+/*
+ * A mapped file which shrinks, as with the copytruncate of logrotate,
+ * raises SIGBUS when the pages past its new end are read. The jump is
+ * volatile, or the compiler could drop setting it around a memcpy() it
+ * knows does not read it.
+ */
+static __thread sigjmp_buf *volatile sigbus_jump = NULL;
+static struct sigaction old_sigbus_action;
+
+static void
+sigbus_handler (int signum)
+{
+    if (sigbus_jump != NULL)
+    {
+        siglongjmp (*sigbus_jump, 1);
+    }
+
+    /* Not a read of ours, the faulting access is made again with the
+     * previous handler */
+    sigaction (SIGBUS, &old_sigbus_action, NULL);
+}
+
+static void
+install_sigbus_handler (void)
+{
+    static gsize installed = 0;
+
+    if (g_once_init_enter (&installed))
+    {
+        struct sigaction action;
+
+        memset (&action, 0, sizeof (action));
+        action.sa_handler = sigbus_handler;
+        sigemptyset (&action.sa_mask);
+
+        sigaction (SIGBUS, &action, &old_sigbus_action);
+
+        g_once_init_leave (&installed, 1);
+    }
+}
+
+/**
+ * xed_utils_read_mapped_guarded:
+ * @func: (scope call): the function reading the mapped file
+ * @user_data: data to pass to @func
+ *
+ * Calls @func, which reads a mapped file, turning the fault raised when
+ * the file shrinks under the mapping into a failed call rather than a
+ * crash. @func is left at the read which faulted: what it allocated until
+ * then must be reachable from @user_data for the caller to free it.
+ *
+ * Return value: %FALSE if the file shrank while @func was reading it
+ */
+gboolean
+xed_utils_read_mapped_guarded (XedMappedReadFunc func,
+                               gpointer          user_data)
+{
+    sigjmp_buf jump;
+
+    install_sigbus_handler ();
+
+    if (sigsetjmp (jump, 1) != 0)
+    {
+        sigbus_jump = NULL;
+        return FALSE;
+    }
+
+    sigbus_jump = &jump;
+    func (user_data);
+    sigbus_jump = NULL;
+
+    return TRUE;
+}
+
 static void
 null_ptr (gchar **ptr)
 {
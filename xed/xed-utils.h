@@ -121,6 +121,17 @@ gboolean xed_utils_decode_uri (const gchar  *uri,
 /* Turns data from a drop into a list of well formatted uris */
 gchar **xed_utils_drop_get_uris (GtkSelectionData *selection_data);
 
+gchar *xed_utils_make_match_snippet (gint         line,
+                                     const gchar *line_start,
+                                     const gchar *match_start,
+                                     const gchar *match_end,
+                                     const gchar *text_end);
+
+typedef void (* XedMappedReadFunc) (gpointer user_data);
+
+gboolean xed_utils_read_mapped_guarded (XedMappedReadFunc func,
+                                        gpointer          user_data);
+
 /* Private */
 GSList *_xed_utils_encoding_strv_to_list (const gchar * const *enc_str);
 
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 
 #include "xed-view-frame.h"
+#include "xed-tab.h"
 #include "xed-marshal.h"
 #include "xed-debug.h"
 #include "xed-utils.h"
@@ -291,13 +292,23 @@ search_init (GtkWidget      *entry,
         gint line;
         gint offset_line = 0;
         gint line_offset = 0;
+        gint first_line = 0;
         gchar **split_text = NULL;
         const gchar *text;
         GtkTextIter iter;
         XedDocument *doc;
+        XedTab *tab;
 
         doc = xed_view_frame_get_document (frame);
         gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc), &iter, frame->priv->start_mark);
+
+        /* Lines of a large file count from the start of the file */
+        tab = xed_tab_get_from_document (doc);
+
+        if (tab != NULL)
+        {
+            first_line = _xed_tab_get_first_line (tab);
+        }
         split_text = g_strsplit (entry_text, ":", -1);
 
         if (g_strv_length (split_text) > 1)
@@ -311,7 +322,7 @@ search_init (GtkWidget      *entry,
 
         if (*text == '-')
         {
-            gint cur_line = gtk_text_iter_get_line (&iter);
+            gint cur_line = first_line + gtk_text_iter_get_line (&iter);
 
             if (*(text + 1) != '\0')
             {
@@ -322,7 +333,7 @@ search_init (GtkWidget      *entry,
         }
         else if (*entry_text == '+')
         {
-            gint cur_line = gtk_text_iter_get_line (&iter);
+            gint cur_line = first_line + gtk_text_iter_get_line (&iter);
 
             if (*(text + 1) != '\0')
             {
@@ -343,12 +354,20 @@ search_init (GtkWidget      *entry,
 
         g_strfreev (split_text);
 
-        moved = xed_document_goto_line (doc, line);
-        moved_offset = xed_document_goto_line_offset (doc, line, line_offset);
+        if (tab != NULL)
+        {
+            moved = _xed_tab_goto_line (tab, line, line_offset);
+        }
+        else
+        {
+            moved = xed_document_goto_line (doc, line);
+            moved_offset = xed_document_goto_line_offset (doc, line, line_offset);
+            moved = moved && moved_offset;
+        }
 
         xed_view_scroll_to_cursor (XED_VIEW (frame->priv->view));
 
-        if (!moved || !moved_offset)
+        if (!moved)
         {
             set_search_state (frame, SEARCH_STATE_NOT_FOUND);
         }
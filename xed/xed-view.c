@@ -15,6 +15,7 @@
 #include "xed-utils.h"
 #include "xed-settings.h"
 #include "xed-app.h"
+#include "xed-trace.h"
 
 #define XED_VIEW_SCROLL_MARGIN 0.02
 
@@ -69,7 +70,9 @@ extension_added (PeasExtensionSet *extensions,
                  PeasExtension    *exten,
                  XedView          *view)
 {
+    xed_trace_begin ("view-plugins", peas_plugin_info_get_module_name (info));
     peas_extension_call (exten, "activate");
+    xed_trace_end ("view-plugins", peas_plugin_info_get_module_name (info));
 }
 
 static void
@@ -121,14 +124,6 @@ xed_view_init (XedView *view)
         gtk_target_list_add_uri_targets (tl, TARGET_URI_LIST);
     }
 
-    view->priv->extensions = peas_extension_set_new (PEAS_ENGINE (xed_plugins_engine_get_default ()),
-                                                     XED_TYPE_VIEW_ACTIVATABLE, "view", view, NULL);
-
-    g_signal_connect (view->priv->extensions, "extension-added",
-                      G_CALLBACK (extension_added), view);
-    g_signal_connect (view->priv->extensions, "extension-removed",
-                      G_CALLBACK (extension_removed), view);
-
     /* Act on buffer change */
     g_signal_connect(view, "notify::buffer", G_CALLBACK (on_notify_buffer_cb), NULL);
 }
@@ -434,6 +429,16 @@ xed_view_realize (GtkWidget *widget)
 
     if (!view->priv->view_realized)
     {
+        /* Created here rather than in init, views of tabs nobody looks
+         * at do not need their plugins */
+        view->priv->extensions = peas_extension_set_new (PEAS_ENGINE (xed_plugins_engine_get_default ()),
+                                                         XED_TYPE_VIEW_ACTIVATABLE, "view", view, NULL);
+
+        g_signal_connect (view->priv->extensions, "extension-added",
+                          G_CALLBACK (extension_added), view);
+        g_signal_connect (view->priv->extensions, "extension-removed",
+                          G_CALLBACK (extension_removed), view);
+
         peas_extension_set_call (view->priv->extensions, "activate");
         view->priv->view_realized = TRUE;
     }
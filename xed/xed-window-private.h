@@ -52,6 +52,7 @@ struct _XedWindowPrivate
 
     GtkWidget *side_panel;
     GtkWidget *bottom_panel;
+    GtkWidget *search_results_panel;
 
     GtkWidget *hpaned;
     GtkWidget *vpaned;
@@ -85,6 +86,14 @@ struct _XedWindowPrivate
     guint      use_word_wrap_id;
     guint      show_overview_map_id;
 
+    /* tab stops of the line holding the cursor, used to compute the
+     * visual column shown in the statusbar without rescanning the line */
+    GtkTextBuffer *column_cache_buffer;
+    GArray        *column_cache_tabs;
+    gint           column_cache_line;
+    gint           column_cache_scanned;
+    guint          column_cache_tab_size;
+
     /* Menus & Toolbars */
     GtkUIManager   *manager;
     GtkActionGroup *action_group;
@@ -109,6 +118,9 @@ struct _XedWindowPrivate
     XedTab *active_tab;
     gint    num_tabs;
 
+    /* tabs holding their contents, most recently shown first */
+    GList  *loaded_tabs;
+
     gint num_tabs_with_error;
 
     gint            width;
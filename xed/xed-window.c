@@ -21,6 +21,7 @@
 #include "xed-document-private.h"
 #include "xed-panel.h"
 #include "xed-documents-panel.h"
+#include "xed-search-results-panel.h"
 #include "xed-plugins-engine.h"
 #include "xed-window-activatable.h"
 #include "xed-enum-types.h"
@@ -28,6 +29,7 @@
 #include "xed-status-menu-button.h"
 #include "xed-highlight-mode-selector.h"
 #include "xed-settings.h"
+#include "xed-trace.h"
 
 #define LANGUAGE_NONE  (const gchar *)"LangNone"
 #define TAB_WIDTH_DATA "XedWindowTabWidthData"
@@ -263,8 +265,13 @@ xed_window_dispose (GObject *object)
 static void
 xed_window_finalize (GObject *object)
 {
+    XedWindow *window = XED_WINDOW (object);
+
     xed_debug (DEBUG_WINDOW);
 
+    g_array_free (window->priv->column_cache_tabs, TRUE);
+    g_list_free (window->priv->loaded_tabs);
+
     G_OBJECT_CLASS (xed_window_parent_class)->finalize (object);
 }
 
@@ -651,14 +658,16 @@ set_sensitivity_according_to_tab (XedWindow *window,
                     action,
                     (state_normal || (state == XED_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION)
                     || (state == XED_TAB_STATE_SHOWING_PRINT_PREVIEW))
-                    && !xed_document_get_readonly (doc));
+                    && !xed_document_get_readonly (doc)
+                    && !_xed_tab_is_large_file (tab));
 
     action = gtk_action_group_get_action (window->priv->action_group, "FileSaveAs");
     gtk_action_set_sensitive (
                     action,
                     (state_normal || (state == XED_TAB_STATE_SAVING_ERROR)
                     || (state == XED_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION)
-                    || (state == XED_TAB_STATE_SHOWING_PRINT_PREVIEW)));
+                    || (state == XED_TAB_STATE_SHOWING_PRINT_PREVIEW))
+                    && !_xed_tab_is_large_file (tab));
 
     action = gtk_action_group_get_action (window->priv->action_group, "FileRevert");
     gtk_action_set_sensitive (
@@ -682,10 +691,10 @@ set_sensitivity_according_to_tab (XedWindow *window,
                     && (state != XED_TAB_STATE_SAVING_ERROR));
 
     action = gtk_action_group_get_action (window->priv->action_group, "EditUndo");
-    gtk_action_set_sensitive (action, state_normal && gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER(doc)));
+    gtk_action_set_sensitive (action, state_normal && _xed_document_can_undo (doc));
 
     action = gtk_action_group_get_action (window->priv->action_group, "EditRedo");
-    gtk_action_set_sensitive (action, state_normal && gtk_source_buffer_can_redo (GTK_SOURCE_BUFFER(doc)));
+    gtk_action_set_sensitive (action, state_normal && _xed_document_can_redo (doc));
 
     action = gtk_action_group_get_action (window->priv->action_group, "EditCut");
     gtk_action_set_sensitive (action,
@@ -1762,13 +1771,184 @@ clone_window (XedWindow *origin)
     return window;
 }
 
+/* A tab found in the cached line: its offset in the line and the visual
+ * column right after it. Since every other char takes exactly one column,
+ * the column of any offset can be derived from the closest preceding tab. */
+typedef struct
+{
+    gint offset;
+    gint column;
+} ColumnTabStop;
+
+static void
+column_cache_invalidate (XedWindow *window)
+{
+    window->priv->column_cache_buffer = NULL;
+    window->priv->column_cache_line = -1;
+    window->priv->column_cache_scanned = 0;
+    g_array_set_size (window->priv->column_cache_tabs, 0);
+}
+
+/* Forget what we know about the cached line from @offset onwards */
+static void
+column_cache_truncate (XedWindow *window,
+                       gint       offset)
+{
+    GArray *tabs = window->priv->column_cache_tabs;
+
+    if (offset < window->priv->column_cache_scanned)
+    {
+        window->priv->column_cache_scanned = offset;
+    }
+
+    while (tabs->len > 0 && g_array_index (tabs, ColumnTabStop, tabs->len - 1).offset >= offset)
+    {
+        g_array_set_size (tabs, tabs->len - 1);
+    }
+}
+
+static gint
+column_cache_lookup (XedWindow *window,
+                     gint       offset)
+{
+    GArray *tabs = window->priv->column_cache_tabs;
+    ColumnTabStop *stop;
+    guint low = 0;
+    guint high = tabs->len;
+
+    /* find the first tab at or after offset */
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+
+        if (g_array_index (tabs, ColumnTabStop, mid).offset < offset)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (low == 0)
+    {
+        return offset;
+    }
+
+    stop = &g_array_index (tabs, ColumnTabStop, low - 1);
+
+    return stop->column + (offset - stop->offset - 1);
+}
+
+static gboolean
+is_tab_char (gunichar ch,
+             gpointer user_data)
+{
+    return ch == '\t';
+}
+
+/* Record the tabs between the end of the scanned part of the line and @limit */
+static void
+column_cache_scan (XedWindow         *window,
+                   GtkTextBuffer     *buffer,
+                   const GtkTextIter *limit)
+{
+    GtkTextIter iter;
+    gboolean found;
+
+    gtk_text_buffer_get_iter_at_line_offset (buffer, &iter,
+                                             window->priv->column_cache_line,
+                                             window->priv->column_cache_scanned);
+
+    found = gtk_text_iter_get_char (&iter) == '\t' ||
+            gtk_text_iter_forward_find_char (&iter, is_tab_char, NULL, limit);
+
+    while (found && gtk_text_iter_compare (&iter, limit) < 0)
+    {
+        ColumnTabStop stop;
+        guint tab_size = window->priv->column_cache_tab_size;
+        gint col;
+
+        stop.offset = gtk_text_iter_get_line_offset (&iter);
+        col = column_cache_lookup (window, stop.offset);
+        stop.column = col + (tab_size - (col % tab_size));
+        g_array_append_val (window->priv->column_cache_tabs, stop);
+
+        found = gtk_text_iter_forward_find_char (&iter, is_tab_char, NULL, limit);
+    }
+
+    window->priv->column_cache_scanned = gtk_text_iter_get_line_offset (limit);
+}
+
+static void
+column_cache_insert_text_cb (GtkTextBuffer *buffer,
+                             GtkTextIter   *location,
+                             const gchar   *text,
+                             gint           len,
+                             XedWindow     *window)
+{
+    gint line;
+
+    if (buffer != window->priv->column_cache_buffer)
+    {
+        return;
+    }
+
+    line = gtk_text_iter_get_line (location);
+
+    if (line == window->priv->column_cache_line)
+    {
+        column_cache_truncate (window, gtk_text_iter_get_line_offset (location));
+    }
+    else if (line < window->priv->column_cache_line)
+    {
+        gint delimiter;
+        gint next_start;
+
+        /* the cached line only moves if new lines are inserted above it */
+        pango_find_paragraph_boundary (text, len, &delimiter, &next_start);
+        if (delimiter < len)
+        {
+            column_cache_invalidate (window);
+        }
+    }
+}
+
+static void
+column_cache_delete_range_cb (GtkTextBuffer *buffer,
+                              GtkTextIter   *start,
+                              GtkTextIter   *end,
+                              XedWindow     *window)
+{
+    gint start_line;
+    gint end_line;
+
+    if (buffer != window->priv->column_cache_buffer)
+    {
+        return;
+    }
+
+    start_line = gtk_text_iter_get_line (start);
+    end_line = gtk_text_iter_get_line (end);
+
+    if (start_line == window->priv->column_cache_line)
+    {
+        column_cache_truncate (window, gtk_text_iter_get_line_offset (start));
+    }
+    else if (start_line < window->priv->column_cache_line && start_line != end_line)
+    {
+        column_cache_invalidate (window);
+    }
+}
+
 static void
 update_cursor_position_statusbar (GtkTextBuffer *buffer,
                                   XedWindow *window)
 {
     gint row, col;
+    gint offset;
     GtkTextIter iter;
-    GtkTextIter start;
     guint tab_size;
     XedView *view;
 
@@ -1784,27 +1964,31 @@ update_cursor_position_statusbar (GtkTextBuffer *buffer,
     gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
 
     row = gtk_text_iter_get_line (&iter);
-
-    start = iter;
-    gtk_text_iter_set_line_offset (&start, 0);
-    col = 0;
+    offset = gtk_text_iter_get_line_offset (&iter);
 
     tab_size = gtk_source_view_get_tab_width (GTK_SOURCE_VIEW(view));
 
-    while (!gtk_text_iter_equal (&start, &iter))
+    if (buffer != window->priv->column_cache_buffer ||
+        row != window->priv->column_cache_line ||
+        tab_size != window->priv->column_cache_tab_size)
     {
-        /* FIXME: Are we Unicode compliant here? */
-        if (gtk_text_iter_get_char (&start) == '\t')
-        {
-            col += (tab_size - (col % tab_size));
-        }
-        else
-        {
-            ++col;
-        }
-        gtk_text_iter_forward_char (&start);
+        column_cache_invalidate (window);
+        window->priv->column_cache_buffer = buffer;
+        window->priv->column_cache_line = row;
+        window->priv->column_cache_tab_size = tab_size;
+    }
+
+    /* Only the part of the line not seen yet has to be walked, so moving
+     * around a very long line or typing in it does not rescan it each time */
+    if (offset > window->priv->column_cache_scanned)
+    {
+        column_cache_scan (window, buffer, &iter);
     }
 
+    col = column_cache_lookup (window, offset);
+
+    row += _xed_tab_get_first_line (xed_window_get_active_tab (window));
+
     xed_statusbar_set_cursor_position (XED_STATUSBAR(window->priv->statusbar), row + 1, col + 1);
 }
 
@@ -2081,6 +2265,50 @@ show_overview_map_changed (GObject    *object,
     g_signal_handlers_unblock_by_func (action, G_CALLBACK (_xed_cmd_view_toggle_overview_map), window);
 }
 
+/* Unloads the unmodified tabs shown least recently once the text held by
+ * the tabs of the window goes over the configured size. The size is in
+ * millions of characters, which the buffers count for free, rather than
+ * in bytes. */
+static void
+limit_loaded_tabs (XedWindow *window)
+{
+    guint limit;
+    gint64 max_size;
+    gint64 total = 0;
+    GList *l;
+
+    limit = g_settings_get_uint (window->priv->editor_settings, XED_SETTINGS_MAX_LOADED_TABS_SIZE);
+
+    if (limit == 0)
+    {
+        return;
+    }
+
+    max_size = (gint64) limit * 1000 * 1000;
+
+    l = window->priv->loaded_tabs;
+
+    while (l != NULL)
+    {
+        XedTab *tab = l->data;
+        GList *next = l->next;
+        gint size;
+
+        size = gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (xed_tab_get_document (tab)));
+
+        if (total + size > max_size && tab != window->priv->active_tab && _xed_tab_unload (tab))
+        {
+            window->priv->loaded_tabs = g_list_delete_link (window->priv->loaded_tabs, l);
+        }
+        else
+        {
+            total += size;
+        }
+
+        l = next;
+    }
+}
+
 static void
 notebook_switch_page (GtkNotebook *book,
                       GtkWidget *pg,
@@ -2132,6 +2360,14 @@ notebook_switch_page (GtkNotebook *book,
     /* set the active tab */
     window->priv->active_tab = tab;
 
+    if (_xed_tab_is_placeholder (tab))
+    {
+        _xed_tab_materialize (tab);
+    }
+
+    window->priv->loaded_tabs = g_list_remove (window->priv->loaded_tabs, tab);
+    window->priv->loaded_tabs = g_list_prepend (window->priv->loaded_tabs, tab);
+
     set_title (window);
     set_sensitivity_according_to_tab (window, tab);
 
@@ -2369,6 +2605,12 @@ sync_state (XedTab *tab,
 {
     xed_debug (DEBUG_WINDOW);
     update_window_state (window);
+
+    if (xed_tab_get_state (tab) == XED_TAB_STATE_NORMAL)
+    {
+        limit_loaded_tabs (window);
+    }
+
     if (tab != window->priv->active_tab)
     {
         return;
@@ -2677,7 +2919,7 @@ can_undo (XedDocument *doc,
     GtkAction *action;
     gboolean sensitive;
 
-    sensitive = gtk_source_buffer_can_undo (GTK_SOURCE_BUFFER(doc));
+    sensitive = _xed_document_can_undo (doc);
 
     if (doc != xed_window_get_active_document (window))
     {
@@ -2696,7 +2938,7 @@ can_redo (XedDocument *doc,
     GtkAction *action;
     gboolean sensitive;
 
-    sensitive = gtk_source_buffer_can_redo (GTK_SOURCE_BUFFER(doc));
+    sensitive = _xed_document_can_redo (doc);
 
     if (doc != xed_window_get_active_document (window))
     {
@@ -2802,6 +3044,12 @@ notebook_tab_added (XedNotebook *notebook,
 
     ++window->priv->num_tabs;
 
+    /* Switching to the tab may have added it already */
+    if (!_xed_tab_is_placeholder (tab) && g_list_find (window->priv->loaded_tabs, tab) == NULL)
+    {
+        window->priv->loaded_tabs = g_list_append (window->priv->loaded_tabs, tab);
+    }
+
     update_sensitivity_according_to_open_tabs (window);
 
     view = xed_tab_get_view (tab);
@@ -2815,6 +3063,8 @@ notebook_tab_added (XedNotebook *notebook,
     g_signal_connect (tab, "notify::can-close", G_CALLBACK (sync_can_close), window);
 
     g_signal_connect (doc, "cursor-moved", G_CALLBACK (update_cursor_position_statusbar), window);
+    g_signal_connect (doc, "insert-text", G_CALLBACK (column_cache_insert_text_cb), window);
+    g_signal_connect (doc, "delete-range", G_CALLBACK (column_cache_delete_range_cb), window);
     g_signal_connect (doc, "notify::search-text", G_CALLBACK (search_text_notify_cb), window);
     g_signal_connect (doc, "notify::can-undo", G_CALLBACK (can_undo), window);
     g_signal_connect (doc, "notify::can-redo", G_CALLBACK (can_redo), window);
@@ -2849,6 +3099,8 @@ notebook_tab_removed (XedNotebook *notebook,
 
     --window->priv->num_tabs;
 
+    window->priv->loaded_tabs = g_list_remove (window->priv->loaded_tabs, tab);
+
     view = xed_tab_get_view (tab);
     frame = XED_VIEW_FRAME (_xed_tab_get_view_frame (tab));
     doc = xed_tab_get_document (tab);
@@ -2857,6 +3109,8 @@ notebook_tab_removed (XedNotebook *notebook,
     g_signal_handlers_disconnect_by_func (tab, G_CALLBACK (sync_state), window);
     g_signal_handlers_disconnect_by_func (tab, G_CALLBACK (sync_can_close), window);
     g_signal_handlers_disconnect_by_func (doc, G_CALLBACK (update_cursor_position_statusbar), window);
+    g_signal_handlers_disconnect_by_func (doc, G_CALLBACK (column_cache_insert_text_cb), window);
+    g_signal_handlers_disconnect_by_func (doc, G_CALLBACK (column_cache_delete_range_cb), window);
     g_signal_handlers_disconnect_by_func (doc, G_CALLBACK (search_text_notify_cb), window);
     g_signal_handlers_disconnect_by_func (doc, G_CALLBACK (can_undo), window);
     g_signal_handlers_disconnect_by_func (doc, G_CALLBACK (can_redo), window);
@@ -2867,6 +3121,11 @@ notebook_tab_removed (XedNotebook *notebook,
     g_signal_handlers_disconnect_by_func (view, G_CALLBACK (editable_changed), window);
     g_signal_handlers_disconnect_by_func (view, G_CALLBACK (drop_uris_cb), NULL);
 
+    if (GTK_TEXT_BUFFER (doc) == window->priv->column_cache_buffer)
+    {
+        column_cache_invalidate (window);
+    }
+
     if (window->priv->tab_width_id && tab == xed_window_get_active_tab (window))
     {
         g_signal_handler_disconnect (view, window->priv->tab_width_id);
@@ -3338,7 +3597,9 @@ extension_added (PeasExtensionSet *extensions,
                  PeasExtension    *exten,
                  XedWindow        *window)
 {
+    xed_trace_begin ("window-plugins", peas_plugin_info_get_module_name (info));
     peas_extension_call (exten, "activate");
+    xed_trace_end ("window-plugins", peas_plugin_info_get_module_name (info));
 }
 
 static void
@@ -3370,6 +3631,8 @@ xed_window_init (XedWindow *window)
     window->priv->inhibition_cookie = 0;
     window->priv->dispose_has_run = FALSE;
     window->priv->fullscreen_controls = NULL;
+    window->priv->column_cache_tabs = g_array_new (FALSE, FALSE, sizeof (ColumnTabStop));
+    window->priv->column_cache_line = -1;
     window->priv->editor_settings = g_settings_new ("org.x.editor.preferences.editor");
     window->priv->ui_settings = g_settings_new ("org.x.editor.preferences.ui");
 
@@ -3635,7 +3898,16 @@ xed_window_create_tab_from_location (XedWindow               *window,
     g_return_val_if_fail(XED_IS_WINDOW (window), NULL);
     g_return_val_if_fail(G_IS_FILE (location), NULL);
 
-    tab = _xed_tab_new_from_location (location, encoding, line_pos, create);
+    /* Tabs opened in the background are only read once they are shown */
+    if (!jump_to && window->priv->active_tab != NULL &&
+        g_settings_get_boolean (window->priv->editor_settings, XED_SETTINGS_LAZY_TAB_LOADING))
+    {
+        tab = _xed_tab_new_placeholder (location, encoding, line_pos, create);
+    }
+    else
+    {
+        tab = _xed_tab_new_from_location (location, encoding, line_pos, create);
+    }
 
     return process_create_tab (window, XED_TAB (tab), jump_to);
 }
@@ -4258,3 +4530,21 @@ _xed_window_get_bottom_panel_size (XedWindow *window)
 {
     return window->priv->bottom_panel_size;
 }
+
+/* Added to the bottom panel the first time all the documents are searched */
+GtkWidget *
+_xed_window_get_search_results_panel (XedWindow *window)
+{
+    if (window->priv->search_results_panel == NULL)
+    {
+        window->priv->search_results_panel = xed_search_results_panel_new (window);
+        gtk_widget_show (window->priv->search_results_panel);
+
+        xed_panel_add_item (XED_PANEL (window->priv->bottom_panel),
+                            window->priv->search_results_panel,
+                            _("Search Results"),
+                            "xsi-edit-find-symbolic");
+    }
+
+    return window->priv->search_results_panel;
+}
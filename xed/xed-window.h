@@ -113,6 +113,8 @@ gint _xed_window_get_bottom_panel_size (XedWindow *window);
 XedPaned *_xed_window_get_hpaned (XedWindow *window);
 XedPaned *_xed_window_get_vpaned (XedWindow *window);
 
+GtkWidget *_xed_window_get_search_results_panel (XedWindow *window);
+
 G_END_DECLS
 
 #endif /* __XED_WINDOW_H__ */